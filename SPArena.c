@@ -0,0 +1,309 @@
+/*
+ * SPArena.c
+ */
+
+#define _DEFAULT_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <sys/mman.h>
+#include "SPArena.h"
+
+/*
+ * rounds a size up to the alignment of the allocations
+ */
+#define ALIGN_UP(size) (((size) + SP_ARENA_ALIGNMENT - 1) & ~((size_t) SP_ARENA_ALIGNMENT - 1))
+
+/*
+ * A block of memory. The blocks form a list in allocation order, the blocks
+ * after the current one are free for reuse.
+ */
+typedef struct sp_arena_block_t {
+	struct sp_arena_block_t* next;
+	size_t size;
+	size_t used;
+	size_t mapped; // the size of the mapping of a block mapped to huge pages, 0 otherwise
+} Block;
+
+/** the space taken at the start of every block by its header **/
+#define HEADER_SIZE ALIGN_UP(sizeof(Block))
+
+struct SPArena {
+	size_t blockSize;
+	Block* first;
+	Block* current;
+	size_t usedBefore; // the bytes used in the blocks before the current one
+	size_t peakBytesUsed;
+	size_t bytesReserved;
+	int blocksCount;
+	long allocationsCount;
+	bool hugePages;
+	int hugeBlocksCount;
+	SP_MEMORY_SUBSYSTEM subsystem; // the subsystem the blocks are charged to
+};
+
+/*
+ * Helper function to get the bytes used in the arena
+ */
+size_t bytesUsed(SPArena* arena) {
+	return arena->usedBefore + (arena->current == NULL ? 0 : arena->current->used);
+}
+
+/*
+ * Helper function to map a block with room for the given size to huge pages
+ *
+ * @return NULL if the block is smaller than a huge page or can't be mapped
+ */
+Block* mapHugeBlock(size_t size) {
+	Block* block = MAP_FAILED;
+	size_t mapped = HEADER_SIZE + size;
+
+#if defined(MAP_ANONYMOUS)
+	if (mapped < SP_ARENA_HUGE_PAGE_SIZE) {
+		return NULL;
+	}
+	mapped = (mapped + SP_ARENA_HUGE_PAGE_SIZE - 1)
+			& ~((size_t) SP_ARENA_HUGE_PAGE_SIZE - 1);
+#if defined(MAP_HUGETLB)
+	block = (Block*) mmap(NULL, mapped, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+	// without reserved huge pages, the kernel may still back the block with transparent ones
+	if (block == MAP_FAILED) {
+		block = (Block*) mmap(NULL, mapped, PROT_READ | PROT_WRITE,
+				MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+#if defined(MADV_HUGEPAGE)
+		if (block != MAP_FAILED) {
+			madvise(block, mapped, MADV_HUGEPAGE);
+		}
+#endif
+	}
+#endif
+	if (block == MAP_FAILED) {
+		return NULL;
+	}
+	block->size = mapped - HEADER_SIZE;
+	block->mapped = mapped;
+	return block;
+}
+
+/*
+ * Helper function to allocate a block with room for the given size, mapping a
+ * large block of an arena for huge pages to them
+ */
+Block* allocBlock(SPArena* arena, size_t size) {
+	Block* block = arena->hugePages ? mapHugeBlock(size) : NULL;
+
+	if (block != NULL) {
+		arena->hugeBlocksCount++;
+		return block;
+	}
+	block = (Block*) malloc(HEADER_SIZE + size);
+	if (block != NULL) {
+		block->size = size;
+		block->mapped = 0;
+	}
+	return block;
+}
+
+/*
+ * Helper function to release a block
+ */
+void freeBlock(Block* block) {
+	if (block->mapped != 0) {
+		munmap(block, block->mapped);
+	} else {
+		free(block);
+	}
+}
+
+/*
+ * Helper function to move to the next block which has room for the given size,
+ * reusing free blocks which are large enough, and inserting a new block otherwise
+ */
+Block* nextBlock(SPArena* arena, size_t size) {
+	Block* block = arena->current == NULL ? arena->first : arena->current->next;
+	Block* previous = arena->current;
+	size_t blockSize = size > arena->blockSize ? size : arena->blockSize;
+
+	// skip free blocks too small for an allocation which didn't fit the blocks
+	while (block != NULL && block->size < size) {
+		previous = block;
+		block = block->next;
+	}
+	if (block == NULL) {
+		block = allocBlock(arena, blockSize);
+		if (block == NULL) {
+			return NULL;
+		}
+		block->next = NULL;
+		if (previous == NULL) {
+			arena->first = block;
+		} else {
+			previous->next = block;
+		}
+		arena->bytesReserved += HEADER_SIZE + block->size;
+		arena->blocksCount++;
+		spMemoryCharge(arena->subsystem, HEADER_SIZE + block->size);
+	}
+
+	// skipped blocks stay unused until a rewind before them
+	if (arena->current != NULL) {
+		arena->usedBefore += arena->current->used;
+	}
+	for (previous = arena->current == NULL ? arena->first : arena->current->next;
+			previous != block; previous = previous->next) {
+		previous->used = previous->size;
+		arena->usedBefore += previous->used;
+	}
+	block->used = 0;
+	arena->current = block;
+	return block;
+}
+
+SPArena* spArenaCreate(size_t blockSize) {
+	SPArena* arena;
+
+	if (blockSize == 0) {
+		return NULL;
+	}
+	arena = (SPArena*) calloc(1, sizeof(SPArena));
+	if (arena == NULL) {
+		return NULL;
+	}
+	arena->blockSize = ALIGN_UP(blockSize);
+	arena->subsystem = SP_MEMORY_UNCHARGED;
+	return arena;
+}
+
+SPArena* spArenaCreateHuge(size_t blockSize) {
+	SPArena* arena = spArenaCreate(blockSize);
+
+	if (arena != NULL) {
+		arena->hugePages = true;
+	}
+	return arena;
+}
+
+void spArenaDestroy(SPArena* arena) {
+	Block* block;
+	Block* next;
+
+	if (arena == NULL) {
+		return;
+	}
+	for (block = arena->first; block != NULL; block = next) {
+		next = block->next;
+		freeBlock(block);
+	}
+	spMemoryRelease(arena->subsystem, arena->bytesReserved);
+	free(arena);
+}
+
+void* spArenaAlloc(SPArena* arena, size_t size) {
+	Block* block;
+	void* memory;
+	size_t used;
+
+	if (arena == NULL || size == 0) {
+		return NULL;
+	}
+	size = ALIGN_UP(size);
+	block = arena->current;
+	if (block == NULL || block->size - block->used < size) {
+		block = nextBlock(arena, size);
+		if (block == NULL) {
+			return NULL;
+		}
+	}
+
+	memory = (char*) block + HEADER_SIZE + block->used;
+	block->used += size;
+	arena->allocationsCount++;
+	used = bytesUsed(arena);
+	if (used > arena->peakBytesUsed) {
+		arena->peakBytesUsed = used;
+	}
+	return memory;
+}
+
+void* spArenaCalloc(SPArena* arena, size_t count, size_t size) {
+	void* memory;
+
+	if (size != 0 && count > (size_t) -1 / size) {
+		return NULL;
+	}
+	memory = spArenaAlloc(arena, count * size);
+	if (memory != NULL) {
+		memset(memory, 0, count * size);
+	}
+	return memory;
+}
+
+SPArenaMark spArenaGetMark(SPArena* arena) {
+	SPArenaMark mark;
+	mark.block = arena->current;
+	mark.used = arena->current == NULL ? 0 : arena->current->used;
+	return mark;
+}
+
+void spArenaRewind(SPArena* arena, SPArenaMark mark) {
+	Block* block;
+
+	if (mark.block == NULL) {
+		spArenaReset(arena);
+		return;
+	}
+	arena->usedBefore = 0;
+	for (block = arena->first; block != mark.block; block = block->next) {
+		arena->usedBefore += block->used;
+	}
+	arena->current = (Block*) mark.block;
+	arena->current->used = mark.used;
+}
+
+void spArenaReset(SPArena* arena) {
+	if (arena != NULL) {
+		arena->current = NULL;
+		arena->usedBefore = 0;
+	}
+}
+
+void spArenaChargeTo(SPArena* arena, SP_MEMORY_SUBSYSTEM subsystem) {
+	if (arena == NULL) {
+		return;
+	}
+	spMemoryRelease(arena->subsystem, arena->bytesReserved);
+	spMemoryCharge(subsystem, arena->bytesReserved);
+	arena->subsystem = subsystem;
+}
+
+void spArenaGetStats(SPArena* arena, SPArenaStats* stats) {
+	stats->bytesUsed = bytesUsed(arena);
+	stats->peakBytesUsed = arena->peakBytesUsed;
+	stats->bytesReserved = arena->bytesReserved;
+	stats->blocksCount = arena->blocksCount;
+	stats->allocationsCount = arena->allocationsCount;
+	stats->hugeBlocksCount = arena->hugeBlocksCount;
+}
+
+void* spArenaAllocHuge(size_t size) {
+	Block* block = mapHugeBlock(size);
+
+	if (block == NULL) {
+		block = (Block*) malloc(HEADER_SIZE + size);
+		if (block == NULL) {
+			return NULL;
+		}
+		block->size = size;
+		block->mapped = 0;
+	}
+	return (char*) block + HEADER_SIZE;
+}
+
+void spArenaFreeHuge(void* memory) {
+	if (memory != NULL) {
+		freeBlock((Block*) ((char*) memory - HEADER_SIZE));
+	}
+}
@@ -0,0 +1,166 @@
+/*
+ * SPArena.h
+ */
+
+#ifndef SPARENA_H_
+#define SPARENA_H_
+
+#include <stddef.h>
+#include "SPMemory.h"
+
+/*
+ * A bump allocator. Memory is handed out sequentially from large blocks and is
+ * never freed individually: it is released all at once when the arena is
+ * destroyed, or back to a mark taken earlier, which makes the arena suited to
+ * data whose lifetime is nested, such as the nodes of a tree or the scratch
+ * of a recursive build. Blocks released by a rewind are kept for reuse.
+ *
+ * An arena must not be used by several threads at once.
+ *
+ * An arena created for huge pages maps its large blocks to huge pages, which
+ * spares the TLB misses of searching large structures such as the kd-trees.
+ */
+struct SPArena;
+typedef struct SPArena SPArena;
+
+/** the alignment of every allocation **/
+#define SP_ARENA_ALIGNMENT 16
+
+/** the size of a huge page, blocks of an arena for huge pages at least this large use them **/
+#define SP_ARENA_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+/*
+ * A position in an arena, everything allocated after it is released by a rewind
+ */
+typedef struct sp_arena_mark_t {
+	void* block;
+	size_t used;
+} SPArenaMark;
+
+/*
+ * Statistics on the memory of an arena
+ */
+typedef struct sp_arena_stats_t {
+	size_t bytesUsed; // the bytes handed out and not released, including padding
+	size_t peakBytesUsed; // the most bytes used at once
+	size_t bytesReserved; // the bytes of all the blocks, used or not
+	int blocksCount;
+	long allocationsCount; // the number of allocations since the arena was created
+	int hugeBlocksCount; // the blocks mapped to huge pages, explicit or transparent
+} SPArenaStats;
+
+/*
+ * @param blockSize - the size of the blocks allocations are made from. Larger
+ * 		  allocations get a block of their own.
+ *
+ * @return NULL if blockSize is 0 or on allocation failure
+ * @return a new arena with no blocks, the first is allocated on demand
+ */
+SPArena* spArenaCreate(size_t blockSize);
+
+/*
+ * @param blockSize - the size of the blocks allocations are made from
+ *
+ * The function creates an arena like spArenaCreate, whose blocks of at least
+ * SP_ARENA_HUGE_PAGE_SIZE are mapped to explicit huge pages when the system has
+ * some reserved, and otherwise to pages the kernel is advised to back with
+ * transparent huge pages. Smaller blocks, and blocks which can't be mapped, are
+ * allocated as usual. A mapped block is extended to a whole number of huge pages.
+ *
+ * @return NULL if blockSize is 0 or on allocation failure
+ * @return a new arena with no blocks, the first is allocated on demand
+ */
+SPArena* spArenaCreateHuge(size_t blockSize);
+
+/*
+ * @param arena - an arena
+ *
+ * The function releases all the memory allocated from the arena, and the arena
+ *
+ */
+void spArenaDestroy(SPArena* arena);
+
+/*
+ * @param arena - an arena
+ * @param size - the number of bytes to allocate
+ *
+ * @return NULL on invalid argument or allocation failure
+ * @return uninitialized memory of the given size, aligned to SP_ARENA_ALIGNMENT
+ */
+void* spArenaAlloc(SPArena* arena, size_t size);
+
+/*
+ * @param arena - an arena
+ * @param count - the number of elements
+ * @param size - the size of each element
+ *
+ * @return like spArenaAlloc, but the memory is zeroed
+ */
+void* spArenaCalloc(SPArena* arena, size_t count, size_t size);
+
+/*
+ * @param arena - an arena
+ *
+ * @return the current position in the arena, to rewind to later
+ */
+SPArenaMark spArenaGetMark(SPArena* arena);
+
+/*
+ * @param arena - an arena
+ * @param mark - a mark taken from the arena, after the last rewind to an
+ * 		  earlier mark
+ *
+ * The function releases everything allocated after the mark was taken
+ *
+ */
+void spArenaRewind(SPArena* arena, SPArenaMark mark);
+
+/*
+ * @param arena - an arena
+ *
+ * The function releases everything allocated from the arena, keeping its blocks
+ *
+ */
+void spArenaReset(SPArena* arena);
+
+/*
+ * @param arena - an arena
+ * @param subsystem - the subsystem the memory of the arena belongs to
+ *
+ * The function charges the blocks of the arena, the ones allocated already and
+ * the ones to come, to the subsystem, until the arena is destroyed, see
+ * SPMemory.h. The blocks of a new arena are charged to no subsystem.
+ *
+ */
+void spArenaChargeTo(SPArena* arena, SP_MEMORY_SUBSYSTEM subsystem);
+
+/*
+ * @param arena - an arena
+ * @param stats - an output parameter for the statistics of the arena
+ *
+ */
+void spArenaGetStats(SPArena* arena, SPArenaStats* stats);
+
+/*
+ * @param size - the size of the allocation
+ *
+ * Allocates memory outside of any arena the way an arena for huge pages
+ * allocates its large blocks, for a single large structure such as the
+ * coordinates of all the features, which is searched as the kd-trees are.
+ * Allocations smaller than a huge page, or which can't be mapped, fall back
+ * to malloc. The memory isn't charged to any subsystem.
+ *
+ * @return NULL on allocation failure, the memory aligned to SP_ARENA_ALIGNMENT
+ * 		   otherwise, which is released with spArenaFreeHuge
+ */
+void* spArenaAllocHuge(size_t size);
+
+/*
+ * @param memory - memory allocated by spArenaAllocHuge, or NULL
+ *
+ * The function releases the memory
+ *
+ */
+void spArenaFreeHuge(void* memory);
+
+#endif /* SPARENA_H_ */
@@ -1,6 +1,7 @@
 #include <stdlib.h>
 #include "SPBPriorityQueue.h"
 #include "SPList.h"
+#include "SPMemory.h"
 
 
 struct sp_bp_queue_t{
@@ -9,24 +10,43 @@ struct sp_bp_queue_t{
 };
 
 
-SPBPQueue spBPQueueCreate(int maxSize){
-	SPBPQueue queue = malloc(sizeof(struct sp_bp_queue_t));
-	queue->capacity = maxSize;
-	queue->list = spListCreate();
+/*
+ * Helper function to allocate a queue around a list, charging it only once
+ * both are allocated
+ *
+ * @return NULL if list is NULL or on allocation failure, the list is destroyed
+ */
+SPBPQueue createQueueWithList(int capacity, SPList list){
+	SPBPQueue queue;
+
+	if (list == NULL){
+		return NULL;
+	}
+	queue = malloc(sizeof(struct sp_bp_queue_t));
+	if (queue == NULL){
+		spListDestroy(list);
+		return NULL;
+	}
+	spMemoryCharge(SP_MEMORY_LIST, sizeof(struct sp_bp_queue_t));
+	queue->capacity = capacity;
+	queue->list = list;
 	return queue;
 }
 
 
+SPBPQueue spBPQueueCreate(int maxSize){
+	return createQueueWithList(maxSize, spListCreate());
+}
+
+
 SPBPQueue spBPQueueCopy(SPBPQueue source){
-	SPBPQueue queue = malloc(sizeof(struct sp_bp_queue_t));
-	queue->capacity = source->capacity;
-	queue->list = spListCopy(source->list);
-	return queue;
+	return createQueueWithList(source->capacity, spListCopy(source->list));
 }
 
 
 void spBPQueueDestroy(SPBPQueue source){
 	spListDestroy(source->list);
+	spMemoryRelease(SP_MEMORY_LIST, sizeof(struct sp_bp_queue_t));
 	free(source);
 }
 
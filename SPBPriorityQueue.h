@@ -23,11 +23,15 @@ typedef enum sp_bp_queue_msg_t {
 
 /**
  * The function creates an empty priority queue of capacity maxSize
+ *
+ * @return NULL on allocation failure
  */
 SPBPQueue spBPQueueCreate(int maxSize);
 
 /**
  * The function creates a copy of the given priority queue
+ *
+ * @return NULL on allocation failure
  */
 SPBPQueue spBPQueueCopy(SPBPQueue source);
 
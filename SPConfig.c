@@ -7,6 +7,7 @@
 
 #include "SPConfig.h"
 #include "SPLogger.h"
+#include "SPTokenizer.h"
 
 /** default values for configuration **/
 #define spPCADimensionDefault 20
@@ -17,8 +18,18 @@
 #define spLoggerLevelDefault 3
 #define spLoggerFilenameDefault "stdout"
 #define spKDTreeSplitMethodDefault MAX_SPREAD
+#define spKDTreeBuildMethodDefault PRESORT
+#define spKDTreeLayoutDefault DEPTH_FIRST
 #define spExtractionModeDefault true
 #define spMinimalGuiDefault false
+#define spAppendModeDefault false
+#define spNumOfShardsDefault 1
+#define spNumaReplicationDefault false
+#define spExtractionThreadsDefault 0
+#define spMaxImageSideDefault 0
+#define spOctaveLayersDefault 3
+#define spEnoughFeaturesDefault 0
+#define spFeaturesFormatDefault TEXT_FEATURES
 
 /**the range of spPCADimension **/
 #define PCADimUpperBound 28
@@ -32,6 +43,7 @@
 #define preffixNotSet "Parameter spImagesPrefix is not set\n"
 #define suffixNotSet "Parameter spImagesSuffix is not set\n"
 #define imageNumNotSet "Parameter spNumOfImages is not set\n"
+#define enoughFeaturesTooMany "Parameters spExtractionEnoughFeatures and spQueryEnoughFeatures can't exceed spNumOfFeatures\n"
 
 /** Error massages reported to logger **/
 #define configIsNull "config is NULL\n"
@@ -57,6 +69,19 @@ struct sp_config_t {
 	bool spMinimalGUI;
 	int spLoggerLevel;
 	char spLoggerFilename[MAX_SIZE];
+	bool spAppendMode;
+	int spNumOfShards;
+	BuildMethod spKDTreeBuildMethod;
+	TreeLayout spKDTreeLayout;
+	bool spNumaReplication;
+	int spExtractionThreads;
+	int spExtractionMaxImageSide;
+	int spQueryMaxImageSide;
+	int spExtractionOctaveLayers;
+	int spQueryOctaveLayers;
+	int spExtractionEnoughFeatures;
+	int spQueryEnoughFeatures;
+	FeaturesFormat spFeaturesFormat;
 };
 
 /*
@@ -103,10 +128,12 @@ bool getterAssert(const SPConfig config, SP_CONFIG_MSG* msg, const char* func);
 
 SPConfig spConfigCreate(const char* filename, SP_CONFIG_MSG* msg) {
 	SPConfig config = NULL;
-	FILE* file = NULL;
+	char* text = NULL;
+	size_t capacity = 0;
+	SPTokenizer tokenizer;
 	char line[MAX_SIZE] = {'\0'};
 	int lineCounter = 0;
-	int i;
+	SP_TOKENIZER_MSG readMsg;
 
 	assert(msg != NULL);
 
@@ -115,28 +142,35 @@ SPConfig spConfigCreate(const char* filename, SP_CONFIG_MSG* msg) {
 		printf("Warning in %s: %s", __func__, filenameIsNull);
 		return config;
 	}
-	file = fopen(filename, "r");
-	if (file == NULL) {
-		*msg = SP_CONFIG_CANNOT_OPEN_FILE;
+	readMsg = spTokenizerReadFile(filename, &text, &capacity, NULL);
+	if (readMsg != SP_TOKENIZER_SUCCESS) {
+		free(text);
+		*msg = (readMsg == SP_TOKENIZER_ALLOC_FAIL) ?
+				SP_CONFIG_ALLOC_FAIL : SP_CONFIG_CANNOT_OPEN_FILE;
 		return config;
 	}
 
 	config = (SPConfig) malloc(sizeof(struct sp_config_t));
 	if (config == NULL) {
 		*msg = SP_CONFIG_ALLOC_FAIL;
-		free(config);
-		config = NULL;
+		free(text);
 		printf("Warning in %s: %s", __func__, allocFail);
 		return config;
 	}
 
 	initConfiguration(config);
 
-	while (fgets(line, MAX_SIZE, file)) {
+	spTokenizerInit(&tokenizer, text);
+	while (!spTokenizerAtEnd(&tokenizer)) {
 		lineCounter++;
-		parseConfigLine(line, config, msg);
+		// a line too long for any field and value is invalid
+		if (spTokenizerReadLine(&tokenizer, line, MAX_SIZE) < 0) {
+			*msg = SP_CONFIG_INVALID_LINE;
+		} else {
+			parseConfigLine(line, config, msg);
+		}
 		if (*msg != SP_CONFIG_SUCCESS) {
-			fclose(file);
+			free(text);
 			if (*msg == SP_CONFIG_INVALID_LINE) {
 				printErrorInConfig(filename, lineCounter, invalidLine);
 			} else if (*msg == SP_CONFIG_INVALID_INTEGER
@@ -152,14 +186,9 @@ SPConfig spConfigCreate(const char* filename, SP_CONFIG_MSG* msg) {
 			config = NULL;
 			return config;
 		}
-
-		//initialize line to be an array of '\0'
-		for (i = 0; i < MAX_SIZE; i++) {
-			line[i] = '\0';
-		}
 	}
 
-	fclose(file);
+	free(text);
 
 	if (strcmp(config->spImagesDirectory, "") == 0) {
 		*msg = SP_CONFIG_MISSING_DIR;
@@ -173,6 +202,11 @@ SPConfig spConfigCreate(const char* filename, SP_CONFIG_MSG* msg) {
 	} else if (config->spNumOfImages == -1) {
 		*msg = SP_CONFIG_MISSING_NUM_IMAGES;
 		printErrorInConfig(filename, lineCounter, imageNumNotSet);
+	} else if (config->spExtractionEnoughFeatures > config->spNumOfFeatures
+			|| config->spQueryEnoughFeatures > config->spNumOfFeatures) {
+		// SIFT keeps at most spNumOfFeatures keypoints, so they could never be enough
+		*msg = SP_CONFIG_INVALID_INTEGER;
+		printErrorInConfig(filename, lineCounter, enoughFeaturesTooMany);
 	} else {
 		*msg = SP_CONFIG_SUCCESS;
 	}
@@ -192,6 +226,20 @@ bool spConfigIsExtractionMode(const SPConfig config, SP_CONFIG_MSG* msg) {
 	return (config->spExtractionMode == true);
 }
 
+bool spConfigIsAppendMode(const SPConfig config, SP_CONFIG_MSG* msg) {
+	if (!getterAssert(config, msg, __func__)) {
+		return false;
+	}
+	return (config->spAppendMode == true);
+}
+
+bool spConfigIsNumaReplication(const SPConfig config, SP_CONFIG_MSG* msg) {
+	if (!getterAssert(config, msg, __func__)) {
+		return false;
+	}
+	return (config->spNumaReplication == true);
+}
+
 bool spConfigMinimalGui(const SPConfig config, SP_CONFIG_MSG* msg) {
 	if (!getterAssert(config, msg, __func__)) {
 		return false;
@@ -241,6 +289,55 @@ int spConfigGetSpKNN(const SPConfig config, SP_CONFIG_MSG* msg) {
 	return config->spKNN;
 }
 
+int spConfigGetNumOfShards(const SPConfig config, SP_CONFIG_MSG* msg) {
+	if (!getterAssert(config, msg, __func__)) {
+		return -1;
+	}
+	return config->spNumOfShards;
+}
+
+int spConfigGetExtractionThreads(const SPConfig config, SP_CONFIG_MSG* msg) {
+	if (!getterAssert(config, msg, __func__)) {
+		return -1;
+	}
+	return config->spExtractionThreads;
+}
+
+int spConfigGetMaxImageSide(const SPConfig config, ImageRole role,
+		SP_CONFIG_MSG* msg) {
+	if (!getterAssert(config, msg, __func__)) {
+		return -1;
+	}
+	return role == QUERY_IMAGES ?
+			config->spQueryMaxImageSide : config->spExtractionMaxImageSide;
+}
+
+int spConfigGetOctaveLayers(const SPConfig config, ImageRole role,
+		SP_CONFIG_MSG* msg) {
+	if (!getterAssert(config, msg, __func__)) {
+		return -1;
+	}
+	return role == QUERY_IMAGES ?
+			config->spQueryOctaveLayers : config->spExtractionOctaveLayers;
+}
+
+int spConfigGetEnoughFeatures(const SPConfig config, ImageRole role,
+		SP_CONFIG_MSG* msg) {
+	if (!getterAssert(config, msg, __func__)) {
+		return -1;
+	}
+	return role == QUERY_IMAGES ?
+			config->spQueryEnoughFeatures : config->spExtractionEnoughFeatures;
+}
+
+FeaturesFormat spConfigGetFeaturesFormat(const SPConfig config,
+		SP_CONFIG_MSG* msg) {
+	if (!getterAssert(config, msg, __func__)) {
+		return TEXT_FEATURES;
+	}
+	return config->spFeaturesFormat;
+}
+
 char* spConfigGetLogName(const SPConfig config, SP_CONFIG_MSG* msg) {
 	if (!getterAssert(config, msg, __func__)) {
 		return NULL;
@@ -276,6 +373,31 @@ SP_CONFIG_MSG spConfigGetPCAPath(char* pcaPath, const SPConfig config) {
 	return SP_CONFIG_SUCCESS;
 }
 
+SP_CONFIG_MSG spConfigGetShardManifestPath(char* manifestPath,
+		const SPConfig config, int shard) {
+	int pathLength;
+
+	if (manifestPath == NULL || config == NULL) {
+		SP_LOG_WARNING("The function %s was called with an invalid argument",
+				__func__);
+		return SP_CONFIG_INVALID_ARGUMENT;
+	}
+
+	if (shard >= config->spNumOfShards || shard < 0) {
+		SP_LOG_ERROR("The index given to %s is out of range", __func__);
+		return SP_CONFIG_INDEX_OUT_OF_RANGE;
+	}
+
+	pathLength = sprintf(manifestPath, "%sshard%d%s", config->spImagesDirectory,
+			shard, spShardManifestSuffix);
+	if (pathLength < 1) {
+		SP_LOG_ERROR("sprintf function has failed");
+		return SP_CONFIG_UNKNOWN_ERROR;
+	}
+
+	return SP_CONFIG_SUCCESS;
+}
+
 char* spConfigGetDirectory(const SPConfig config, SP_CONFIG_MSG* msg) {
 	if (!getterAssert(config, msg, __func__)) {
 		return NULL;
@@ -311,6 +433,20 @@ SplitMethod spConfigGetSplitMethod(const SPConfig config, SP_CONFIG_MSG* msg) {
 	return config->spKDTreeSplitMethod;
 }
 
+BuildMethod spConfigGetBuildMethod(const SPConfig config, SP_CONFIG_MSG* msg) {
+	assert(msg);
+	assert(config);
+	*msg = SP_CONFIG_SUCCESS;
+	return config->spKDTreeBuildMethod;
+}
+
+TreeLayout spConfigGetTreeLayout(const SPConfig config, SP_CONFIG_MSG* msg) {
+	assert(msg);
+	assert(config);
+	*msg = SP_CONFIG_SUCCESS;
+	return config->spKDTreeLayout;
+}
+
 void spConfigDestroy(SPConfig config) {
 	if (config != NULL) {
 		if (logger != NULL) {
@@ -384,7 +520,8 @@ void parseConfigLine(char* line, SPConfig config, SP_CONFIG_MSG* msg) {
 	 */
 	valueAsNum = convertStringToNum(value);
 	if (fieldId == 4 || fieldId == 5 || fieldId == 7 || fieldId == 9
-			|| fieldId == 11 || fieldId == 13) {
+			|| fieldId == 11 || fieldId == 13 || fieldId == 16
+			|| (fieldId >= 20 && fieldId <= 26)) {
 		if (valueAsNum < 0) {
 			*msg = SP_CONFIG_INVALID_INTEGER;
 			return;
@@ -451,7 +588,7 @@ void parseConfigLine(char* line, SPConfig config, SP_CONFIG_MSG* msg) {
 
 	case 10:
 
-		for (SplitMethod splitMethod = RANDOM; splitMethod <= INCREMENTAL; splitMethod++) {
+		for (SplitMethod splitMethod = RANDOM; splitMethod <= COST_MODEL; splitMethod++) {
 			if (strcmp(value, convertMethodToString((splitMethod))) == 0) {
 				config->spKDTreeSplitMethod = splitMethod;
 				return;
@@ -487,6 +624,100 @@ void parseConfigLine(char* line, SPConfig config, SP_CONFIG_MSG* msg) {
 		strcpy(config->spLoggerFilename, value);
 		break;
 
+	case 15:
+		if (strcmp(value, "true") == 0) {
+			config->spAppendMode = true;
+		} else if (strcmp(value, "false") == 0) {
+			config->spAppendMode = false;
+		} else {
+			*msg = SP_CONFIG_INVALID_BOOLEAN;
+			return;
+		}
+		break;
+
+	case 16:
+		if (valueAsNum < 1) {
+			*msg = SP_CONFIG_INVALID_INTEGER;
+			return;
+		}
+		config->spNumOfShards = valueAsNum;
+		break;
+
+	case 17:
+		for (BuildMethod buildMethod = PRESORT; buildMethod <= SELECTION; buildMethod++) {
+			if (strcmp(value, convertBuildMethodToString(buildMethod)) == 0) {
+				config->spKDTreeBuildMethod = buildMethod;
+				return;
+			}
+		}
+		*msg = SP_CONFIG_INVALID_STRING;
+		return;
+
+	case 18:
+		for (TreeLayout layout = DEPTH_FIRST; layout <= VAN_EMDE_BOAS; layout++) {
+			if (strcmp(value, convertLayoutToString(layout)) == 0) {
+				config->spKDTreeLayout = layout;
+				return;
+			}
+		}
+		*msg = SP_CONFIG_INVALID_STRING;
+		return;
+
+	case 19:
+		if (strcmp(value, "true") == 0) {
+			config->spNumaReplication = true;
+		} else if (strcmp(value, "false") == 0) {
+			config->spNumaReplication = false;
+		} else {
+			*msg = SP_CONFIG_INVALID_BOOLEAN;
+			return;
+		}
+		break;
+
+	case 20:
+		config->spExtractionThreads = valueAsNum;
+		break;
+
+	case 21:
+		config->spExtractionMaxImageSide = valueAsNum;
+		break;
+
+	case 22:
+		config->spQueryMaxImageSide = valueAsNum;
+		break;
+
+	case 23:
+	case 24:
+		if (valueAsNum < 1) {
+			*msg = SP_CONFIG_INVALID_INTEGER;
+			return;
+		}
+		if (fieldId == 23) {
+			config->spExtractionOctaveLayers = valueAsNum;
+		} else {
+			config->spQueryOctaveLayers = valueAsNum;
+		}
+		break;
+
+	case 25:
+		config->spExtractionEnoughFeatures = valueAsNum;
+		break;
+
+	case 26:
+		config->spQueryEnoughFeatures = valueAsNum;
+		break;
+
+	case 27:
+		for (FeaturesFormat format = TEXT_FEATURES; format <= BINARY_FEATURES;
+				format++) {
+			if (strcmp(value, convertFeaturesFormatToString(format)) == 0) {
+				config->spFeaturesFormat = format;
+				return;
+			}
+		}
+		*msg = SP_CONFIG_INVALID_STRING;
+		return;
+
 	default:
 		*msg = SP_CONFIG_INVALID_LINE;
 		return;
@@ -506,6 +737,19 @@ void initConfiguration(SPConfig config) {
 	config->spKDTreeSplitMethod = spKDTreeSplitMethodDefault;
 	config->spKNN = spKNNDefault;
 	config->spMinimalGUI = spMinimalGuiDefault;
+	config->spAppendMode = spAppendModeDefault;
+	config->spNumOfShards = spNumOfShardsDefault;
+	config->spKDTreeBuildMethod = spKDTreeBuildMethodDefault;
+	config->spKDTreeLayout = spKDTreeLayoutDefault;
+	config->spNumaReplication = spNumaReplicationDefault;
+	config->spExtractionThreads = spExtractionThreadsDefault;
+	config->spExtractionMaxImageSide = spMaxImageSideDefault;
+	config->spQueryMaxImageSide = spMaxImageSideDefault;
+	config->spExtractionOctaveLayers = spOctaveLayersDefault;
+	config->spQueryOctaveLayers = spOctaveLayersDefault;
+	config->spExtractionEnoughFeatures = spEnoughFeaturesDefault;
+	config->spQueryEnoughFeatures = spEnoughFeaturesDefault;
+	config->spFeaturesFormat = spFeaturesFormatDefault;
 	config->spLoggerLevel = spLoggerLevelDefault;
 	config->spNumOfImages = -1;
 	strcpy(config->spPCAFilename, spPCAFilenameDefault);
@@ -516,26 +760,22 @@ SP_CONFIG_MSG createFilePath(char* imagePath, const SPConfig config, int index,
 		char* suffix, const char* func) {
 
 	int pathLen;
-	char errMsg[256];
 
 	if (imagePath == NULL || config == NULL) {
-		sprintf(errMsg, "The function %s was called with an invalid argument",
+		SP_LOG_ERROR("The function %s was called with an invalid argument",
 				func);
-		spLoggerPrintError(errMsg, __FILE__, __func__, __LINE__);
 		return SP_CONFIG_INVALID_ARGUMENT;
 	}
 
 	if (index >= config->spNumOfImages || index < 0) {
-		sprintf(errMsg, "The index given to %s is out of range", func);
-		spLoggerPrintError(errMsg, __FILE__, __func__, __LINE__);
+		SP_LOG_ERROR("The index given to %s is out of range", func);
 		return SP_CONFIG_INDEX_OUT_OF_RANGE;
 	}
 
 	pathLen = sprintf(imagePath, "%s%s%d%s", config->spImagesDirectory,
 			config->spImagesPrefix, index, suffix);
 	if (pathLen < 1) {
-		sprintf(errMsg, "sprintf function has failed");
-		spLoggerPrintError(errMsg, __FILE__, __func__, __LINE__);
+		SP_LOG_ERROR("sprintf function has failed");
 		return SP_CONFIG_UNKNOWN_ERROR;
 	}
 
@@ -543,15 +783,11 @@ SP_CONFIG_MSG createFilePath(char* imagePath, const SPConfig config, int index,
 }
 
 bool getterAssert(const SPConfig config, SP_CONFIG_MSG* msg, const char* func) {
-	char warningMsg[MAX_SIZE];
-
 	assert(msg);
 	if (config == NULL) {
 		*msg = SP_CONFIG_INVALID_ARGUMENT;
-
-		sprintf(warningMsg, "The function %s was called with an invalid argument"
-				, func);
-		spLoggerPrintWarning(warningMsg, __FILE__, __func__, __LINE__);
+		SP_LOG_WARNING("The function %s was called with an invalid argument",
+				func);
 		return false;
 	}
 
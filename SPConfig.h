@@ -53,6 +53,8 @@ typedef struct sp_config_t* SPConfig;
  * - SP_CONFIG_MISSING_PREFIX - if spImagesPrefix is missing
  * - SP_CONFIG_MISSING_SUFFIX - if spImagesSuffix is missing 
  * - SP_CONFIG_MISSING_NUM_IMAGES - if spNumOfImages is missing
+ * - SP_CONFIG_INVALID_INTEGER - if spExtractionEnoughFeatures or spQueryEnoughFeatures
+ *   exceed spNumOfFeatures
  * - SP_CONFIG_SUCCESS - in case of success
  *
  *
@@ -72,6 +74,40 @@ SPConfig spConfigCreate(const char* filename, SP_CONFIG_MSG* msg);
  */
 bool spConfigIsExtractionMode(const SPConfig config, SP_CONFIG_MSG* msg);
 
+/*
+ * Returns true if spAppendMode = true, false otherwise.
+ *
+ * In append mode the extraction keeps the existing PCA file instead of
+ * training a new one, and extracts features only for the images which don't
+ * have a features file yet. It is meaningful only in extraction mode.
+ *
+ * @param config - the configuration structure
+ * @assert msg != NULL
+ * @param msg - pointer in which the msg returned by the function is stored
+ * @return true if spAppendMode = true, false otherwise.
+ *
+ * - SP_CONFIG_INVALID_ARGUMENT - if config == NULL
+ * - SP_CONFIG_SUCCESS - in case of success
+ */
+bool spConfigIsAppendMode(const SPConfig config, SP_CONFIG_MSG* msg);
+
+/*
+ * Returns true if spNumaReplication = true, false otherwise.
+ *
+ * With NUMA replication the kd-trees are copied to the memory of every NUMA
+ * node, and every node searches its own copies, see
+ * spShardedIndexSetNumaReplication.
+ *
+ * @param config - the configuration structure
+ * @assert msg != NULL
+ * @param msg - pointer in which the msg returned by the function is stored
+ * @return true if spNumaReplication = true, false otherwise.
+ *
+ * - SP_CONFIG_INVALID_ARGUMENT - if config == NULL
+ * - SP_CONFIG_SUCCESS - in case of success
+ */
+bool spConfigIsNumaReplication(const SPConfig config, SP_CONFIG_MSG* msg);
+
 /*
  * Returns true if spMinimalGUI = true, false otherwise.
  *
@@ -181,6 +217,109 @@ int spConfigGetLogLevel(const SPConfig config, SP_CONFIG_MSG* msg);
  */
 int spConfigGetSpKNN(const SPConfig config, SP_CONFIG_MSG* msg);
 
+/**
+ * Returns the value of spNumOfShards, the number of shards the images are
+ * partitioned into. Each shard has its own kd-tree, and the shards are
+ * searched in parallel.
+ *
+ * @param config - the configuration structure
+ * @assert msg != NULL
+ * @param msg - pointer in which the msg returned by the function is stored
+ * @return positive integer on success, -1 otherwise.
+ *
+ * - SP_CONFIG_INVALID_ARGUMENT - if config == NULL
+ * - SP_CONFIG_SUCCESS - in case of success
+ */
+int spConfigGetNumOfShards(const SPConfig config, SP_CONFIG_MSG* msg);
+
+/**
+ * Returns the value of spExtractionThreads, the number of threads detecting
+ * and describing the features of the images in extraction mode, 0 for one per
+ * online processor. Reading the images, projecting and writing the features
+ * have a thread each.
+ *
+ * @param config - the configuration structure
+ * @assert msg != NULL
+ * @param msg - pointer in which the msg returned by the function is stored
+ * @return non negative integer on success, -1 otherwise.
+ *
+ * - SP_CONFIG_INVALID_ARGUMENT - if config == NULL
+ * - SP_CONFIG_SUCCESS - in case of success
+ */
+int spConfigGetExtractionThreads(const SPConfig config, SP_CONFIG_MSG* msg);
+
+/**
+ * Returns the longest side the images of the given role are detected at, the
+ * value of spExtractionMaxImageSide for the database images and of
+ * spQueryMaxImageSide for the query images. Larger images are downscaled
+ * before SIFT, whose time grows with the number of pixels. 0 keeps the images
+ * at their full resolution.
+ *
+ * @param config - the configuration structure
+ * @param role - the images, DATABASE_IMAGES or QUERY_IMAGES
+ * @assert msg != NULL
+ * @param msg - pointer in which the msg returned by the function is stored
+ * @return non negative integer on success, -1 otherwise.
+ *
+ * - SP_CONFIG_INVALID_ARGUMENT - if config == NULL
+ * - SP_CONFIG_SUCCESS - in case of success
+ */
+int spConfigGetMaxImageSide(const SPConfig config, ImageRole role,
+		SP_CONFIG_MSG* msg);
+
+/**
+ * Returns the number of layers SIFT detects in every octave of the images of
+ * the given role, the value of spExtractionOctaveLayers for the database
+ * images and of spQueryOctaveLayers for the query images, 3 by default.
+ *
+ * @param config - the configuration structure
+ * @param role - the images, DATABASE_IMAGES or QUERY_IMAGES
+ * @assert msg != NULL
+ * @param msg - pointer in which the msg returned by the function is stored
+ * @return positive integer on success, -1 otherwise.
+ *
+ * - SP_CONFIG_INVALID_ARGUMENT - if config == NULL
+ * - SP_CONFIG_SUCCESS - in case of success
+ */
+int spConfigGetOctaveLayers(const SPConfig config, ImageRole role,
+		SP_CONFIG_MSG* msg);
+
+/**
+ * Returns the number of keypoints which are enough for the images of the given
+ * role, the value of spExtractionEnoughFeatures for the database images and of
+ * spQueryEnoughFeatures for the query images. When it is set, an image is
+ * first detected at half its size, and only detected again at its full size
+ * if fewer keypoints are found there. 0 always detects at the full size.
+ *
+ * @param config - the configuration structure
+ * @param role - the images, DATABASE_IMAGES or QUERY_IMAGES
+ * @assert msg != NULL
+ * @param msg - pointer in which the msg returned by the function is stored
+ * @return non negative integer on success, -1 otherwise.
+ *
+ * - SP_CONFIG_INVALID_ARGUMENT - if config == NULL
+ * - SP_CONFIG_SUCCESS - in case of success
+ */
+int spConfigGetEnoughFeatures(const SPConfig config, ImageRole role,
+		SP_CONFIG_MSG* msg);
+
+/**
+ * Returns the format the features files are written in, the value of
+ * spFeaturesFormat. TEXT_FEATURES, the default, writes the coordinates as
+ * text, BINARY_FEATURES quantizes and bit-packs them as SPFeaturesCodec.h
+ * describes. Files of either format are read whatever the value is.
+ *
+ * @param config - the configuration structure
+ * @assert msg != NULL
+ * @param msg - pointer in which the msg returned by the function is stored
+ * @return the format on success, TEXT_FEATURES otherwise.
+ *
+ * - SP_CONFIG_INVALID_ARGUMENT - if config == NULL
+ * - SP_CONFIG_SUCCESS - in case of success
+ */
+FeaturesFormat spConfigGetFeaturesFormat(const SPConfig config,
+		SP_CONFIG_MSG* msg);
+
 /*
  * Returns the directory set in the configuration file, i.e the value
  * of spImagesDirectory.
@@ -250,6 +389,34 @@ char* spConfigGetPCAFilename(const SPConfig config, SP_CONFIG_MSG* msg);
  */
 SplitMethod spConfigGetSplitMethod(const SPConfig config, SP_CONFIG_MSG* msg);
 
+/*
+ * Returns the Build Method set in the configuration file, i.e the value
+ * of spKDTreeBuildMethod. PRESORT sorts the features by every dimension
+ * once, SELECTION selects the median of the split dimension at every node.
+ *
+ * @param config - the configuration structure
+ * @assert config != NULL
+ * @param msg - pointer in which the msg returned by the function is stored
+ * @assert msg != NULL
+ *
+ * - SP_CONFIG_SUCCESS - in case of success
+ */
+BuildMethod spConfigGetBuildMethod(const SPConfig config, SP_CONFIG_MSG* msg);
+
+/*
+ * Returns the Tree Layout set in the configuration file, i.e the value
+ * of spKDTreeLayout. DEPTH_FIRST keeps the nodes of the kd-trees in the order
+ * they are built, VAN_EMDE_BOAS stores them in van Emde Boas order.
+ *
+ * @param config - the configuration structure
+ * @assert config != NULL
+ * @param msg - pointer in which the msg returned by the function is stored
+ * @assert msg != NULL
+ *
+ * - SP_CONFIG_SUCCESS - in case of success
+ */
+TreeLayout spConfigGetTreeLayout(const SPConfig config, SP_CONFIG_MSG* msg);
+
 /**
  * Given an index 'index' the function stores in imagePath the full path of the
  * ith image.
@@ -325,6 +492,28 @@ SP_CONFIG_MSG spConfigGetImageFeatsPath(char* imagePath, const SPConfig config,
  */
 SP_CONFIG_MSG spConfigGetPCAPath(char* pcaPath, const SPConfig config);
 
+/**
+ * Given a shard index 'shard' the function stores in manifestPath the full path
+ * of the manifest file of the shard, which lists the images assigned to it.
+ * For example given the values of:
+ *  spImagesDirectory = "./images/"
+ *  shard = 2
+ *
+ * The functions stores "./images/shard2.manifest" to the address given by
+ * manifestPath. Thus the address given by manifestPath must contain enough space
+ * to store the resulting string.
+ *
+ * @param manifestPath - an address to store the result in, it must contain enough space.
+ * @param config - the configuration structure
+ * @param shard - the index of the shard
+ * @return
+ *  - SP_CONFIG_INVALID_ARGUMENT - if manifestPath == NULL or config == NULL
+ *  - SP_CONFIG_INDEX_OUT_OF_RANGE - if shard >= spNumOfShards or shard < 0
+ *  - SP_CONFIG_SUCCESS - in case of success
+ */
+SP_CONFIG_MSG spConfigGetShardManifestPath(char* manifestPath,
+		const SPConfig config, int shard);
+
 /**
  * Frees all memory resources associate with config. 
  * If config == NULL nothing is done.
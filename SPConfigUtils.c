@@ -4,6 +4,7 @@
 
 #include "SPConfigUtils.h"
 #include "SPLogger.h"
+#include "SPTokenizer.h"
 #include <assert.h>
 #include <string.h>
 #include <stdlib.h>
@@ -40,6 +41,32 @@ int convertFieldToNum(char* field) {
 		return 13;
 	if (strcmp(field, "spLoggerFilename") == 0)
 		return 14;
+	if (strcmp(field, "spAppendMode") == 0)
+		return 15;
+	if (strcmp(field, "spNumOfShards") == 0)
+		return 16;
+	if (strcmp(field, "spKDTreeBuildMethod") == 0)
+		return 17;
+	if (strcmp(field, "spKDTreeLayout") == 0)
+		return 18;
+	if (strcmp(field, "spNumaReplication") == 0)
+		return 19;
+	if (strcmp(field, "spExtractionThreads") == 0)
+		return 20;
+	if (strcmp(field, "spExtractionMaxImageSide") == 0)
+		return 21;
+	if (strcmp(field, "spQueryMaxImageSide") == 0)
+		return 22;
+	if (strcmp(field, "spExtractionOctaveLayers") == 0)
+		return 23;
+	if (strcmp(field, "spQueryOctaveLayers") == 0)
+		return 24;
+	if (strcmp(field, "spExtractionEnoughFeatures") == 0)
+		return 25;
+	if (strcmp(field, "spQueryEnoughFeatures") == 0)
+		return 26;
+	if (strcmp(field, "spFeaturesFormat") == 0)
+		return 27;
 	return -1;
 }
 
@@ -72,6 +99,14 @@ const char* convertMethodToString(SplitMethod method) {
 		return "MAX_SPREAD";
 	case 2:
 		return "INCREMENTAL";
+	case 3:
+		return "MAX_VARIANCE";
+	case 4:
+		return "SAMPLED_MAX_SPREAD";
+	case 5:
+		return "SLIDING_MIDPOINT";
+	case 6:
+		return "COST_MODEL";
 	}
 
 	/*shouldn't get to this line */
@@ -81,6 +116,51 @@ const char* convertMethodToString(SplitMethod method) {
 	return NULL;
 }
 
+const char* convertBuildMethodToString(BuildMethod method) {
+	switch (method) {
+	case 0:
+		return "PRESORT";
+	case 1:
+		return "SELECTION";
+	}
+
+	/*shouldn't get to this line */
+	spLoggerPrintError(
+			"BuildMethod was altered, but convertBuildMethodToString wasn't",
+			__FILE__, __func__, __LINE__);
+	return NULL;
+}
+
+const char* convertLayoutToString(TreeLayout layout) {
+	switch (layout) {
+	case 0:
+		return "DEPTH_FIRST";
+	case 1:
+		return "VAN_EMDE_BOAS";
+	}
+
+	/*shouldn't get to this line */
+	spLoggerPrintError(
+			"TreeLayout was altered, but convertLayoutToString wasn't",
+			__FILE__, __func__, __LINE__);
+	return NULL;
+}
+
+const char* convertFeaturesFormatToString(FeaturesFormat format) {
+	switch (format) {
+	case 0:
+		return "TEXT_FEATURES";
+	case 1:
+		return "BINARY_FEATURES";
+	}
+
+	/*shouldn't get to this line */
+	spLoggerPrintError(
+			"FeaturesFormat was altered, but convertFeaturesFormatToString wasn't",
+			__FILE__, __func__, __LINE__);
+	return NULL;
+}
+
 const char* convertTypeToString(ImageType type) {
 	switch (type) {
 	case 0:
@@ -100,51 +180,24 @@ const char* convertTypeToString(ImageType type) {
 	return NULL;
 }
 
-#define SKIP_SPACES(ptr)  \
-		while (*ptr == ' ') {  \
-			ptr++;  \
-		}
-
 int extractFieldAndValue(const char* line, char* value) {
 	char field[MAX_SIZE] = { 0 };
-	char dummy[MAX_SIZE] = { 0 };
-	int fieldId;
-
-	if (*line == '\0' || *line == '\n' || *line == '\r') {
-		return 0;
-	}
-
-	SKIP_SPACES(line);
+	SPTokenizer tokenizer;
 
-	if (*line == '#'  || *line == '\n' || *line == '\r') {
+	spTokenizerInit(&tokenizer, line);
+	if (spTokenizerAtLineEnd(&tokenizer) || spTokenizerExpect(&tokenizer, '#')) {
 		return 0;
 	}
 
-	if (!sscanf(line, "%1024[^= ]", field)) {
+	// the field and the value are single words, which fit their buffers
+	if (spTokenizerReadWord(&tokenizer, "=", field, MAX_SIZE) <= 0
+			|| !spTokenizerExpect(&tokenizer, '=')
+			|| spTokenizerReadWord(&tokenizer, "", value, MAX_SIZE) <= 0
+			|| !spTokenizerAtLineEnd(&tokenizer)) {
 		return -1;
 	}
-	line += strlen(field);
-
-	SKIP_SPACES(line);
-
-	if (*line != '=') {
-		return -1;
-	}
-	line++;
-
-	SKIP_SPACES(line);
-
-	if (!sscanf(line, "%s %s", value, dummy)) {
-		return -1;
-	}
-
-	if (value[0] == '\0' || dummy[0] != '\0') {
-		return -1;
-	}
-
-	fieldId = convertFieldToNum(field);
 
-	return fieldId;
+	return convertFieldToNum(field);
 }
 
 void printErrorInConfig(const char* filename, int lineNumber, char* msg) {
@@ -10,11 +10,40 @@
 /** suffix for features file **/
 #define spFeatsSuffix ".feats"
 
+/** suffix for shard manifest files **/
+#define spShardManifestSuffix ".manifest"
+
 /** the options for the cut method when the kd-tree is build **/
 typedef enum sp_methods {
-	RANDOM = 0, MAX_SPREAD = 1, INCREMENTAL = 2
+	RANDOM = 0,
+	MAX_SPREAD = 1,
+	INCREMENTAL = 2,
+	MAX_VARIANCE = 3,
+	SAMPLED_MAX_SPREAD = 4,
+	SLIDING_MIDPOINT = 5,
+	COST_MODEL = 6
 } SplitMethod;
 
+/** the options for the way the kd-array is ordered when the kd-tree is build **/
+typedef enum sp_build_methods {
+	PRESORT = 0, SELECTION = 1
+} BuildMethod;
+
+/** the options for the order in which the nodes of a built kd-tree are stored **/
+typedef enum sp_tree_layouts {
+	DEPTH_FIRST = 0, VAN_EMDE_BOAS = 1
+} TreeLayout;
+
+/** the formats of the features files, see SPFeaturesCodec.h for the binary one **/
+typedef enum sp_features_formats {
+	TEXT_FEATURES = 0, BINARY_FEATURES = 1
+} FeaturesFormat;
+
+/** the images features are extracted from, each with its own limits **/
+typedef enum sp_image_roles {
+	DATABASE_IMAGES = 0, QUERY_IMAGES = 1
+} ImageRole;
+
 /** the options for the image suffix **/
 typedef enum imageTypes {
 	jpg = 0, png = 1, bmp = 2, gif = 3
@@ -44,6 +73,21 @@ int convertFieldToNum(char* field);
  */
 const char* convertMethodToString(SplitMethod method);
 
+/* @param method
+ * @returns method as string
+ */
+const char* convertBuildMethodToString(BuildMethod method);
+
+/* @param layout
+ * @returns layout as string
+ */
+const char* convertLayoutToString(TreeLayout layout);
+
+/* @param format
+ * @returns format as string
+ */
+const char* convertFeaturesFormatToString(FeaturesFormat format);
+
 /* @param type
  * @returns type as string
  */
@@ -0,0 +1,558 @@
+/*
+ * SPDynamicKDTree.c
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "SPDynamicKDTree.h"
+#include "SPKDArray.h"
+#include "SPLogger.h"
+
+/** the maximal number of levels, level i holds up to BASE_SIZE * 2^i points **/
+#define MAX_LEVELS 32
+
+#define LEVEL_CAPACITY(i) (((long) SP_DYNAMIC_KDTREE_BASE_SIZE) << (i))
+
+/*
+ * A component of the index: a static kd-tree and the points it was built from
+ */
+typedef struct sp_dynamic_level_t {
+	SPPoint* points;
+	int count;
+	SPKDTreeNode* tree;
+} Level;
+
+struct SPDynamicKDTree {
+	int dim;
+	SplitMethod splitMethod;
+	Level levels[MAX_LEVELS];
+	SPPoint* staging; // inserted points which aren't in any level yet
+	int stagingCount;
+	int stagingCapacity;
+	bool* deleted; // tombstones, by image index
+	int* storedCount; // number of stored points, deleted or not, by image index
+	int imagesCapacity;
+	int totalPoints; // number of stored points, including deleted ones
+	int deletedPoints; // number of stored points of deleted images
+	bool fullMergeRequested;
+	pthread_rwlock_t lock; // guards all the fields above
+	pthread_mutex_t mergeMutex; // guards the merging thread state below
+	pthread_cond_t mergeCond;
+	pthread_cond_t idleCond;
+	bool mergeRequested;
+	bool merging;
+	bool stop;
+	pthread_t merger;
+};
+
+/*
+ * Helper filter skipping the points of deleted images, called under the lock
+ */
+bool isDeletedImage(int index, void* data) {
+	SPDynamicKDTree* tree = (SPDynamicKDTree*) data;
+	return index < tree->imagesCapacity && tree->deleted[index];
+}
+
+/*
+ * Helper function to grow the per image arrays to hold the given image index,
+ * called under the write lock
+ *
+ * @return false on allocation failure
+ */
+bool growImages(SPDynamicKDTree* tree, int imageIndex) {
+	int newCapacity, i;
+	bool* deleted;
+	int* storedCount;
+
+	if (imageIndex < tree->imagesCapacity) {
+		return true;
+	}
+	newCapacity = tree->imagesCapacity * 2;
+	if (newCapacity <= imageIndex) {
+		newCapacity = imageIndex + 1;
+	}
+	deleted = (bool*) realloc(tree->deleted, sizeof(bool) * newCapacity);
+	if (deleted == NULL) {
+		return false;
+	}
+	tree->deleted = deleted;
+	storedCount = (int*) realloc(tree->storedCount, sizeof(int) * newCapacity);
+	if (storedCount == NULL) {
+		return false;
+	}
+	tree->storedCount = storedCount;
+	for (i = tree->imagesCapacity; i < newCapacity; i++) {
+		tree->deleted[i] = false;
+		tree->storedCount[i] = 0;
+	}
+	tree->imagesCapacity = newCapacity;
+	return true;
+}
+
+/*
+ * Helper function to grow the staging buffer, called under the write lock
+ *
+ * @return false on allocation failure
+ */
+bool growStaging(SPDynamicKDTree* tree, int extra) {
+	int newCapacity = tree->stagingCapacity * 2;
+	SPPoint* staging;
+
+	if (tree->stagingCount + extra <= tree->stagingCapacity) {
+		return true;
+	}
+	if (newCapacity < tree->stagingCount + extra) {
+		newCapacity = tree->stagingCount + extra;
+	}
+	staging = (SPPoint*) realloc(tree->staging, sizeof(SPPoint) * newCapacity);
+	if (staging == NULL) {
+		return false;
+	}
+	tree->staging = staging;
+	tree->stagingCapacity = newCapacity;
+	return true;
+}
+
+/*
+ * Helper function to wake the merging thread up
+ */
+void requestMerge(SPDynamicKDTree* tree) {
+	pthread_mutex_lock(&tree->mergeMutex);
+	tree->mergeRequested = true;
+	pthread_cond_signal(&tree->mergeCond);
+	pthread_mutex_unlock(&tree->mergeMutex);
+}
+
+/*
+ * Helper function to build a static kd-tree over the given points
+ */
+SPKDTreeNode* buildTree(SPDynamicKDTree* tree, SPPoint* points, int count) {
+	SPKDArray* kdArr = spKDArrayInit(points, count, tree->dim);
+	SPKDTreeNode* root;
+
+	if (kdArr == NULL) {
+		return NULL;
+	}
+	root = spKDTreeInit(kdArr, tree->splitMethod);
+	spKDArrayDestroy(kdArr);
+	return root;
+}
+
+/*
+ * Performs a single merge if one is needed. The points to merge are collected
+ * under the read lock, the new tree is built without holding any lock, and it
+ * is installed under the write lock. Only the merging thread removes points,
+ * so the collected points stay valid while the tree is built, while insertions
+ * only append to the staging buffer past the collected prefix.
+ *
+ * @return true if a merge was performed
+ */
+bool mergeOnce(SPDynamicKDTree* tree) {
+	SPPoint* keep = NULL;
+	SPPoint* purge = NULL;
+	SPKDTreeNode* root = NULL;
+	Level old[MAX_LEVELS];
+	int keepCount = 0, purgeCount = 0, stagingCount, merged, target, total;
+	int i, j, index;
+	bool full;
+
+	pthread_rwlock_rdlock(&tree->lock);
+	full = tree->fullMergeRequested
+			|| (tree->deletedPoints > 0
+					&& 2 * tree->deletedPoints > tree->totalPoints);
+	stagingCount = tree->stagingCount;
+	if (!full && stagingCount < SP_DYNAMIC_KDTREE_BASE_SIZE) {
+		pthread_rwlock_unlock(&tree->lock);
+		return false;
+	}
+
+	// carry into the first empty level large enough for the lower levels
+	total = stagingCount;
+	for (merged = 0; merged < MAX_LEVELS; merged++) {
+		if (!full && tree->levels[merged].count == 0
+				&& LEVEL_CAPACITY(merged) >= total) {
+			break;
+		}
+		total += tree->levels[merged].count;
+	}
+	full = (merged == MAX_LEVELS);
+
+	if (total > 0) {
+		keep = (SPPoint*) malloc(sizeof(SPPoint) * total);
+		purge = (SPPoint*) malloc(sizeof(SPPoint) * total);
+		if (keep == NULL || purge == NULL) {
+			pthread_rwlock_unlock(&tree->lock);
+			free(keep);
+			free(purge);
+			SP_LOG_ERROR("merge aborted on memory allocation failure");
+			return false;
+		}
+	}
+	for (i = 0; i < stagingCount; i++) {
+		if (isDeletedImage(spPointGetIndex(tree->staging[i]), tree)) {
+			purge[purgeCount++] = tree->staging[i];
+		} else {
+			keep[keepCount++] = tree->staging[i];
+		}
+	}
+	for (i = 0; i < merged; i++) {
+		for (j = 0; j < tree->levels[i].count; j++) {
+			if (isDeletedImage(spPointGetIndex(tree->levels[i].points[j]), tree)) {
+				purge[purgeCount++] = tree->levels[i].points[j];
+			} else {
+				keep[keepCount++] = tree->levels[i].points[j];
+			}
+		}
+	}
+	pthread_rwlock_unlock(&tree->lock);
+
+	if (keepCount > 0) {
+		root = buildTree(tree, keep, keepCount);
+		if (root == NULL) {
+			free(keep);
+			free(purge);
+			SP_LOG_ERROR("merge aborted on memory allocation failure");
+			return false;
+		}
+	}
+
+	target = merged;
+	if (full) {
+		for (target = 0; target < MAX_LEVELS - 1; target++) {
+			if (LEVEL_CAPACITY(target) >= keepCount) {
+				break;
+			}
+		}
+	}
+
+	pthread_rwlock_wrlock(&tree->lock);
+	for (i = 0; i < MAX_LEVELS; i++) {
+		old[i].points = NULL;
+		old[i].tree = NULL;
+		if (i < merged) {
+			old[i] = tree->levels[i];
+			tree->levels[i].points = NULL;
+			tree->levels[i].count = 0;
+			tree->levels[i].tree = NULL;
+		}
+	}
+	if (keepCount > 0) {
+		tree->levels[target].points = keep;
+		tree->levels[target].count = keepCount;
+		tree->levels[target].tree = root;
+		keep = NULL;
+	}
+	memmove(tree->staging, tree->staging + stagingCount,
+			sizeof(SPPoint) * (tree->stagingCount - stagingCount));
+	tree->stagingCount -= stagingCount;
+	for (i = 0; i < purgeCount; i++) {
+		index = spPointGetIndex(purge[i]);
+		tree->storedCount[index]--;
+		if (tree->storedCount[index] == 0) {
+			tree->deleted[index] = false;
+		}
+	}
+	tree->deletedPoints -= purgeCount;
+	tree->totalPoints -= purgeCount;
+	if (full) {
+		tree->fullMergeRequested = false;
+	}
+	pthread_rwlock_unlock(&tree->lock);
+
+	// the merged points were moved to the new level or purged
+	for (i = 0; i < merged; i++) {
+		spKDTreeDestroy(old[i].tree);
+		free(old[i].points);
+	}
+	for (i = 0; i < purgeCount; i++) {
+		spPointDestroy(purge[i]);
+	}
+	free(keep);
+	free(purge);
+	return true;
+}
+
+/*
+ * The merging thread main loop
+ */
+void* mergerLoop(void* arg) {
+	SPDynamicKDTree* tree = (SPDynamicKDTree*) arg;
+
+	while (true) {
+		pthread_mutex_lock(&tree->mergeMutex);
+		while (!tree->mergeRequested && !tree->stop) {
+			pthread_cond_wait(&tree->mergeCond, &tree->mergeMutex);
+		}
+		if (tree->stop) {
+			pthread_mutex_unlock(&tree->mergeMutex);
+			break;
+		}
+		tree->mergeRequested = false;
+		tree->merging = true;
+		pthread_mutex_unlock(&tree->mergeMutex);
+
+		while (mergeOnce(tree)) {
+		}
+
+		pthread_mutex_lock(&tree->mergeMutex);
+		tree->merging = false;
+		pthread_cond_broadcast(&tree->idleCond);
+		pthread_mutex_unlock(&tree->mergeMutex);
+	}
+	return NULL;
+}
+
+SPDynamicKDTree* spDynamicKDTreeCreate(int dim, SplitMethod splitMethod) {
+	SPDynamicKDTree* tree;
+
+	if (dim <= 0) {
+		return NULL;
+	}
+	tree = (SPDynamicKDTree*) calloc(1, sizeof(SPDynamicKDTree));
+	if (tree == NULL) {
+		return NULL;
+	}
+	tree->dim = dim;
+	tree->splitMethod = splitMethod;
+
+	if (pthread_rwlock_init(&tree->lock, NULL) != 0) {
+		free(tree);
+		return NULL;
+	}
+	pthread_mutex_init(&tree->mergeMutex, NULL);
+	pthread_cond_init(&tree->mergeCond, NULL);
+	pthread_cond_init(&tree->idleCond, NULL);
+	if (pthread_create(&tree->merger, NULL, mergerLoop, tree) != 0) {
+		pthread_cond_destroy(&tree->idleCond);
+		pthread_cond_destroy(&tree->mergeCond);
+		pthread_mutex_destroy(&tree->mergeMutex);
+		pthread_rwlock_destroy(&tree->lock);
+		free(tree);
+		return NULL;
+	}
+	return tree;
+}
+
+void spDynamicKDTreeDestroy(SPDynamicKDTree* tree) {
+	int i, j;
+
+	if (tree == NULL) {
+		return;
+	}
+	pthread_mutex_lock(&tree->mergeMutex);
+	tree->stop = true;
+	pthread_cond_signal(&tree->mergeCond);
+	pthread_mutex_unlock(&tree->mergeMutex);
+	pthread_join(tree->merger, NULL);
+
+	for (i = 0; i < MAX_LEVELS; i++) {
+		spKDTreeDestroy(tree->levels[i].tree);
+		for (j = 0; j < tree->levels[i].count; j++) {
+			spPointDestroy(tree->levels[i].points[j]);
+		}
+		free(tree->levels[i].points);
+	}
+	for (i = 0; i < tree->stagingCount; i++) {
+		spPointDestroy(tree->staging[i]);
+	}
+	free(tree->staging);
+	free(tree->deleted);
+	free(tree->storedCount);
+
+	pthread_cond_destroy(&tree->idleCond);
+	pthread_cond_destroy(&tree->mergeCond);
+	pthread_mutex_destroy(&tree->mergeMutex);
+	pthread_rwlock_destroy(&tree->lock);
+	free(tree);
+}
+
+SP_DYNAMIC_KDTREE_MSG spDynamicKDTreeInsert(SPDynamicKDTree* tree, int imageIndex,
+		SPPoint* features, int count) {
+	SPPoint* copies;
+	bool needsMerge;
+	int i;
+
+	if (tree == NULL || imageIndex < 0 || (features == NULL && count > 0)
+			|| count < 0) {
+		return SP_DYNAMIC_KDTREE_INVALID_ARGUMENT;
+	}
+	for (i = 0; i < count; i++) {
+		if (features[i] == NULL || spPointGetDimension(features[i]) != tree->dim
+				|| spPointGetIndex(features[i]) != imageIndex) {
+			return SP_DYNAMIC_KDTREE_INVALID_ARGUMENT;
+		}
+	}
+	if (count == 0) {
+		return SP_DYNAMIC_KDTREE_SUCCESS;
+	}
+
+	// copy outside the lock so searches aren't held back by allocations
+	copies = (SPPoint*) malloc(sizeof(SPPoint) * count);
+	if (copies == NULL) {
+		return SP_DYNAMIC_KDTREE_OUT_OF_MEMORY;
+	}
+	for (i = 0; i < count; i++) {
+		copies[i] = spPointCopy(features[i]);
+		if (copies[i] == NULL) {
+			while (i-- > 0) {
+				spPointDestroy(copies[i]);
+			}
+			free(copies);
+			return SP_DYNAMIC_KDTREE_OUT_OF_MEMORY;
+		}
+	}
+
+	pthread_rwlock_wrlock(&tree->lock);
+	if (imageIndex < tree->imagesCapacity && tree->deleted[imageIndex]) {
+		tree->fullMergeRequested = true;
+		pthread_rwlock_unlock(&tree->lock);
+		for (i = 0; i < count; i++) {
+			spPointDestroy(copies[i]);
+		}
+		free(copies);
+		requestMerge(tree);
+		return SP_DYNAMIC_KDTREE_PENDING_DELETE;
+	}
+	if (!growImages(tree, imageIndex) || !growStaging(tree, count)) {
+		pthread_rwlock_unlock(&tree->lock);
+		for (i = 0; i < count; i++) {
+			spPointDestroy(copies[i]);
+		}
+		free(copies);
+		return SP_DYNAMIC_KDTREE_OUT_OF_MEMORY;
+	}
+	memcpy(tree->staging + tree->stagingCount, copies, sizeof(SPPoint) * count);
+	tree->stagingCount += count;
+	tree->storedCount[imageIndex] += count;
+	tree->totalPoints += count;
+	needsMerge = (tree->stagingCount >= SP_DYNAMIC_KDTREE_BASE_SIZE);
+	pthread_rwlock_unlock(&tree->lock);
+
+	free(copies);
+	if (needsMerge) {
+		requestMerge(tree);
+	}
+	return SP_DYNAMIC_KDTREE_SUCCESS;
+}
+
+SP_DYNAMIC_KDTREE_MSG spDynamicKDTreeDelete(SPDynamicKDTree* tree, int imageIndex) {
+	bool needsMerge = false;
+
+	if (tree == NULL || imageIndex < 0) {
+		return SP_DYNAMIC_KDTREE_INVALID_ARGUMENT;
+	}
+
+	pthread_rwlock_wrlock(&tree->lock);
+	if (imageIndex < tree->imagesCapacity && !tree->deleted[imageIndex]
+			&& tree->storedCount[imageIndex] > 0) {
+		tree->deleted[imageIndex] = true;
+		tree->deletedPoints += tree->storedCount[imageIndex];
+		needsMerge = (2 * tree->deletedPoints > tree->totalPoints);
+	}
+	pthread_rwlock_unlock(&tree->lock);
+
+	if (needsMerge) {
+		requestMerge(tree);
+	}
+	return SP_DYNAMIC_KDTREE_SUCCESS;
+}
+
+SPBPQueue spDynamicKDTreeNearestNeighbor(SPDynamicKDTree* tree, SPPoint testPoint,
+		int neighborsCount) {
+	SPBPQueue bpq;
+	SPKDTreeSearchContext* context;
+
+	if (tree == NULL || testPoint == NULL) {
+		return NULL;
+	}
+	if (neighborsCount <= 0) {
+		return spBPQueueCreate(neighborsCount);
+	}
+	context = spKDTreeSearchContextCreate(neighborsCount);
+	if (context == NULL) {
+		return NULL;
+	}
+	bpq = spDynamicKDTreeNearestNeighborInContext(tree, testPoint, neighborsCount,
+			context);
+	spKDTreeSearchContextDestroy(context);
+	return bpq;
+}
+
+SPBPQueue spDynamicKDTreeNearestNeighborInContext(SPDynamicKDTree* tree,
+		SPPoint testPoint, int neighborsCount, SPKDTreeSearchContext* context) {
+	SPBPQueue bpq;
+	bool found = true;
+	int i, index;
+
+	if (tree == NULL || testPoint == NULL || context == NULL
+			|| !spKDTreeSearchContextReserve(context, neighborsCount)) {
+		return NULL;
+	}
+	bpq = spBPQueueCreate(neighborsCount);
+	if (bpq == NULL) {
+		return NULL;
+	}
+
+	pthread_rwlock_rdlock(&tree->lock);
+	for (i = 0; found && i < MAX_LEVELS; i++) {
+		found = spKDTreeSearch(tree->levels[i].tree, testPoint, context,
+				isDeletedImage, tree, NULL);
+	}
+	for (i = 0; i < tree->stagingCount; i++) {
+		index = spPointGetIndex(tree->staging[i]);
+		if (!isDeletedImage(index, tree)) {
+			spKDTreeSearchContextOffer(context, index,
+					spPointL2SquaredDistance(tree->staging[i], testPoint));
+		}
+	}
+	pthread_rwlock_unlock(&tree->lock);
+
+	if (!found || !spKDTreeSearchContextCopyResults(context, bpq)) {
+		spBPQueueDestroy(bpq);
+		bpq = NULL;
+	}
+	return bpq;
+}
+
+void spDynamicKDTreeFlush(SPDynamicKDTree* tree) {
+	if (tree == NULL) {
+		return;
+	}
+	pthread_mutex_lock(&tree->mergeMutex);
+	while (tree->mergeRequested || tree->merging) {
+		pthread_cond_wait(&tree->idleCond, &tree->mergeMutex);
+	}
+	pthread_mutex_unlock(&tree->mergeMutex);
+}
+
+int spDynamicKDTreeGetPointsCount(SPDynamicKDTree* tree) {
+	int count;
+
+	if (tree == NULL) {
+		return -1;
+	}
+	pthread_rwlock_rdlock(&tree->lock);
+	count = tree->totalPoints - tree->deletedPoints;
+	pthread_rwlock_unlock(&tree->lock);
+	return count;
+}
+
+int spDynamicKDTreeGetTreesCount(SPDynamicKDTree* tree) {
+	int count = 0, i;
+
+	if (tree == NULL) {
+		return -1;
+	}
+	pthread_rwlock_rdlock(&tree->lock);
+	for (i = 0; i < MAX_LEVELS; i++) {
+		if (tree->levels[i].tree != NULL) {
+			count++;
+		}
+	}
+	pthread_rwlock_unlock(&tree->lock);
+	return count;
+}
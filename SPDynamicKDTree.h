@@ -0,0 +1,147 @@
+/*
+ * SPDynamicKDTree.h
+ */
+
+#ifndef SPDYNAMICKDTREE_H_
+#define SPDYNAMICKDTREE_H_
+
+#include <stdbool.h>
+#include "SPPoint.h"
+#include "SPBPriorityQueue.h"
+#include "SPConfigUtils.h"
+#include "SPKDTree.h"
+
+/*
+ * A kd-tree index which supports adding and removing the features of images.
+ *
+ * The index follows the logarithmic method: it is a set of static kd-trees,
+ * where level i holds up to SP_DYNAMIC_KDTREE_BASE_SIZE * 2^i points, and a
+ * staging buffer for recently inserted points. Once the buffer fills up, a
+ * background thread merges it with the lower levels into the first level
+ * which is large enough, the way a binary counter carries.
+ *
+ * Deleting an image marks its index with a tombstone, its points are skipped
+ * by searches and purged by the next merge which covers them. Once more than
+ * half of the points are deleted, all the levels are merged into one.
+ *
+ * All the functions may be called concurrently, except spDynamicKDTreeDestroy.
+ */
+struct SPDynamicKDTree;
+typedef struct SPDynamicKDTree SPDynamicKDTree;
+
+/** the number of points gathered in the staging buffer before a merge **/
+#define SP_DYNAMIC_KDTREE_BASE_SIZE 256
+
+/** type used for error reporting **/
+typedef enum sp_dynamic_kd_tree_msg_t {
+	SP_DYNAMIC_KDTREE_SUCCESS,
+	SP_DYNAMIC_KDTREE_INVALID_ARGUMENT,
+	SP_DYNAMIC_KDTREE_OUT_OF_MEMORY,
+	SP_DYNAMIC_KDTREE_PENDING_DELETE
+} SP_DYNAMIC_KDTREE_MSG;
+
+/*
+ * @param dim - the dimension of the points
+ * @param splitMethod - the method by which the component trees are split
+ *
+ * The function creates an empty index and starts its merging thread
+ *
+ * @return NULL on any allocation or initialization failure
+ * @return a new empty index otherwise
+ */
+SPDynamicKDTree* spDynamicKDTreeCreate(int dim, SplitMethod splitMethod);
+
+/*
+ * @param tree - a dynamic kd-tree
+ *
+ * The function stops the merging thread and destroys the index with all its points
+ *
+ */
+void spDynamicKDTreeDestroy(SPDynamicKDTree* tree);
+
+/*
+ * @param tree - a dynamic kd-tree
+ * @param imageIndex - the index of the image the features belong to
+ * @param features - the features of the image, all with index imageIndex
+ * @param count - the number of features
+ *
+ * The function adds copies of the features of an image to the index. The features
+ * are visible to searches as soon as the function returns.
+ *
+ * @return SP_DYNAMIC_KDTREE_INVALID_ARGUMENT if any argument is invalid, or if the
+ * 		   dimension or the index of any of the features don't match
+ * @return SP_DYNAMIC_KDTREE_OUT_OF_MEMORY on allocation failure, the index is unchanged
+ * @return SP_DYNAMIC_KDTREE_PENDING_DELETE if the image was deleted and its points
+ * 		   weren't purged yet. A full merge is requested, the insertion may be
+ * 		   retried after spDynamicKDTreeFlush
+ * @return SP_DYNAMIC_KDTREE_SUCCESS otherwise
+ */
+SP_DYNAMIC_KDTREE_MSG spDynamicKDTreeInsert(SPDynamicKDTree* tree, int imageIndex,
+		SPPoint* features, int count);
+
+/*
+ * @param tree - a dynamic kd-tree
+ * @param imageIndex - the index of an image
+ *
+ * The function removes all the features of an image from the index. The features
+ * are invisible to searches as soon as the function returns. Deleting an image
+ * which has no features in the index does nothing.
+ *
+ * @return SP_DYNAMIC_KDTREE_INVALID_ARGUMENT if any argument is invalid
+ * @return SP_DYNAMIC_KDTREE_SUCCESS otherwise
+ */
+SP_DYNAMIC_KDTREE_MSG spDynamicKDTreeDelete(SPDynamicKDTree* tree, int imageIndex);
+
+/*
+ * @param tree - a dynamic kd-tree
+ * @param testPoint - a point for which to search neighbors
+ * @param neighborsCount - the number of neighbors to search for
+ *
+ * The function searches all the component trees and the staging buffer, merging
+ * the results into one queue
+ *
+ * @return NULL on allocation failure
+ * @return a priority queue stuffed with the nearest points found, represented by index and distance
+ */
+SPBPQueue spDynamicKDTreeNearestNeighbor(SPDynamicKDTree* tree, SPPoint testPoint,
+		int neighborsCount);
+
+/*
+ * @param tree - a dynamic kd-tree
+ * @param testPoint - a point for which to search neighbors
+ * @param neighborsCount - the number of neighbors to search for, at least 1
+ * @param context - a search context, grown to neighborsCount if it holds fewer,
+ * 		  see spKDTreeSearchContextReserve
+ *
+ * The function searches like spDynamicKDTreeNearestNeighbor, in the given
+ * context, so a thread searching many points allocates its context once
+ *
+ * @return NULL on invalid argument or allocation failure
+ * @return a priority queue stuffed with the nearest points found, represented by index and distance
+ */
+SPBPQueue spDynamicKDTreeNearestNeighborInContext(SPDynamicKDTree* tree,
+		SPPoint testPoint, int neighborsCount, SPKDTreeSearchContext* context);
+
+/*
+ * @param tree - a dynamic kd-tree
+ *
+ * The function blocks until the merging thread has no pending work
+ *
+ */
+void spDynamicKDTreeFlush(SPDynamicKDTree* tree);
+
+/*
+ * @param tree - a dynamic kd-tree
+ *
+ * @return the number of points in the index which aren't deleted
+ */
+int spDynamicKDTreeGetPointsCount(SPDynamicKDTree* tree);
+
+/*
+ * @param tree - a dynamic kd-tree
+ *
+ * @return the number of levels currently holding a component tree
+ */
+int spDynamicKDTreeGetTreesCount(SPDynamicKDTree* tree);
+
+#endif /* SPDYNAMICKDTREE_H_ */
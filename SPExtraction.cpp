@@ -0,0 +1,271 @@
+#include <cstdlib>
+#include <atomic>
+#include <vector>
+#include <unistd.h>
+#include "SPExtraction.h"
+
+extern "C" {
+#include "SPLogger.h"
+#include "SPPoint.h"
+#include "SPPipeline.h"
+#include "SPFeaturesSerializer.h"
+#include "SPFeaturesLoader.h"
+#include "SPMemory.h"
+}
+
+using namespace cv;
+using namespace std;
+
+#define EXTRACTION_STAGES 4
+#define IMAGE_PATH_LENGTH 1024
+
+/** the images waiting before every stage, per describing thread **/
+#define IMAGES_PER_THREAD 2
+
+/**
+ * An image on its way through the extraction pipeline
+ */
+struct ExtractionItem {
+	int index;
+	Mat image;
+	Mat descriptors;
+	double* coordinates; // the block the features are projected to
+	SPPoint* features; // the points over the block
+	int featuresCount;
+};
+
+/**
+ * The data shared by the stages of the extraction pipeline
+ */
+struct ExtractionData {
+	sp::ImageProc* imageProc;
+	SPConfig config;
+	int pcaDim;
+	atomic<int> msg; // the first error, SP_CONFIG_SUCCESS while there is none
+};
+
+/**
+ * Records the first error of the extraction
+ */
+void setExtractionError(ExtractionData* context, SP_CONFIG_MSG msg) {
+	int success = SP_CONFIG_SUCCESS;
+	context->msg.compare_exchange_strong(success, msg);
+}
+
+/**
+ * Destroys the features of an item, if they were projected
+ */
+void destroyItemFeatures(ExtractionItem* item) {
+	spPointDestroyArray(item->features);
+	free(item->coordinates);
+	item->features = NULL;
+	item->coordinates = NULL;
+}
+
+/**
+ * Charges a matrix an item just got to the image processing
+ */
+void chargeItemMat(const Mat& mat) {
+	spMemoryCharge(SP_MEMORY_IMAGE_PROC, sp::getMatBytes(mat));
+}
+
+/**
+ * Releases a matrix of an item, and its charge
+ */
+void releaseItemMat(Mat& mat) {
+	spMemoryRelease(SP_MEMORY_IMAGE_PROC, sp::getMatBytes(mat));
+	mat.release();
+}
+
+/**
+ * Releases whatever an item holds, for the items which don't finish
+ */
+void releaseExtractionItem(void* item) {
+	ExtractionItem* extractionItem = (ExtractionItem*) item;
+	releaseItemMat(extractionItem->image);
+	releaseItemMat(extractionItem->descriptors);
+	destroyItemFeatures(extractionItem);
+}
+
+/**
+ * The first stage: reads the image
+ */
+bool readStage(void* item, void* data) {
+	ExtractionItem* extractionItem = (ExtractionItem*) item;
+	ExtractionData* context = (ExtractionData*) data;
+	char imagePath[IMAGE_PATH_LENGTH];
+	SP_CONFIG_MSG msg = spConfigGetImagePath(imagePath, context->config,
+			extractionItem->index);
+
+	if (msg != SP_CONFIG_SUCCESS) {
+		spLoggerPrintError(imPathErr, __FILE__, __func__, __LINE__);
+		setExtractionError(context, msg);
+		return false;
+	}
+	if (!context->imageProc->readImage(imagePath, extractionItem->image)) {
+		setExtractionError(context, SP_CONFIG_UNKNOWN_ERROR);
+		return false;
+	}
+	chargeItemMat(extractionItem->image);
+	return true;
+}
+
+/**
+ * The second stage: detects and describes the keypoints, the image isn't
+ * needed anymore. Every worker keeps its detector between images.
+ */
+bool describeStage(void* item, void* data) {
+	static thread_local sp::ExtractionContext threadContext;
+	ExtractionItem* extractionItem = (ExtractionItem*) item;
+	ExtractionData* context = (ExtractionData*) data;
+
+	context->imageProc->describeImage(extractionItem->image,
+			extractionItem->descriptors, threadContext);
+	chargeItemMat(extractionItem->descriptors);
+	releaseItemMat(extractionItem->image);
+	return true;
+}
+
+/**
+ * The third stage: projects the descriptors on the PCA into a block, and
+ * creates the points over it
+ */
+bool projectStage(void* item, void* data) {
+	static thread_local sp::ExtractionContext threadContext;
+	ExtractionItem* extractionItem = (ExtractionItem*) item;
+	ExtractionData* context = (ExtractionData*) data;
+	int rows = extractionItem->descriptors.rows;
+
+	if (rows == 0) {
+		return true;
+	}
+	extractionItem->coordinates = (double*) malloc(sizeof(double) * rows
+			* context->pcaDim);
+	if (extractionItem->coordinates == NULL) {
+		spLoggerPrintError(allocFail, __FILE__, __func__, __LINE__);
+		setExtractionError(context, SP_CONFIG_ALLOC_FAIL);
+		return false;
+	}
+	extractionItem->featuresCount = context->imageProc->projectFeatures(
+			extractionItem->descriptors, threadContext,
+			extractionItem->coordinates, rows);
+	releaseItemMat(extractionItem->descriptors);
+	extractionItem->features = spPointCreateArray(extractionItem->coordinates,
+			extractionItem->featuresCount, context->pcaDim, extractionItem->index);
+	if (extractionItem->features == NULL) {
+		spLoggerPrintError(allocFail, __FILE__, __func__, __LINE__);
+		setExtractionError(context, SP_CONFIG_ALLOC_FAIL);
+		return false;
+	}
+	return true;
+}
+
+/**
+ * The last stage: writes the features file and destroys the features
+ */
+bool writeStage(void* item, void* data) {
+	ExtractionItem* extractionItem = (ExtractionItem*) item;
+	ExtractionData* context = (ExtractionData*) data;
+	SP_CONFIG_MSG msg = writeImageFeaturesToFile(extractionItem->features,
+			extractionItem->featuresCount, context->config, extractionItem->index);
+
+	destroyItemFeatures(extractionItem);
+	if (msg != SP_CONFIG_SUCCESS) {
+		setExtractionError(context, msg);
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Logs the throughput of every stage and the depth of its queue
+ */
+void logExtractionStats(SPPipeline* pipeline) {
+	SPPipelineStageStats stats;
+	double elapsedSeconds = spPipelineGetElapsedSeconds(pipeline);
+
+	SP_LOG_INFO("extraction took %.2fs", elapsedSeconds);
+	for (int i = 0; i < EXTRACTION_STAGES; i++) {
+		spPipelineGetStageStats(pipeline, i, &stats);
+		SP_LOG_INFO("%s: %ld images, %.1f images/s, %d threads busy %.2fs waiting %.2fs,"
+				" queue depth %.1f average %d max", stats.name, stats.itemsCount,
+				elapsedSeconds > 0 ? stats.itemsCount / elapsedSeconds : 0,
+				stats.workersCount, stats.busySeconds, stats.waitSeconds,
+				stats.averageQueueDepth, stats.maxQueueDepth);
+	}
+}
+
+SP_CONFIG_MSG extractImagesFeatures(sp::ImageProc* imageProc, const SPConfig config) {
+	SP_CONFIG_MSG msg = SP_CONFIG_SUCCESS;
+	ExtractionData context;
+	vector<ExtractionItem> items;
+	vector<void*> pointers;
+	SPPipeline* pipeline;
+	bool* valid = NULL;
+	int numOfImages = spConfigGetNumOfImages(config, &msg);
+	bool appendMode = spConfigIsAppendMode(config, &msg);
+	int threads = spConfigGetExtractionThreads(config, &msg);
+	int invalid;
+
+	if (threads == 0) {
+		long processors = sysconf(_SC_NPROCESSORS_ONLN);
+		threads = processors > 0 ? (int) processors : 1;
+	}
+
+	// in append mode only the images added since the last run are extracted,
+	// and the ones whose features file an earlier run left invalid, which the
+	// threads of the extraction validate before it starts
+	if (appendMode) {
+		valid = (bool*) malloc(sizeof(bool) * (numOfImages + 1));
+		VERIFY_ALLOC(valid);
+		invalid = spFeaturesValidate(config, threads, valid, NULL, &msg);
+		if (invalid == -1) {
+			free(valid);
+			return msg;
+		}
+		SP_LOG_INFO("%d of %d images have no valid features file and are extracted",
+				invalid, numOfImages);
+	}
+	context.imageProc = imageProc;
+	context.config = config;
+	context.pcaDim = spConfigGetPCADim(config, &msg);
+	context.msg = SP_CONFIG_SUCCESS;
+
+	SPPipelineStage stages[EXTRACTION_STAGES] = {
+		{ "read", readStage, &context, 1 },
+		{ "describe", describeStage, &context, threads },
+		{ "project", projectStage, &context, 1 },
+		{ "write", writeStage, &context, 1 }
+	};
+	pipeline = spPipelineCreate(stages, EXTRACTION_STAGES,
+			IMAGES_PER_THREAD * threads, releaseExtractionItem);
+	if (pipeline == NULL) {
+		free(valid);
+	}
+	VERIFY_ALLOC(pipeline);
+
+	for (int i = 0; i < numOfImages; i++) {
+		if (!appendMode || !valid[i]) {
+			ExtractionItem item;
+			item.index = i;
+			item.coordinates = NULL;
+			item.features = NULL;
+			item.featuresCount = 0;
+			items.push_back(item);
+		}
+	}
+	free(valid);
+	for (size_t i = 0; i < items.size(); i++) {
+		pointers.push_back(&items[i]);
+	}
+
+	if (!spPipelineRun(pipeline, pointers.data(), (int) pointers.size())) {
+		msg = (SP_CONFIG_MSG) context.msg.load();
+		if (msg == SP_CONFIG_SUCCESS) {
+			msg = SP_CONFIG_UNKNOWN_ERROR;
+		}
+	}
+	logExtractionStats(pipeline);
+	spPipelineDestroy(pipeline);
+	return msg;
+}
@@ -0,0 +1,30 @@
+#ifndef SPEXTRACTION_H_
+#define SPEXTRACTION_H_
+
+#include "SPImageProc.h"
+
+extern "C" {
+#include "SPConfig.h"
+}
+
+/**
+ * Extracts the features of the images of the database and writes them to
+ * their features files, skipping the images which have one in append mode.
+ *
+ * The images go through a pipeline of four stages: reading the image,
+ * detecting and describing its keypoints, projecting the descriptors on the
+ * PCA and writing the features file, see SPPipeline.h. Reading, projecting
+ * and writing have a thread each, and spExtractionThreads threads describe,
+ * so the disk and the decoder work while SIFT runs, and only a few images are
+ * held in memory at once. The throughput of every stage and the depth of its
+ * queue are logged at the info level once the extraction ends.
+ *
+ * @param imageProc - the image processor, whose PCA is set
+ * @param config - the configuration structure
+ * @return SP_CONFIG_ALLOC_FAIL on allocation failure
+ * @return SP_CONFIG_UNKNOWN_ERROR if an image can't be read or written
+ * @return SP_CONFIG_SUCCESS otherwise
+ */
+SP_CONFIG_MSG extractImagesFeatures(sp::ImageProc* imageProc, const SPConfig config);
+
+#endif
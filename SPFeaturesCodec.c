@@ -0,0 +1,197 @@
+/*
+ * SPFeaturesCodec.c
+ */
+
+#include <string.h>
+#include <stdint.h>
+#include "SPFeaturesCodec.h"
+
+/** the largest whole number of steps of a coordinate **/
+#define MAX_STEPS ((1 << SP_CODEC_QUANTIZATION_BITS) - 1)
+
+/*
+ * Helper functions to store doubles little endian
+ */
+void putCodecDouble(unsigned char* data, double value) {
+	uint64_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	for (int i = 0; i < 8; i++) {
+		data[i] = (unsigned char) (bits >> (8 * i));
+	}
+}
+
+double getCodecDouble(const unsigned char* data) {
+	uint64_t bits = 0;
+	double value;
+	for (int i = 0; i < 8; i++) {
+		bits |= (uint64_t) data[i] << (8 * i);
+	}
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+/*
+ * Helper function to get the bytes the packed steps of a dimension take
+ */
+size_t packedCodecLength(int count, int bits) {
+	return ((size_t) count * bits + 7) / 8;
+}
+
+size_t spFeaturesEncodedBound(int count, int dim) {
+	return SP_FILE_HEADER_LENGTH + (size_t) dim * SP_CODEC_DIMENSION_HEADER_LENGTH
+			+ (size_t) dim * packedCodecLength(count, SP_CODEC_QUANTIZATION_BITS);
+}
+
+size_t spFeaturesEncode(const double* coordinates, int count, int dim,
+		unsigned char* data) {
+	unsigned char* dimensionHeader = data + SP_FILE_HEADER_LENGTH;
+	unsigned char* packed = dimensionHeader
+			+ (size_t) dim * SP_CODEC_DIMENSION_HEADER_LENGTH;
+	SPFileHeader header;
+	double minimum, maximum, step, value;
+	uint64_t accumulator;
+	long steps, maxSteps;
+	int bits, pending;
+
+	for (int d = 0; d < dim; d++,
+			dimensionHeader += SP_CODEC_DIMENSION_HEADER_LENGTH) {
+		minimum = count > 0 ? coordinates[d] : 0;
+		maximum = minimum;
+		for (int i = 1; i < count; i++) {
+			value = coordinates[(size_t) i * dim + d];
+			minimum = value < minimum ? value : minimum;
+			maximum = value > maximum ? value : maximum;
+		}
+		// a dimension whose features are all equal takes no bits at all
+		step = 0;
+		maxSteps = 0;
+		bits = 0;
+		if (maximum > minimum) {
+			step = (maximum - minimum) / MAX_STEPS;
+			step = step < SP_CODEC_MIN_STEP ? SP_CODEC_MIN_STEP : step;
+			maxSteps = (long) ((maximum - minimum) / step + 0.5);
+			maxSteps = maxSteps > MAX_STEPS ? MAX_STEPS : maxSteps;
+			while ((1L << bits) <= maxSteps) {
+				bits++;
+			}
+		}
+		putCodecDouble(dimensionHeader, minimum);
+		putCodecDouble(dimensionHeader + 8, step);
+		dimensionHeader[16] = (unsigned char) bits;
+		if (bits == 0) {
+			continue;
+		}
+
+		accumulator = 0;
+		pending = 0;
+		for (int i = 0; i < count; i++) {
+			steps = (long) ((coordinates[(size_t) i * dim + d] - minimum) / step + 0.5);
+			steps = steps > maxSteps ? maxSteps : steps;
+			accumulator |= (uint64_t) steps << pending;
+			for (pending += bits; pending >= 8; pending -= 8) {
+				*packed++ = (unsigned char) accumulator;
+				accumulator >>= 8;
+			}
+		}
+		if (pending > 0) {
+			*packed++ = (unsigned char) accumulator;
+		}
+	}
+	memcpy(header.magic, SP_CODEC_MAGIC, SP_FILE_MAGIC_LENGTH);
+	header.dim = dim;
+	header.count = count;
+	spFileHeaderWrite(&header, data + SP_FILE_HEADER_LENGTH,
+			(size_t) (packed - data) - SP_FILE_HEADER_LENGTH, data);
+	return (size_t) (packed - data);
+}
+
+bool spFeaturesIsEncoded(const void* data, size_t length) {
+	return length >= SP_FILE_MAGIC_LENGTH
+			&& memcmp(data, SP_CODEC_MAGIC, SP_FILE_MAGIC_LENGTH) == 0;
+}
+
+bool spFeaturesDecodeHeader(const void* data, size_t length, int* count,
+		int* dim) {
+	SPFileHeader header;
+
+	if (spFileHeaderRead(data, length, SP_CODEC_MAGIC, &header)
+			!= SP_FILE_FORMAT_SUCCESS || header.dim < 1) {
+		return false;
+	}
+	*count = header.count;
+	*dim = header.dim;
+	return true;
+}
+
+SP_FILE_FORMAT_MSG spFeaturesVerify(const void* data, size_t length) {
+	const unsigned char* dimensionHeader = (const unsigned char*) data
+			+ SP_FILE_HEADER_LENGTH;
+	SPFileHeader header;
+	SP_FILE_FORMAT_MSG msg = spFileHeaderRead(data, length, SP_CODEC_MAGIC,
+			&header);
+	size_t expected;
+
+	if (msg == SP_FILE_FORMAT_SUCCESS) {
+		msg = spFileHeaderVerify(&header, data, length);
+	}
+	if (msg != SP_FILE_FORMAT_SUCCESS) {
+		return msg;
+	}
+	// the dimensions must account for the payload exactly
+	if (header.dim < 1 || header.payloadLength
+			/ SP_CODEC_DIMENSION_HEADER_LENGTH < (size_t) header.dim) {
+		return SP_FILE_FORMAT_INVALID;
+	}
+	expected = (size_t) header.dim * SP_CODEC_DIMENSION_HEADER_LENGTH;
+	for (int d = 0; d < header.dim; d++) {
+		if (dimensionHeader[d * SP_CODEC_DIMENSION_HEADER_LENGTH + 16]
+				> SP_CODEC_QUANTIZATION_BITS) {
+			return SP_FILE_FORMAT_INVALID;
+		}
+		expected += packedCodecLength(header.count,
+				dimensionHeader[d * SP_CODEC_DIMENSION_HEADER_LENGTH + 16]);
+	}
+	return expected == header.payloadLength ?
+			SP_FILE_FORMAT_SUCCESS : SP_FILE_FORMAT_INVALID;
+}
+
+SP_FILE_FORMAT_MSG spFeaturesDecode(const void* data, size_t length,
+		double* coordinates) {
+	const unsigned char* dimensionHeader = (const unsigned char*) data
+			+ SP_FILE_HEADER_LENGTH;
+	const unsigned char* packed;
+	SP_FILE_FORMAT_MSG msg = spFeaturesVerify(data, length);
+	SPFileHeader header;
+	double minimum, step;
+	uint64_t accumulator, mask;
+	int count, dim, bits, pending;
+
+	if (msg != SP_FILE_FORMAT_SUCCESS) {
+		return msg;
+	}
+	spFileHeaderRead(data, length, SP_CODEC_MAGIC, &header);
+	count = header.count;
+	dim = header.dim;
+	packed = dimensionHeader + (size_t) dim * SP_CODEC_DIMENSION_HEADER_LENGTH;
+
+	for (int d = 0; d < dim; d++,
+			dimensionHeader += SP_CODEC_DIMENSION_HEADER_LENGTH) {
+		minimum = getCodecDouble(dimensionHeader);
+		step = getCodecDouble(dimensionHeader + 8);
+		bits = dimensionHeader[16];
+
+		mask = ((uint64_t) 1 << bits) - 1;
+		accumulator = 0;
+		pending = 0;
+		for (int i = 0; i < count; i++) {
+			for (; pending < bits; pending += 8) {
+				accumulator |= (uint64_t) *packed++ << pending;
+			}
+			coordinates[(size_t) i * dim + d] = minimum
+					+ (double) (accumulator & mask) * step;
+			accumulator >>= bits;
+			pending -= bits;
+		}
+	}
+	return SP_FILE_FORMAT_SUCCESS;
+}
@@ -0,0 +1,111 @@
+/*
+ * SPFeaturesCodec.h
+ */
+
+#ifndef SPFEATURESCODEC_H_
+#define SPFEATURESCODEC_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "SPFileFormat.h"
+
+/*
+ * The binary format of the features files, several times smaller than the
+ * text writeImageFeaturesToFile writes by default.
+ *
+ * Every coordinate is quantized on a grid of its dimension: the minimum of the
+ * dimension over the features of the image, plus a whole number of steps, of
+ * at most SP_CODEC_QUANTIZATION_BITS bits. A step is never finer than
+ * SP_CODEC_MIN_STEP, the precision of the text format, so a dimension which
+ * spans a short range takes fewer bits. The steps of every dimension are then
+ * bit-packed one dimension after the other, so a coordinate is decoded with a
+ * shift and a mask, and the decoder writes straight into the coordinates of
+ * the loader, feature after feature.
+ *
+ * A file is made of:
+ * - the header of SPFileFormat.h, with SP_CODEC_MAGIC, the dimension and the
+ *   number of features, and the checksum of the rest of the file
+ * - for every dimension its minimum and its step, 8 bytes each, and the bits
+ *   of its steps, 1 byte
+ * - for every dimension the steps of its features, packed from the lowest bit
+ *   of every byte and padded to a whole byte
+ * Doubles are stored little endian.
+ */
+
+/** the magic of a features file in the binary format **/
+#define SP_CODEC_MAGIC "SPFQ"
+
+/** the length of the header of a dimension **/
+#define SP_CODEC_DIMENSION_HEADER_LENGTH 17
+
+/** the most bits of a quantized coordinate **/
+#define SP_CODEC_QUANTIZATION_BITS 16
+
+/** the finest step of the quantization **/
+#define SP_CODEC_MIN_STEP 1e-6
+
+/*
+ * @param count - the number of features
+ * @param dim - the dimension of the features
+ *
+ * @return the most bytes spFeaturesEncode writes for the features
+ */
+size_t spFeaturesEncodedBound(int count, int dim);
+
+/*
+ * @param coordinates - count features of dim coordinates, feature after feature
+ * @param count - the number of features, at least 0
+ * @param dim - the dimension of the features, at least 1
+ * @param data - the output, of at least spFeaturesEncodedBound(count, dim) bytes
+ *
+ * @return the number of bytes written
+ */
+size_t spFeaturesEncode(const double* coordinates, int count, int dim,
+		unsigned char* data);
+
+/*
+ * @param data - the first bytes of a file
+ * @param length - the number of bytes
+ *
+ * @return true if the file is in the binary format, false otherwise
+ */
+bool spFeaturesIsEncoded(const void* data, size_t length);
+
+/*
+ * @param data - the first bytes of a file in the binary format
+ * @param length - the number of bytes
+ * @param count - pointer in which the number of features is stored
+ * @param dim - pointer in which the dimension of the features is stored
+ *
+ * @return false if the header is truncated, invalid or of a newer version,
+ * 		   true otherwise
+ */
+bool spFeaturesDecodeHeader(const void* data, size_t length, int* count,
+		int* dim);
+
+/*
+ * @param data - a file in the binary format
+ * @param length - the length of the file
+ *
+ * Verifies the header, the checksum and the layout of the file, without
+ * decoding it
+ *
+ * @return SP_FILE_FORMAT_SUCCESS if the file is valid, the reason it isn't otherwise
+ */
+SP_FILE_FORMAT_MSG spFeaturesVerify(const void* data, size_t length);
+
+/*
+ * @param data - a file in the binary format
+ * @param length - the length of the file
+ * @param coordinates - the output, of the count and dimension in the header,
+ * 		  feature after feature
+ *
+ * Verifies the file as spFeaturesVerify does, then decodes it
+ *
+ * @return SP_FILE_FORMAT_SUCCESS if the file was decoded, the reason it isn't
+ * 		   valid otherwise, in which case nothing is written
+ */
+SP_FILE_FORMAT_MSG spFeaturesDecode(const void* data, size_t length,
+		double* coordinates);
+
+#endif /* SPFEATURESCODEC_H_ */
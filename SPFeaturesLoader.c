@@ -0,0 +1,631 @@
+/*
+ * SPFeaturesLoader.c
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include "SPFeaturesLoader.h"
+#include "SPTokenizer.h"
+#include "SPFeaturesCodec.h"
+#include "SPLogger.h"
+#include "SPMemory.h"
+#include "SPArena.h"
+
+/** a path of a features file, made of the directory, the prefix and the suffix **/
+#define FEATS_PATH_LENGTH (3 * MAX_SIZE)
+
+/** the bytes read for the number of features at the head of a file **/
+#define HEADER_BYTES 32
+
+struct SPLoadedFeatures {
+	int imagesCount;
+	int dim;
+	int* counts; // the number of features of every image
+	long* offsets; // the first feature of every image, and the total after the last
+	double* coordinates;
+};
+
+/*
+ * The state the threads loading share
+ */
+typedef struct sp_load_shared_t {
+	SPLoadedFeatures* features;
+	SPConfig config;
+	int nextImage; // the next image a thread takes
+	int msg; // the first error, SP_CONFIG_SUCCESS while there is none
+	bool* valid; // whether the file of every image is valid, when validating
+	long bytes; // the bytes validated
+	int* files; // the file of every image, open from its count to its features, -1 if closed
+	int filesLeft; // the files which may still be kept open, accessed atomically
+} LoadShared;
+
+/*
+ * The work of a single thread loading
+ */
+typedef struct sp_load_task_t {
+	LoadShared* shared;
+	char* buffer; // the file being parsed, kept from one file to the next
+	size_t capacity;
+} LoadTask;
+
+/*
+ * Records the first error of the loading, after which the threads stop
+ */
+void setLoadError(LoadShared* shared, SP_CONFIG_MSG msg) {
+	int success = SP_CONFIG_SUCCESS;
+	__atomic_compare_exchange_n(&shared->msg, &success, (int) msg, false,
+			__ATOMIC_RELEASE, __ATOMIC_RELAXED);
+}
+
+/*
+ * Helper function to get the path of the features file of an image
+ *
+ * @return false if it can't be resolved, true otherwise
+ */
+bool getLoadedFeatsPath(const SPConfig config, int imageIndex, char* featsPath) {
+	if (spConfigGetImageFeatsPath(featsPath, config, imageIndex)
+			!= SP_CONFIG_SUCCESS) {
+		spLoggerPrintError(featsPathErr, __FILE__, __func__, __LINE__);
+		return false;
+	}
+	return true;
+}
+
+/*
+ * Keeps the file of an image open for its features to be read from it, unless
+ * as many files as may be are open already
+ */
+void keepFeaturesFile(LoadShared* shared, int imageIndex, int file) {
+	if (shared->files != NULL
+			&& __atomic_sub_fetch(&shared->filesLeft, 1, __ATOMIC_RELAXED) >= 0) {
+		shared->files[imageIndex] = file;
+	} else {
+		close(file);
+	}
+}
+
+/*
+ * Reads the number of features at the head of the features file of an image,
+ * keeping the file open when possible
+ */
+SP_CONFIG_MSG loadFeaturesCount(LoadTask* task, int imageIndex) {
+	char featsPath[FEATS_PATH_LENGTH];
+	char header[HEADER_BYTES];
+	SPTokenizer tokenizer;
+	ssize_t length;
+	int file, count, dim;
+
+	if (!getLoadedFeatsPath(task->shared->config, imageIndex, featsPath)) {
+		return SP_CONFIG_UNKNOWN_ERROR;
+	}
+	file = open(featsPath, O_RDONLY);
+	if (file == -1) {
+		SP_LOG_ERROR("Feats file for image number %d doesn't exist", imageIndex);
+		return SP_CONFIG_UNKNOWN_ERROR;
+	}
+	length = pread(file, header, HEADER_BYTES - 1, 0);
+	length = length > 0 ? length : 0;
+	header[length] = '\0';
+	spTokenizerInit(&tokenizer, header);
+	if (spFeaturesIsEncoded(header, length) ?
+			!spFeaturesDecodeHeader(header, length, &count, &dim) :
+			(!spTokenizerReadInt(&tokenizer, &count) || count < 0)) {
+		SP_LOG_ERROR("Feats file for image number %d has no valid count", imageIndex);
+		close(file);
+		return SP_CONFIG_UNKNOWN_ERROR;
+	}
+	task->shared->features->counts[imageIndex] = count;
+	keepFeaturesFile(task->shared, imageIndex, file);
+	return SP_CONFIG_SUCCESS;
+}
+
+/*
+ * Decodes a features file in the binary format into the place of the image in
+ * the coordinates
+ */
+SP_CONFIG_MSG decodeImageFeatures(LoadTask* task, int imageIndex,
+		size_t length) {
+	SPLoadedFeatures* features = task->shared->features;
+	SP_FILE_FORMAT_MSG formatMsg;
+	int count, dim;
+
+	if (!spFeaturesDecodeHeader(task->buffer, length, &count, &dim)
+			|| count != features->counts[imageIndex]) {
+		SP_LOG_ERROR("Feats file for image number %d changed while loading",
+				imageIndex);
+		return SP_CONFIG_UNKNOWN_ERROR;
+	}
+	if (dim != features->dim) {
+		SP_LOG_ERROR("Feats file for image number %d has dimension %d", imageIndex,
+				dim);
+		return SP_CONFIG_UNKNOWN_ERROR;
+	}
+	formatMsg = spFeaturesDecode(task->buffer, length, features->coordinates
+			+ features->offsets[imageIndex] * features->dim);
+	if (formatMsg != SP_FILE_FORMAT_SUCCESS) {
+		SP_LOG_ERROR("Feats file for image number %d %s", imageIndex,
+				spFileFormatDescribe(formatMsg));
+		return SP_CONFIG_UNKNOWN_ERROR;
+	}
+	return SP_CONFIG_SUCCESS;
+}
+
+/*
+ * Parses the features of a text features file after its count, into
+ * coordinates, or only to validate them if coordinates is NULL
+ */
+SP_CONFIG_MSG parseTextFeatures(SPTokenizer* tokenizer, int imageIndex,
+		int count, int dim, double* coordinates) {
+	double discarded;
+	int pointIndex, dimension, i, j;
+
+	for (i = 0; i < count; i++) {
+		if (!spTokenizerReadInt(tokenizer, &pointIndex)
+				|| !spTokenizerExpect(tokenizer, ',')
+				|| !spTokenizerReadInt(tokenizer, &dimension)
+				|| dimension != dim) {
+			SP_LOG_ERROR("Feats file for image number %d has an invalid feature"
+					" at line %d, column %d", imageIndex,
+					spTokenizerGetLine(tokenizer), spTokenizerGetColumn(tokenizer));
+			return SP_CONFIG_UNKNOWN_ERROR;
+		}
+		if (pointIndex != imageIndex) {
+			SP_LOG_ERROR("Feats file for image number %d has a feature of image"
+					" number %d at line %d", imageIndex, pointIndex,
+					spTokenizerGetLine(tokenizer));
+			return SP_CONFIG_UNKNOWN_ERROR;
+		}
+		for (j = 0; j < dimension; j++) {
+			if (!spTokenizerReadDouble(tokenizer,
+					coordinates != NULL ? coordinates++ : &discarded)) {
+				SP_LOG_ERROR("Feats file for image number %d has an invalid"
+						" coordinate at line %d, column %d", imageIndex,
+						spTokenizerGetLine(tokenizer),
+						spTokenizerGetColumn(tokenizer));
+				return SP_CONFIG_UNKNOWN_ERROR;
+			}
+		}
+	}
+	return SP_CONFIG_SUCCESS;
+}
+
+/*
+ * Reads the features file of an image whole into the buffer of the task, from
+ * the file kept open since its count was read if there is one
+ */
+SP_CONFIG_MSG readLoadedFeatsFile(LoadTask* task, int imageIndex,
+		size_t* length) {
+	int* file = task->shared->files != NULL ?
+			&task->shared->files[imageIndex] : NULL;
+	char featsPath[FEATS_PATH_LENGTH];
+	SP_TOKENIZER_MSG readMsg;
+
+	if (file != NULL && *file != -1) {
+		readMsg = spTokenizerReadOpenFile(*file, &task->buffer, &task->capacity,
+				length);
+		close(*file);
+		*file = -1;
+	} else if (!getLoadedFeatsPath(task->shared->config, imageIndex, featsPath)) {
+		return SP_CONFIG_UNKNOWN_ERROR;
+	} else {
+		readMsg = spTokenizerReadFile(featsPath, &task->buffer, &task->capacity,
+				length);
+	}
+	if (readMsg != SP_TOKENIZER_SUCCESS) {
+		SP_LOG_ERROR("Feats file for image number %d can't be read", imageIndex);
+		return readMsg == SP_TOKENIZER_ALLOC_FAIL ?
+				SP_CONFIG_ALLOC_FAIL : SP_CONFIG_UNKNOWN_ERROR;
+	}
+	return SP_CONFIG_SUCCESS;
+}
+
+/*
+ * Parses the features file of an image into the place of the image in the
+ * coordinates
+ */
+SP_CONFIG_MSG loadImageFeatures(LoadTask* task, int imageIndex) {
+	SPLoadedFeatures* features = task->shared->features;
+	SPTokenizer tokenizer;
+	size_t length;
+	int count;
+	SP_CONFIG_MSG msg = readLoadedFeatsFile(task, imageIndex, &length);
+
+	if (msg != SP_CONFIG_SUCCESS) {
+		return msg;
+	}
+	if (spFeaturesIsEncoded(task->buffer, length)) {
+		return decodeImageFeatures(task, imageIndex, length);
+	}
+	spTokenizerInit(&tokenizer, task->buffer);
+	if (!spTokenizerReadInt(&tokenizer, &count)
+			|| count != features->counts[imageIndex]) {
+		SP_LOG_ERROR("Feats file for image number %d changed while loading",
+				imageIndex);
+		return SP_CONFIG_UNKNOWN_ERROR;
+	}
+	return parseTextFeatures(&tokenizer, imageIndex, count, features->dim,
+			features->coordinates + features->offsets[imageIndex] * features->dim);
+}
+
+/*
+ * Validates the features file of an image without loading it: a binary file
+ * by its header, its checksum and its layout, a text file by parsing it whole.
+ * An invalid file is only recorded, so every file is validated.
+ */
+SP_CONFIG_MSG validateImageFeatures(LoadTask* task, int imageIndex) {
+	LoadShared* shared = task->shared;
+	SP_FILE_FORMAT_MSG formatMsg;
+	SPTokenizer tokenizer;
+	size_t length;
+	int count, dim;
+	SP_CONFIG_MSG msg = readLoadedFeatsFile(task, imageIndex, &length);
+
+	if (msg == SP_CONFIG_ALLOC_FAIL) {
+		return msg;
+	}
+	if (msg != SP_CONFIG_SUCCESS) {
+		shared->valid[imageIndex] = false;
+		return SP_CONFIG_SUCCESS;
+	}
+	__atomic_fetch_add(&shared->bytes, (long) length, __ATOMIC_RELAXED);
+	if (spFeaturesIsEncoded(task->buffer, length)) {
+		formatMsg = spFeaturesVerify(task->buffer, length);
+		if (formatMsg != SP_FILE_FORMAT_SUCCESS) {
+			SP_LOG_ERROR("Feats file for image number %d %s", imageIndex,
+					spFileFormatDescribe(formatMsg));
+			msg = SP_CONFIG_UNKNOWN_ERROR;
+		} else if (spFeaturesDecodeHeader(task->buffer, length, &count, &dim)
+				&& dim != shared->features->dim) {
+			SP_LOG_ERROR("Feats file for image number %d has dimension %d",
+					imageIndex, dim);
+			msg = SP_CONFIG_UNKNOWN_ERROR;
+		}
+	} else {
+		spTokenizerInit(&tokenizer, task->buffer);
+		if (!spTokenizerReadInt(&tokenizer, &count) || count < 0) {
+			SP_LOG_ERROR("Feats file for image number %d has no valid count",
+					imageIndex);
+			msg = SP_CONFIG_UNKNOWN_ERROR;
+		} else {
+			msg = parseTextFeatures(&tokenizer, imageIndex, count,
+					shared->features->dim, NULL);
+		}
+	}
+	shared->valid[imageIndex] = (msg == SP_CONFIG_SUCCESS);
+	return SP_CONFIG_SUCCESS;
+}
+
+/*
+ * Runs a step of the loading on every image, taking them one by one until none
+ * is left or a thread fails
+ */
+void loadEveryImage(LoadTask* task, SP_CONFIG_MSG (*step)(LoadTask*, int)) {
+	LoadShared* shared = task->shared;
+	SP_CONFIG_MSG msg;
+	int imageIndex;
+
+	while (__atomic_load_n(&shared->msg, __ATOMIC_ACQUIRE) == SP_CONFIG_SUCCESS
+			&& (imageIndex = __atomic_fetch_add(&shared->nextImage, 1,
+					__ATOMIC_RELAXED)) < shared->features->imagesCount) {
+		msg = step(task, imageIndex);
+		if (msg != SP_CONFIG_SUCCESS) {
+			setLoadError(shared, msg);
+		}
+	}
+}
+
+void* loadCountsWork(void* arg) {
+	loadEveryImage((LoadTask*) arg, loadFeaturesCount);
+	return NULL;
+}
+
+void* loadFeaturesWork(void* arg) {
+	loadEveryImage((LoadTask*) arg, loadImageFeatures);
+	return NULL;
+}
+
+void* validateFeaturesWork(void* arg) {
+	loadEveryImage((LoadTask*) arg, validateImageFeatures);
+	return NULL;
+}
+
+/*
+ * Helper function to run a pass of the loading on every task, a thread per
+ * task. The last task runs on the calling thread, as does any task whose thread
+ * can't be created.
+ */
+void runLoadTasks(void* (*work)(void*), LoadTask* tasks, int count) {
+	pthread_t* threads = (pthread_t*) malloc(sizeof(pthread_t) * count);
+	bool* started = (bool*) calloc(count, sizeof(bool));
+	int i;
+
+	tasks[0].shared->nextImage = 0;
+	for (i = 0; i < count - 1 && threads != NULL && started != NULL; i++) {
+		started[i] = (pthread_create(&threads[i], NULL, work, &tasks[i]) == 0);
+	}
+	for (i = 0; i < count; i++) {
+		if (started == NULL || !started[i]) {
+			work(&tasks[i]);
+		}
+	}
+	for (i = 0; i < count - 1 && started != NULL; i++) {
+		if (started[i]) {
+			pthread_join(threads[i], NULL);
+		}
+	}
+	free(threads);
+	free(started);
+}
+
+/*
+ * Helper function to get the bytes of the coordinates, charged to the points
+ * while the loaded features hold them
+ */
+size_t getCoordinatesBytes(const SPLoadedFeatures* features) {
+	return sizeof(double)
+			* (features->offsets[features->imagesCount] * features->dim + 1);
+}
+
+/*
+ * Places every image after the images before it and allocates the coordinates
+ */
+SP_CONFIG_MSG placeLoadedFeatures(SPLoadedFeatures* features) {
+	int i;
+
+	features->offsets[0] = 0;
+	for (i = 0; i < features->imagesCount; i++) {
+		features->offsets[i + 1] = features->offsets[i] + features->counts[i];
+	}
+	// the coordinates become the leaves of the trees once adopted by an index
+	features->coordinates = (double*) spArenaAllocHuge(getCoordinatesBytes(features));
+	if (features->coordinates == NULL) {
+		spLoggerPrintError(allocFail, __FILE__, __func__, __LINE__);
+		return SP_CONFIG_ALLOC_FAIL;
+	}
+	spMemoryCharge(SP_MEMORY_POINT, getCoordinatesBytes(features));
+	return SP_CONFIG_SUCCESS;
+}
+
+/*
+ * Helper function to get the number of files kept open between the passes of
+ * the loading, half of the files the process may open at most
+ */
+int getKeptFilesCount(int imagesCount) {
+	struct rlimit limit;
+
+	if (getrlimit(RLIMIT_NOFILE, &limit) != 0) {
+		return 0;
+	}
+	if (limit.rlim_cur == RLIM_INFINITY || limit.rlim_cur / 2 > (rlim_t) imagesCount) {
+		return imagesCount;
+	}
+	return (int) (limit.rlim_cur / 2);
+}
+
+/*
+ * Helper function to get the number of threads loading the images
+ */
+int getLoadThreadsCount(int threadsCount, int imagesCount) {
+	long processors;
+
+	if (threadsCount == 0) {
+		processors = sysconf(_SC_NPROCESSORS_ONLN);
+		threadsCount = processors > 0 ? (int) processors : 1;
+	}
+	if (threadsCount > imagesCount) {
+		threadsCount = imagesCount > 0 ? imagesCount : 1;
+	}
+	return threadsCount;
+}
+
+SPLoadedFeatures* spFeaturesLoad(const SPConfig config, int threadsCount,
+		SP_CONFIG_MSG* msg) {
+	SPLoadedFeatures* features;
+	LoadShared shared;
+	LoadTask* tasks;
+	int i;
+
+	if (config == NULL || threadsCount < 0) {
+		*msg = SP_CONFIG_INVALID_ARGUMENT;
+		return NULL;
+	}
+	features = (SPLoadedFeatures*) calloc(1, sizeof(SPLoadedFeatures));
+	if (features == NULL) {
+		*msg = SP_CONFIG_ALLOC_FAIL;
+		return NULL;
+	}
+	features->imagesCount = spConfigGetNumOfImages(config, msg);
+	features->dim = spConfigGetPCADim(config, msg);
+	features->counts = (int*) calloc(features->imagesCount + 1, sizeof(int));
+	features->offsets = (long*) malloc(sizeof(long) * (features->imagesCount + 1));
+	shared.files = (int*) malloc(sizeof(int) * (features->imagesCount + 1));
+	threadsCount = getLoadThreadsCount(threadsCount, features->imagesCount);
+	tasks = (LoadTask*) calloc(threadsCount, sizeof(LoadTask));
+	if (features->counts == NULL || features->offsets == NULL
+			|| shared.files == NULL || tasks == NULL) {
+		free(shared.files);
+		free(tasks);
+		spLoadedFeaturesDestroy(features);
+		spLoggerPrintError(allocFail, __FILE__, __func__, __LINE__);
+		*msg = SP_CONFIG_ALLOC_FAIL;
+		return NULL;
+	}
+
+	shared.features = features;
+	shared.config = config;
+	shared.msg = SP_CONFIG_SUCCESS;
+	shared.valid = NULL;
+	shared.filesLeft = getKeptFilesCount(features->imagesCount);
+	for (i = 0; i < features->imagesCount; i++) {
+		shared.files[i] = -1;
+	}
+	for (i = 0; i < threadsCount; i++) {
+		tasks[i].shared = &shared;
+	}
+	runLoadTasks(loadCountsWork, tasks, threadsCount);
+	if (shared.msg == SP_CONFIG_SUCCESS) {
+		shared.msg = placeLoadedFeatures(features);
+	}
+	if (shared.msg == SP_CONFIG_SUCCESS) {
+		runLoadTasks(loadFeaturesWork, tasks, threadsCount);
+	}
+
+	// the files of the images a failure left unread are still open
+	for (i = 0; i < features->imagesCount; i++) {
+		if (shared.files[i] != -1) {
+			close(shared.files[i]);
+		}
+	}
+	free(shared.files);
+	for (i = 0; i < threadsCount; i++) {
+		free(tasks[i].buffer);
+	}
+	free(tasks);
+	*msg = (SP_CONFIG_MSG) shared.msg;
+	if (*msg != SP_CONFIG_SUCCESS) {
+		spLoadedFeaturesDestroy(features);
+		return NULL;
+	}
+	return features;
+}
+
+int spFeaturesValidate(const SPConfig config, int threadsCount, bool* valid,
+		long* bytes, SP_CONFIG_MSG* msg) {
+	SPLoadedFeatures features;
+	LoadShared shared;
+	LoadTask* tasks;
+	int invalid = 0, i;
+
+	if (config == NULL || threadsCount < 0 || valid == NULL) {
+		*msg = SP_CONFIG_INVALID_ARGUMENT;
+		return -1;
+	}
+	memset(&features, 0, sizeof(features));
+	features.imagesCount = spConfigGetNumOfImages(config, msg);
+	features.dim = spConfigGetPCADim(config, msg);
+	threadsCount = getLoadThreadsCount(threadsCount, features.imagesCount);
+	tasks = (LoadTask*) calloc(threadsCount, sizeof(LoadTask));
+	if (tasks == NULL) {
+		spLoggerPrintError(allocFail, __FILE__, __func__, __LINE__);
+		*msg = SP_CONFIG_ALLOC_FAIL;
+		return -1;
+	}
+
+	shared.features = &features;
+	shared.config = config;
+	shared.msg = SP_CONFIG_SUCCESS;
+	shared.valid = valid;
+	shared.bytes = 0;
+	shared.files = NULL;
+	for (i = 0; i < threadsCount; i++) {
+		tasks[i].shared = &shared;
+	}
+	runLoadTasks(validateFeaturesWork, tasks, threadsCount);
+
+	for (i = 0; i < threadsCount; i++) {
+		free(tasks[i].buffer);
+	}
+	free(tasks);
+	*msg = (SP_CONFIG_MSG) shared.msg;
+	if (*msg != SP_CONFIG_SUCCESS) {
+		return -1;
+	}
+	for (i = 0; i < features.imagesCount; i++) {
+		invalid += valid[i] ? 0 : 1;
+	}
+	if (bytes != NULL) {
+		*bytes = shared.bytes;
+	}
+	return invalid;
+}
+
+void spLoadedFeaturesDestroy(SPLoadedFeatures* features) {
+	if (features != NULL) {
+		if (features->coordinates != NULL) {
+			spMemoryRelease(SP_MEMORY_POINT, getCoordinatesBytes(features));
+		}
+		free(features->counts);
+		free(features->offsets);
+		spArenaFreeHuge(features->coordinates);
+		free(features);
+	}
+}
+
+int spLoadedFeaturesGetImagesCount(const SPLoadedFeatures* features) {
+	return features->imagesCount;
+}
+
+int spLoadedFeaturesGetDim(const SPLoadedFeatures* features) {
+	return features->dim;
+}
+
+long spLoadedFeaturesGetTotalCount(const SPLoadedFeatures* features) {
+	return features->offsets[features->imagesCount];
+}
+
+int spLoadedFeaturesGetCount(const SPLoadedFeatures* features, int imageIndex) {
+	if (imageIndex < 0 || imageIndex >= features->imagesCount) {
+		return -1;
+	}
+	return features->counts[imageIndex];
+}
+
+const int* spLoadedFeaturesGetCounts(const SPLoadedFeatures* features) {
+	return features->counts;
+}
+
+const double* spLoadedFeaturesGetCoordinates(const SPLoadedFeatures* features,
+		int imageIndex) {
+	if (imageIndex < 0 || imageIndex >= features->imagesCount
+			|| features->coordinates == NULL) {
+		return NULL;
+	}
+	return features->coordinates + features->offsets[imageIndex] * features->dim;
+}
+
+double* spLoadedFeaturesReleaseCoordinates(SPLoadedFeatures* features) {
+	double* coordinates = features->coordinates;
+	// whoever takes the coordinates charges them
+	if (coordinates != NULL) {
+		spMemoryRelease(SP_MEMORY_POINT, getCoordinatesBytes(features));
+	}
+	features->coordinates = NULL;
+	return coordinates;
+}
+
+SPPoint* spLoadedFeaturesCreatePoints(const SPLoadedFeatures* features,
+		int imageIndex) {
+	const double* coordinates = spLoadedFeaturesGetCoordinates(features,
+			imageIndex);
+	int count = spLoadedFeaturesGetCount(features, imageIndex);
+	SPPoint* points;
+	int i;
+
+	if (coordinates == NULL || count <= 0) {
+		return NULL;
+	}
+	points = (SPPoint*) malloc(sizeof(SPPoint) * count);
+	if (points == NULL) {
+		return NULL;
+	}
+	for (i = 0; i < count; i++) {
+		// spPointCreate copies the coordinates, it never writes through them
+		points[i] = spPointCreate((double*) coordinates + (size_t) i * features->dim,
+				features->dim, imageIndex);
+		if (points[i] == NULL) {
+			while (--i >= 0) {
+				spPointDestroy(points[i]);
+			}
+			free(points);
+			return NULL;
+		}
+	}
+	return points;
+}
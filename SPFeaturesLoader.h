@@ -0,0 +1,159 @@
+/*
+ * SPFeaturesLoader.h
+ */
+
+#ifndef SPFEATURESLOADER_H_
+#define SPFEATURESLOADER_H_
+
+#include "SPConfig.h"
+#include "SPPoint.h"
+
+/*
+ * The features of all the images of the database, loaded from their features
+ * files into one contiguous block of coordinates, image after image and
+ * feature after feature.
+ *
+ * The files are loaded by several threads in two passes. The first reads the
+ * number of features at the head of every file, and a prefix sum over these
+ * numbers places every image in the block, which is then allocated at once.
+ * The second reads every file whole and parses its coordinates straight into
+ * the place of its image, with SPTokenizer instead of fscanf for a text file
+ * and with the decoder of SPFeaturesCodec.h for a binary one, so a catalog may
+ * mix both formats. Every thread takes the next image to load, so a thread is
+ * never left idle while the others load large files.
+ *
+ * A catalog may also be validated with the same threads, without being loaded,
+ * so that its bad files are found before it is loaded and queried.
+ */
+struct SPLoadedFeatures;
+typedef struct SPLoadedFeatures SPLoadedFeatures;
+
+/*
+ * @param config - the configs provider
+ * @param threadsCount - the number of threads loading, 0 for one per online
+ * 		  processor
+ * @assert msg != NULL
+ * @param msg - pointer in which the msg returned by the function is stored
+ *
+ * Loads the features files of all the images of config, whose features must
+ * be of dimension spPCADimension
+ *
+ * @return NULL on failure, with msg:
+ * - SP_CONFIG_INVALID_ARGUMENT - if config == NULL or threadsCount < 0
+ * - SP_CONFIG_UNKNOWN_ERROR - if a features file is missing or malformed
+ * - SP_CONFIG_ALLOC_FAIL - on allocation failure
+ * @return the loaded features otherwise, with msg SP_CONFIG_SUCCESS
+ */
+SPLoadedFeatures* spFeaturesLoad(const SPConfig config, int threadsCount,
+		SP_CONFIG_MSG* msg);
+
+/*
+ * @param config - the configs provider
+ * @param threadsCount - the number of threads validating, 0 for one per online
+ * 		  processor
+ * @param valid - an array of spNumOfImages, in which whether the features file
+ * 		  of every image is valid is stored
+ * @param bytes - pointer in which the number of bytes validated is stored, may
+ * 		  be NULL
+ * @assert msg != NULL
+ * @param msg - pointer in which the msg returned by the function is stored
+ *
+ * Validates the features files of all the images of config without loading
+ * them. A file in the binary format is valid if its header, checksum and
+ * layout are, and its dimension is spPCADimension. A file in the text format
+ * is valid if it parses whole, with features of dimension spPCADimension. The
+ * reason a file is invalid is logged as an error.
+ *
+ * @return -1 on failure, with msg:
+ * - SP_CONFIG_INVALID_ARGUMENT - if config == NULL, threadsCount < 0 or
+ * 	 valid == NULL
+ * - SP_CONFIG_ALLOC_FAIL - on allocation failure
+ * @return the number of invalid files otherwise, with msg SP_CONFIG_SUCCESS
+ */
+int spFeaturesValidate(const SPConfig config, int threadsCount, bool* valid,
+		long* bytes, SP_CONFIG_MSG* msg);
+
+/*
+ * @param features - loaded features, may be NULL
+ *
+ * The function releases the features and their coordinates
+ *
+ */
+void spLoadedFeaturesDestroy(SPLoadedFeatures* features);
+
+/*
+ * @param features - loaded features
+ *
+ * @return the number of images whose features were loaded
+ */
+int spLoadedFeaturesGetImagesCount(const SPLoadedFeatures* features);
+
+/*
+ * @param features - loaded features
+ *
+ * @return the dimension of the features
+ */
+int spLoadedFeaturesGetDim(const SPLoadedFeatures* features);
+
+/*
+ * @param features - loaded features
+ *
+ * @return the number of features of all the images
+ */
+long spLoadedFeaturesGetTotalCount(const SPLoadedFeatures* features);
+
+/*
+ * @param features - loaded features
+ * @param imageIndex - the index of an image
+ *
+ * @return the number of features of the image, -1 if imageIndex is out of range
+ */
+int spLoadedFeaturesGetCount(const SPLoadedFeatures* features, int imageIndex);
+
+/*
+ * @param features - loaded features
+ *
+ * @return the number of features of every image
+ */
+const int* spLoadedFeaturesGetCounts(const SPLoadedFeatures* features);
+
+/*
+ * @param features - loaded features
+ * @param imageIndex - the index of an image
+ *
+ * @return the coordinates of the features of the image, feature after feature,
+ * 		   NULL if imageIndex is out of range or the coordinates were released
+ */
+const double* spLoadedFeaturesGetCoordinates(const SPLoadedFeatures* features,
+		int imageIndex);
+
+/*
+ * @param features - loaded features
+ *
+ * Hands the block of the coordinates of all the images over to the caller,
+ * e.g. to spShardedIndexAdoptFeatures, instead of copying it. The features keep
+ * their counts, but no coordinates anymore, and the coordinates aren't
+ * charged to the points anymore, see SPMemory.h.
+ *
+ * @return the coordinates, image after image and feature after feature, which
+ * 		   the caller frees with spArenaFreeHuge, or NULL if they were released
+ * 		   already
+ */
+double* spLoadedFeaturesReleaseCoordinates(SPLoadedFeatures* features);
+
+/*
+ * @param features - loaded features
+ * @param imageIndex - the index of an image with features
+ *
+ * Creates the points of the features of an image, each with its own copy of
+ * its coordinates, as readImageFeaturesFromFile does
+ *
+ * @return NULL if imageIndex is out of range, the image has no features, or on
+ * 		   allocation failure
+ * @return an array of spLoadedFeaturesGetCount(features, imageIndex) new points
+ * 		   otherwise, the caller frees the array and owns the points
+ */
+SPPoint* spLoadedFeaturesCreatePoints(const SPLoadedFeatures* features,
+		int imageIndex);
+
+#endif /* SPFEATURESLOADER_H_ */
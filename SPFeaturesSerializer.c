@@ -2,100 +2,457 @@
 #include "SPLogger.h"
 #include "SPConfig.h"
 #include "SPPoint.h"
+#include "SPTokenizer.h"
+#include "SPFeaturesCodec.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
 
+/** a path of a features or a manifest file, made of the directory, the prefix and the suffix **/
+#define SERIALIZER_PATH_LENGTH (3 * MAX_SIZE)
+
+/** the suffix of the temporary file a features file is written to **/
+#define SERIALIZER_TEMP_SUFFIX ".tmp"
+
+/** a path of a temporary file, a features file path and the suffix **/
+#define SERIALIZER_TEMP_PATH_LENGTH (SERIALIZER_PATH_LENGTH + sizeof(SERIALIZER_TEMP_SUFFIX))
+
 /*
  * @param config - the configs provider
  * @param imageIndex - index of the image
- * @param file - output parameter that will store the handler to feats file
- * @param mode - file open mode, as given to the OS
+ * @param featsPath - output parameter for the path of the feats file
+ * @param tempPath - output parameter for the path of the temporary file, next to it
+ * @param file - output parameter that will store the handler to the temporary file
  *
- * The helper function is retrieving a handler to a matching feats file, for either reading or writing
+ * The helper function is opening the temporary file a feats file is written to,
+ * so the feats file is replaced only once written whole
  *
  * @return SP_CONFIG_SUCCESS on success
  * @return SP_CONFIG_UNKNOWN_ERROR on open failure
  */
-SP_CONFIG_MSG getFeatsFile(SPConfig config, int imageIndex, FILE** file,
-		const char* mode) {
-	char featsPath[260];
-
+SP_CONFIG_MSG getFeatsTempFile(SPConfig config, int imageIndex, char* featsPath,
+		char* tempPath, FILE** file) {
 	SP_CONFIG_MSG msg = spConfigGetImageFeatsPath(featsPath, config,
 			imageIndex);
 	if (msg != SP_CONFIG_SUCCESS) {
 		spLoggerPrintError(featsPathErr, __FILE__, __func__, __LINE__);
 		return msg;
 	}
+	snprintf(tempPath, SERIALIZER_TEMP_PATH_LENGTH, "%s%s", featsPath,
+			SERIALIZER_TEMP_SUFFIX);
 
-	*file = fopen(featsPath, mode);
+	*file = fopen(tempPath, "w");
 	if (*file == NULL) {
-		msg = SP_CONFIG_UNKNOWN_ERROR;
 		spLoggerPrintError(featsFileErr, __FILE__, __func__, __LINE__);
-		return msg;
+		return SP_CONFIG_UNKNOWN_ERROR;
 	}
+	return SP_CONFIG_SUCCESS;
+}
 
+/*
+ * Helper function to close the temporary file of a feats file and rename it
+ * over the feats file, or to remove it if it wasn't written whole, in which
+ * case the feats file is kept as it was
+ *
+ * @return SP_CONFIG_UNKNOWN_ERROR if the file wasn't written, closed or renamed
+ * @return SP_CONFIG_SUCCESS otherwise
+ */
+SP_CONFIG_MSG replaceFeatsFile(FILE* tempFile, const char* tempPath,
+		const char* featsPath, bool written) {
+	written = (fflush(tempFile) == 0) && written;
+	written = (fclose(tempFile) == 0) && written;
+	if (!written || rename(tempPath, featsPath) != 0) {
+		remove(tempPath);
+		SP_LOG_ERROR("The features file %s couldn't be written", featsPath);
+		return SP_CONFIG_UNKNOWN_ERROR;
+	}
+	return SP_CONFIG_SUCCESS;
+}
+
+/*
+ * Helper function to write features in the binary format, see SPFeaturesCodec.h
+ *
+ * @return SP_CONFIG_ALLOC_FAIL if the encoding can't be allocated
+ * @return SP_CONFIG_UNKNOWN_ERROR if the file can't be written
+ * @return SP_CONFIG_SUCCESS otherwise
+ */
+SP_CONFIG_MSG writeEncodedFeatures(SPPoint* imFeatures, int numOfFeats,
+		int dim, FILE* featsFile) {
+	double* coordinates = (double*) malloc(
+			sizeof(double) * ((size_t) numOfFeats * dim + 1));
+	unsigned char* data = (unsigned char*) malloc(
+			spFeaturesEncodedBound(numOfFeats, dim));
+	size_t length = 0;
+	int i, j;
+
+	if (coordinates == NULL || data == NULL) {
+		free(coordinates);
+		free(data);
+		spLoggerPrintError(allocFail, __FILE__, __func__, __LINE__);
+		return SP_CONFIG_ALLOC_FAIL;
+	}
+	for (i = 0; i < numOfFeats; i++) {
+		for (j = 0; j < dim; j++) {
+			coordinates[(size_t) i * dim + j] = spPointGetAxisCoor(imFeatures[i], j);
+		}
+	}
+	length = spFeaturesEncode(coordinates, numOfFeats, dim, data);
+	free(coordinates);
+	if (fwrite(data, 1, length, featsFile) != length) {
+		free(data);
+		return SP_CONFIG_UNKNOWN_ERROR;
+	}
+	free(data);
 	return SP_CONFIG_SUCCESS;
 }
 
 SP_CONFIG_MSG writeImageFeaturesToFile(SPPoint* imFeatures, int numOfFeats,
 		SPConfig config, int imageIndex) {
+	SP_CONFIG_MSG msg;
+	FeaturesFormat format = spConfigGetFeaturesFormat(config, &msg);
+
+	if (msg != SP_CONFIG_SUCCESS) {
+		return msg;
+	}
+	return writeImageFeaturesInFormat(imFeatures, numOfFeats, config,
+			imageIndex, format);
+}
+
+SP_CONFIG_MSG writeImageFeaturesInFormat(SPPoint* imFeatures, int numOfFeats,
+		SPConfig config, int imageIndex, FeaturesFormat format) {
+	char featsPath[SERIALIZER_PATH_LENGTH];
+	char tempPath[SERIALIZER_TEMP_PATH_LENGTH];
 	FILE* featsFile;
-	SP_CONFIG_MSG msg = getFeatsFile(config, imageIndex, &featsFile, "w+");
-	int i, j;
+	SP_CONFIG_MSG msg = getFeatsTempFile(config, imageIndex, featsPath, tempPath,
+			&featsFile);
+	bool written;
+	int i, j, dim;
 	if (msg != SP_CONFIG_SUCCESS) {
 		return msg;
 	}
 
-	fprintf(featsFile, "%d\n", numOfFeats);
-	for (i = 0; i < numOfFeats; i++) {
+	if (format == BINARY_FEATURES) {
+		dim = numOfFeats > 0 ?
+				spPointGetDimension(imFeatures[0]) : spConfigGetPCADim(config, &msg);
+		msg = writeEncodedFeatures(imFeatures, numOfFeats, dim, featsFile);
+		if (msg == SP_CONFIG_ALLOC_FAIL) {
+			replaceFeatsFile(featsFile, tempPath, featsPath, false);
+			return msg;
+		}
+		return replaceFeatsFile(featsFile, tempPath, featsPath,
+				msg == SP_CONFIG_SUCCESS);
+	}
+
+	written = fprintf(featsFile, "%d\n", numOfFeats) >= 0;
+	for (i = 0; written && i < numOfFeats; i++) {
 		SPPoint point = imFeatures[i];
-		fprintf(featsFile, "%d,%d\n", spPointGetIndex(point),
-				spPointGetDimension(point));
-		for (j = 0; j < spPointGetDimension(point); j++) {
-			fprintf(featsFile, "%f\n", spPointGetAxisCoor(point, j));
+		written = fprintf(featsFile, "%d,%d\n", spPointGetIndex(point),
+				spPointGetDimension(point)) >= 0;
+		for (j = 0; written && j < spPointGetDimension(point); j++) {
+			written = fprintf(featsFile, "%f\n", spPointGetAxisCoor(point, j)) >= 0;
 		}
 	}
+	return replaceFeatsFile(featsFile, tempPath, featsPath, written);
+}
+
+/*
+ * Helper function to read a file whole, and log where it fails
+ *
+ * @return SP_CONFIG_UNKNOWN_ERROR if the file can't be read
+ * @return SP_CONFIG_ALLOC_FAIL if the buffer can't be allocated
+ * @return SP_CONFIG_SUCCESS otherwise
+ */
+SP_CONFIG_MSG readSerializedFile(const char* path, char** buffer,
+		size_t* length) {
+	size_t capacity = 0;
+	SP_TOKENIZER_MSG msg;
+
+	*buffer = NULL;
+	msg = spTokenizerReadFile(path, buffer, &capacity, length);
+	if (msg == SP_TOKENIZER_SUCCESS) {
+		return SP_CONFIG_SUCCESS;
+	}
+	free(*buffer);
+	*buffer = NULL;
+	if (msg == SP_TOKENIZER_ALLOC_FAIL) {
+		spLoggerPrintError(allocFail, __FILE__, __func__, __LINE__);
+		return SP_CONFIG_ALLOC_FAIL;
+	}
+	return SP_CONFIG_UNKNOWN_ERROR;
+}
+
+/*
+ * Helper function to destroy the points read before a features file failed
+ */
+void destroySerializedFeatures(SPPoint* imFeatures, int count) {
+	int i;
+	for (i = 0; i < count; i++) {
+		spPointDestroy(imFeatures[i]);
+	}
+	free(imFeatures);
+}
+
+/*
+ * Helper function to create the points of a features file in the binary
+ * format, which all belong to the image
+ *
+ * @return SP_CONFIG_UNKNOWN_ERROR if the file is invalid
+ * @return SP_CONFIG_ALLOC_FAIL if an allocation fails
+ * @return SP_CONFIG_SUCCESS otherwise
+ */
+SP_CONFIG_MSG decodeSerializedFeatures(const char* data, size_t length,
+		SPPoint** imFeatures, int* numOfFeats, int imageIndex) {
+	double* coordinates;
+	SP_FILE_FORMAT_MSG formatMsg;
+	int dim, i;
+
+	if (!spFeaturesDecodeHeader(data, length, numOfFeats, &dim)) {
+		SP_LOG_ERROR("Feats file for image number %d has an invalid header",
+				imageIndex);
+		return SP_CONFIG_UNKNOWN_ERROR;
+	}
+	coordinates = (double*) malloc(
+			sizeof(double) * ((size_t) *numOfFeats * dim + 1));
+	*imFeatures = (SPPoint*) malloc(sizeof(SPPoint) * (*numOfFeats + 1));
+	if (coordinates == NULL || *imFeatures == NULL) {
+		spLoggerPrintError(allocFail, __FILE__, __func__, __LINE__);
+		free(coordinates);
+		free(*imFeatures);
+		return SP_CONFIG_ALLOC_FAIL;
+	}
+	formatMsg = spFeaturesDecode(data, length, coordinates);
+	if (formatMsg != SP_FILE_FORMAT_SUCCESS) {
+		SP_LOG_ERROR("Feats file for image number %d %s", imageIndex,
+				spFileFormatDescribe(formatMsg));
+		free(coordinates);
+		free(*imFeatures);
+		return SP_CONFIG_UNKNOWN_ERROR;
+	}
 
-	fflush(featsFile);
-	fclose(featsFile);
+	for (i = 0; i < *numOfFeats; i++) {
+		(*imFeatures)[i] = spPointCreate(coordinates + (size_t) i * dim, dim,
+				imageIndex);
+		if ((*imFeatures)[i] == NULL) {
+			spLoggerPrintError(allocFail, __FILE__, __func__, __LINE__);
+			destroySerializedFeatures(*imFeatures, i);
+			free(coordinates);
+			return SP_CONFIG_ALLOC_FAIL;
+		}
+	}
+	free(coordinates);
 	return SP_CONFIG_SUCCESS;
 }
 
 SP_CONFIG_MSG readImageFeaturesFromFile(SPPoint** imFeatures, int* numOfFeats,
 		SPConfig config, int imageIndex) {
-	FILE* featsFile;
-	char warning[MAX_SIZE];
-	SP_CONFIG_MSG msg = getFeatsFile(config, imageIndex, &featsFile, "r+");
-	int i, j;
+	char featsPath[SERIALIZER_PATH_LENGTH];
+	char* buffer;
+	size_t length;
+	SPTokenizer tokenizer;
+	SP_CONFIG_MSG msg;
+	int pcaDim = spConfigGetPCADim(config, &msg);
+	int i, j, index, dimension;
+
+	msg = spConfigGetImageFeatsPath(featsPath, config, imageIndex);
 	if (msg != SP_CONFIG_SUCCESS) {
-		sprintf(warning, "Feats file for image number %d doesn't exist\n", imageIndex);
-		spLoggerPrintError(warning, __FILE__, __func__, __LINE__);
+		spLoggerPrintError(featsPathErr, __FILE__, __func__, __LINE__);
+		return msg;
+	}
+	msg = readSerializedFile(featsPath, &buffer, &length);
+	if (msg != SP_CONFIG_SUCCESS) {
+		SP_LOG_ERROR("Feats file for image number %d doesn't exist\n", imageIndex);
+		return msg;
+	}
+	if (spFeaturesIsEncoded(buffer, length)) {
+		msg = decodeSerializedFeatures(buffer, length, imFeatures, numOfFeats,
+				imageIndex);
+		free(buffer);
 		return msg;
 	}
 
-	fscanf(featsFile, "%d", numOfFeats);
-
-	*imFeatures = (SPPoint*) malloc(sizeof(SPPoint) * *numOfFeats);
-	VERIFY_ALLOC(*imFeatures);
+	spTokenizerInit(&tokenizer, buffer);
+	if (!spTokenizerReadInt(&tokenizer, numOfFeats) || *numOfFeats < 0) {
+		SP_LOG_ERROR("Feats file for image number %d has no valid count", imageIndex);
+		free(buffer);
+		return SP_CONFIG_UNKNOWN_ERROR;
+	}
+	*imFeatures = (SPPoint*) malloc(sizeof(SPPoint) * (*numOfFeats + 1));
+	if (*imFeatures == NULL) {
+		spLoggerPrintError(allocFail, __FILE__, __func__, __LINE__);
+		free(buffer);
+		return SP_CONFIG_ALLOC_FAIL;
+	}
 
 	for (i = 0; i < *numOfFeats; i++) {
-		int index;
-		int dimension;
-		fscanf(featsFile, "%d,%d", &index, &dimension);
+		if (!spTokenizerReadInt(&tokenizer, &index)
+				|| !spTokenizerExpect(&tokenizer, ',')
+				|| !spTokenizerReadInt(&tokenizer, &dimension)
+				|| dimension != pcaDim) {
+			break;
+		}
 
 		double values[dimension];
 
-		for (j = 0; j < dimension; j++) {
-			fscanf(featsFile, "%lf", &(values[j]));
+		for (j = 0; j < dimension
+				&& spTokenizerReadDouble(&tokenizer, &values[j]); j++) {
+		}
+		if (j < dimension) {
+			break;
+		}
+		(*imFeatures)[i] = spPointCreate(values, dimension, index);
+		if ((*imFeatures)[i] == NULL) {
+			spLoggerPrintError(allocFail, __FILE__, __func__, __LINE__);
+			destroySerializedFeatures(*imFeatures, i);
+			free(buffer);
+			return SP_CONFIG_ALLOC_FAIL;
+		}
+	}
+	if (i < *numOfFeats) {
+		SP_LOG_ERROR("Feats file for image number %d is invalid at line %d, column %d",
+				imageIndex, spTokenizerGetLine(&tokenizer),
+				spTokenizerGetColumn(&tokenizer));
+		destroySerializedFeatures(*imFeatures, i);
+		free(buffer);
+		return SP_CONFIG_UNKNOWN_ERROR;
+	}
+
+	free(buffer);
+	return SP_CONFIG_SUCCESS;
+}
+
+SP_CONFIG_MSG writeShardManifests(SPShardedIndex* index, SPConfig config) {
+	char manifestPath[SERIALIZER_PATH_LENGTH];
+	FILE* manifestFile;
+	SP_CONFIG_MSG msg;
+	int shardsCount = spShardedIndexGetShardsCount(index);
+	int imagesCount = spShardedIndexGetImagesCount(index);
+	int shard, imagesInShard, i;
+
+	for (shard = 0; shard < shardsCount; shard++) {
+		msg = spConfigGetShardManifestPath(manifestPath, config, shard);
+		if (msg != SP_CONFIG_SUCCESS) {
+			return msg;
+		}
+		manifestFile = fopen(manifestPath, "w+");
+		if (manifestFile == NULL) {
+			SP_LOG_ERROR("Manifest file %s can't be written", manifestPath);
+			return SP_CONFIG_UNKNOWN_ERROR;
 		}
 
-		SPPoint point = spPointCreate(values, dimension, index);
-		VERIFY_ALLOC(point);
-		(*imFeatures)[i] = point;
+		imagesInShard = 0;
+		for (i = 0; i < imagesCount; i++) {
+			if (spShardedIndexGetShard(index, i) == shard) {
+				imagesInShard++;
+			}
+		}
+		fprintf(manifestFile, "%d,%d\n%d\n", shard, shardsCount, imagesInShard);
+		for (i = 0; i < imagesCount; i++) {
+			if (spShardedIndexGetShard(index, i) == shard) {
+				fprintf(manifestFile, "%d,%d\n", i,
+						spShardedIndexGetImageFeaturesCount(index, i));
+			}
+		}
+
+		fflush(manifestFile);
+		fclose(manifestFile);
 	}
 
-	fclose(featsFile);
 	return SP_CONFIG_SUCCESS;
 }
 
+/*
+ * Helper function to read the entry of an image in a manifest
+ */
+bool readManifestEntry(SPTokenizer* tokenizer, int* imageIndex,
+		int* featuresCount) {
+	return spTokenizerReadInt(tokenizer, imageIndex)
+			&& spTokenizerExpect(tokenizer, ',')
+			&& spTokenizerReadInt(tokenizer, featuresCount);
+}
+
+/*
+ * Helper function to check the entries of a manifest against the features
+ * loaded, an entry of an image in the catalog having to list the number of
+ * features the image has. Returns the number of entries read, or -1 if one
+ * disagrees or the manifest is truncated.
+ */
+int checkManifestEntries(SPTokenizer* tokenizer, int imagesInShard,
+		int imagesCount, const int* counts, const char* manifestPath) {
+	int imageIndex, featuresCount, i;
+
+	for (i = 0; i < imagesInShard; i++) {
+		if (!readManifestEntry(tokenizer, &imageIndex, &featuresCount)) {
+			SP_LOG_WARNING("Manifest %s is truncated at line %d, column %d, it is"
+					" skipped", manifestPath, spTokenizerGetLine(tokenizer),
+					spTokenizerGetColumn(tokenizer));
+			return -1;
+		}
+		if (imageIndex >= 0 && imageIndex < imagesCount
+				&& counts[imageIndex] != featuresCount) {
+			SP_LOG_WARNING("Manifest %s lists %d features for image %d, which has %d,"
+					" it is skipped", manifestPath, featuresCount, imageIndex,
+					counts[imageIndex]);
+			return -1;
+		}
+	}
+	return imagesInShard;
+}
+
+SP_CONFIG_MSG readShardManifests(SPShardedIndex* index, SPConfig config,
+		const int* counts) {
+	char manifestPath[SERIALIZER_PATH_LENGTH];
+	char* buffer;
+	SPTokenizer tokenizer, entries;
+	SP_CONFIG_MSG msg;
+	int shardsCount = spShardedIndexGetShardsCount(index);
+	int imagesCount = spShardedIndexGetImagesCount(index);
+	int shard, fileShard, fileShardsCount, imagesInShard, imageIndex,
+			featuresCount, i;
+
+	if (index == NULL || config == NULL || counts == NULL) {
+		return SP_CONFIG_INVALID_ARGUMENT;
+	}
+
+	for (shard = 0; shard < shardsCount; shard++) {
+		if (spConfigGetShardManifestPath(manifestPath, config, shard)
+				!= SP_CONFIG_SUCCESS) {
+			continue;
+		}
+		msg = readSerializedFile(manifestPath, &buffer, NULL);
+		if (msg == SP_CONFIG_ALLOC_FAIL) {
+			return msg;
+		}
+		if (msg != SP_CONFIG_SUCCESS) {
+			SP_LOG_INFO("No manifest for shard %d, its images are assigned anew",
+					shard);
+			continue;
+		}
+
+		spTokenizerInit(&tokenizer, buffer);
+		if (!spTokenizerReadInt(&tokenizer, &fileShard)
+				|| !spTokenizerExpect(&tokenizer, ',')
+				|| !spTokenizerReadInt(&tokenizer, &fileShardsCount)
+				|| !spTokenizerReadInt(&tokenizer, &imagesInShard)
+				|| fileShard != shard || fileShardsCount != shardsCount) {
+			SP_LOG_WARNING("Manifest %s doesn't match %d shards, it is skipped",
+					manifestPath, shardsCount);
+			free(buffer);
+			continue;
+		}
+
+		// a stale manifest is skipped whole, and written anew once the images
+		// are placed, so its entries are checked before any is assigned
+		entries = tokenizer;
+		imagesInShard = checkManifestEntries(&tokenizer, imagesInShard,
+				imagesCount, counts, manifestPath);
+		for (i = 0; i < imagesInShard; i++) {
+			readManifestEntry(&entries, &imageIndex, &featuresCount);
+			// images no longer in the catalog are dropped from the shard
+			spShardedIndexAssign(index, imageIndex, shard);
+		}
+
+		free(buffer);
+	}
+
+	return SP_CONFIG_SUCCESS;
+}
@@ -10,6 +10,7 @@
 
 #include "SPConfig.h"
 #include "SPPoint.h"
+#include "SPShardedIndex.h"
 
 #define VERIFY_ALLOC(ptr)   \
 	if ((ptr) == NULL) {	\
@@ -24,25 +25,79 @@
  * @param config - the configs provider
  * @param imageIndex - index of the image to which the feats belong to
  *
- * Creates features file for the index-th image in directory
+ * Creates features file for the index-th image in directory, in the format
+ * spConfigGetFeaturesFormat returns
  *
  * @return SP_CONFIG_UNKNOWN_ERROR if fopens fails
  * @return SP_CONFIG_SUCCESS if successful
  */
 SP_CONFIG_MSG writeImageFeaturesToFile(SPPoint* imFeatures, int numOfFeats, SPConfig config, int imageIndex);
 
+/*
+ * @param imFeatures - the features extracted
+ * @param numOfFeats - the number of features
+ * @param config - the configs provider
+ * @param imageIndex - index of the image to which the feats belong to
+ * @param format - the format of the file
+ *
+ * Creates features file for the index-th image in directory, in the given
+ * format. The binary format doesn't store the index of every feature, the
+ * features read from it all belong to the index-th image. The file is written
+ * to a temporary file in the same directory, which is renamed over it once
+ * written whole, so a failed write keeps the previous file.
+ *
+ * @return SP_CONFIG_UNKNOWN_ERROR if fopens, the writing or the renaming fails
+ * @return SP_CONFIG_ALLOC_FAIL if the binary encoding can't be allocated
+ * @return SP_CONFIG_SUCCESS if successful
+ */
+SP_CONFIG_MSG writeImageFeaturesInFormat(SPPoint* imFeatures, int numOfFeats,
+		SPConfig config, int imageIndex, FeaturesFormat format);
+
 /*
  * @param imFeatures - an output parameter for the imported features
  * @param numOfFeats - an output parameter for the number of imported features
  * @param config - the configs provider
  * @param imageIndex - index of the image to which the feats belong to
  *
- * Creates features file for the index-th image in directory
+ * Reads the features file of the index-th image in directory, in either
+ * format. A feature of a text file must have the dimension spPCADimension. An
+ * invalid file is logged with the line and column it fails at, and nothing is
+ * returned.
  *
- * @return SP_CONFIG_UNKNOWN_ERROR if fopens fails
+ * @return SP_CONFIG_UNKNOWN_ERROR if the file can't be read or is invalid
+ * @return SP_CONFIG_ALLOC_FAIL if an allocation fails
  * @return SP_CONFIG_SUCCESS if successful
  */
 SP_CONFIG_MSG readImageFeaturesFromFile(SPPoint** imFeatures, int* numOfFeats, SPConfig config, int imageIndex);
 
+/*
+ * @param index - a sharded index whose images were all added
+ * @param config - the configs provider
+ *
+ * Creates the manifest file of every shard in directory, listing the images
+ * assigned to the shard and their number of features
+ *
+ * @return SP_CONFIG_UNKNOWN_ERROR if fopens fails
+ * @return SP_CONFIG_SUCCESS if successful
+ */
+SP_CONFIG_MSG writeShardManifests(SPShardedIndex* index, SPConfig config);
+
+/*
+ * @param index - a sharded index to which no features were added yet
+ * @param config - the configs provider
+ * @param counts - the number of features of every image, as loaded
+ *
+ * Restores the assignment of images to shards from the manifest files in
+ * directory. Missing manifests, manifests written for a different number of
+ * shards, truncated manifests and manifests listing a number of features an
+ * image doesn't have are skipped whole, and images out of range are dropped,
+ * so the skipped images are assigned anew once their features are added.
+ *
+ * @return SP_CONFIG_INVALID_ARGUMENT if index, config or counts is NULL
+ * @return SP_CONFIG_ALLOC_FAIL if a manifest can't be read for lack of memory
+ * @return SP_CONFIG_SUCCESS otherwise
+ */
+SP_CONFIG_MSG readShardManifests(SPShardedIndex* index, SPConfig config,
+		const int* counts);
 
 #endif /* SPFEATURESSERIALIZER_H_ */
@@ -0,0 +1,196 @@
+/*
+ * SPFileFormat.c
+ */
+
+#include <string.h>
+#include <limits.h>
+#include <pthread.h>
+#include "SPFileFormat.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define SP_HAVE_CRC32_INSTRUCTION
+#endif
+
+/** the reversed polynomial of CRC32C **/
+#define CRC32C_POLYNOMIAL 0x82F63B78u
+
+/** the tables of the software CRC32C, one per byte of a word **/
+static uint32_t crcTables[8][256];
+
+/** the function computing the CRC32C, chosen once **/
+static uint32_t (*crcFunction)(uint32_t, const unsigned char*, size_t);
+
+static pthread_once_t crcOnce = PTHREAD_ONCE_INIT;
+
+/*
+ * Helper function to compute the CRC32C with tables, eight bytes at a time
+ */
+uint32_t crcWithTables(uint32_t crc, const unsigned char* data, size_t length) {
+	uint64_t word;
+
+	for (; length >= 8; length -= 8, data += 8) {
+		memcpy(&word, data, sizeof(word));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+		word = __builtin_bswap64(word);
+#endif
+		word ^= crc;
+		crc = crcTables[7][word & 0xFF] ^ crcTables[6][(word >> 8) & 0xFF]
+				^ crcTables[5][(word >> 16) & 0xFF] ^ crcTables[4][(word >> 24) & 0xFF]
+				^ crcTables[3][(word >> 32) & 0xFF] ^ crcTables[2][(word >> 40) & 0xFF]
+				^ crcTables[1][(word >> 48) & 0xFF] ^ crcTables[0][word >> 56];
+	}
+	for (; length > 0; length--) {
+		crc = crcTables[0][(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+	}
+	return crc;
+}
+
+#ifdef SP_HAVE_CRC32_INSTRUCTION
+/*
+ * Helper function to compute the CRC32C with the crc32 instruction of SSE4.2
+ */
+__attribute__((target("sse4.2")))
+uint32_t crcWithInstruction(uint32_t crc, const unsigned char* data,
+		size_t length) {
+	unsigned long long wide = crc;
+	uint64_t word;
+
+	for (; length >= 8; length -= 8, data += 8) {
+		memcpy(&word, data, sizeof(word));
+		wide = __builtin_ia32_crc32di(wide, word);
+	}
+	crc = (uint32_t) wide;
+	for (; length > 0; length--) {
+		crc = __builtin_ia32_crc32qi(crc, *data++);
+	}
+	return crc;
+}
+#endif
+
+/*
+ * Helper function to build the tables and choose the function, once
+ */
+void initFileChecksum() {
+	uint32_t crc;
+
+	for (int i = 0; i < 256; i++) {
+		crc = (uint32_t) i;
+		for (int bit = 0; bit < 8; bit++) {
+			crc = (crc >> 1) ^ ((crc & 1) ? CRC32C_POLYNOMIAL : 0);
+		}
+		crcTables[0][i] = crc;
+	}
+	for (int i = 0; i < 256; i++) {
+		for (int table = 1; table < 8; table++) {
+			crcTables[table][i] = crcTables[0][crcTables[table - 1][i] & 0xFF]
+					^ (crcTables[table - 1][i] >> 8);
+		}
+	}
+	crcFunction = crcWithTables;
+#ifdef SP_HAVE_CRC32_INSTRUCTION
+	if (__builtin_cpu_supports("sse4.2")) {
+		crcFunction = crcWithInstruction;
+	}
+#endif
+}
+
+uint32_t spFileChecksum(uint32_t crc, const void* data, size_t length) {
+	pthread_once(&crcOnce, initFileChecksum);
+	return ~crcFunction(~crc, (const unsigned char*) data, length);
+}
+
+/*
+ * Helper functions to store integers little endian
+ */
+void putFormatUint32(unsigned char* data, uint32_t value) {
+	for (int i = 0; i < 4; i++) {
+		data[i] = (unsigned char) (value >> (8 * i));
+	}
+}
+
+uint32_t getFormatUint32(const unsigned char* data) {
+	uint32_t value = 0;
+	for (int i = 0; i < 4; i++) {
+		value |= (uint32_t) data[i] << (8 * i);
+	}
+	return value;
+}
+
+void spFileHeaderWrite(SPFileHeader* header, const void* payload, size_t length,
+		unsigned char* data) {
+	header->version = SP_FILE_FORMAT_VERSION;
+	header->payloadLength = (uint32_t) length;
+	header->checksum = spFileChecksum(0, payload, length);
+	memcpy(data, header->magic, SP_FILE_MAGIC_LENGTH);
+	putFormatUint32(data + 4, (uint32_t) header->version);
+	putFormatUint32(data + 8, (uint32_t) header->dim);
+	putFormatUint32(data + 12, (uint32_t) header->count);
+	putFormatUint32(data + 16, header->payloadLength);
+	putFormatUint32(data + 20, header->checksum);
+}
+
+SP_FILE_FORMAT_MSG spFileHeaderRead(const void* data, size_t length,
+		const char* magic, SPFileHeader* header) {
+	const unsigned char* bytes = (const unsigned char*) data;
+	uint32_t version, dim, count;
+
+	if (length < SP_FILE_MAGIC_LENGTH
+			|| memcmp(bytes, magic, SP_FILE_MAGIC_LENGTH) != 0) {
+		return SP_FILE_FORMAT_BAD_MAGIC;
+	}
+	if (length < SP_FILE_HEADER_LENGTH) {
+		return SP_FILE_FORMAT_TRUNCATED;
+	}
+	version = getFormatUint32(bytes + 4);
+	dim = getFormatUint32(bytes + 8);
+	count = getFormatUint32(bytes + 12);
+	if (version < 1 || version > SP_FILE_FORMAT_VERSION) {
+		return SP_FILE_FORMAT_UNSUPPORTED_VERSION;
+	}
+	if (dim > INT_MAX || count > INT_MAX) {
+		return SP_FILE_FORMAT_INVALID;
+	}
+	memcpy(header->magic, bytes, SP_FILE_MAGIC_LENGTH);
+	header->version = (int) version;
+	header->dim = (int) dim;
+	header->count = (int) count;
+	header->payloadLength = getFormatUint32(bytes + 16);
+	header->checksum = getFormatUint32(bytes + 20);
+	return SP_FILE_FORMAT_SUCCESS;
+}
+
+SP_FILE_FORMAT_MSG spFileHeaderVerify(const SPFileHeader* header,
+		const void* data, size_t length) {
+	const unsigned char* payload = (const unsigned char*) data
+			+ SP_FILE_HEADER_LENGTH;
+
+	if (length < SP_FILE_HEADER_LENGTH
+			|| length - SP_FILE_HEADER_LENGTH < header->payloadLength) {
+		return SP_FILE_FORMAT_TRUNCATED;
+	}
+	if (length - SP_FILE_HEADER_LENGTH > header->payloadLength) {
+		return SP_FILE_FORMAT_INVALID;
+	}
+	if (spFileChecksum(0, payload, header->payloadLength) != header->checksum) {
+		return SP_FILE_FORMAT_CHECKSUM_MISMATCH;
+	}
+	return SP_FILE_FORMAT_SUCCESS;
+}
+
+const char* spFileFormatDescribe(SP_FILE_FORMAT_MSG msg) {
+	switch (msg) {
+	case SP_FILE_FORMAT_BAD_MAGIC:
+		return "is not of the expected kind";
+	case SP_FILE_FORMAT_UNSUPPORTED_VERSION:
+		return "has a version this build doesn't read";
+	case SP_FILE_FORMAT_TRUNCATED:
+		return "is truncated";
+	case SP_FILE_FORMAT_CHECKSUM_MISMATCH:
+		return "doesn't match its checksum";
+	case SP_FILE_FORMAT_INVALID:
+		return "is invalid";
+	case SP_FILE_FORMAT_SUCCESS:
+		return "is valid";
+	}
+	return "is invalid";
+}
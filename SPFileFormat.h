@@ -0,0 +1,116 @@
+/*
+ * SPFileFormat.h
+ */
+
+#ifndef SPFILEFORMAT_H_
+#define SPFILEFORMAT_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * The header every binary file of the system starts with, so a file of the
+ * wrong kind, of a newer version, of another PCA dimension, truncated or
+ * corrupted is rejected before it's used.
+ *
+ * A header is made of, in 4 bytes each and little endian:
+ * - the magic of the kind of file
+ * - the version of the format
+ * - the dimension of the records, the PCA dimension for features
+ * - the number of records
+ * - the length of the payload which follows the header
+ * - the CRC32C of the payload
+ *
+ * The CRC32C is computed with the crc32 instruction of SSE4.2 when the
+ * processor has it, and with tables eight bytes at a time otherwise.
+ */
+
+/** the length of the magic of a kind of file **/
+#define SP_FILE_MAGIC_LENGTH 4
+
+/** the length of a header **/
+#define SP_FILE_HEADER_LENGTH 24
+
+/** the version of the formats written, older versions are still read **/
+#define SP_FILE_FORMAT_VERSION 1
+
+typedef struct sp_file_header_t {
+	char magic[SP_FILE_MAGIC_LENGTH];
+	int version;
+	int dim;
+	int count;
+	uint32_t payloadLength;
+	uint32_t checksum;
+} SPFileHeader;
+
+/** Type used for reading and verifying headers **/
+typedef enum sp_file_format_msg_t {
+	SP_FILE_FORMAT_BAD_MAGIC,
+	SP_FILE_FORMAT_UNSUPPORTED_VERSION,
+	SP_FILE_FORMAT_TRUNCATED,
+	SP_FILE_FORMAT_CHECKSUM_MISMATCH,
+	SP_FILE_FORMAT_INVALID,
+	SP_FILE_FORMAT_SUCCESS
+} SP_FILE_FORMAT_MSG;
+
+/*
+ * @param crc - 0, or the CRC32C of the bytes before data to continue it
+ * @param data - the bytes
+ * @param length - the number of bytes
+ *
+ * @return the CRC32C of the bytes
+ */
+uint32_t spFileChecksum(uint32_t crc, const void* data, size_t length);
+
+/*
+ * @param header - the header to write, whose magic, dim and count are set
+ * @param payload - the payload which follows the header
+ * @param length - the length of the payload
+ * @param data - the output, of at least SP_FILE_HEADER_LENGTH bytes
+ *
+ * Writes the header of the current version, with the length and the checksum
+ * of the payload, which are stored in header as well
+ */
+void spFileHeaderWrite(SPFileHeader* header, const void* payload, size_t length,
+		unsigned char* data);
+
+/*
+ * @param data - the first bytes of a file
+ * @param length - the number of bytes
+ * @param magic - the magic of the kind of file expected
+ * @param header - pointer in which the header is stored
+ *
+ * Reads a header without verifying the payload
+ *
+ * @return SP_FILE_FORMAT_BAD_MAGIC if the file isn't of the kind expected
+ * @return SP_FILE_FORMAT_TRUNCATED if the header is truncated
+ * @return SP_FILE_FORMAT_UNSUPPORTED_VERSION if the version is newer than the
+ * 		   one of this build
+ * @return SP_FILE_FORMAT_INVALID if the dimension or the count is negative
+ * @return SP_FILE_FORMAT_SUCCESS otherwise
+ */
+SP_FILE_FORMAT_MSG spFileHeaderRead(const void* data, size_t length,
+		const char* magic, SPFileHeader* header);
+
+/*
+ * @param header - a header read
+ * @param data - the whole file, header included
+ * @param length - the length of the file
+ *
+ * @return SP_FILE_FORMAT_TRUNCATED if the payload is shorter than the header says
+ * @return SP_FILE_FORMAT_INVALID if it is longer
+ * @return SP_FILE_FORMAT_CHECKSUM_MISMATCH if it is corrupted
+ * @return SP_FILE_FORMAT_SUCCESS otherwise
+ */
+SP_FILE_FORMAT_MSG spFileHeaderVerify(const SPFileHeader* header,
+		const void* data, size_t length);
+
+/*
+ * @param msg - a message of the functions above
+ *
+ * @return a description of the message, to be logged
+ */
+const char* spFileFormatDescribe(SP_FILE_FORMAT_MSG msg);
+
+#endif /* SPFILEFORMAT_H_ */
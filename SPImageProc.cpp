@@ -7,9 +7,11 @@
 #include <opencv2/imgcodecs.hpp>
 #include <opencv2/highgui.hpp>
 #include <cstdio>
+#include <algorithm>
 #include "SPImageProc.h"
 extern "C" {
 #include "SPLogger.h"
+#include "SPFileFormat.h"
 }
 
 using namespace cv;
@@ -18,13 +20,23 @@ using namespace std;
 #define PCA_MEAN_STR "mean"
 #define PCA_EIGEN_VEC_STR "e_vectors"
 #define PCA_EIGEN_VAL_STR "e_values"
+#define PCA_VERSION_STR "version"
+#define PCA_DIM_STR "pca_dim"
+#define PCA_CHECKSUM_STR "checksum"
 #define STRING_LENGTH 1024
-#define WARNING_MSG_LENGTH 2048
+
+/** the shortest side an image is detected at half its size **/
+#define MIN_HALVED_SIDE 64
 
 #define GENERAL_ERROR_MSG "An error occurred"
 #define PCA_DIM_ERROR_MSG "PCA dimension couldn't be resolved"
 #define PCA_FILE_NOT_EXIST "PCA file doesn't exist"
+#define PCA_PROJECTION_ERROR "PCA projection couldn't be created"
 #define PCA_FILE_NOT_RESOLVED "PCA filename couldn't be resolved"
+#define PCA_VERSION_ERROR "PCA file has a version this build doesn't read"
+#define PCA_FILE_DIM_ERROR "PCA file has fewer dimensions than the PCA dimension"
+#define PCA_CHECKSUM_ERROR "PCA file doesn't match its checksum"
+#define PCA_LEGACY_WARNING "PCA file has no version, its dimension and checksum aren't validated"
 #define NUM_OF_IMAGES_ERROR "Number of images couldn't be resolved"
 #define NUM_OF_FEATS_ERROR "Number of features couldn't be resolved"
 #define MINIMAL_GUI_ERROR "Minimal GUI mode couldn't be resolved"
@@ -34,6 +46,26 @@ using namespace std;
 #define ALLOC_ERROR_MSG "Allocation error"
 #define INVALID_ARG_ERROR "Invalid arguments"
 
+size_t sp::getMatBytes(const Mat& mat) {
+	return mat.empty() ? 0 : mat.total() * mat.elemSize();
+}
+
+void sp::ExtractionContext::chargeBuffers() {
+	size_t bytes = getMatBytes(image) + getMatBytes(scaled)
+			+ getMatBytes(descriptors) + getMatBytes(converted)
+			+ keypoints.capacity() * sizeof(KeyPoint);
+	if (bytes > chargedBytes) {
+		spMemoryCharge(SP_MEMORY_IMAGE_PROC, bytes - chargedBytes);
+	} else {
+		spMemoryRelease(SP_MEMORY_IMAGE_PROC, chargedBytes - bytes);
+	}
+	chargedBytes = bytes;
+}
+
+sp::ExtractionContext::~ExtractionContext() {
+	spMemoryRelease(SP_MEMORY_IMAGE_PROC, chargedBytes);
+}
+
 void sp::ImageProc::initFromConfig(const SPConfig config) {
 	SP_CONFIG_MSG msg = SP_CONFIG_SUCCESS;
 	pcaDim = spConfigGetPCADim(config, &msg);
@@ -56,10 +88,15 @@ void sp::ImageProc::initFromConfig(const SPConfig config) {
 		spLoggerPrintError(MINIMAL_GUI_ERROR, __FILE__, __func__, __LINE__);
 		throw Exception();
 	}
+	for (ImageRole role = DATABASE_IMAGES; role <= QUERY_IMAGES;
+			role = (ImageRole) (role + 1)) {
+		limits[role].maxImageSide = spConfigGetMaxImageSide(config, role, &msg);
+		limits[role].octaveLayers = spConfigGetOctaveLayers(config, role, &msg);
+		limits[role].enoughFeatures = spConfigGetEnoughFeatures(config, role, &msg);
+	}
 }
 
 void sp::ImageProc::getImagesMat(vector<Mat>& images, const SPConfig config) {
-	char warningMSG[WARNING_MSG_LENGTH] = { '\0' };
 	for (int i = 0; i < numOfImages; i++) {
 		char imagePath[STRING_LENGTH + 1] = { '\0' };
 		if (spConfigGetImagePath(imagePath, config, i) != SP_CONFIG_SUCCESS) {
@@ -69,8 +106,7 @@ void sp::ImageProc::getImagesMat(vector<Mat>& images, const SPConfig config) {
 
 		Mat img = imread(imagePath, IMREAD_GRAYSCALE);
 		if (img.empty()) {
-			sprintf(warningMSG, "%s %s", imagePath, IMAGE_NOT_EXIST_MSG);
-			spLoggerPrintWarning(warningMSG, __FILE__, __func__, __LINE__);
+			SP_LOG_WARNING("%s %s", imagePath, IMAGE_NOT_EXIST_MSG);
 			continue;
 		}
 		images.push_back(img);
@@ -78,41 +114,65 @@ void sp::ImageProc::getImagesMat(vector<Mat>& images, const SPConfig config) {
 }
 
 void sp::ImageProc::getFeatures(vector<Mat>& images, Mat& features) {
-	//To store the keypoints that will be extracted by SIFT
-	vector<KeyPoint> keypoints;
 	//To store the SIFT descriptor of current image
 	Mat descriptor;
-	//To store all the descriptors that are extracted from all the images.
-
-	//The SIFT feature extractor and descriptor
-	Ptr<xfeatures2d::SiftDescriptorExtractor> detector =
-			xfeatures2d::SIFT::create(numOfFeatures);
+	//The PCA is trained on the descriptors the database images get
+	ExtractionContext context(DATABASE_IMAGES);
 
 	//feature descriptors and build the vocabulary
 	for (int i = 0; i < static_cast<int>(images.size()); i++) {
-		//detect feature points
-		detector->detect(images[i], keypoints);
-		//compute the descriptors for each keypoint
-		detector->compute(images[i], keypoints, descriptor);
+		//detect feature points and compute the descriptors for each keypoint
+		describeImage(images[i], descriptor, context);
 		//put the all feature descriptors in a single Mat object
 		features.push_back(descriptor);
 	}
 }
 
+/*
+ * Helper function to get the CRC32C of the data of a Mat, continued from crc
+ */
+uint32_t getMatChecksum(uint32_t crc, const Mat& mat) {
+	Mat rows = mat.isContinuous() ? mat : mat.clone();
+	return spFileChecksum(crc, rows.ptr(0), rows.total() * rows.elemSize());
+}
+
+/*
+ * Helper function to get the CRC32C of the PCA saved in the PCA file
+ */
+uint32_t getPCAChecksum(const PCA& pca) {
+	uint32_t crc = getMatChecksum(0, pca.eigenvectors);
+	crc = getMatChecksum(crc, pca.eigenvalues);
+	return getMatChecksum(crc, pca.mean);
+}
+
 void sp::ImageProc::preprocess(const SPConfig config) {
 	try {
 		vector<Mat> images;
 		Mat features;
 		char pcaPath[STRING_LENGTH + 1] = { '\0' };
+		size_t trainingBytes = 0;
 		getImagesMat(images, config);
 		getFeatures(images, features);
+		// every image is held until the PCA is trained, the peak of the extraction
+		for (size_t i = 0; i < images.size(); i++) {
+			trainingBytes += getMatBytes(images[i]);
+		}
+		trainingBytes += getMatBytes(features);
+		spMemoryCharge(SP_MEMORY_IMAGE_PROC, trainingBytes);
 		pca = PCA(features, Mat(), CV_PCA_DATA_AS_ROW, pcaDim);
+		images.clear();
+		features.release();
+		spMemoryRelease(SP_MEMORY_IMAGE_PROC, trainingBytes);
 		if (spConfigGetPCAPath(pcaPath, config) != SP_CONFIG_SUCCESS) {
 			spLoggerPrintError(PCA_FILE_NOT_RESOLVED, __FILE__, __func__,
 			__LINE__);
 			throw Exception();
 		}
 		FileStorage fs(pcaPath, FileStorage::WRITE);
+		fs << PCA_VERSION_STR << SP_FILE_FORMAT_VERSION;
+		fs << PCA_DIM_STR << pca.eigenvectors.rows;
+		// stored as an int, the type of integers of the file
+		fs << PCA_CHECKSUM_STR << (int) getPCAChecksum(pca);
 		fs << PCA_EIGEN_VEC_STR << pca.eigenvectors;
 		fs << PCA_EIGEN_VAL_STR << pca.eigenvalues;
 		fs << PCA_MEAN_STR << pca.mean;
@@ -141,10 +201,43 @@ void sp::ImageProc::initPCAFromFile(const SPConfig config) {
 	fs[PCA_EIGEN_VEC_STR] >> pca.eigenvectors;
 	fs[PCA_EIGEN_VAL_STR] >> pca.eigenvalues;
 	fs[PCA_MEAN_STR] >> pca.mean;
+	FileNode version = fs[PCA_VERSION_STR];
+	if (version.empty() || version.isNone()) {
+		// written before the PCA file had a version
+		spLoggerPrintWarning(PCA_LEGACY_WARNING, __FILE__, __func__, __LINE__);
+	} else if ((int) version > SP_FILE_FORMAT_VERSION) {
+		spLoggerPrintError(PCA_VERSION_ERROR, __FILE__, __func__, __LINE__);
+		throw Exception();
+	} else if ((int) fs[PCA_DIM_STR] < pcaDim
+			|| (int) fs[PCA_DIM_STR] != pca.eigenvectors.rows) {
+		spLoggerPrintError(PCA_FILE_DIM_ERROR, __FILE__, __func__, __LINE__);
+		throw Exception();
+	} else if ((uint32_t) (int) fs[PCA_CHECKSUM_STR] != getPCAChecksum(pca)) {
+		spLoggerPrintError(PCA_CHECKSUM_ERROR, __FILE__, __func__, __LINE__);
+		throw Exception();
+	}
 	fs.release();
 }
 
-sp::ImageProc::ImageProc(const SPConfig config) {
+void sp::ImageProc::initProjection() {
+	Mat eigenvectors, mean;
+	// the projection multiplies floats, as SIFT describes, whatever the PCA was saved in
+	pca.eigenvectors.convertTo(eigenvectors, CV_32F);
+	pca.mean.convertTo(mean, CV_32F);
+	if (eigenvectors.rows < pcaDim || (int) mean.total() != eigenvectors.cols) {
+		spLoggerPrintError(PCA_DIM_ERROR_MSG, __FILE__, __func__, __LINE__);
+		throw Exception();
+	}
+	projection = spProjectionCreate(eigenvectors.ptr<float>(0),
+			mean.ptr<float>(0), eigenvectors.cols, pcaDim);
+	if (!projection) {
+		spLoggerPrintError(PCA_PROJECTION_ERROR, __FILE__, __func__, __LINE__);
+		throw Exception();
+	}
+}
+
+sp::ImageProc::ImageProc(const SPConfig config) :
+		projection(NULL), chargedBytes(0) {
 	try {
 		if (!config) {
 			spLoggerPrintError(INVALID_ARG_ERROR, __FILE__, __func__, __LINE__);
@@ -153,11 +246,16 @@ sp::ImageProc::ImageProc(const SPConfig config) {
 		SP_CONFIG_MSG msg;
 		bool preprocMode = false;
 		initFromConfig(config);
-		if ((preprocMode = spConfigIsExtractionMode(config, &msg))) {
+		if ((preprocMode = spConfigIsExtractionMode(config, &msg))
+				&& !spConfigIsAppendMode(config, &msg)) {
 			preprocess(config);
 		} else {
 			initPCAFromFile(config);
 		}
+		initProjection();
+		chargedBytes = getMatBytes(pca.eigenvectors)
+				+ getMatBytes(pca.eigenvalues) + getMatBytes(pca.mean);
+		spMemoryCharge(SP_MEMORY_IMAGE_PROC, chargedBytes);
 	} catch (Exception& e) {
 		spLoggerPrintError(e.what(), __FILE__, __func__, __LINE__);
 		throw Exception();
@@ -167,49 +265,129 @@ sp::ImageProc::ImageProc(const SPConfig config) {
 	}
 }
 
+sp::ImageProc::~ImageProc() {
+	spMemoryRelease(SP_MEMORY_IMAGE_PROC, chargedBytes);
+	spProjectionDestroy(projection);
+}
+
 SPPoint* sp::ImageProc::getImageFeatures(const char* imagePath, int index,
 		int* numOfFeats) {
-	vector<KeyPoint> keypoints;
-	Mat descriptor, img, points;
-	double* pcaSift = NULL;
-	char errorMSG[STRING_LENGTH * 2];
-	Ptr<xfeatures2d::SiftDescriptorExtractor> detector;
+	Mat descriptor, img;
 	if (!imagePath || !numOfFeats) {
 		spLoggerPrintError(INVALID_ARG_ERROR, __FILE__, __func__, __LINE__);
 		return NULL;
 	}
-	img = imread(imagePath, IMREAD_GRAYSCALE);
-	if (img.empty()) {
-		sprintf(errorMSG, "%s %s", imagePath, IMAGE_NOT_EXIST_MSG);
-		spLoggerPrintError(errorMSG, __FILE__, __func__, __LINE__);
+	ExtractionContext context(QUERY_IMAGES);
+	vector<double> features((size_t) getMaxFeatures() * pcaDim);
+	*numOfFeats = extractFeatures(imagePath, context, features.data(),
+			getMaxFeatures());
+	if (*numOfFeats < 0) {
 		return NULL;
 	}
-	detector = xfeatures2d::SIFT::create(numOfFeatures);
-	detector->detect(img, keypoints);
-	detector->compute(img, keypoints, descriptor);
-	points = pca.project(descriptor);
-	pcaSift = (double*) malloc(sizeof(double) * pcaDim);
-	if (!pcaSift) {
-		spLoggerPrintError(ALLOC_ERROR_MSG, __FILE__, __func__, __LINE__);
-		return NULL;
-	}
-	*numOfFeats = points.rows;
-	SPPoint* resPoints = (SPPoint*) malloc(sizeof(*resPoints) * points.rows);
+	SPPoint* resPoints = (SPPoint*) malloc(sizeof(*resPoints) * *numOfFeats);
 	if (!resPoints) {
-		free(pcaSift);
 		spLoggerPrintError(ALLOC_ERROR_MSG, __FILE__, __func__, __LINE__);
 		return NULL;
 	}
-	for (int i = 0; i < points.rows; i++) {
-		for (int j = 0; j < points.cols; j++) {
-			pcaSift[j] = (double) points.at<float>(i, j);
-		}
-		resPoints[i] = spPointCreate(pcaSift, pcaDim, index);
+	for (int i = 0; i < *numOfFeats; i++) {
+		resPoints[i] = spPointCreate(&features[(size_t) i * pcaDim], pcaDim, index);
 	}
-	free(pcaSift);
 	return resPoints;
 }
 
+int sp::ImageProc::getMaxFeatures() const {
+	return numOfFeatures;
+}
+
+int sp::ImageProc::extractFeatures(const char* imagePath,
+		ExtractionContext& context, double* features, int capacity) {
+	if (!imagePath || !features) {
+		spLoggerPrintError(INVALID_ARG_ERROR, __FILE__, __func__, __LINE__);
+		return -1;
+	}
+	if (!readImage(imagePath, context.image)) {
+		return -1;
+	}
+	describeImage(context.image, context.descriptors, context);
+	return projectFeatures(context.descriptors, context, features, capacity);
+}
+
+bool sp::ImageProc::readImage(const char* imagePath, Mat& image) {
+	image = imread(imagePath, IMREAD_GRAYSCALE);
+	if (image.empty()) {
+		SP_LOG_ERROR("%s %s", imagePath, IMAGE_NOT_EXIST_MSG);
+		return false;
+	}
+	return true;
+}
+
+void sp::ImageProc::describeImage(const Mat& image, Mat& descriptors,
+		ExtractionContext& context) {
+	const FeatureLimits& imageLimits = limits[context.role];
+	const Mat* detected = &image;
+	int side = max(image.rows, image.cols);
+	double scale = 1;
+	bool enough = false;
+	if (!context.detector) {
+		context.detector = xfeatures2d::SIFT::create(numOfFeatures,
+				imageLimits.octaveLayers);
+	}
+	if (imageLimits.maxImageSide > 0 && side > imageLimits.maxImageSide) {
+		scale = (double) imageLimits.maxImageSide / side;
+	}
+	context.keypoints.clear();
+	// half the size is about a quarter of the time, worth a try when it may be enough
+	if (imageLimits.enoughFeatures > 0 && side * scale / 2 >= MIN_HALVED_SIDE) {
+		resize(image, context.scaled, Size(), scale / 2, scale / 2, INTER_AREA);
+		context.detector->detect(context.scaled, context.keypoints);
+		enough = (int) context.keypoints.size() >= imageLimits.enoughFeatures;
+		if (enough) {
+			detected = &context.scaled;
+		} else {
+			context.keypoints.clear();
+		}
+	}
+	if (!enough) {
+		if (scale < 1) {
+			resize(image, context.scaled, Size(), scale, scale, INTER_AREA);
+			detected = &context.scaled;
+		}
+		context.detector->detect(*detected, context.keypoints);
+	}
+	// SIFT keeps the ties of the weakest keypoint it retains, which may exceed the budget
+	if (numOfFeatures > 0 && (int) context.keypoints.size() > numOfFeatures) {
+		nth_element(context.keypoints.begin(),
+				context.keypoints.begin() + numOfFeatures, context.keypoints.end(),
+				[](const KeyPoint& a, const KeyPoint& b) {
+					return a.response > b.response;
+				});
+		context.keypoints.resize(numOfFeatures);
+	}
+	context.detector->compute(*detected, context.keypoints, descriptors);
+	context.chargeBuffers();
+}
+
+int sp::ImageProc::projectFeatures(const Mat& descriptors,
+		ExtractionContext& context, double* features, int capacity) {
+	int rows = descriptors.rows < capacity ? descriptors.rows : capacity;
+	if (rows <= 0) {
+		return 0;
+	}
+	const Mat* input = &descriptors;
+	if (descriptors.cols != spProjectionGetInputDim(projection)) {
+		spLoggerPrintError(PCA_DIM_ERROR_MSG, __FILE__, __func__, __LINE__);
+		return 0;
+	}
+	// SIFT computes continuous float rows, anything else is converted first
+	if (descriptors.type() != CV_32F || !descriptors.isContinuous()) {
+		descriptors.rowRange(0, rows).convertTo(context.converted, CV_32F);
+		input = &context.converted;
+	}
+	spProjectionApply(projection, input->ptr<float>(0), rows, features);
+	context.chargeBuffers();
+	return rows;
+}
+
 void sp::ImageProc::showImage(const char* imgPath) {
 	if (minimalGui) {
 		Mat img = imread(imgPath, cv::IMREAD_COLOR);
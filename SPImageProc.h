@@ -2,15 +2,64 @@
 #define SPIMAGEPROC_H_
 #include <opencv2/core.hpp>
 #include <opencv2/imgcodecs.hpp>
+#include <opencv2/xfeatures2d.hpp>
 #include <vector>
 
 extern "C" {
 #include "SPConfig.h"
 #include "SPPoint.h"
+#include "SPProjection.h"
+#include "SPMemory.h"
 }
 
 namespace sp {
 
+/**
+ * Returns the bytes of the data of a matrix, 0 if it is empty, the bytes the
+ * image processing charges for it, see SPMemory.h.
+ */
+size_t getMatBytes(const cv::Mat& mat);
+
+/**
+ * The state an extraction keeps between images: the SIFT detector and the
+ * buffers of the keypoints, the image and its downscaled copy, the descriptors
+ * and their conversion for the projection, which keep their memory from one
+ * image to the next. A context must not be used by several threads at once,
+ * every thread extracting should have its own. The buffers are charged to the
+ * image processing as they grow, until the context is destroyed.
+ */
+class ExtractionContext {
+public:
+	/**
+	 * Creates a context for the images of the given role, whose limits on the
+	 * size of the images and the keypoints the extraction applies, see
+	 * spConfigGetMaxImageSide.
+	 *
+	 * @param role - DATABASE_IMAGES or QUERY_IMAGES
+	 */
+	explicit ExtractionContext(ImageRole role = DATABASE_IMAGES) :
+			role(role), chargedBytes(0) {}
+
+	ExtractionContext(const ExtractionContext&) = delete;
+	ExtractionContext& operator=(const ExtractionContext&) = delete;
+
+	/**
+	 * Releases the charge of the buffers of the context
+	 */
+	~ExtractionContext();
+private:
+	friend class ImageProc;
+	ImageRole role;
+	cv::Ptr<cv::xfeatures2d::SIFT> detector;
+	std::vector<cv::KeyPoint> keypoints;
+	cv::Mat image;
+	cv::Mat scaled;
+	cv::Mat descriptors;
+	cv::Mat converted;
+	size_t chargedBytes; // the bytes of the buffers charged to the image processing
+	void chargeBuffers();
+};
+
 /**
  * A class which supports different image processing functionalites.
  */
@@ -20,27 +69,47 @@ private:
 	int pcaDim;
 	int numOfImages;
 	int numOfFeatures;
+	// the limits of the extraction, per ImageRole
+	struct FeatureLimits {
+		int maxImageSide;
+		int octaveLayers;
+		int enoughFeatures;
+	} limits[2];
 	cv::PCA pca;
+	SPProjection* projection; // the PCA, in the layout projectFeatures multiplies by
 	bool minimalGui;
+	size_t chargedBytes; // the bytes of the PCA charged to the image processing
 	void initFromConfig(const SPConfig);
 	void getImagesMat(std::vector<cv::Mat>&, const SPConfig);
 	void getFeatures(std::vector<cv::Mat>&,
 			cv::Mat&);
 	void preprocess(const SPConfig config);
 	void initPCAFromFile(const SPConfig config);
+	void initProjection();
 public:
 
 	/**
 	 * Creates a new object for the purpose of image processing based
-	 * on the configuration file.
+	 * on the configuration file. In extraction mode a new PCA is trained over
+	 * all the images and saved, unless append mode is set, in which case the
+	 * existing PCA file is loaded as in query mode.
 	 * @param config - the configuration file from which the object is created
 	 */
 	ImageProc(const SPConfig config);
 
+	ImageProc(const ImageProc&) = delete;
+	ImageProc& operator=(const ImageProc&) = delete;
+
+	/**
+	 * Frees the resources of the object
+	 */
+	~ImageProc();
+
 	/**
 	 * Returns an array of features for the image imagePath. All SPPoint elements
 	 * will have the index given by index. The actual number of features extracted
-	 * for this image will be stored in the pointer given by numOfFeats.
+	 * for this image will be stored in the pointer given by numOfFeats. The
+	 * limits of the query images apply.
 	 *
 	 * @param imagePath - the target imagePath
 	 * @param index - the index  of the image in the database
@@ -52,6 +121,71 @@ public:
 	 */
 	SPPoint* getImageFeatures(const char* imagePath,int index,int* numOfFeats);
 
+	/**
+	 * Reads the image imagePath in grayscale, the first step of
+	 * getImageFeatures. May be called by several threads at once.
+	 *
+	 * @param imagePath - the target imagePath
+	 * @param image - the matrix in which the image will be stored
+	 * @return false if the image can't be read, true otherwise
+	 */
+	bool readImage(const char* imagePath, cv::Mat& image);
+
+	/**
+	 * Returns the most features extracted from an image, the capacity an
+	 * output block of extractFeatures or projectFeatures needs, in rows.
+	 */
+	int getMaxFeatures() const;
+
+	/**
+	 * Extracts the features of the image imagePath like getImageFeatures, but
+	 * reusing the detector and the buffers of the context, and writing the
+	 * projected features to a block given by the caller, a row of pcaDim
+	 * coordinates per feature, see spPointCreateArray.
+	 *
+	 * @param imagePath - the target imagePath
+	 * @param context - the extraction context of the calling thread
+	 * @param features - the output block, of capacity rows
+	 * @param capacity - the rows of the block, getMaxFeatures() is enough
+	 * @return
+	 * The number of features written, -1 in case of an error.
+	 */
+	int extractFeatures(const char* imagePath, ExtractionContext& context,
+			double* features, int capacity);
+
+	/**
+	 * Detects the SIFT keypoints of an image read by readImage and computes
+	 * the descriptors of the getMaxFeatures() strongest, the second step of
+	 * extractFeatures. The image is downscaled to the longest side set for the
+	 * role of the context first, and if enough keypoints are set for it, it is
+	 * detected at half that size, and at the full size only when fewer are
+	 * found. May be called by several threads at once, each with its own
+	 * context.
+	 *
+	 * @param image - the image
+	 * @param descriptors - the matrix in which the descriptors will be stored,
+	 * 					   a row per keypoint
+	 * @param context - the extraction context of the calling thread
+	 */
+	void describeImage(const cv::Mat& image, cv::Mat& descriptors,
+			ExtractionContext& context);
+
+	/**
+	 * Projects descriptors computed by describeImage on the PCA, the last step
+	 * of extractFeatures, all the descriptors in one blocked multiplication, see
+	 * SPProjection.h. May be called by several threads at once, each with its
+	 * own context.
+	 *
+	 * @param descriptors - the descriptors
+	 * @param context - the extraction context of the calling thread
+	 * @param features - the output block, of capacity rows of pcaDim coordinates
+	 * @param capacity - the rows of the block, extra descriptors are dropped
+	 * @return
+	 * The number of features written.
+	 */
+	int projectFeatures(const cv::Mat& descriptors, ExtractionContext& context,
+			double* features, int capacity);
+
 	/**
 	 *	Displays the image given by imagePath. Notice that this function works
 	 *	only in MinimalGUI mode (otherwise a warnning message is printed).
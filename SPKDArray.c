@@ -14,37 +14,94 @@
 
 #define NULL_CHECK(val,kdArr) if (val == NULL) { spKDArrayDestroy(kdArr); return NULL; }
 
+/** the number of independent accumulators in the sample statistics loops **/
+#define SP_KDARRAY_LANES 4
+
+#define SWAP_INDICES(indices, i, j) { \
+	int tmp = indices[i]; \
+	indices[i] = indices[j]; \
+	indices[j] = tmp; \
+}
+
 /*
  * A helper function to initialize the sorted array of indices for the given coordinate
  */
 void fillIndices(SPKDArray* kdArr, int coor);
 
 /*
- * A helper function to sort the indices array according to the given coordinate
+ * A helper function to sort the indices array according to the given coordinate,
+ * using the given buffers of pointsCount values and indices as scratch
  */
-void sortIndices(SPKDArray* kdArr, int coor);
+void sortIndices(SPKDArray* kdArr, int coor, double* keys, int* scratch);
 
+/*
+ * A kd-array is either presorted, holding the indices of its points sorted by
+ * every coordinate, or built for selection, holding a single order of its points
+ * which is partially ordered on demand by the axis being split. The arrays split
+ * from a selection kd-array borrow its points instead of copying them.
+ */
 struct SPKDArray {
 	SPPoint* points;
 	int pointsCount;
 	int dim;
-	int** sortedIndices;
+	int** sortedIndices; // NULL for selection kd-arrays
+	int* order; // selection kd-arrays only, ordered around orderedRank on orderedAxis
+	double* keys; // selection kd-arrays only, the coordinates on orderedAxis
+	int orderedAxis;
+	int orderedRank;
+	bool ownsPoints;
+	SPArena* arena; // the arena the array is allocated from, or NULL
+	size_t chargedBytes; // the bytes charged for the arrays, see SPMemory.h
 };
 
 /*
- * A helper function to initialize a kd-array
+ * A helper function to charge the arrays of a kd-array allocated on the heap,
+ * once they are all allocated
  */
-SPKDArray* InitBasic(SPPoint* arr, int size, int dim) {
-	SPKDArray* kdArr = (SPKDArray*) malloc(sizeof(SPKDArray));
+void chargeKDArray(SPKDArray* kdArr) {
+	size_t count = (size_t) kdArr->pointsCount;
+
+	kdArr->chargedBytes = sizeof(SPKDArray) + sizeof(SPPoint) * count;
+	if (kdArr->sortedIndices != NULL) {
+		kdArr->chargedBytes += (sizeof(int*) + sizeof(int) * count) * kdArr->dim;
+	} else {
+		kdArr->chargedBytes += (sizeof(int) + sizeof(double)) * count;
+	}
+	spMemoryCharge(SP_MEMORY_KD_ARRAY, kdArr->chargedBytes);
+}
+
+/*
+ * A helper function to compare two points by their keys, ties are broken by
+ * their index so the order is total
+ */
+int keysComparator(const double* keys, int index1, int index2) {
+	if (keys[index1] < keys[index2]) {
+		return -1;
+	}
+	if (keys[index1] > keys[index2]) {
+		return 1;
+	}
+	return (index1 > index2) - (index1 < index2);
+}
+
+/*
+ * A helper function to initialize a kd-array over copies of the given points,
+ * or over the points themselves if they are borrowed
+ */
+SPKDArray* InitBasic(SPPoint* arr, int size, int dim, bool borrowed) {
+	SPKDArray* kdArr = (SPKDArray*) calloc(1, sizeof(SPKDArray));
 	int i;
 	NULL_CHECK(kdArr, kdArr);
 
 	kdArr->pointsCount = size;
-	kdArr->points = (SPPoint*) malloc(sizeof(SPPoint) * size);
+	kdArr->ownsPoints = !borrowed;
+	kdArr->orderedAxis = -1;
+	kdArr->orderedRank = -1;
+	kdArr->points = (SPPoint*) calloc(size, sizeof(SPPoint));
 	NULL_CHECK(kdArr->points, kdArr);
 
 	for (i = 0; i < size; i++) {
-		SPPoint curr = spPointCopy(arr[i]);
+		SPPoint curr = borrowed ? arr[i] : spPointCopy(arr[i]);
 		NULL_CHECK(curr, kdArr);
 		kdArr->points[i] = curr;
 	}
@@ -59,31 +116,156 @@ SPKDArray* InitBasic(SPPoint* arr, int size, int dim) {
 		NULL_CHECK(kdArr->sortedIndices[i], kdArr);
 	}
 
+	chargeKDArray(kdArr);
 	return kdArr;
 }
 
-SPKDArray* spKDArrayInit(SPPoint* arr, int size, int dim) {
-	SPKDArray* kdArr = InitBasic(arr, size, dim);
+/*
+ * A helper function to initialize a kd-array allocated from an arena over the given
+ * points array, which is allocated from the arena as well. The points are borrowed.
+ */
+SPKDArray* InitInArena(SPArena* arena, SPPoint* points, int size, int dim,
+		bool presorted) {
+	SPKDArray* kdArr = (SPKDArray*) spArenaCalloc(arena, 1, sizeof(SPKDArray));
+	int* indices;
+	int i;
+
+	if (kdArr == NULL || points == NULL) {
+		return NULL;
+	}
+	kdArr->points = points;
+	kdArr->pointsCount = size;
+	kdArr->dim = dim;
+	kdArr->orderedAxis = -1;
+	kdArr->orderedRank = -1;
+	kdArr->ownsPoints = false;
+	kdArr->arena = arena;
+
+	if (!presorted) {
+		kdArr->order = (int*) spArenaAlloc(arena, sizeof(int) * size);
+		kdArr->keys = (double*) spArenaAlloc(arena, sizeof(double) * size);
+		if (kdArr->order == NULL || kdArr->keys == NULL) {
+			return NULL;
+		}
+		for (i = 0; i < size; i++) {
+			kdArr->order[i] = i;
+		}
+		return kdArr;
+	}
+
+	kdArr->sortedIndices = (int**) spArenaAlloc(arena, sizeof(int*) * dim);
+	indices = (int*) spArenaAlloc(arena, sizeof(int) * size * dim);
+	if (kdArr->sortedIndices == NULL || indices == NULL) {
+		return NULL;
+	}
+	for (i = 0; i < dim; i++) {
+		kdArr->sortedIndices[i] = indices + (size_t) i * size;
+	}
+	return kdArr;
+}
+
+/*
+ * A helper function to initialize a selection kd-array over the given points
+ * array, which it takes ownership of. The points themselves are borrowed.
+ */
+SPKDArray* InitSelection(SPPoint* points, int size, int dim) {
+	SPKDArray* kdArr = (SPKDArray*) calloc(1, sizeof(SPKDArray));
 	int i;
 	if (kdArr == NULL) {
+		free(points);
+		return NULL;
+	}
+
+	kdArr->points = points;
+	kdArr->pointsCount = size;
+	kdArr->dim = dim;
+	kdArr->orderedAxis = -1;
+	kdArr->orderedRank = -1;
+	kdArr->ownsPoints = false;
+	kdArr->order = (int*) malloc(sizeof(int) * size);
+	NULL_CHECK(kdArr->order, kdArr);
+	kdArr->keys = (double*) malloc(sizeof(double) * size);
+	NULL_CHECK(kdArr->keys, kdArr);
+
+	for (i = 0; i < size; i++) {
+		kdArr->order[i] = i;
+	}
+	chargeKDArray(kdArr);
+	return kdArr;
+}
+
+/*
+ * A helper function to initialize a kd-array sorted by every coordinate
+ */
+SPKDArray* InitPresorted(SPPoint* arr, int size, int dim, bool borrowed) {
+	SPKDArray* kdArr = InitBasic(arr, size, dim, borrowed);
+	double* keys = (double*) malloc(sizeof(double) * size);
+	int* scratch = (int*) malloc(sizeof(int) * size);
+	int i;
+	if (kdArr == NULL || keys == NULL || scratch == NULL) {
+		spKDArrayDestroy(kdArr);
+		free(keys);
+		free(scratch);
 		return NULL;
 	}
 
 	for (i = 0; i < dim; i++) {
 		fillIndices(kdArr, i);
-		sortIndices(kdArr, i);
+		sortIndices(kdArr, i, keys, scratch);
 	}
 
+	free(keys);
+	free(scratch);
 	return kdArr;
 }
 
-void spKDArrayDestroy(SPKDArray* kdArr) {
+SPKDArray* spKDArrayInit(SPPoint* arr, int size, int dim) {
+	return InitPresorted(arr, size, dim, false);
+}
+
+SPKDArray* spKDArrayInitBorrowed(SPPoint* arr, int size, int dim) {
+	return InitPresorted(arr, size, dim, true);
+}
+
+SPKDArray* spKDArrayInitSelection(SPPoint* arr, int size, int dim) {
+	SPPoint* points = (SPPoint*) calloc(size, sizeof(SPPoint));
+	SPKDArray* kdArr;
 	int i;
+	if (points == NULL) {
+		return NULL;
+	}
+
+	kdArr = InitSelection(points, size, dim);
 	if (kdArr == NULL) {
+		return NULL;
+	}
+	kdArr->ownsPoints = true;
+	for (i = 0; i < size; i++) {
+		kdArr->points[i] = spPointCopy(arr[i]);
+		NULL_CHECK(kdArr->points[i], kdArr);
+	}
+	return kdArr;
+}
+
+SPKDArray* spKDArrayInitSelectionBorrowed(SPPoint* arr, int size, int dim) {
+	SPPoint* points = (SPPoint*) malloc(sizeof(SPPoint) * (size + 1));
+	int i;
+	if (points == NULL) {
+		return NULL;
+	}
+	for (i = 0; i < size; i++) {
+		points[i] = arr[i];
+	}
+	return InitSelection(points, size, dim);
+}
+
+void spKDArrayDestroy(SPKDArray* kdArr) {
+	int i;
+	if (kdArr == NULL || kdArr->arena != NULL) {
 		return;
 	}
 	if (kdArr->points != NULL) {
-		for (i = 0; i < kdArr->pointsCount; i++) {
+		for (i = 0; kdArr->ownsPoints && i < kdArr->pointsCount; i++) {
 			spPointDestroy(kdArr->points[i]);
 		}
 
@@ -96,6 +278,9 @@ void spKDArrayDestroy(SPKDArray* kdArr) {
 		}
 		free(kdArr->sortedIndices);
 	}
+	free(kdArr->order);
+	free(kdArr->keys);
+	spMemoryRelease(SP_MEMORY_KD_ARRAY, kdArr->chargedBytes);
 	free(kdArr);
 }
 
@@ -106,34 +291,223 @@ void fillIndices(SPKDArray* kdArr, int coor) {
 	}
 }
 
-static SPKDArray* currentKdArr = NULL;
+void sortIndices(SPKDArray* kdArr, int axis, double* keys, int* scratch) {
+	int* from = kdArr->sortedIndices[axis];
+	int* to = scratch;
+	int* tmp;
+	int count = kdArr->pointsCount;
+	int width, low, mid, high, i, j, k;
+
+	// the coordinates are gathered once instead of on every comparison
+	for (i = 0; i < count; i++) {
+		keys[i] = spPointGetAxisCoor(kdArr->points[i], axis);
+	}
+
+	// bottom-up merge sort, passing the keys instead of sharing them in globals
+	for (width = 1; width < count; width *= 2) {
+		for (low = 0; low < count; low += 2 * width) {
+			mid = (low + width < count) ? low + width : count;
+			high = (low + 2 * width < count) ? low + 2 * width : count;
+			for (i = low, j = mid, k = low; k < high; k++) {
+				if (j >= high
+						|| (i < mid && keysComparator(keys, from[i], from[j]) <= 0)) {
+					to[k] = from[i++];
+				} else {
+					to[k] = from[j++];
+				}
+			}
+		}
+		tmp = from;
+		from = to;
+		to = tmp;
+	}
+
+	if (from != kdArr->sortedIndices[axis]) {
+		for (i = 0; i < count; i++) {
+			kdArr->sortedIndices[axis][i] = from[i];
+		}
+	}
+}
+
+/*
+ * A helper function to order a selection kd-array around the given rank on the
+ * given axis, so the first rank + 1 points in its order are the lowest
+ */
+void selectRank(SPKDArray* kdArr, int axis, int k) {
+	int* indices = kdArr->order;
+	double* keys = kdArr->keys;
+	int low = 0, high = kdArr->pointsCount - 1;
+	int i, j, mid, pivot;
+
+	if (kdArr->orderedAxis == axis && kdArr->orderedRank == k) {
+		return;
+	}
+	if (kdArr->orderedAxis != axis) {
+		for (i = 0; i < kdArr->pointsCount; i++) {
+			keys[i] = spPointGetAxisCoor(kdArr->points[i], axis);
+		}
+	}
+
+	// quickselect with a median of three pivot
+	while (low < high) {
+		mid = low + (high - low) / 2;
+		if (keysComparator(keys, indices[mid], indices[low]) < 0) {
+			SWAP_INDICES(indices, mid, low);
+		}
+		if (keysComparator(keys, indices[high], indices[low]) < 0) {
+			SWAP_INDICES(indices, high, low);
+		}
+		if (keysComparator(keys, indices[mid], indices[high]) < 0) {
+			SWAP_INDICES(indices, mid, high);
+		}
+		pivot = indices[high];
+		for (i = low, j = low; j < high; j++) {
+			if (keysComparator(keys, indices[j], pivot) < 0) {
+				SWAP_INDICES(indices, i, j);
+				i++;
+			}
+		}
+		SWAP_INDICES(indices, i, high);
+		if (i == k) {
+			break;
+		} else if (k < i) {
+			high = i - 1;
+		} else {
+			low = i + 1;
+		}
+	}
 
-static int currentAxis = -1;
+	kdArr->orderedAxis = axis;
+	kdArr->orderedRank = k;
+}
 
 /*
- * A helper function to compare two points in a kd-array
+ * A helper function to split a selection kd-array, the split arrays borrow its points
  */
-int pointsComparator(const void* ptr1, const void* ptr2) {
-	int index1 = *(const int*) ptr1;
-	int index2 = *(const int*) ptr2;
+void splitBySelection(SPKDArray* kdArr, int coor, int leftSize,
+		SPKDArray** kdLeft, SPKDArray** kdRight) {
+	int rightSize = kdArr->pointsCount - leftSize;
+	SPPoint* leftPoints = (SPPoint*) malloc(sizeof(SPPoint) * leftSize);
+	SPPoint* rightPoints = (SPPoint*) malloc(sizeof(SPPoint) * rightSize);
+	int i;
 
-	double coor1 = spPointGetAxisCoor(currentKdArr->points[index1],
-			currentAxis);
-	double coor2 = spPointGetAxisCoor(currentKdArr->points[index2],
-			currentAxis);
+	*kdLeft = NULL;
+	*kdRight = NULL;
+	if (leftPoints == NULL || rightPoints == NULL) {
+		free(leftPoints);
+		free(rightPoints);
+		return;
+	}
 
-	if (coor1 == coor2) {
-		return index1 - index2;
+	selectRank(kdArr, coor, leftSize - 1);
+	for (i = 0; i < leftSize; i++) {
+		leftPoints[i] = kdArr->points[kdArr->order[i]];
+	}
+	for (i = 0; i < rightSize; i++) {
+		rightPoints[i] = kdArr->points[kdArr->order[leftSize + i]];
 	}
 
-	return coor1 - coor2;
+	*kdLeft = InitSelection(leftPoints, leftSize, kdArr->dim);
+	*kdRight = InitSelection(rightPoints, rightSize, kdArr->dim);
+	if (*kdLeft == NULL || *kdRight == NULL) {
+		spKDArrayDestroy(*kdLeft);
+		spKDArrayDestroy(*kdRight);
+		*kdLeft = NULL;
+		*kdRight = NULL;
+	}
+}
+
+/*
+ * A helper function to fill the sorted indices of the arrays split from a
+ * presorted kd-array, given the position of every point in the split arrays
+ * plus 1, marked in the map of its side
+ */
+void splitSortedIndices(SPKDArray* kdArr, int* leftMap, int* rightMap,
+		SPKDArray* kdLeft, SPKDArray* kdRight) {
+	int i, j, currIndex, leftSpot, rightSpot;
+
+	for (i = 0; i < kdArr->dim; i++) {
+		leftSpot = 0;
+		rightSpot = 0;
+		for (j = 0; j < kdArr->pointsCount; j++) {
+			currIndex = kdArr->sortedIndices[i][j];
+			if (leftMap[currIndex] > 0) {
+				assert(leftMap[currIndex] <= kdLeft->pointsCount);
+				kdLeft->sortedIndices[i][leftSpot] = leftMap[currIndex] - 1;
+				leftSpot++;
+			} else if (rightMap[currIndex] > 0) {
+				assert(rightMap[currIndex] <= kdRight->pointsCount);
+				kdRight->sortedIndices[i][rightSpot] = rightMap[currIndex] - 1;
+				rightSpot++;
+			} else {
+				assert(false);
+			}
+		}
+		assert(leftSpot == kdLeft->pointsCount && rightSpot == kdRight->pointsCount);
+	}
 }
 
-void sortIndices(SPKDArray* kdArr, int axis) {
-	currentKdArr = kdArr;
-	currentAxis = axis;
-	qsort(kdArr->sortedIndices[axis], kdArr->pointsCount, sizeof(int),
-			pointsComparator);
+void spKDArraySplitInArena(SPKDArray* kdArr, int coor, int leftSize, SPArena* arena,
+		SPKDArray** kdLeft, SPKDArray** kdRight) {
+	int rightSize = kdArr->pointsCount - leftSize;
+	bool presorted = (kdArr->sortedIndices != NULL);
+	SPKDArray* left;
+	SPKDArray* right;
+	SPArenaMark mark;
+	int* leftMap;
+	int* rightMap;
+	int i, j, currIndex;
+
+	*kdLeft = NULL;
+	*kdRight = NULL;
+	if (leftSize < 1 || leftSize >= kdArr->pointsCount || arena == NULL) {
+		return;
+	}
+	left = InitInArena(arena,
+			(SPPoint*) spArenaAlloc(arena, sizeof(SPPoint) * leftSize), leftSize,
+			kdArr->dim, presorted);
+	right = InitInArena(arena,
+			(SPPoint*) spArenaAlloc(arena, sizeof(SPPoint) * rightSize), rightSize,
+			kdArr->dim, presorted);
+	if (left == NULL || right == NULL) {
+		return;
+	}
+
+	if (!presorted) {
+		selectRank(kdArr, coor, leftSize - 1);
+		for (i = 0; i < leftSize; i++) {
+			left->points[i] = kdArr->points[kdArr->order[i]];
+		}
+		for (i = 0; i < rightSize; i++) {
+			right->points[i] = kdArr->points[kdArr->order[leftSize + i]];
+		}
+		*kdLeft = left;
+		*kdRight = right;
+		return;
+	}
+
+	// the maps are only needed while splitting
+	mark = spArenaGetMark(arena);
+	leftMap = (int*) spArenaCalloc(arena, kdArr->pointsCount, sizeof(int));
+	rightMap = (int*) spArenaCalloc(arena, kdArr->pointsCount, sizeof(int));
+	if (leftMap == NULL || rightMap == NULL) {
+		return;
+	}
+	for (i = 0; i < leftSize; i++) {
+		currIndex = kdArr->sortedIndices[coor][i];
+		leftMap[currIndex] = i + 1; // mark lefts
+		left->points[i] = kdArr->points[currIndex];
+	}
+	for (j = 0; i < kdArr->pointsCount; i++, j++) {
+		currIndex = kdArr->sortedIndices[coor][i];
+		rightMap[currIndex] = j + 1; // mark rights
+		right->points[j] = kdArr->points[currIndex];
+	}
+	splitSortedIndices(kdArr, leftMap, rightMap, left, right);
+	spArenaRewind(arena, mark);
+
+	*kdLeft = left;
+	*kdRight = right;
 }
 
 /*
@@ -149,15 +523,34 @@ void sortIndices(SPKDArray* kdArr, int axis) {
 
 void spKDArraySplit(SPKDArray* kdArr, int coor, SPKDArray** kdLeft,
 		SPKDArray** kdRight) {
-	int i, j, currIndex, leftSpot, rightSpot;
-	
-	int* leftMap = (int*) calloc(kdArr->pointsCount, sizeof(int));
-	int* rightMap = (int*) calloc(kdArr->pointsCount, sizeof(int));
+	spKDArraySplitAt(kdArr, coor, (kdArr->pointsCount + 1) / 2, kdLeft, kdRight);
+}
+
+void spKDArraySplitAt(SPKDArray* kdArr, int coor, int leftSize,
+		SPKDArray** kdLeft, SPKDArray** kdRight) {
+	int i, j, currIndex;
+	int* leftMap;
+	int* rightMap;
+	int rightSize;
+	SPPoint* leftPoints;
+	SPPoint* rightPoints;
+
+	if (leftSize < 1 || leftSize >= kdArr->pointsCount) {
+		*kdLeft = NULL;
+		*kdRight = NULL;
+		return;
+	}
+	if (kdArr->sortedIndices == NULL) {
+		splitBySelection(kdArr, coor, leftSize, kdLeft, kdRight);
+		return;
+	}
+
+	leftMap = (int*) calloc(kdArr->pointsCount, sizeof(int));
+	rightMap = (int*) calloc(kdArr->pointsCount, sizeof(int));
 
-	int leftSize = (kdArr->pointsCount + 1) / 2;
-	int rightSize = kdArr->pointsCount / 2;
-	SPPoint* leftPoints = (SPPoint*) calloc(leftSize, sizeof(SPPoint));
-	SPPoint* rightPoints = (SPPoint*) calloc(rightSize, sizeof(SPPoint));
+	rightSize = kdArr->pointsCount - leftSize;
+	leftPoints = (SPPoint*) calloc(leftSize, sizeof(SPPoint));
+	rightPoints = (SPPoint*) calloc(rightSize, sizeof(SPPoint));
 	
 	*kdLeft = NULL;
 	*kdRight = NULL;
@@ -178,8 +571,9 @@ void spKDArraySplit(SPKDArray* kdArr, int coor, SPKDArray** kdLeft,
 		rightPoints[j] = kdArr->points[currIndex];
 	}
 
-	*kdLeft = InitBasic(leftPoints, leftSize, kdArr->dim);
-	*kdRight = InitBasic(rightPoints, rightSize, kdArr->dim);
+	// the arrays split from a borrowing kd-array borrow the same points
+	*kdLeft = InitBasic(leftPoints, leftSize, kdArr->dim, !kdArr->ownsPoints);
+	*kdRight = InitBasic(rightPoints, rightSize, kdArr->dim, !kdArr->ownsPoints);
 
 	if (*kdLeft == NULL || *kdRight == NULL) {
 		SPLIT_CLEANUP(leftMap, rightMap, leftPoints, rightPoints, *kdLeft,
@@ -187,28 +581,7 @@ void spKDArraySplit(SPKDArray* kdArr, int coor, SPKDArray** kdLeft,
 		return;
 	}
 
-	for (i = 0; i < kdArr->dim; i++) {
-		leftSpot = 0;
-		rightSpot = 0;
-		for (j = 0; j < kdArr->pointsCount; j++) {
-			currIndex = kdArr->sortedIndices[i][j];
-			if (leftMap[currIndex] > 0) {
-				assert(leftMap[currIndex] <= leftSize);
-				(*kdLeft)->sortedIndices[i][leftSpot] = leftMap[currIndex] - 1;
-				leftSpot++;
-			} else if (rightMap[currIndex] > 0) {
-				assert(rightMap[currIndex] <= rightSize);
-				(*kdRight)->sortedIndices[i][rightSpot] = rightMap[currIndex] - 1;
-				rightSpot++;
-			} else {
-				assert(false);
-			}
-		}
-		if (leftSpot != leftSize || rightSpot != rightSize) {
-			assert(leftSpot == leftSize);
-			assert(rightSpot == rightSize);
-		}
-	}
+	splitSortedIndices(kdArr, leftMap, rightMap, *kdLeft, *kdRight);
 
 	SPLIT_CLEANUP(leftMap, rightMap, leftPoints, rightPoints, NULL, NULL);
 }
@@ -222,7 +595,9 @@ SPPoint spKDArrayGetPointAt(SPKDArray* kdArr, int i) {
 }
 
 double spKDArrayGetPointVal(SPKDArray* kdArr, int dim, int i) {
-	int index = kdArr->sortedIndices[dim][i];
+	int index;
+	assert(kdArr->sortedIndices != NULL);
+	index = kdArr->sortedIndices[dim][i];
 	return spPointGetAxisCoor(kdArr->points[index], dim);
 }
 
@@ -231,15 +606,15 @@ int spKDArrayGetDimension(SPKDArray* kdArr) {
 }
 
 int spKDArrayFindMaxSpreadDimension(SPKDArray* kdArr) {
-	int maxSpread = INT_MIN;
+	double maxSpread = -1;
 	int maxSpreadDim = -1;
 	int i, j;
 	double minPointVal, maxPointVal, currVal, spread;
 
 	for (i = 0; i < kdArr->dim; i++) {
-		minPointVal = INT_MAX;
-		maxPointVal = INT_MIN;
-		for (j = 0; j < kdArr->pointsCount; j++) {
+		minPointVal = spPointGetAxisCoor(kdArr->points[0], i);
+		maxPointVal = minPointVal;
+		for (j = 1; j < kdArr->pointsCount; j++) {
 			currVal = spPointGetAxisCoor(kdArr->points[j], i);
 			if (currVal < minPointVal) {
 				minPointVal = currVal;
@@ -258,11 +633,233 @@ int spKDArrayFindMaxSpreadDimension(SPKDArray* kdArr) {
 	return maxSpreadDim;
 }
 
+/*
+ * A helper function to draw a pseudo random number, xorshift keeps the state
+ * with the caller so concurrent builds don't share it
+ */
+unsigned int nextRandom(unsigned int* seed) {
+	unsigned int x = *seed != 0 ? *seed : 2463534242u;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*seed = x;
+	return x;
+}
+
+/*
+ * A helper function to choose a sample of the points, all of them if there are
+ * no more than SP_KDARRAY_SAMPLE_SIZE
+ *
+ * @return the number of sampled points, whose indices are stored in indices
+ */
+int gatherSample(SPKDArray* kdArr, unsigned int* seed, int* indices) {
+	int count = kdArr->pointsCount;
+	int sampleSize = count <= SP_KDARRAY_SAMPLE_SIZE ? count : SP_KDARRAY_SAMPLE_SIZE;
+	int j;
+
+	for (j = 0; j < sampleSize; j++) {
+		indices[j] = (count == sampleSize) ? j : (int) (nextRandom(seed) % count);
+	}
+	return sampleSize;
+}
+
+/*
+ * A helper function to gather the coordinates of the sampled points on one
+ * dimension into a contiguous row, so the sample takes a fixed amount of stack
+ * whatever the dimension
+ */
+void gatherSampleRow(SPKDArray* kdArr, const int* indices, int sampleSize,
+		int axis, double* row) {
+	int j;
+
+	for (j = 0; j < sampleSize; j++) {
+		row[j] = spPointGetAxisCoor(kdArr->points[indices[j]], axis);
+	}
+}
+
+/*
+ * A helper function to compute the spread of the sampled coordinates of a
+ * dimension. The independent lanes keep the loop free of a serial dependency,
+ * so the compiler can run it on vector registers.
+ */
+double rowSpread(const double* row, int count) {
+	double minLanes[SP_KDARRAY_LANES], maxLanes[SP_KDARRAY_LANES];
+	double minVal, maxVal;
+	int i, j;
+
+	for (j = 0; j < SP_KDARRAY_LANES; j++) {
+		minLanes[j] = row[0];
+		maxLanes[j] = row[0];
+	}
+	for (i = 0; i + SP_KDARRAY_LANES <= count; i += SP_KDARRAY_LANES) {
+		for (j = 0; j < SP_KDARRAY_LANES; j++) {
+			minLanes[j] = row[i + j] < minLanes[j] ? row[i + j] : minLanes[j];
+			maxLanes[j] = row[i + j] > maxLanes[j] ? row[i + j] : maxLanes[j];
+		}
+	}
+	for (; i < count; i++) {
+		minLanes[0] = row[i] < minLanes[0] ? row[i] : minLanes[0];
+		maxLanes[0] = row[i] > maxLanes[0] ? row[i] : maxLanes[0];
+	}
+
+	minVal = minLanes[0];
+	maxVal = maxLanes[0];
+	for (j = 1; j < SP_KDARRAY_LANES; j++) {
+		minVal = minLanes[j] < minVal ? minLanes[j] : minVal;
+		maxVal = maxLanes[j] > maxVal ? maxLanes[j] : maxVal;
+	}
+	return maxVal - minVal;
+}
+
+/*
+ * A helper function to compute the variance of the sampled coordinates of a
+ * dimension, shifted by the first to keep the sums small. Vectorizable like
+ * rowSpread.
+ */
+double rowVariance(const double* row, int count) {
+	double sumLanes[SP_KDARRAY_LANES] = { 0 };
+	double squaresLanes[SP_KDARRAY_LANES] = { 0 };
+	double shift = row[0], sum = 0, squares = 0, value, mean;
+	int i, j;
+
+	for (i = 0; i + SP_KDARRAY_LANES <= count; i += SP_KDARRAY_LANES) {
+		for (j = 0; j < SP_KDARRAY_LANES; j++) {
+			value = row[i + j] - shift;
+			sumLanes[j] += value;
+			squaresLanes[j] += value * value;
+		}
+	}
+	for (; i < count; i++) {
+		value = row[i] - shift;
+		sumLanes[0] += value;
+		squaresLanes[0] += value * value;
+	}
+
+	for (j = 0; j < SP_KDARRAY_LANES; j++) {
+		sum += sumLanes[j];
+		squares += squaresLanes[j];
+	}
+	mean = sum / count;
+	return squares / count - mean * mean;
+}
+
+int spKDArrayFindSampledMaxSpreadDimension(SPKDArray* kdArr, unsigned int* seed) {
+	int indices[SP_KDARRAY_SAMPLE_SIZE];
+	double row[SP_KDARRAY_SAMPLE_SIZE];
+	int sampleSize = gatherSample(kdArr, seed, indices);
+	double spread, maxSpread = -1;
+	int i, maxSpreadDim = -1;
+
+	for (i = 0; i < kdArr->dim; i++) {
+		gatherSampleRow(kdArr, indices, sampleSize, i, row);
+		spread = rowSpread(row, sampleSize);
+		if (spread > maxSpread) {
+			maxSpread = spread;
+			maxSpreadDim = i;
+		}
+	}
+	return maxSpreadDim;
+}
+
+int spKDArrayFindMaxVarianceDimension(SPKDArray* kdArr, unsigned int* seed) {
+	int indices[SP_KDARRAY_SAMPLE_SIZE];
+	double row[SP_KDARRAY_SAMPLE_SIZE];
+	int sampleSize = gatherSample(kdArr, seed, indices);
+	double variance, maxVariance = -1;
+	int i, maxVarianceDim = -1;
+
+	for (i = 0; i < kdArr->dim; i++) {
+		gatherSampleRow(kdArr, indices, sampleSize, i, row);
+		variance = rowVariance(row, sampleSize);
+		if (variance > maxVariance) {
+			maxVariance = variance;
+			maxVarianceDim = i;
+		}
+	}
+	return maxVarianceDim;
+}
+
+int spKDArrayFindMidpointSplit(SPKDArray* kdArr, int axis) {
+	double minVal, maxVal, midpoint, currVal;
+	int leftCount = 0, i;
+
+	minVal = spPointGetAxisCoor(kdArr->points[0], axis);
+	maxVal = minVal;
+	for (i = 1; i < kdArr->pointsCount; i++) {
+		currVal = spPointGetAxisCoor(kdArr->points[i], axis);
+		minVal = currVal < minVal ? currVal : minVal;
+		maxVal = currVal > maxVal ? currVal : maxVal;
+	}
+
+	midpoint = minVal + (maxVal - minVal) / 2;
+	for (i = 0; i < kdArr->pointsCount; i++) {
+		if (spPointGetAxisCoor(kdArr->points[i], axis) <= midpoint) {
+			leftCount++;
+		}
+	}
+
+	// slide the plane to the nearest point if either side is empty
+	if (leftCount >= kdArr->pointsCount) {
+		leftCount = kdArr->pointsCount - 1;
+	}
+	return leftCount < 1 ? 1 : leftCount;
+}
+
+int spKDArrayFindCostModelSplit(SPKDArray* kdArr, int axis, unsigned int* seed) {
+	double sample[SP_KDARRAY_SAMPLE_SIZE];
+	int count = kdArr->pointsCount;
+	int sampleSize = count <= SP_KDARRAY_SAMPLE_SIZE ? count : SP_KDARRAY_SAMPLE_SIZE;
+	int i, j, best, leftCount;
+	double value, gap, cost, bestCost;
+
+	// sorting a sample is cheap, and is enough to estimate the cost of a position
+	for (i = 0; i < sampleSize; i++) {
+		j = (count == sampleSize) ? i : (int) (nextRandom(seed) % count);
+		value = spPointGetAxisCoor(kdArr->points[j], axis);
+		for (j = i; j > 0 && sample[j - 1] > value; j--) {
+			sample[j] = sample[j - 1];
+		}
+		sample[j] = value;
+	}
+
+	/*
+	 * A side is visited by a search as likely as a query ball around the query
+	 * overlaps it, so the cost of a position is the number of points on every side
+	 * times the extent of its points widened by the ball, estimated by the mean gap
+	 * between sampled points. Positions too far from the median are not considered,
+	 * which keeps the depth of the tree logarithmic.
+	 */
+	gap = (sample[sampleSize - 1] - sample[0]) / sampleSize;
+	best = (sampleSize - 1) / 2;
+	bestCost = -1;
+	for (i = sampleSize / 8; i < sampleSize - 1 - sampleSize / 8; i++) {
+		cost = (i + 1) * (sample[i] - sample[0] + gap)
+				+ (sampleSize - 1 - i) * (sample[sampleSize - 1] - sample[i + 1] + gap);
+		if (bestCost < 0 || cost < bestCost) {
+			bestCost = cost;
+			best = i;
+		}
+	}
+
+	leftCount = (int) ((double) (best + 1) * count / sampleSize + 0.5);
+	if (leftCount >= count) {
+		leftCount = count - 1;
+	}
+	return leftCount < 1 ? 1 : leftCount;
+}
+
+double spKDArrayGetRankValue(SPKDArray* kdArr, int axis, int rank) {
+	int index;
+	assert(rank >= 0 && rank < kdArr->pointsCount);
+	if (kdArr->sortedIndices == NULL) {
+		selectRank(kdArr, axis, rank);
+		return kdArr->keys[kdArr->order[rank]];
+	}
+	index = kdArr->sortedIndices[axis][rank];
+	return spPointGetAxisCoor(kdArr->points[index], axis);
+}
+
 double spKDArrayGetMedian(SPKDArray* kdArr, int axis) {
-	int meanIndex;
-	SPPoint meanPoint;
 	assert(kdArr->pointsCount >= 2);
-	meanIndex = kdArr->sortedIndices[axis][(kdArr->pointsCount - 1) / 2];
-	meanPoint = kdArr->points[meanIndex];
-	return spPointGetAxisCoor(meanPoint, axis);
+	return spKDArrayGetRankValue(kdArr, axis, (kdArr->pointsCount - 1) / 2);
 }
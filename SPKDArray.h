@@ -9,6 +9,10 @@
 #define SPKDARRAY_H_
 
 #include "SPPoint.h"
+#include "SPArena.h"
+
+/** the number of points sampled to estimate the spread or variance of a kd-array **/
+#define SP_KDARRAY_SAMPLE_SIZE 64
 
 /*
  * struct for kd-array data structure
@@ -28,6 +32,51 @@ typedef struct SPKDArray SPKDArray;
  */
 SPKDArray* spKDArrayInit(SPPoint* arr, int size, int dim);
 
+/*
+ * @param arr - an array of points
+ * @param size - the size of the points array
+ * @param dim - the dimension of the points
+ *
+ * The function is building a new kd-array composed of the given points, without
+ * sorting them by every dimension. Instead, every split selects the median on
+ * its dimension in linear time, so building a kd-tree takes O(n log n) regardless
+ * of the dimension. The arrays split from it borrow its points instead of copying
+ * them, so they must be destroyed before it. spKDArrayGetPointVal isn't
+ * supported by such arrays.
+ *
+ * @return NULL on any allocation or other initialization error
+ * @return a newly constructed kd-array otherwise
+ */
+SPKDArray* spKDArrayInitSelection(SPPoint* arr, int size, int dim);
+
+/*
+ * @param arr - an array of points
+ * @param size - the size of the points array
+ * @param dim - the dimension of the points
+ *
+ * The function is building a new kd-array like spKDArrayInit, over the given
+ * points themselves instead of copies of them. The points remain the caller's
+ * and must outlive the kd-array and the arrays split from it.
+ *
+ * @return NULL on any allocation or other initialization error
+ * @return a newly constructed kd-array otherwise
+ */
+SPKDArray* spKDArrayInitBorrowed(SPPoint* arr, int size, int dim);
+
+/*
+ * @param arr - an array of points
+ * @param size - the size of the points array
+ * @param dim - the dimension of the points
+ *
+ * The function is building a new kd-array like spKDArrayInitSelection, over the
+ * given points themselves instead of copies of them. The points remain the
+ * caller's and must outlive the kd-array and the arrays split from it.
+ *
+ * @return NULL on any allocation or other initialization error
+ * @return a newly constructed kd-array otherwise
+ */
+SPKDArray* spKDArrayInitSelectionBorrowed(SPPoint* arr, int size, int dim);
+
 /*
  * @param kdArr - a kd-array
  *
@@ -42,11 +91,45 @@ void spKDArrayDestroy(SPKDArray* kdArr);
  * @param kdLeft - an output parameter for the left splitted array
  * @param kdRight - and output parameter for the right splitted array
  *
- * The function gets a kd-array and splits it to two arrays according to a given split dimension
+ * The function gets a kd-array and splits it to two arrays according to a given split dimension.
+ * The left array holds the (size + 1) / 2 lowest points in that dimension. Both output
+ * parameters are set to NULL on allocation failure.
  *
  */
 void spKDArraySplit(SPKDArray* kdArr, int coor, SPKDArray** kdLeft, SPKDArray** kdRight);
 
+/*
+ * @param kdArr - a kd-array
+ * @param coor - the dimension on which to split
+ * @param leftCount - the number of points in the left array, between 1 and size - 1
+ * @param kdLeft - an output parameter for the left splitted array
+ * @param kdRight - and output parameter for the right splitted array
+ *
+ * The function splits a kd-array like spKDArraySplit, but the left array holds the
+ * leftCount lowest points in that dimension. Both output parameters are set to NULL
+ * if leftCount is out of range or on allocation failure.
+ *
+ */
+void spKDArraySplitAt(SPKDArray* kdArr, int coor, int leftCount, SPKDArray** kdLeft,
+		SPKDArray** kdRight);
+
+/*
+ * @param kdArr - a kd-array
+ * @param coor - the dimension on which to split
+ * @param leftCount - the number of points in the left array, between 1 and size - 1
+ * @param arena - the arena to allocate the split arrays from
+ * @param kdLeft - an output parameter for the left splitted array
+ * @param kdRight - and output parameter for the right splitted array
+ *
+ * The function splits a kd-array like spKDArraySplitAt, allocating the split
+ * arrays from the arena. The split arrays borrow the points of kdArr, which must
+ * outlive them. spKDArrayDestroy does nothing for them, their memory is released
+ * with the arena, or by rewinding it to a mark taken before the split.
+ *
+ */
+void spKDArraySplitInArena(SPKDArray* kdArr, int coor, int leftCount, SPArena* arena,
+		SPKDArray** kdLeft, SPKDArray** kdRight);
+
 /*
  * @param kdArr - a kd-array
  *
@@ -69,7 +152,8 @@ SPPoint spKDArrayGetPointAt(SPKDArray* kdArr, int i);
  * @param dim - a dimension
  * @param i - an index
  *
- * The function returns the i-th ordered point in the given dimension
+ * The function returns the i-th ordered point in the given dimension,
+ * for kd-arrays created by spKDArrayInit
  *
  */
 double spKDArrayGetPointVal(SPKDArray* kdArr, int dim, int i);
@@ -90,6 +174,26 @@ int spKDArrayGetDimension(SPKDArray* kdArr);
  */
 int spKDArrayFindMaxSpreadDimension(SPKDArray* kdArr);
 
+/*
+ * @param kdArr - a kd-array
+ * @param seed - the state of the pseudo random sampling, updated by the function
+ *
+ * The function returns the dimension which has the max spread among a sample of
+ * SP_KDARRAY_SAMPLE_SIZE points, or among all the points if there are no more
+ *
+ */
+int spKDArrayFindSampledMaxSpreadDimension(SPKDArray* kdArr, unsigned int* seed);
+
+/*
+ * @param kdArr - a kd-array
+ * @param seed - the state of the pseudo random sampling, updated by the function
+ *
+ * The function returns the dimension which has the max variance among a sample of
+ * SP_KDARRAY_SAMPLE_SIZE points, or among all the points if there are no more
+ *
+ */
+int spKDArrayFindMaxVarianceDimension(SPKDArray* kdArr, unsigned int* seed);
+
 /*
  * @param kdArr - a kd-array
  * @param axis - a dimension
@@ -99,4 +203,41 @@ int spKDArrayFindMaxSpreadDimension(SPKDArray* kdArr);
  */
 double spKDArrayGetMedian(SPKDArray* kdArr, int axis);
 
+/*
+ * @param kdArr - a kd-array
+ * @param axis - a dimension
+ * @param rank - a rank, between 0 and size - 1
+ *
+ * The function returns the value of the point of the given rank according to the
+ * given dimension, the median is of rank (size - 1) / 2
+ *
+ */
+double spKDArrayGetRankValue(SPKDArray* kdArr, int axis, int rank);
+
+/*
+ * @param kdArr - a kd-array with at least 2 points
+ * @param axis - a dimension
+ *
+ * The function returns the number of points to place in the left array when the
+ * splitting plane is at the middle of the range of the points on the given
+ * dimension. If every point falls on one side of the plane, it is slid to the
+ * nearest point, so that side holds one point.
+ *
+ */
+int spKDArrayFindMidpointSplit(SPKDArray* kdArr, int axis);
+
+/*
+ * @param kdArr - a kd-array with at least 2 points
+ * @param axis - a dimension
+ * @param seed - the state of the pseudo random sampling, updated by the function
+ *
+ * The function returns the number of points to place in the left array so the
+ * estimated search cost of the split is minimal. The cost of each side is its
+ * number of points times its extent on the given dimension, widened by the mean
+ * gap between points, and is estimated from a sample of SP_KDARRAY_SAMPLE_SIZE
+ * points. Only splits within the middle three quarters of the points are considered.
+ *
+ */
+int spKDArrayFindCostModelSplit(SPKDArray* kdArr, int axis, unsigned int* seed);
+
 #endif /* SPKDARRAY_H_ */
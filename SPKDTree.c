@@ -13,16 +13,105 @@
 #include <assert.h>
 
 /*
- * macro to check allocation failures
+ * macro to check allocation failures, the memory of a failed build is released
+ * with its arenas
  */
-#define NULL_CHECK(val, tree) if (val == NULL) { spKDTreeDestroy(tree); return NULL; }
+#define NULL_CHECK(val) if (val == NULL) { return NULL; }
 
+/** the initial state of the sampling done by the sampled split methods **/
+#define SAMPLE_SEED 2016u
+
+/** the initial capacity of the traversal stack of a search context **/
+#define INITIAL_FRAMES 64
+
+/** the size of the blocks of the build scratch arena, beyond what the root split needs **/
+#define SCRATCH_SLACK 4096
+
+/** the size of the cache lines which prefetches fill **/
+#define CACHE_LINE_SIZE 64
+
+/** the bytes an allocation of the given size takes from an arena **/
+#define ARENA_BYTES(size) \
+	(((size) + SP_ARENA_ALIGNMENT - 1) / SP_ARENA_ALIGNMENT * SP_ARENA_ALIGNMENT)
+
+/*
+ * hints the processor to start loading memory which is about to be read, the
+ * search is the same on compilers without the hint
+ */
+#if defined(__GNUC__)
+#define PREFETCH(address) __builtin_prefetch(address)
+#else
+#define PREFETCH(address)
+#endif
+
+/*
+ * The nodes of a tree and the coordinates of its leaves are allocated from a
+ * single arena, which the root holds, so the tree is released at once. The
+ * leaves of a tree built by spKDTreeInitBorrowed point at the coordinates of
+ * the points instead.
+ */
 struct SPKDTreeNode {
 	int dim;
+	int leafIndex;
 	double medianValue;
 	SPKDTreeNode* left;
 	SPKDTreeNode* right;
-	SPPoint leaf;
+	const double* leaf; // the coordinates of the point of a leaf, NULL for inner nodes
+	SPArena* arena; // the root only
+};
+
+/*
+ * The state shared by the nodes of a build
+ */
+typedef struct sp_build_state_t {
+	SplitMethod splitMethod;
+	unsigned int seed;
+	SPArena* nodes; // the arena of the tree
+	SPArena* scratch; // the split kd-arrays, released once a subtree is built
+	bool borrowLeaves; // the leaves point at the coordinates of the points
+} BuildState;
+
+/*
+ * A deferred step of a search. A frame with a node holds a far child to visit,
+ * the squared distance to its cell and the offset to set on the splitting
+ * dimension. A frame without a node restores the offset of a dimension once the
+ * cell of a far child is done.
+ */
+typedef struct sp_search_frame_t {
+	SPKDTreeNode* node;
+	double cellDistance;
+	int dim;
+	double offset;
+} SearchFrame;
+
+/*
+ * The outcome of a step of a search
+ */
+typedef enum sp_search_step_t {
+	SEARCH_RUNNING, SEARCH_DONE, SEARCH_FAILED
+} SearchStep;
+
+struct SPKDTreeSearchContext {
+	int neighborsCount;
+	int resultsCount;
+	int resultsCapacity; // the results the indices and the distances may hold
+	int* indices;
+	double* distances;
+	double* offsets; // for every dimension, the distance from the point to the cell
+	double* query; // the coordinates of the searched point
+	int offsetsCapacity;
+	SearchFrame* frames;
+	int framesCapacity;
+
+	// the search in progress, kept here so several searches can be interleaved
+	SPKDTreeNode* node; // the next node to visit, NULL once the search is done
+	bool leafPrefetched; // node is a leaf whose coordinates were prefetched
+	double cellDistance; // the squared distance from the point to the cell of node
+	int framesCount;
+	int dim;
+	SPKDTreeFilter isExcluded;
+	void* filterData;
+	SPKDTreeSearchStats* stats;
 };
 
 /*
@@ -36,29 +125,43 @@ int randomDimension(int max) {
 /*
  * Helper function to initialize a kd-tree
  */
-SPKDTreeNode* Init(SPKDArray* kdArr, SplitMethod splitMethod,
+SPKDTreeNode* Init(SPKDArray* kdArr, BuildState* state,
 		int parentSplittingDimension) {
-	int splittingDimension, arrayDimension;
+	int splittingDimension, arrayDimension, leftCount, i;
 	SPKDArray* leftArr = NULL;
 	SPKDArray* rightArr = NULL;
+	SPArenaMark mark;
+	SPPoint point;
+	double* leaf;
+	unsigned int* seed = &state->seed;
 	
-	SPKDTreeNode* root = (SPKDTreeNode*) malloc(sizeof(SPKDTreeNode));
-	NULL_CHECK(root, root);
+	SPKDTreeNode* root = (SPKDTreeNode*) spArenaCalloc(state->nodes, 1,
+			sizeof(SPKDTreeNode));
+	NULL_CHECK(root);
+	arrayDimension = spKDArrayGetDimension(kdArr);
 
 	if (spKDArrayGetPointsCount(kdArr) == 1) {
+		point = spKDArrayGetPointAt(kdArr, 0);
 		root->dim = INVALID_DIM;
 		root->medianValue = INVALID_VAL;
-		root->left = NULL;
-		root->right = NULL;
-		root->leaf = spPointCopy(spKDArrayGetPointAt(kdArr, 0));
-		NULL_CHECK(root->leaf, root);
+		root->leafIndex = spPointGetIndex(point);
+		if (state->borrowLeaves) {
+			root->leaf = spPointGetCoordinates(point);
+			return root;
+		}
+		leaf = (double*) spArenaAlloc(state->nodes, sizeof(double) * arrayDimension);
+		NULL_CHECK(leaf);
+		for (i = 0; i < arrayDimension; i++) {
+			leaf[i] = spPointGetAxisCoor(point, i);
+		}
+		root->leaf = leaf;
 		return root;
 	}
 
 	splittingDimension = INVALID_DIM;
-	arrayDimension = spKDArrayGetDimension(kdArr);
+	leftCount = (spKDArrayGetPointsCount(kdArr) + 1) / 2;
 
-	switch (splitMethod) {
+	switch (state->splitMethod) {
 	case MAX_SPREAD:
 		splittingDimension = spKDArrayFindMaxSpreadDimension(kdArr);
 		assert(splittingDimension < arrayDimension);
@@ -72,91 +175,676 @@ SPKDTreeNode* Init(SPKDArray* kdArr, SplitMethod splitMethod,
 	case INCREMENTAL:
 		splittingDimension = (parentSplittingDimension + 1) % arrayDimension;
 		break;
+
+	case MAX_VARIANCE:
+		splittingDimension = spKDArrayFindMaxVarianceDimension(kdArr, seed);
+		assert(splittingDimension < arrayDimension);
+		break;
+
+	case SAMPLED_MAX_SPREAD:
+		splittingDimension = spKDArrayFindSampledMaxSpreadDimension(kdArr, seed);
+		assert(splittingDimension < arrayDimension);
+		break;
+
+	case SLIDING_MIDPOINT:
+		splittingDimension = spKDArrayFindMaxSpreadDimension(kdArr);
+		leftCount = spKDArrayFindMidpointSplit(kdArr, splittingDimension);
+		break;
+
+	case COST_MODEL:
+		splittingDimension = spKDArrayFindMaxSpreadDimension(kdArr);
+		leftCount = spKDArrayFindCostModelSplit(kdArr, splittingDimension, seed);
+		break;
 	}
 
-	spKDArraySplit(kdArr, splittingDimension, &leftArr, &rightArr);
-	NULL_CHECK(leftArr, root);
-	NULL_CHECK(rightArr, root);
+	// the split arrays of the subtrees are released once they are built
+	mark = spArenaGetMark(state->scratch);
+	spKDArraySplitInArena(kdArr, splittingDimension, leftCount, state->scratch,
+			&leftArr, &rightArr);
+	NULL_CHECK(leftArr);
+	NULL_CHECK(rightArr);
 
+	// the search goes left for values up to the highest value of the left array
 	root->dim = splittingDimension;
-	root->medianValue = spKDArrayGetMedian(kdArr, splittingDimension);
-	root->left = Init(leftArr, splitMethod, splittingDimension);
-	NULL_CHECK(root->left, root);
-	root->right = Init(rightArr, splitMethod, splittingDimension);
-	NULL_CHECK(root->right, root);
-	root->leaf = NULL;
+	root->medianValue = spKDArrayGetRankValue(kdArr, splittingDimension, leftCount - 1);
+	root->left = Init(leftArr, state, splittingDimension);
+	NULL_CHECK(root->left);
+	root->right = Init(rightArr, state, splittingDimension);
+	NULL_CHECK(root->right);
+	spArenaRewind(state->scratch, mark);
+
+	return root;
+}
 
-	spKDArrayDestroy(leftArr);
-	spKDArrayDestroy(rightArr);
+/*
+ * Helper function to build a tree, whose leaves borrow the coordinates of the
+ * points or copy them
+ */
+SPKDTreeNode* initTree(SPKDArray* kdArr, SplitMethod splitMethod,
+		bool borrowLeaves) {
+	size_t count = (size_t) spKDArrayGetPointsCount(kdArr);
+	size_t dim = (size_t) spKDArrayGetDimension(kdArr);
+	SPKDTreeNode* root = NULL;
+	BuildState state;
 
+	// sized so the whole tree fits a single block, as does the scratch of most builds
+	state.splitMethod = splitMethod;
+	state.seed = SAMPLE_SEED; // a fixed seed keeps the sampled split methods deterministic
+	state.borrowLeaves = borrowLeaves;
+	state.nodes = spArenaCreateHuge(
+			2 * count * (sizeof(SPKDTreeNode) + SP_ARENA_ALIGNMENT) + (borrowLeaves ?
+					0 : count * (sizeof(double) * dim + SP_ARENA_ALIGNMENT)));
+	state.scratch = spArenaCreate(
+			2 * count * (sizeof(int) * (dim + 2) + sizeof(SPPoint) + sizeof(double))
+					+ SCRATCH_SLACK);
+	spArenaChargeTo(state.nodes, SP_MEMORY_KD_TREE);
+	spArenaChargeTo(state.scratch, SP_MEMORY_KD_ARRAY);
+
+	if (state.nodes != NULL && state.scratch != NULL && count > 0) {
+		root = Init(kdArr, &state, -1);
+	}
+	spArenaDestroy(state.scratch);
+	if (root == NULL) {
+		spArenaDestroy(state.nodes);
+		return NULL;
+	}
+	root->arena = state.nodes;
 	return root;
 }
 
 SPKDTreeNode* spKDTreeInit(SPKDArray* kdArr, SplitMethod splitMethod) {
-	return Init(kdArr, splitMethod, -1);
+	return initTree(kdArr, splitMethod, false);
 }
 
-void spKDTreeDestroy(SPKDTreeNode* root) {
-	if (root == NULL) {
-		return;
+/*
+ * Helper function to get the number of levels of a tree
+ */
+int treeHeight(SPKDTreeNode* node) {
+	int leftHeight, rightHeight;
+
+	if (node->leaf != NULL) {
+		return 1;
 	}
-	spPointDestroy(root->leaf);
-	spKDTreeDestroy(root->left);
-	spKDTreeDestroy(root->right);
-	free(root);
+	leftHeight = treeHeight(node->left);
+	rightHeight = treeHeight(node->right);
+	return 1 + (leftHeight > rightHeight ? leftHeight : rightHeight);
 }
 
 /*
- * Helper function to perform neighbor search
+ * Helper function to copy a node into an arena, the coordinates of a leaf right
+ * after it, or, if dim is 0, pointing at the coordinates the leaf points at.
+ * The children of the copy are set once they are copied.
  */
-void neighborSearch(SPKDTreeNode* root, SPBPQueue bpq, SPPoint point) {
-	int index;
-	double dist, pointValue, maxVal, diff;
-	
-	if (root == NULL) {
+SPKDTreeNode* copyNode(SPKDTreeNode* node, SPArena* arena, int dim) {
+	SPKDTreeNode* copy = (SPKDTreeNode*) spArenaAlloc(arena, sizeof(SPKDTreeNode));
+	double* leaf;
+	int i;
+
+	NULL_CHECK(copy);
+	*copy = *node;
+	copy->left = NULL;
+	copy->right = NULL;
+	copy->arena = NULL;
+	if (node->leaf != NULL && dim > 0) {
+		leaf = (double*) spArenaAlloc(arena, sizeof(double) * dim);
+		NULL_CHECK(leaf);
+		for (i = 0; i < dim; i++) {
+			leaf[i] = node->leaf[i];
+		}
+		copy->leaf = leaf;
+	}
+	return copy;
+}
+
+/*
+ * Helper function to get the bytes a copy of a tree takes, with the coordinates
+ * of its leaves, whether they are the tree's or borrowed
+ */
+size_t getCopyBytes(SPKDTreeNode* node, int dim) {
+	size_t nodeBytes = ARENA_BYTES(sizeof(SPKDTreeNode));
+
+	if (node->leaf != NULL) {
+		return nodeBytes + ARENA_BYTES(sizeof(double) * dim);
+	}
+	return nodeBytes + getCopyBytes(node->left, dim)
+			+ getCopyBytes(node->right, dim);
+}
+
+/*
+ * Helper function to copy a subtree in depth first order
+ */
+SPKDTreeNode* copyDepthFirst(SPKDTreeNode* node, SPArena* arena, int dim) {
+	SPKDTreeNode* copy = copyNode(node, arena, dim);
+
+	NULL_CHECK(copy);
+	if (node->leaf != NULL) {
+		return copy;
+	}
+	copy->left = copyDepthFirst(node->left, arena, dim);
+	NULL_CHECK(copy->left);
+	copy->right = copyDepthFirst(node->right, arena, dim);
+	NULL_CHECK(copy->right);
+	return copy;
+}
+
+SPKDTreeNode* copyVanEmdeBoas(SPKDTreeNode* node, int height, SPArena* arena,
+		int dim);
+
+/*
+ * Helper function to copy, in van Emde Boas order, the subtrees hanging below
+ * the top levels of a subtree whose top levels were copied already. node and copy
+ * are a node of the top levels and its copy, depth is the number of top levels
+ * left from node down.
+ */
+bool copyBottomSubtrees(SPKDTreeNode* node, SPKDTreeNode* copy, int depth,
+		int height, SPArena* arena, int dim) {
+	if (node->leaf != NULL) {
+		return true;
+	}
+	if (depth > 1) {
+		return copyBottomSubtrees(node->left, copy->left, depth - 1, height, arena, dim)
+				&& copyBottomSubtrees(node->right, copy->right, depth - 1, height,
+						arena, dim);
+	}
+	copy->left = copyVanEmdeBoas(node->left, height, arena, dim);
+	if (copy->left == NULL) {
+		return false;
+	}
+	copy->right = copyVanEmdeBoas(node->right, height, arena, dim);
+	return copy->right != NULL;
+}
+
+/*
+ * Helper function to copy the given number of levels of a subtree in van Emde
+ * Boas order: the top half of the levels first, then every subtree hanging below
+ * them from left to right, each split the same way until a single level is left
+ */
+SPKDTreeNode* copyVanEmdeBoas(SPKDTreeNode* node, int height, SPArena* arena,
+		int dim) {
+	SPKDTreeNode* copy;
+	int topHeight = height / 2;
+
+	if (height == 1) {
+		return copyNode(node, arena, dim);
+	}
+	copy = copyVanEmdeBoas(node, topHeight, arena, dim);
+	NULL_CHECK(copy);
+	if (!copyBottomSubtrees(node, copy, topHeight, height - topHeight, arena, dim)) {
+		return NULL;
+	}
+	return copy;
+}
+
+/*
+ * Helper function to copy a tree in the given layout, its leaves borrowing the
+ * coordinates like the tree's if dim is 0
+ */
+SPKDTreeNode* copyTree(SPKDTreeNode* root, int dim, TreeLayout layout,
+		size_t bytes) {
+	SPKDTreeNode* copy;
+	SPArena* arena = spArenaCreateHuge(bytes);
+	if (arena == NULL) {
+		return NULL;
+	}
+	spArenaChargeTo(arena, SP_MEMORY_KD_TREE);
+	if (layout == VAN_EMDE_BOAS) {
+		copy = copyVanEmdeBoas(root, treeHeight(root), arena, dim);
+	} else {
+		copy = copyDepthFirst(root, arena, dim);
+	}
+	if (copy == NULL) {
+		spArenaDestroy(arena);
+		return NULL;
+	}
+	copy->arena = arena;
+	return copy;
+}
+
+/*
+ * Helper function to build a tree and store its nodes in the given layout
+ */
+SPKDTreeNode* initTreeWithLayout(SPKDArray* kdArr, SplitMethod splitMethod,
+		TreeLayout layout, bool borrowLeaves) {
+	SPKDTreeNode* root = initTree(kdArr, splitMethod, borrowLeaves);
+	SPKDTreeNode* copy;
+	SPArenaStats stats;
+
+	if (root == NULL || layout == DEPTH_FIRST) {
+		return root;
+	}
+	// the copy takes exactly the memory of the tree, in a single block
+	spArenaGetStats(root->arena, &stats);
+	copy = copyTree(root, borrowLeaves ? 0 : spKDArrayGetDimension(kdArr), layout,
+			stats.bytesUsed);
+	spKDTreeDestroy(root);
+	return copy;
+}
+
+SPKDTreeNode* spKDTreeInitWithLayout(SPKDArray* kdArr, SplitMethod splitMethod,
+		TreeLayout layout) {
+	return initTreeWithLayout(kdArr, splitMethod, layout, false);
+}
+
+SPKDTreeNode* spKDTreeInitBorrowed(SPKDArray* kdArr, SplitMethod splitMethod,
+		TreeLayout layout) {
+	return initTreeWithLayout(kdArr, splitMethod, layout, true);
+}
+
+SPKDTreeNode* spKDTreeCopy(SPKDTreeNode* root, int dim, TreeLayout layout) {
+	if (root == NULL || dim <= 0) {
+		return NULL;
+	}
+	// the copy takes a single block, which holds the coordinates of the leaves
+	// even if the tree borrows them
+	return copyTree(root, dim, layout, getCopyBytes(root, dim));
+}
+
+void spKDTreeDestroy(SPKDTreeNode* root) {
+	if (root != NULL) {
+		spArenaDestroy(root->arena);
+	}
+}
+
+void spKDTreeGetMemoryStats(SPKDTreeNode* root, SPArenaStats* stats) {
+	spArenaGetStats(root->arena, stats);
+}
+SPKDTreeSearchContext* spKDTreeSearchContextCreate(int neighborsCount) {
+	SPKDTreeSearchContext* context;
+
+	if (neighborsCount <= 0) {
+		return NULL;
+	}
+	context = (SPKDTreeSearchContext*) calloc(1, sizeof(SPKDTreeSearchContext));
+	if (context == NULL) {
+		return NULL;
+	}
+	context->neighborsCount = neighborsCount;
+	context->resultsCapacity = neighborsCount;
+	context->indices = (int*) malloc(sizeof(int) * neighborsCount);
+	context->distances = (double*) malloc(sizeof(double) * neighborsCount);
+	context->frames = (SearchFrame*) malloc(sizeof(SearchFrame) * INITIAL_FRAMES);
+	context->framesCapacity = INITIAL_FRAMES;
+	if (context->indices == NULL || context->distances == NULL
+			|| context->frames == NULL) {
+		spKDTreeSearchContextDestroy(context);
+		return NULL;
+	}
+	return context;
+}
+
+void spKDTreeSearchContextDestroy(SPKDTreeSearchContext* context) {
+	if (context == NULL) {
 		return;
 	}
+	free(context->indices);
+	free(context->distances);
+	free(context->offsets);
+	free(context->frames);
+	free(context);
+}
+
+void spKDTreeSearchContextReset(SPKDTreeSearchContext* context) {
+	if (context != NULL) {
+		context->resultsCount = 0;
+	}
+}
+
+bool spKDTreeSearchContextReserve(SPKDTreeSearchContext* context,
+		int neighborsCount) {
+	int* indices;
+	double* distances;
+
+	if (context == NULL || neighborsCount <= 0) {
+		return false;
+	}
+	if (neighborsCount > context->resultsCapacity) {
+		indices = (int*) realloc(context->indices, sizeof(int) * neighborsCount);
+		if (indices == NULL) {
+			return false;
+		}
+		context->indices = indices;
+		distances = (double*) realloc(context->distances,
+				sizeof(double) * neighborsCount);
+		if (distances == NULL) {
+			return false;
+		}
+		context->distances = distances;
+		context->resultsCapacity = neighborsCount;
+	}
+	context->neighborsCount = neighborsCount;
+	context->resultsCount = 0;
+	return true;
+}
+
+void spKDTreeSearchContextOffer(SPKDTreeSearchContext* context, int index,
+		double distance) {
+	int i;
 
-	if (root->leaf != NULL) {
-		index = spPointGetIndex(root->leaf);
-		dist = spPointL2SquaredDistance(root->leaf, point);
-		SPListElement elem = spListElementCreate(index, dist);
-		if (elem == NULL) {
+	// results are ordered by distance then index, the way the bounded queue orders them
+	if (context->resultsCount == context->neighborsCount) {
+		i = context->resultsCount - 1;
+		if (distance > context->distances[i]
+				|| (distance == context->distances[i] && index >= context->indices[i])) {
 			return;
 		}
-		spBPQueueEnqueue(bpq, elem);
-		spListElementDestroy(elem);
-		return;
+	} else {
+		context->resultsCount++;
+	}
+	for (i = context->resultsCount - 1;
+			i > 0
+					&& (context->distances[i - 1] > distance
+							|| (context->distances[i - 1] == distance
+									&& context->indices[i - 1] > index)); i--) {
+		context->distances[i] = context->distances[i - 1];
+		context->indices[i] = context->indices[i - 1];
+	}
+	context->distances[i] = distance;
+	context->indices[i] = index;
+}
+
+int spKDTreeSearchContextGetResultsCount(SPKDTreeSearchContext* context) {
+	return context == NULL ? -1 : context->resultsCount;
+}
+
+int spKDTreeSearchContextGetIndex(SPKDTreeSearchContext* context, int i) {
+	assert(context != NULL && i >= 0 && i < context->resultsCount);
+	return context->indices[i];
+}
+
+double spKDTreeSearchContextGetDistance(SPKDTreeSearchContext* context, int i) {
+	assert(context != NULL && i >= 0 && i < context->resultsCount);
+	return context->distances[i];
+}
+
+bool spKDTreeSearchContextCopyResults(SPKDTreeSearchContext* context,
+		SPBPQueue bpq) {
+	SPListElement element;
+	int i;
+
+	if (context == NULL || bpq == NULL) {
+		return false;
+	}
+	for (i = 0; i < context->resultsCount; i++) {
+		element = spListElementCreate(context->indices[i], context->distances[i]);
+		if (element == NULL) {
+			return false;
+		}
+		spBPQueueEnqueue(bpq, element);
+		spListElementDestroy(element);
+	}
+	return true;
+}
+
+/*
+ * Helper function to push a frame to the traversal stack of a search, growing it
+ * if needed
+ */
+bool pushFrame(SPKDTreeSearchContext* context, int framesCount, SPKDTreeNode* node,
+		double cellDistance, int dim, double offset) {
+	SearchFrame* frames;
+
+	if (framesCount == context->framesCapacity) {
+		frames = (SearchFrame*) realloc(context->frames,
+				sizeof(SearchFrame) * 2 * context->framesCapacity);
+		if (frames == NULL) {
+			return false;
+		}
+		context->frames = frames;
+		context->framesCapacity *= 2;
+	}
+	context->frames[framesCount].node = node;
+	context->frames[framesCount].cellDistance = cellDistance;
+	context->frames[framesCount].dim = dim;
+	context->frames[framesCount].offset = offset;
+	return true;
+}
+
+/*
+ * Helper function to check whether a cell may hold a point nearer than the results
+ */
+bool mayImprove(SPKDTreeSearchContext* context, double cellDistance) {
+	return context->resultsCount < context->neighborsCount
+			|| cellDistance < context->distances[context->resultsCount - 1];
+}
+
+/*
+ * Helper function to start a search of the point, setting the query and clearing
+ * the offsets. Returns false on allocation failure.
+ */
+bool startSearch(SPKDTreeNode* root, SPPoint testPoint,
+		SPKDTreeSearchContext* context, SPKDTreeFilter isExcluded, void* filterData,
+		SPKDTreeSearchStats* stats) {
+	int dim = spPointGetDimension(testPoint), i;
+	double* offsets;
+
+	if (dim > context->offsetsCapacity) {
+		// the offsets and the query share a buffer
+		offsets = (double*) realloc(context->offsets, sizeof(double) * 2 * dim);
+		if (offsets == NULL) {
+			return false;
+		}
+		context->offsets = offsets;
+		context->query = offsets + dim;
+		context->offsetsCapacity = dim;
+	}
+	for (i = 0; i < dim; i++) {
+		context->offsets[i] = 0;
+		context->query[i] = spPointGetAxisCoor(testPoint, i);
 	}
+	context->node = root;
+	context->leafPrefetched = false;
+	context->cellDistance = 0;
+	context->framesCount = 0;
+	context->dim = dim;
+	context->isExcluded = isExcluded;
+	context->filterData = filterData;
+	context->stats = stats;
+	return true;
+}
 
-	pointValue = spPointGetAxisCoor(point, root->dim);
-	SPKDTreeNode* firstToSearch = NULL;
-	SPKDTreeNode* secondToSearch = NULL;
-	if (pointValue <= root->medianValue) {
-		firstToSearch = root->left;
-		secondToSearch = root->right;
+/*
+ * Helper function to prefetch the coordinates of a leaf, wherever they are,
+ * every line they span
+ */
+void prefetchLeaf(const double* leaf, int dim) {
+	const char* start = (const char*) leaf;
+	size_t bytes = sizeof(double) * dim, offset;
+
+	for (offset = 0; offset < bytes; offset += CACHE_LINE_SIZE) {
+		PREFETCH(start + offset);
+	}
+	// the coordinates needn't start a line, so the last may be one more
+	PREFETCH(start + bytes - 1);
+}
+
+/*
+ * Helper function to check whether the coordinates of a leaf are loaded along
+ * with it: an arena leaf is followed by its coordinates, and when they end
+ * within the two lines the node starts on, the processor loads them with the
+ * node. The coordinates of a borrowed leaf are elsewhere.
+ */
+bool leafLoadsWithNode(SPKDTreeNode* node, int dim) {
+	size_t nodeBytes = ARENA_BYTES(sizeof(SPKDTreeNode));
+
+	return node->leaf == (const double*) ((const char*) node + nodeBytes)
+			&& nodeBytes + sizeof(double) * dim <= 2 * CACHE_LINE_SIZE;
+}
+
+/*
+ * Helper function to advance a search by a node. An inner node defers its far
+ * child and moves to its near one, a leaf is offered to the results, and the
+ * search then resumes at the nearest deferred cell which may still hold a nearer
+ * point. Both children of an inner node are prefetched, as the far one is often
+ * visited soon after, so the loads are under way by the time they are visited,
+ * while interleaved searches take their turns. When deferLeaves is set, the
+ * first step at a leaf whose coordinates aren't loaded with it only prefetches
+ * them, and they are scanned on the next turn of the search.
+ */
+SearchStep searchStep(SPKDTreeSearchContext* context, bool deferLeaves) {
+	SPKDTreeNode* node = context->node;
+	SPKDTreeNode* nearChild;
+	double* offsets = context->offsets;
+	double* query = context->query;
+	double pointValue, oldOffset, newOffset, distance, diff;
+	SearchFrame frame;
+	int i;
+
+	if (node->leaf != NULL && deferLeaves && !context->leafPrefetched
+			&& !leafLoadsWithNode(node, context->dim)) {
+		prefetchLeaf(node->leaf, context->dim);
+		context->leafPrefetched = true;
+		return SEARCH_RUNNING;
+	}
+	context->leafPrefetched = false;
+	if (node->leaf != NULL) {
+		if (context->stats != NULL) {
+			context->stats->nodesVisited++;
+			context->stats->leavesVisited++;
+		}
+		if (context->isExcluded == NULL
+				|| !context->isExcluded(node->leafIndex, context->filterData)) {
+			distance = 0;
+			for (i = 0; i < context->dim; i++) {
+				diff = node->leaf[i] - query[i];
+				distance += diff * diff;
+			}
+			spKDTreeSearchContextOffer(context, node->leafIndex, distance);
+		}
+		node = NULL;
 	} else {
-		firstToSearch = root->right;
-		secondToSearch = root->left;
+		if (context->stats != NULL) {
+			context->stats->nodesVisited++;
+		}
+		PREFETCH(node->left);
+		PREFETCH(node->right);
+
+		/*
+		 * the far cell differs from this one only in the offset on the splitting
+		 * dimension, so its squared distance is updated incrementally (Arya and Mount)
+		 */
+		pointValue = query[node->dim];
+		newOffset = pointValue - node->medianValue;
+		oldOffset = offsets[node->dim];
+		nearChild = (pointValue <= node->medianValue) ? node->left : node->right;
+		if (!pushFrame(context, context->framesCount++,
+				(nearChild == node->left) ? node->right : node->left,
+				context->cellDistance + newOffset * newOffset - oldOffset * oldOffset,
+				node->dim, newOffset)) {
+			return SEARCH_FAILED;
+		}
+		node = nearChild;
 	}
 
-	neighborSearch(firstToSearch, bpq, point);
+	// after a leaf, resume at the nearest deferred cell which may still hold a nearer point
+	while (node == NULL && context->framesCount > 0) {
+		frame = context->frames[--context->framesCount];
+		if (frame.node == NULL) {
+			offsets[frame.dim] = frame.offset;
+		} else if (mayImprove(context, frame.cellDistance)) {
+			// the offset is restored once the cell is done
+			if (!pushFrame(context, context->framesCount++, NULL, 0, frame.dim,
+					offsets[frame.dim])) {
+				return SEARCH_FAILED;
+			}
+			offsets[frame.dim] = frame.offset;
+			context->cellDistance = frame.cellDistance;
+			node = frame.node;
+		}
+	}
+	context->node = node;
+	return node == NULL ? SEARCH_DONE : SEARCH_RUNNING;
+}
+
+bool spKDTreeSearch(SPKDTreeNode* root, SPPoint testPoint,
+		SPKDTreeSearchContext* context, SPKDTreeFilter isExcluded, void* filterData,
+		SPKDTreeSearchStats* stats) {
+	if (context == NULL || testPoint == NULL
+			|| !startSearch(root, testPoint, context, isExcluded, filterData, stats)) {
+		return false;
+	}
+	while (context->node != NULL) {
+		if (searchStep(context, false) == SEARCH_FAILED) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool spKDTreeSearchGroup(SPKDTreeNode* root, SPPoint* testPoints, int count,
+		SPKDTreeSearchContext** contexts, SPKDTreeFilter isExcluded, void* filterData,
+		SPKDTreeSearchStats* stats) {
+	int i, running = 0;
 
-	maxVal = spBPQueueMaxValue(bpq);
-	diff = (pointValue - root->medianValue) * (pointValue - root->medianValue);
-	if (!spBPQueueIsFull(bpq) || diff < maxVal) {
-		neighborSearch(secondToSearch, bpq, point);
+	if (testPoints == NULL || contexts == NULL || count < 0) {
+		return false;
 	}
+	for (i = 0; i < count; i++) {
+		if (contexts[i] == NULL || testPoints[i] == NULL
+				|| !startSearch(root, testPoints[i], contexts[i], isExcluded,
+						filterData, stats)) {
+			return false;
+		}
+		running += (root != NULL);
+	}
+
+	// a step of every search in turn, so the loads of one overlap the work of the others
+	while (running > 0) {
+		for (i = 0; i < count; i++) {
+			if (contexts[i]->node == NULL) {
+				continue;
+			}
+			switch (searchStep(contexts[i], count > 1)) {
+			case SEARCH_FAILED:
+				return false;
+			case SEARCH_DONE:
+				running--;
+				break;
+			case SEARCH_RUNNING:
+				break;
+			}
+		}
+	}
+	return true;
 }
 
 SPBPQueue spKDTreeNearestNeighbor(SPKDTreeNode* root, SPPoint testPoint,
 		int neighborsCount) {
-	SPBPQueue bpq = spBPQueueCreate(neighborsCount);
-	if (bpq == NULL) {
+	return spKDTreeNearestNeighborWithStats(root, testPoint, neighborsCount, NULL);
+}
+
+SPBPQueue spKDTreeNearestNeighborWithStats(SPKDTreeNode* root, SPPoint testPoint,
+		int neighborsCount, SPKDTreeSearchStats* stats) {
+	SPKDTreeSearchContext* context;
+	SPBPQueue bpq;
+
+	if (neighborsCount <= 0) {
+		return spBPQueueCreate(neighborsCount);
+	}
+	context = spKDTreeSearchContextCreate(neighborsCount);
+	if (context == NULL) {
 		return NULL;
 	}
-
-	neighborSearch(root, bpq, testPoint);
+	bpq = spKDTreeNearestNeighborInContext(root, testPoint, context, stats);
+	spKDTreeSearchContextDestroy(context);
 	return bpq;
 }
 
+SPBPQueue spKDTreeNearestNeighborInContext(SPKDTreeNode* root, SPPoint testPoint,
+		SPKDTreeSearchContext* context, SPKDTreeSearchStats* stats) {
+	SPBPQueue bpq;
+
+	if (context == NULL) {
+		return NULL;
+	}
+	bpq = spBPQueueCreate(context->neighborsCount);
+	if (bpq == NULL) {
+		return NULL;
+	}
+	spKDTreeSearchContextReset(context);
+	if (!spKDTreeSearch(root, testPoint, context, NULL, NULL, stats)
+			|| !spKDTreeSearchContextCopyResults(context, bpq)) {
+		spBPQueueDestroy(bpq);
+		return NULL;
+	}
+	return bpq;
+}
@@ -11,16 +11,44 @@
 #include "SPKDArray.h"
 #include "SPBPriorityQueue.h"
 #include "SPConfigUtils.h"
+#include "SPArena.h"
 
 #define INVALID_DIM -1
 #define INVALID_VAL -1
 
+/*
+ * A predicate over image indices, used to exclude points from a search
+ *
+ * @param index - the image index of a point
+ * @param data - the data given along with the predicate
+ * @return true if points of the image should be skipped
+ */
+typedef bool (*SPKDTreeFilter)(int index, void* data);
+
+/*
+ * Counters of the work done by searches, accumulated over any number of searches
+ */
+typedef struct sp_kd_tree_search_stats_t {
+	long nodesVisited;
+	long leavesVisited;
+} SPKDTreeSearchStats;
+
 /*
  * A struct to represent a kd-tree data structure
  */
 struct SPKDTreeNode;
 typedef struct SPKDTreeNode SPKDTreeNode;
 
+/*
+ * The state of nearest-neighbor searches: the nearest points found so far, the
+ * traversal stack and the scratch buffers of the search. A context is meant to be
+ * created once per thread and reused for every query, so searches don't allocate
+ * once its buffers have grown to fit the trees searched. A context must not be
+ * used by several threads at once.
+ */
+struct SPKDTreeSearchContext;
+typedef struct SPKDTreeSearchContext SPKDTreeSearchContext;
+
 /*
  * @param kdArr - a kd-array
  * @param splitMethod - a method by which to split kd-arrays
@@ -32,14 +60,77 @@ typedef struct SPKDTreeNode SPKDTreeNode;
  */
 SPKDTreeNode* spKDTreeInit(SPKDArray* kdArr, SplitMethod splitMethod);
 
+/*
+ * @param kdArr - a kd-array
+ * @param splitMethod - a method by which to split kd-arrays
+ * @param layout - the order in which the nodes of the tree are stored
+ *
+ * The function is creating a new kd-tree like spKDTreeInit, and stores its nodes
+ * in the given order. DEPTH_FIRST is the order of the build, where a node is
+ * followed by its left subtree. VAN_EMDE_BOAS stores the top half of the levels
+ * of the tree first, followed by every subtree hanging below them, each stored
+ * the same way recursively, so a search from the root to a leaf touches few cache
+ * lines and pages whatever their sizes. The tree is copied to that order once
+ * built. In both, the coordinates of a leaf follow its node.
+ *
+ * @return NULL on any failure
+ * @return a new kd-tree otherwise
+ */
+SPKDTreeNode* spKDTreeInitWithLayout(SPKDArray* kdArr, SplitMethod splitMethod,
+		TreeLayout layout);
+
+/*
+ * @param kdArr - a kd-array
+ * @param splitMethod - a method by which to split kd-arrays
+ * @param layout - the order in which the nodes of the tree are stored
+ *
+ * The function is creating a new kd-tree like spKDTreeInitWithLayout, but its
+ * leaves point at the coordinates of the points of the kd-array instead of
+ * copies of them, see spPointGetCoordinates, so a tree over a block of
+ * coordinates adds only its nodes to the block. The coordinates must outlive
+ * the tree: the points themselves, or the block of points created by
+ * spPointCreateArray, whose points may be released before the tree is.
+ *
+ * @return NULL on any failure
+ * @return a new kd-tree otherwise
+ */
+SPKDTreeNode* spKDTreeInitBorrowed(SPKDArray* kdArr, SplitMethod splitMethod,
+		TreeLayout layout);
+
 /*
  * @param root - the root of a kd-tree
+ * @param dim - the dimension of the points of the tree
+ * @param layout - the order in which to store the nodes of the copy
  *
- * The function destroys a given kd-tree
+ * The function copies a kd-tree into memory of its own, storing its nodes in the
+ * given order. The memory of the copy is placed by the thread which copies it,
+ * e.g. on the NUMA node the thread runs on.
+ *
+ * @return NULL if root is NULL, dim is not positive or on allocation failure
+ * @return a new kd-tree, holding copies of the points of the given one, even if
+ * 		   it borrows them
+ */
+SPKDTreeNode* spKDTreeCopy(SPKDTreeNode* root, int dim, TreeLayout layout);
+
+/*
+ * @param root - the root of a kd-tree
+ *
+ * The function destroys a given kd-tree, releasing all its nodes at once
  *
  */
 void spKDTreeDestroy(SPKDTreeNode* root);
 
+/*
+ * @param root - the root of a kd-tree
+ * @param stats - an output parameter for the statistics of the memory of the tree
+ *
+ * The nodes of a tree and the coordinates of its leaves are allocated from a
+ * single arena, whose large blocks are mapped to huge pages, the function
+ * returns its statistics
+ *
+ */
+void spKDTreeGetMemoryStats(SPKDTreeNode* root, SPArenaStats* stats);
+
 /*
  * @param root - the root of a kd-tree
  * @param testPoint - a point for which to search neighbors
@@ -52,4 +143,165 @@ void spKDTreeDestroy(SPKDTreeNode* root);
  */
 SPBPQueue spKDTreeNearestNeighbor(SPKDTreeNode* root, SPPoint testPoint, int neighborsCount);
 
+/*
+ * @param root - the root of a kd-tree
+ * @param testPoint - a point for which to search neighbors
+ * @param neighborsCount - the number of neighbors to search for
+ * @param stats - counters to which the nodes and leaves visited by the search are added
+ *
+ * The function is performing a nearest-neighbor search like spKDTreeNearestNeighbor,
+ * and counts the work it does, to compare split methods
+ *
+ * @return a priority queue stuffed with the nearest points found, represented by index and distance
+ *
+ */
+SPBPQueue spKDTreeNearestNeighborWithStats(SPKDTreeNode* root, SPPoint testPoint,
+		int neighborsCount, SPKDTreeSearchStats* stats);
+
+/*
+ * @param root - the root of a kd-tree
+ * @param testPoint - a point for which to search neighbors
+ * @param context - a search context, whose results are cleared first
+ * @param stats - optional counters to which the nodes and leaves visited are added
+ *
+ * The function is performing a nearest-neighbor search like
+ * spKDTreeNearestNeighborWithStats for as many neighbors as the context holds,
+ * in the given context, so a thread searching many points allocates its
+ * context once
+ *
+ * @return NULL on invalid argument or allocation failure
+ * @return a priority queue stuffed with the nearest points found, represented by index and distance
+ *
+ */
+SPBPQueue spKDTreeNearestNeighborInContext(SPKDTreeNode* root, SPPoint testPoint,
+		SPKDTreeSearchContext* context, SPKDTreeSearchStats* stats);
+
+/*
+ * @param neighborsCount - the number of neighbors to search for, at least 1
+ *
+ * @return NULL on invalid argument or allocation failure
+ * @return a new search context holding no results
+ */
+SPKDTreeSearchContext* spKDTreeSearchContextCreate(int neighborsCount);
+
+/*
+ * @param context - a search context
+ *
+ * The function destroys the context and its results
+ *
+ */
+void spKDTreeSearchContextDestroy(SPKDTreeSearchContext* context);
+
+/*
+ * @param context - a search context
+ *
+ * The function clears the results of the context, before searching for a new point
+ *
+ */
+void spKDTreeSearchContextReset(SPKDTreeSearchContext* context);
+
+/*
+ * @param context - a search context
+ * @param neighborsCount - the number of neighbors to search for, at least 1
+ *
+ * The function clears the results of the context and sets the number of
+ * neighbors it holds, growing it only if it holds fewer, so a context is kept
+ * across searches for different numbers of neighbors
+ *
+ * @return false on invalid argument or allocation failure, in which case the
+ * 		   context is kept as it was
+ * @return true otherwise
+ */
+bool spKDTreeSearchContextReserve(SPKDTreeSearchContext* context,
+		int neighborsCount);
+
+/*
+ * @param root - the root of a kd-tree, may be NULL for an empty tree
+ * @param testPoint - a point for which to search neighbors
+ * @param context - a search context, to which the nearest points found are added
+ * @param isExcluded - an optional predicate, points for which it holds are skipped
+ * @param filterData - the data passed to isExcluded
+ * @param stats - optional counters to which the nodes and leaves visited are added
+ *
+ * The function is performing a nearest-neighbor search on the given tree, adding
+ * the results to the context, which may already hold results of other searches
+ * for the same point. The results already in the context take part in pruning the
+ * search, so searching several trees into one context yields the nearest points
+ * of all of them.
+ *
+ * @return false on invalid argument or allocation failure, in which case the
+ * 		   results may be partial
+ * @return true otherwise
+ */
+bool spKDTreeSearch(SPKDTreeNode* root, SPPoint testPoint,
+		SPKDTreeSearchContext* context, SPKDTreeFilter isExcluded, void* filterData,
+		SPKDTreeSearchStats* stats);
+
+/*
+ * @param root - the root of a kd-tree, may be NULL for an empty tree
+ * @param testPoints - the points for which to search neighbors
+ * @param count - the number of points
+ * @param contexts - count search contexts, the nearest points found for the i-th
+ * 		  point are added to the i-th context
+ * @param isExcluded - an optional predicate, points for which it holds are skipped
+ * @param filterData - the data passed to isExcluded
+ * @param stats - optional counters to which the nodes and leaves visited are added
+ *
+ * The function is performing the searches of spKDTreeSearch for all the points,
+ * interleaved: every search advances by a node in turn, and prefetches the nodes
+ * it may read next, and the coordinates of a leaf a turn before scanning them,
+ * so the memory latency of each search is hidden behind the work of the others. Groups of about 8 points suit trees larger than the cache,
+ * for smaller trees searching one point at a time is as fast.
+ *
+ * @return false on invalid argument or allocation failure, in which case the
+ * 		   results may be partial
+ * @return true otherwise
+ */
+bool spKDTreeSearchGroup(SPKDTreeNode* root, SPPoint* testPoints, int count,
+		SPKDTreeSearchContext** contexts, SPKDTreeFilter isExcluded, void* filterData,
+		SPKDTreeSearchStats* stats);
+
+/*
+ * @param context - a search context
+ * @param index - the image index of a point
+ * @param distance - the squared distance of the point from the searched point
+ *
+ * The function adds a point found outside of the trees to the results, if it is
+ * nearer than the farthest result or the results are not full
+ *
+ */
+void spKDTreeSearchContextOffer(SPKDTreeSearchContext* context, int index,
+		double distance);
+
+/*
+ * @param context - a search context
+ *
+ * @return -1 if context is NULL, the number of results otherwise
+ */
+int spKDTreeSearchContextGetResultsCount(SPKDTreeSearchContext* context);
+
+/*
+ * @param context - a search context
+ * @param i - a rank, between 0 and the number of results - 1
+ *
+ * @return the image index of the i-th nearest point found
+ */
+int spKDTreeSearchContextGetIndex(SPKDTreeSearchContext* context, int i);
+
+/*
+ * @param context - a search context
+ * @param i - a rank, between 0 and the number of results - 1
+ *
+ * @return the squared distance of the i-th nearest point found
+ */
+double spKDTreeSearchContextGetDistance(SPKDTreeSearchContext* context, int i);
+
+/*
+ * @param context - a search context
+ * @param bpq - a queue to which the results are added
+ *
+ * @return false on invalid argument or allocation failure, true otherwise
+ */
+bool spKDTreeSearchContextCopyResults(SPKDTreeSearchContext* context, SPBPQueue bpq);
+
 #endif /* SPKDTREE_H_ */
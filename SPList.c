@@ -1,5 +1,12 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include "SPList.h"
+#include "SPPool.h"
 #include <stdlib.h>
+#include <pthread.h>
+
+/** the number of nodes allocated at once by the pool of nodes **/
+#define NODES_SLAB_SIZE 1024
 
 typedef struct node_t {
 	SPListElement data;
@@ -9,6 +16,47 @@ typedef struct node_t {
 Node createNode(Node previous, Node next, SPListElement element);
 void destroyNode(Node node);
 
+/*
+ * Nodes are allocated from a pool. When SP_LIST_INLINE_ELEMENTS is defined, the
+ * element of a node is stored right after it, in the same object, instead of
+ * being a copy created separately.
+ */
+static SPPool* nodesPool = NULL;
+static pthread_once_t nodesPoolOnce = PTHREAD_ONCE_INIT;
+
+/*
+ * Helper function to create the pool of nodes, once
+ */
+void createNodesPool() {
+#ifdef SP_LIST_INLINE_ELEMENTS
+	nodesPool = spPoolCreate(sizeof(struct node_t) + spListElementStorageSize(),
+			NODES_SLAB_SIZE);
+#else
+	nodesPool = spPoolCreate(sizeof(struct node_t), NODES_SLAB_SIZE);
+#endif
+	spPoolChargeTo(nodesPool, SP_MEMORY_LIST);
+}
+
+/*
+ * Helper function to allocate a node from the pool, without an element
+ */
+Node allocNode(Node previous, Node next) {
+	Node newNode;
+
+	pthread_once(&nodesPoolOnce, createNodesPool);
+	if (nodesPool == NULL) {
+		return NULL;
+	}
+	newNode = (Node) spPoolAlloc(nodesPool);
+	if (newNode == NULL) {
+		return NULL;
+	}
+	newNode->data = NULL;
+	newNode->previous = previous;
+	newNode->next = next;
+	return newNode;
+}
+
 struct sp_list_t {
 	Node head;
 	Node tail;
@@ -17,19 +65,19 @@ struct sp_list_t {
 };
 
 Node createNode(Node previous, Node next, SPListElement element) {
-	SPListElement newElement = spListElementCopy(element);
-	Node newNode;
-	if (newElement == NULL) {
+	Node newNode = allocNode(previous, next);
+	if (newNode == NULL) {
 		return NULL;
 	}
-	newNode = (Node) malloc(sizeof(*newNode));
-	if (newNode == NULL) {
-		spListElementDestroy(newElement);
+#ifdef SP_LIST_INLINE_ELEMENTS
+	newNode->data = spListElementCopyInto(newNode + 1, element);
+#else
+	newNode->data = spListElementCopy(element);
+#endif
+	if (newNode->data == NULL) {
+		destroyNode(newNode);
 		return NULL;
 	}
-	newNode->data = newElement;
-	newNode->previous = previous;
-	newNode->next = next;
 	return newNode;
 }
 
@@ -37,10 +85,10 @@ void destroyNode(Node node) {
 	if (node == NULL) {
 		return;
 	}
-	if (node->data != NULL) {
-		spListElementDestroy(node->data);
-	}
-	free(node);
+#ifndef SP_LIST_INLINE_ELEMENTS
+	spListElementDestroy(node->data);
+#endif
+	spPoolFree(nodesPool, node);
 }
 
 SPList spListCreate() {
@@ -48,25 +96,21 @@ SPList spListCreate() {
 	if (list == NULL) {
 		return NULL;
 	} else {
-		list->head = (Node) malloc(sizeof(*list->head));
+		list->head = allocNode(NULL, NULL);
 		if (list->head == NULL) {
 			free(list);
 			return NULL;
 		}
-		list->tail = (Node) malloc(sizeof(*list->tail));
+		list->tail = allocNode(list->head, NULL);
 		if (list->tail == NULL) {
-			free(list->head);
+			destroyNode(list->head);
 			free(list);
 			return NULL;
 		}
-		list->head->data = NULL;
 		list->head->next = list->tail;
-		list->head->previous = NULL;
-		list->tail->data = NULL;
-		list->tail->next = NULL;
-		list->tail->previous = list->head;
 		list->current = NULL;
 		list->size = 0;
+		spMemoryCharge(SP_MEMORY_LIST, sizeof(*list));
 		return list;
 
 	}
@@ -230,5 +274,6 @@ void spListDestroy(SPList list) {
 	spListClear(list);
 	destroyNode(list->head);
 	destroyNode(list->tail);
+	spMemoryRelease(SP_MEMORY_LIST, sizeof(*list));
 	free(list);
 }
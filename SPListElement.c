@@ -1,19 +1,51 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include "SPListElement.h"
+#include "SPPool.h"
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <pthread.h>
+
+/** the number of elements allocated at once by the pool of elements **/
+#define ELEMENTS_SLAB_SIZE 1024
 
 struct sp_list_element_t {
 	int index;
 	double value;
 };
 
+/*
+ * Elements are small and short lived, so they are allocated from a pool
+ */
+static SPPool* elementsPool = NULL;
+static pthread_once_t elementsPoolOnce = PTHREAD_ONCE_INIT;
+
+/*
+ * Helper function to create the pool of elements, once
+ */
+void createElementsPool() {
+	elementsPool = spPoolCreate(sizeof(struct sp_list_element_t), ELEMENTS_SLAB_SIZE);
+	spPoolChargeTo(elementsPool, SP_MEMORY_LIST);
+}
+
+/*
+ * Helper function to allocate an element from the pool
+ */
+SPListElement allocElement() {
+	pthread_once(&elementsPoolOnce, createElementsPool);
+	if (elementsPool == NULL) {
+		return NULL;
+	}
+	return (SPListElement) spPoolAlloc(elementsPool);
+}
+
 SPListElement spListElementCreate(int index, double value) {
 	SPListElement temp = NULL;
 	if(index < 0 || value <0.0){
 		return NULL;
 	}
-	temp = (SPListElement) malloc(sizeof(*temp));
+	temp = allocElement();
 	if (temp == NULL) { //Allocation Fails
 		return NULL;
 	}
@@ -27,7 +59,7 @@ SPListElement spListElementCopy(SPListElement data) {
 	if (data == NULL) {
 		return NULL;
 	}
-	elementCopy = (SPListElement) malloc(sizeof(*elementCopy));
+	elementCopy = allocElement();
 	if (elementCopy == NULL) {
 		return NULL;
 	}
@@ -40,7 +72,21 @@ void spListElementDestroy(SPListElement data) {
 	if (data == NULL) {
 		return;
 	}
-	free(data);
+	spPoolFree(elementsPool, data);
+}
+
+size_t spListElementStorageSize() {
+	return sizeof(struct sp_list_element_t);
+}
+
+SPListElement spListElementCopyInto(void* storage, SPListElement data) {
+	SPListElement elementCopy = (SPListElement) storage;
+	if (data == NULL || storage == NULL) {
+		return NULL;
+	}
+	elementCopy->index = data->index;
+	elementCopy->value = data->value;
+	return elementCopy;
 }
 
 SP_ELEMENT_MSG spListElementSetIndex(SPListElement data, int index) {
@@ -1,6 +1,8 @@
 #ifndef LISTELEMENT_H_
 #define LISTELEMENT_H_
 
+#include <stddef.h>
+
 /**
  * List Element Summary
  *
@@ -78,6 +80,25 @@ SPListElement spListElementCopy(SPListElement data);
  */
 void spListElementDestroy(SPListElement data);
 
+/**
+ * The size of the storage of an element, for containers which embed elements
+ * in their own memory instead of creating them.
+ *
+ * @return the number of bytes spListElementCopyInto writes
+ */
+size_t spListElementStorageSize();
+
+/**
+ * Copies the target element into the given storage, aligned for a double.
+ * The copy is owned by the storage and must not be destroyed.
+ *
+ * @param storage - memory of at least spListElementStorageSize() bytes
+ * @param data - The target element which will be copied
+ * @return
+ * NULL if a NULL was sent, otherwise the copy
+ */
+SPListElement spListElementCopyInto(void* storage, SPListElement data);
+
 /**
  * Compares two elements e1 and e2. The function asserts that
  * both e1 and e2 are not NULL pointers.
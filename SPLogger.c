@@ -1,8 +1,14 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include "SPLogger.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
+#include <stdarg.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
 
 //File open mode
 #define SP_LOGGER_OPEN_MODE "w"
@@ -16,9 +22,20 @@
 #define NEG -1
 #define INPUT_MAX 1024
 
+//number of records in the ring buffer, must be a power of 2
+#define RING_SIZE 256
+#define RING_MASK (RING_SIZE - 1)
+
+//writer thread back-off bounds when the ring is empty (nanoseconds)
+#define IDLE_SLEEP_MIN 100000
+#define IDLE_SLEEP_MAX 10000000
+
 // Global variable holding the logger
 SPLogger logger = NULL;
 
+// The level of the defined logger, 0 while the logger is undefined
+int spLoggerActiveLevel = 0;
+
 /**
  * @param msg - The message to be printed
  * @return
@@ -39,7 +56,25 @@ SP_LOGGER_MSG spLoggerBeforePrint(const char* msg);
 SP_LOGGER_MSG spLoggerPrint(const char* msg);
 
 /**
- * 	if type is in the right level: Prints the type message. The debug message format is given below:
+ * Formats a record directly into a free slot of the ring buffer and publishes
+ * it to the writer thread.
+ *
+ * @param format - printf style format of the record
+ * @return
+ * SP_LOGGER_WRITE_FAIL			- If formatting failed or a previous write failed
+ * SP_LOGGER_SUCCESS			- otherwise
+ */
+SP_LOGGER_MSG spLoggerEnqueue(const char* format, ...);
+
+/**
+ * The writer thread main loop. Drains every published record in a batch,
+ * flushes the output once per batch, and sleeps with exponential back-off
+ * while the ring is empty. Exits once the logger is stopped and drained.
+ */
+void* spLoggerWriterLoop(void* arg);
+
+/**
+ * 	if level is enabled: Prints the message of the given level. The debug message format is given below:
  * 	---TYPE---
  * 	and for type != INFO:
  * 	- file: <file>
@@ -69,25 +104,60 @@ SP_LOGGER_MSG spLoggerPrint(const char* msg);
  * SP_LOGGER_WRITE_FAIL			- If Write failure occurred
  * SP_LOGGER_SUCCESS			- otherwise
  */
-SP_LOGGER_MSG spLoggerPrintType(char* type, const char* msg, const char* file,
-		const char* function, const int line);
+SP_LOGGER_MSG spLoggerPrintType(SP_LOGGER_LEVEL level, const char* msg,
+		const char* file, const char* function, const int line);
 
 /**
- * @param type		-ERROR || WARNING || INFO || DEBUG
+ * @param level		- a logger level
  * @return
- * true				-if type can be printed in the logger's level
- * false 			-otherwise
+ * the header string of messages printed at the given level
  */
-bool correctLevel(char* type);
+const char* levelToType(SP_LOGGER_LEVEL level);
 
+/*
+ * A single slot of the ring buffer. sequence is the slot's turn counter:
+ * equals the claiming position when free, position + 1 once published.
+ */
+typedef struct sp_logger_record_t {
+	unsigned long sequence;
+	int length;
+	char text[INPUT_MAX];
+} SPLoggerRecord;
 
 struct sp_logger_t {
 	FILE* outputChannel; //The logger file
 	bool isStdOut; //Indicates if the logger is stdout
 	SP_LOGGER_LEVEL level; //Indicates the level
+	SPLoggerRecord ring[RING_SIZE]; //The records waiting to be written
+	unsigned long head; //Next position to be claimed by producers
+	unsigned long tail; //Next position to be written, owned by the writer
+	bool stop; //Set by spLoggerDestroy to make the writer drain and exit
+	bool writeFailed; //Set by the writer once a write has failed
+	pthread_t writer; //The background writer thread
 };
 
+/**
+ * Claims a free slot of the ring buffer for the calling producer. If the ring
+ * is full the caller yields until the writer frees a slot.
+ *
+ * @return the claimed record, to be filled and then published
+ */
+SPLoggerRecord* spLoggerClaimRecord();
+
+/**
+ * Publishes a claimed record to the writer thread.
+ *
+ * @param record - a record returned by spLoggerClaimRecord
+ * @param length - the length of the text formatted into the record, negative
+ * 				   if formatting failed. Longer texts are truncated to INPUT_MAX.
+ * @return
+ * SP_LOGGER_WRITE_FAIL			- If formatting failed or a previous write failed
+ * SP_LOGGER_SUCCESS			- otherwise
+ */
+SP_LOGGER_MSG spLoggerPublishRecord(SPLoggerRecord* record, int length);
+
 SP_LOGGER_MSG spLoggerCreate(const char* filename, SP_LOGGER_LEVEL level) {
+	unsigned long i;
 	if (logger != NULL) { //Already defined
 		return SP_LOGGER_DEFINED;
 	}
@@ -96,6 +166,13 @@ SP_LOGGER_MSG spLoggerCreate(const char* filename, SP_LOGGER_LEVEL level) {
 		return SP_LOGGER_OUT_OF_MEMORY;
 	}
 	logger->level = level; //Set the level of the logger
+	logger->head = 0;
+	logger->tail = 0;
+	logger->stop = false;
+	logger->writeFailed = false;
+	for (i = 0; i < RING_SIZE; i++) {
+		logger->ring[i].sequence = i;
+	}
 	if (filename == NULL || strcmp(filename, "stdout")) {
 		//In case the filename is not set use stdout
 		logger->outputChannel = stdout;
@@ -109,6 +186,15 @@ SP_LOGGER_MSG spLoggerCreate(const char* filename, SP_LOGGER_LEVEL level) {
 		}
 		logger->isStdOut = false;
 	}
+	if (pthread_create(&logger->writer, NULL, spLoggerWriterLoop, logger) != 0) {
+		if (!logger->isStdOut) {
+			fclose(logger->outputChannel);
+		}
+		free(logger);
+		logger = NULL;
+		return SP_LOGGER_OUT_OF_MEMORY;
+	}
+	spLoggerActiveLevel = level;
 	return SP_LOGGER_SUCCESS;
 }
 
@@ -116,6 +202,10 @@ void spLoggerDestroy() {
 	if (!logger) {
 		return;
 	}
+	spLoggerActiveLevel = 0;
+	//Let the writer drain all published records before closing the channel
+	__atomic_store_n(&logger->stop, true, __ATOMIC_RELEASE);
+	pthread_join(logger->writer, NULL);
 	if (!logger->isStdOut) {//Close file only if not stdout
 		fclose(logger->outputChannel);
 	}
@@ -125,21 +215,21 @@ void spLoggerDestroy() {
 
 SP_LOGGER_MSG spLoggerPrintError(const char* msg, const char* file,
 		const char* function, const int line) {
-	return spLoggerPrintType(ERROR, msg, file, function, line);
+	return spLoggerPrintType(SP_LOGGER_ERROR_LEVEL, msg, file, function, line);
 }
 
 SP_LOGGER_MSG spLoggerPrintWarning(const char* msg, const char* file,
 		const char* function, const int line) {
-	return spLoggerPrintType(WARNING, msg, file, function, line);
+	return spLoggerPrintType(SP_LOGGER_WARNING_ERROR_LEVEL, msg, file, function, line);
 }
 
 SP_LOGGER_MSG spLoggerPrintInfo(const char* msg) {
-	return spLoggerPrintType(INFO, msg, NULL, NULL, NEG);
+	return spLoggerPrintType(SP_LOGGER_INFO_WARNING_ERROR_LEVEL, msg, NULL, NULL, NEG);
 }
 
 SP_LOGGER_MSG spLoggerPrintDebug(const char* msg, const char* file,
 		const char* function, const int line) {
-	return spLoggerPrintType(DEBUG, msg, file, function, line);
+	return spLoggerPrintType(SP_LOGGER_DEBUG_INFO_WARNING_ERROR_LEVEL, msg, file, function, line);
 }
 
 SP_LOGGER_MSG spLoggerPrintMsg(const char* msg) {
@@ -163,66 +253,178 @@ SP_LOGGER_MSG spLoggerBeforePrint(const char* msg) {
 }
 
 SP_LOGGER_MSG spLoggerPrint(const char* msg) {
-	int fprintfResult;
+	return spLoggerEnqueue("%s", msg);
+}
 
-	fprintfResult = fprintf(logger->outputChannel, "%s\n", msg);
-	fflush(logger->outputChannel);
-	if (fprintfResult < 0) {
-		return SP_LOGGER_WRITE_FAIL;
+SPLoggerRecord* spLoggerClaimRecord() {
+	SPLoggerRecord* record;
+	unsigned long pos, seq;
+	long diff;
+
+	pos = __atomic_load_n(&logger->head, __ATOMIC_RELAXED);
+	while (true) {
+		record = &logger->ring[pos & RING_MASK];
+		seq = __atomic_load_n(&record->sequence, __ATOMIC_ACQUIRE);
+		diff = (long) (seq - pos);
+		if (diff == 0) { //The slot is free, try to claim it
+			if (__atomic_compare_exchange_n(&logger->head, &pos, pos + 1, true,
+					__ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+				return record;
+			}
+		} else if (diff < 0) { //The ring is full, wait for the writer
+			sched_yield();
+			pos = __atomic_load_n(&logger->head, __ATOMIC_RELAXED);
+		} else { //Another producer claimed it first
+			pos = __atomic_load_n(&logger->head, __ATOMIC_RELAXED);
+		}
+	}
+}
+
+SP_LOGGER_MSG spLoggerPublishRecord(SPLoggerRecord* record, int length) {
+	bool formatFailed = (length < 0);
+
+	if (formatFailed) {
+		length = 0;
+	} else if (length >= INPUT_MAX) {
+		length = INPUT_MAX - 1;
 	}
+	record->length = length;
+	//The claimed slot's sequence still holds its position, nobody else writes it
+	__atomic_store_n(&record->sequence, record->sequence + 1, __ATOMIC_RELEASE);
 
+	if (formatFailed || __atomic_load_n(&logger->writeFailed, __ATOMIC_RELAXED)) {
+		return SP_LOGGER_WRITE_FAIL;
+	}
 	return SP_LOGGER_SUCCESS;
 }
 
-SP_LOGGER_MSG spLoggerPrintType(char* type, const char* msg, const char* file,
-		const char* function, const int line) {
-	int sprintffResult;
-	char newMsg[INPUT_MAX];
-	SP_LOGGER_MSG beforeMsgPrint = spLoggerBeforePrint(msg);
+SP_LOGGER_MSG spLoggerEnqueue(const char* format, ...) {
+	SPLoggerRecord* record = spLoggerClaimRecord();
+	int length;
+	va_list args;
 
-	if(beforeMsgPrint != SP_LOGGER_SUCCESS) {
-		return beforeMsgPrint;
+	va_start(args, format);
+	length = vsnprintf(record->text, INPUT_MAX, format, args);
+	va_end(args);
+
+	return spLoggerPublishRecord(record, length);
+}
+
+SP_LOGGER_MSG spLoggerPrintFormat(SP_LOGGER_LEVEL level, const char* file,
+		const char* function, const int line, const char* format, ...) {
+	SPLoggerRecord* record;
+	int headerLength, msgLength;
+	va_list args;
+
+	if (!logger) {
+		return SP_LOGGER_UNDIFINED;
+	}
+	if (level > logger->level) {
+		return SP_LOGGER_SUCCESS;
+	}
+	if (format == NULL) {
+		return SP_LOGGER_INVAlID_ARGUMENT;
+	}
+	if (level != SP_LOGGER_INFO_WARNING_ERROR_LEVEL
+			&& (line < 0 || file == NULL || function == NULL)) {
+		return SP_LOGGER_INVAlID_ARGUMENT;
 	}
 
-	if(strcmp(type, INFO) != 0) {
-		if(line < 0 || file == NULL || function == NULL) {
-			return SP_LOGGER_INVAlID_ARGUMENT;
-		}
-		if(!correctLevel(type)) {
-			return SP_LOGGER_SUCCESS;
-		}
-		sprintffResult = sprintf(newMsg, "%s\n- file: %s\n- function: %s\n- line: %d\n- message: %s",
-				type, file, function, line, msg);
+	record = spLoggerClaimRecord();
+	if (level != SP_LOGGER_INFO_WARNING_ERROR_LEVEL) {
+		headerLength = snprintf(record->text, INPUT_MAX,
+				"%s\n- file: %s\n- function: %s\n- line: %d\n- message: ",
+				levelToType(level), file, function, line);
 	} else {
-		if(!correctLevel(type)) {
-			return SP_LOGGER_SUCCESS;
-		}
-		sprintffResult = sprintf(newMsg, "%s\n- message: %s", type, msg);
+		headerLength = snprintf(record->text, INPUT_MAX, "%s\n- message: ",
+				levelToType(level));
 	}
-
-	if (sprintffResult < 0) {
-		return SP_LOGGER_WRITE_FAIL;
+	if (headerLength < 0 || headerLength >= INPUT_MAX) {
+		return spLoggerPublishRecord(record, headerLength);
 	}
 
-	return spLoggerPrint(newMsg);
+	va_start(args, format);
+	msgLength = vsnprintf(record->text + headerLength, INPUT_MAX - headerLength,
+			format, args);
+	va_end(args);
+
+	return spLoggerPublishRecord(record,
+			msgLength < 0 ? msgLength : headerLength + msgLength);
 }
 
-SP_LOGGER_LEVEL stringToLevel(char* type) {
-	if (strcmp(type, ERROR) == 0) {
-		return SP_LOGGER_ERROR_LEVEL;
+void* spLoggerWriterLoop(void* arg) {
+	SPLogger self = (SPLogger) arg;
+	SPLoggerRecord* record;
+	struct timespec idle = { 0, IDLE_SLEEP_MIN };
+	bool stopping;
+	int written;
+
+	while (true) {
+		//Read the stop flag before draining, so nothing published before
+		//spLoggerDestroy can be left behind
+		stopping = __atomic_load_n(&self->stop, __ATOMIC_ACQUIRE);
+		written = 0;
+		while (true) {
+			record = &self->ring[self->tail & RING_MASK];
+			if (__atomic_load_n(&record->sequence, __ATOMIC_ACQUIRE)
+					!= self->tail + 1) {
+				break;
+			}
+			if (fwrite(record->text, 1, record->length, self->outputChannel)
+					!= (size_t) record->length
+					|| fputc('\n', self->outputChannel) == EOF) {
+				__atomic_store_n(&self->writeFailed, true, __ATOMIC_RELAXED);
+			}
+			__atomic_store_n(&record->sequence, self->tail + RING_SIZE,
+					__ATOMIC_RELEASE);
+			self->tail++;
+			written++;
+		}
+		if (written > 0) {
+			fflush(self->outputChannel);
+			idle.tv_nsec = IDLE_SLEEP_MIN;
+		} else if (stopping) {
+			break;
+		} else {
+			nanosleep(&idle, NULL);
+			if (idle.tv_nsec < IDLE_SLEEP_MAX) {
+				idle.tv_nsec *= 2;
+			}
+		}
 	}
-	if (strcmp(type, WARNING) == 0) {
-		return SP_LOGGER_WARNING_ERROR_LEVEL;
+	return NULL;
+}
+
+SP_LOGGER_MSG spLoggerPrintType(SP_LOGGER_LEVEL level, const char* msg,
+		const char* file, const char* function, const int line) {
+	if (!logger) {
+		return SP_LOGGER_UNDIFINED;
 	}
-	if (strcmp(type, INFO) == 0) {
-		return SP_LOGGER_INFO_WARNING_ERROR_LEVEL;
+	//The arguments are validated at every level, only the formatting is filtered
+	if (msg == NULL || (level != SP_LOGGER_INFO_WARNING_ERROR_LEVEL
+			&& (line < 0 || file == NULL || function == NULL))) {
+		return SP_LOGGER_INVAlID_ARGUMENT;
+	}
+	if (level > logger->level) {
+		return SP_LOGGER_SUCCESS;
 	}
-	else {
-		return SP_LOGGER_DEBUG_INFO_WARNING_ERROR_LEVEL;
+
+	if (level != SP_LOGGER_INFO_WARNING_ERROR_LEVEL) {
+		return spLoggerEnqueue("%s\n- file: %s\n- function: %s\n- line: %d\n- message: %s",
+				levelToType(level), file, function, line, msg);
 	}
+	return spLoggerEnqueue("%s\n- message: %s", levelToType(level), msg);
 }
 
-bool correctLevel(char* type) {
-	SP_LOGGER_LEVEL logLevel = stringToLevel(type);
-	return logLevel <= logger->level;
+const char* levelToType(SP_LOGGER_LEVEL level) {
+	switch (level) {
+	case SP_LOGGER_ERROR_LEVEL:
+		return ERROR;
+	case SP_LOGGER_WARNING_ERROR_LEVEL:
+		return WARNING;
+	case SP_LOGGER_INFO_WARNING_ERROR_LEVEL:
+		return INFO;
+	default:
+		return DEBUG;
+	}
 }
@@ -13,6 +13,12 @@
  * 	
  * The logger supports another printing function which can be called at any level
  * The user must destroy the logger at end of usage
+ *
+ * Printing is asynchronous: every print call formats its record into a
+ * lock-free multi-producer ring buffer and returns, while a background writer
+ * thread writes the records in batches. The print functions may be called
+ * concurrently from any number of threads. spLoggerCreate and spLoggerDestroy
+ * must not race with any other logger call.
  *	
  * The following functions are supported:
  * spLoggerCreate 		- Creates and initializes the logger
@@ -22,6 +28,13 @@
  * spLoggerPrintInfo    - Prints info messages at levels {Info, Debug}
  * spLoggerPrintDebug   - Prints debug messages at level {Debug}
  * spLoggerPrintMsg     - Prints the exact message at any level (Without formatting)
+ * spLoggerPrintFormat  - Prints a printf style formatted message at a given level
+ *
+ * The SP_LOG_ERROR, SP_LOG_WARNING, SP_LOG_INFO and SP_LOG_DEBUG macros are the
+ * preferred front end. They take a printf style format and arguments, and test
+ * the active level before the arguments are evaluated or anything is formatted,
+ * so a filtered call costs a single comparison. Calls above
+ * SP_LOGGER_COMPILE_LEVEL are removed at compilation time.
  */
 
 /** error massages for logger **/
@@ -57,6 +70,62 @@ typedef struct sp_logger_t* SPLogger;
 /**a global variable **/
 extern SPLogger logger;
 
+/** the level of the defined logger, 0 if the logger is undefined **/
+extern int spLoggerActiveLevel;
+
+/**
+ * The highest level whose macro calls are compiled, as a number between 0 and 4
+ * matching SP_LOGGER_LEVEL. For example -DSP_LOGGER_COMPILE_LEVEL=3 removes all
+ * SP_LOG_DEBUG calls, including the evaluation of their arguments.
+ */
+#ifndef SP_LOGGER_COMPILE_LEVEL
+#define SP_LOGGER_COMPILE_LEVEL 4
+#endif
+
+/** true if messages of the given level are currently printed **/
+#define SP_LOGGER_IS_ENABLED(level) (spLoggerActiveLevel >= (int) (level))
+
+/**
+ * never prints, but keeps the arguments of a compiled out call type checked
+ * and referenced, so removing a level doesn't leave unused variables behind
+ */
+#define SP_LOG_COMPILED_OUT(level, ...) do { \
+		if (0) { \
+			spLoggerPrintFormat((level), __FILE__, __func__, __LINE__, __VA_ARGS__); \
+		} \
+	} while (0)
+
+/** prints a message of the given level only if the level is enabled **/
+#define SP_LOG_AT_LEVEL(level, ...) do { \
+		if (SP_LOGGER_IS_ENABLED(level)) { \
+			spLoggerPrintFormat((level), __FILE__, __func__, __LINE__, __VA_ARGS__); \
+		} \
+	} while (0)
+
+#if SP_LOGGER_COMPILE_LEVEL >= 1
+#define SP_LOG_ERROR(...) SP_LOG_AT_LEVEL(SP_LOGGER_ERROR_LEVEL, __VA_ARGS__)
+#else
+#define SP_LOG_ERROR(...) SP_LOG_COMPILED_OUT(SP_LOGGER_ERROR_LEVEL, __VA_ARGS__)
+#endif
+
+#if SP_LOGGER_COMPILE_LEVEL >= 2
+#define SP_LOG_WARNING(...) SP_LOG_AT_LEVEL(SP_LOGGER_WARNING_ERROR_LEVEL, __VA_ARGS__)
+#else
+#define SP_LOG_WARNING(...) SP_LOG_COMPILED_OUT(SP_LOGGER_WARNING_ERROR_LEVEL, __VA_ARGS__)
+#endif
+
+#if SP_LOGGER_COMPILE_LEVEL >= 3
+#define SP_LOG_INFO(...) SP_LOG_AT_LEVEL(SP_LOGGER_INFO_WARNING_ERROR_LEVEL, __VA_ARGS__)
+#else
+#define SP_LOG_INFO(...) SP_LOG_COMPILED_OUT(SP_LOGGER_INFO_WARNING_ERROR_LEVEL, __VA_ARGS__)
+#endif
+
+#if SP_LOGGER_COMPILE_LEVEL >= 4
+#define SP_LOG_DEBUG(...) SP_LOG_AT_LEVEL(SP_LOGGER_DEBUG_INFO_WARNING_ERROR_LEVEL, __VA_ARGS__)
+#else
+#define SP_LOG_DEBUG(...) SP_LOG_COMPILED_OUT(SP_LOGGER_DEBUG_INFO_WARNING_ERROR_LEVEL, __VA_ARGS__)
+#endif
+
 /**
  * Creates a logger. This function should be called once, prior
  * to the usage of any SP Logger print functions. It is the responsibility
@@ -76,7 +145,8 @@ SP_LOGGER_MSG spLoggerCreate(const char* filename, SP_LOGGER_LEVEL level);
 
 /**
  * Frees all memory allocated for the logger. If the logger is not defined
- * then nothing happens.
+ * then nothing happens. All the messages printed before the call are written
+ * to the log before it returns.
  */
 void spLoggerDestroy();
 
@@ -222,8 +292,36 @@ SP_LOGGER_MSG spLoggerPrintDebug(const char* msg, const char* file,
  * SP_LOGGER_INVAlID_ARGUMENT	- If msg is null
  * SP_LOGGER_WRITE_FAIL			- If Write failure occurred
  * SP_LOGGER_SUCCESS			- otherwise
+ *
+ * Since writes are asynchronous, SP_LOGGER_WRITE_FAIL reports a failure of
+ * any earlier write as well, for all the print functions.
  */
  SP_LOGGER_MSG spLoggerPrintMsg(const char* msg);
 
+/**
+ * Prints a message of the given level, in the format of the level's print
+ * function, where the message is built from format and the following
+ * arguments as in printf. Messages are truncated to 1024 characters.
+ * The level is tested before anything else is done.
+ *
+ * @param level		- The level of the message
+ * @param file    	- A string representing the filename in which the call occurred
+ * @param function 	- A string representing the function name in which the call ocurred
+ * @param line		- A string representing the line in which the call occurred
+ * @param format	- A printf style format of the message
+ * @return
+ * SP_LOGGER_UNDIFINED 			- If the logger is undefined
+ * SP_LOGGER_INVAlID_ARGUMENT	- If format is null, or for levels other than info,
+ * 								  file or function are null or line is negative
+ * SP_LOGGER_WRITE_FAIL			- If Write failure occurred
+ * SP_LOGGER_SUCCESS			- otherwise, including when the level is filtered
+ */
+SP_LOGGER_MSG spLoggerPrintFormat(SP_LOGGER_LEVEL level, const char* file,
+		const char* function, const int line, const char* format, ...)
+#if defined(__GNUC__)
+		__attribute__((format(printf, 5, 6)))
+#endif
+		;
+
 
 #endif
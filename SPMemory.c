@@ -0,0 +1,108 @@
+/*
+ * SPMemory.c
+ */
+
+#include <stdbool.h>
+#include "SPMemory.h"
+
+/** the size of the cache lines the counters are kept apart on **/
+#define CACHE_LINE_SIZE 64
+
+/*
+ * The counters of a subsystem, on a cache line of their own so the
+ * subsystems charged by different threads don't contend on each other. The
+ * total is charged along with every subsystem, so its line is shared by all of
+ * them: a sum of the subsystems read afterwards would tell the current total,
+ * but not its peak. Its peak is only written while it rises.
+ */
+typedef struct sp_memory_counters_t {
+	long currentBytes;
+	long peakBytes;
+	char padding[CACHE_LINE_SIZE - 2 * sizeof(long)];
+} Counters;
+
+/** the counters of every subsystem, followed by the total **/
+static Counters counters[SP_MEMORY_SUBSYSTEMS_COUNT + 1];
+
+/*
+ * Helper function to add to the current bytes of a counter, raising its peak
+ * if the current bytes exceed it, which is the only time the peak is written
+ */
+void addToCounters(Counters* counter, long bytes) {
+	long current = __atomic_add_fetch(&counter->currentBytes, bytes,
+			__ATOMIC_RELAXED);
+	long peak = __atomic_load_n(&counter->peakBytes, __ATOMIC_RELAXED);
+
+	while (current > peak && !__atomic_compare_exchange_n(&counter->peakBytes,
+			&peak, current, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+	}
+}
+
+/*
+ * Helper predicate of the subsystems which may be charged
+ */
+bool isChargeable(SP_MEMORY_SUBSYSTEM subsystem) {
+	return (int) subsystem >= 0 && subsystem < SP_MEMORY_SUBSYSTEMS_COUNT;
+}
+
+void spMemoryCharge(SP_MEMORY_SUBSYSTEM subsystem, size_t bytes) {
+	if (!isChargeable(subsystem) || bytes == 0) {
+		return;
+	}
+	addToCounters(&counters[subsystem], (long) bytes);
+	addToCounters(&counters[SP_MEMORY_TOTAL], (long) bytes);
+}
+
+void spMemoryRelease(SP_MEMORY_SUBSYSTEM subsystem, size_t bytes) {
+	if (!isChargeable(subsystem) || bytes == 0) {
+		return;
+	}
+	__atomic_sub_fetch(&counters[subsystem].currentBytes, (long) bytes,
+			__ATOMIC_RELAXED);
+	__atomic_sub_fetch(&counters[SP_MEMORY_TOTAL].currentBytes, (long) bytes,
+			__ATOMIC_RELAXED);
+}
+
+void spMemoryGetStats(SP_MEMORY_SUBSYSTEM subsystem, SPMemoryStats* stats) {
+	if ((int) subsystem < 0 || subsystem > SP_MEMORY_TOTAL) {
+		stats->currentBytes = 0;
+		stats->peakBytes = 0;
+		return;
+	}
+	stats->currentBytes = __atomic_load_n(&counters[subsystem].currentBytes,
+			__ATOMIC_RELAXED);
+	stats->peakBytes = __atomic_load_n(&counters[subsystem].peakBytes,
+			__ATOMIC_RELAXED);
+	// a charge in progress may have raised the current bytes but not yet the peak
+	if (stats->peakBytes < stats->currentBytes) {
+		stats->peakBytes = stats->currentBytes;
+	}
+}
+
+void spMemoryResetPeaks() {
+	for (int i = 0; i <= SP_MEMORY_TOTAL; i++) {
+		__atomic_store_n(&counters[i].peakBytes,
+				__atomic_load_n(&counters[i].currentBytes, __ATOMIC_RELAXED),
+				__ATOMIC_RELAXED);
+	}
+}
+
+const char* spMemoryGetName(SP_MEMORY_SUBSYSTEM subsystem) {
+	switch (subsystem) {
+	case SP_MEMORY_POINT:
+		return "points";
+	case SP_MEMORY_KD_ARRAY:
+		return "kd-arrays";
+	case SP_MEMORY_KD_TREE:
+		return "kd-trees";
+	case SP_MEMORY_LIST:
+		return "lists and queues";
+	case SP_MEMORY_IMAGE_PROC:
+		return "image processing";
+	case SP_MEMORY_TOTAL:
+		return "total";
+	case SP_MEMORY_UNCHARGED:
+		break;
+	}
+	return "uncharged";
+}
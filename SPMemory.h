@@ -0,0 +1,89 @@
+/*
+ * SPMemory.h
+ */
+
+#ifndef SPMEMORY_H_
+#define SPMEMORY_H_
+
+#include <stddef.h>
+
+/*
+ * The accounting of the memory of the system by subsystem, the bytes every
+ * subsystem holds at the moment and the most it held at once, to size the
+ * hosts and to compare layouts.
+ *
+ * The subsystems charge their memory when they allocate it and release the
+ * charge when they free it:
+ * - the points charge themselves and their coordinates, and the index the
+ *   block of coordinates it adopts
+ * - the kd-arrays charge their arrays, and the trees the scratch of a build
+ * - the trees charge the blocks of their arenas, see spArenaChargeTo
+ * - the lists and the queues charge themselves and the slabs of the pools
+ *   their nodes and elements come from, see spPoolChargeTo
+ * - the image processing charges the OpenCV matrices it keeps, the images
+ *   and the descriptors in flight and the PCA. The buffers OpenCV allocates
+ *   inside a call, such as the scale space of SIFT, aren't charged.
+ *
+ * Memory is charged at the granularity it is allocated at, so an arena or a
+ * pool is charged for its blocks whether they are used or not. The counters
+ * are updated atomically, and may be charged and read by several threads at
+ * once.
+ */
+
+/** Type for the subsystems memory is charged to **/
+typedef enum sp_memory_subsystem_t {
+	SP_MEMORY_POINT,
+	SP_MEMORY_KD_ARRAY,
+	SP_MEMORY_KD_TREE,
+	SP_MEMORY_LIST,
+	SP_MEMORY_IMAGE_PROC,
+	SP_MEMORY_TOTAL, // the sum of the subsystems, can't be charged
+	SP_MEMORY_UNCHARGED // charges to it are ignored
+} SP_MEMORY_SUBSYSTEM;
+
+/** the number of subsystems, which come first in SP_MEMORY_SUBSYSTEM **/
+#define SP_MEMORY_SUBSYSTEMS_COUNT SP_MEMORY_TOTAL
+
+/*
+ * The memory of a subsystem
+ */
+typedef struct sp_memory_stats_t {
+	long currentBytes; // the bytes charged and not released
+	long peakBytes; // the most bytes charged at once since the last reset
+} SPMemoryStats;
+
+/*
+ * @param subsystem - the subsystem the memory belongs to
+ * @param bytes - the number of bytes allocated
+ *
+ */
+void spMemoryCharge(SP_MEMORY_SUBSYSTEM subsystem, size_t bytes);
+
+/*
+ * @param subsystem - the subsystem the memory was charged to
+ * @param bytes - the number of bytes freed
+ *
+ */
+void spMemoryRelease(SP_MEMORY_SUBSYSTEM subsystem, size_t bytes);
+
+/*
+ * @param subsystem - a subsystem, or SP_MEMORY_TOTAL
+ * @param stats - an output parameter for the memory of the subsystem
+ *
+ */
+void spMemoryGetStats(SP_MEMORY_SUBSYSTEM subsystem, SPMemoryStats* stats);
+
+/*
+ * Resets the peak of every subsystem to its current bytes, so the peak of a
+ * phase is measured alone
+ */
+void spMemoryResetPeaks();
+
+/*
+ * @param subsystem - a subsystem, or SP_MEMORY_TOTAL
+ *
+ * @return the name of the subsystem, to be logged
+ */
+const char* spMemoryGetName(SP_MEMORY_SUBSYSTEM subsystem);
+
+#endif /* SPMEMORY_H_ */
@@ -0,0 +1,28 @@
+/*
+ * SPNuma.c
+ */
+
+#include "SPNuma.h"
+
+#ifdef SP_HAVE_LIBNUMA
+#include <numa.h>
+#endif
+
+int spNumaGetNodesCount() {
+#ifdef SP_HAVE_LIBNUMA
+	if (numa_available() >= 0) {
+		return numa_max_node() + 1;
+	}
+#endif
+	return 1;
+}
+
+bool spNumaRunOnNode(int node) {
+#ifdef SP_HAVE_LIBNUMA
+	if (numa_available() >= 0) {
+		return numa_run_on_node(node) == 0;
+	}
+#endif
+	(void) node;
+	return false;
+}
@@ -0,0 +1,41 @@
+/*
+ * SPNuma.h
+ */
+
+#ifndef SPNUMA_H_
+#define SPNUMA_H_
+
+#include <stdbool.h>
+
+/*
+ * The NUMA topology of the machine, and the placement of threads on its nodes.
+ *
+ * Built with SP_HAVE_LIBNUMA defined, the functions use libnuma. Otherwise, or
+ * when the system has no NUMA support, the machine is seen as a single node and
+ * threads are never pinned, so callers work the same on any machine. Memory is
+ * placed on the node of the thread which first writes it, so a pinned thread
+ * gets local memory for what it allocates and fills.
+ */
+
+/** the node passed to spNumaRunOnNode to let a thread run on any node **/
+#define SP_NUMA_ANY_NODE -1
+
+/*
+ * @return the number of NUMA nodes, nodes are numbered 0..count-1. 1 without NUMA
+ * 		   support.
+ */
+int spNumaGetNodesCount();
+
+/*
+ * @param node - a node, or SP_NUMA_ANY_NODE
+ *
+ * The function pins the calling thread to the CPUs of the given node, or lets it
+ * run on any CPU again
+ *
+ * @return false if the thread could not be pinned, e.g. without NUMA support, in
+ * 		   which case it runs where it did
+ * @return true otherwise
+ */
+bool spNumaRunOnNode(int node);
+
+#endif /* SPNUMA_H_ */
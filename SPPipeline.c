@@ -0,0 +1,532 @@
+/*
+ * SPPipeline.c
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include "SPPipeline.h"
+
+/** the failed attempts on a queue after which a waiting worker sleeps instead of yielding **/
+#define YIELD_ATTEMPTS 32
+
+/** the first and the longest sleeps of a waiting worker, in nanoseconds **/
+#define MIN_SLEEP_NANOS 10000L
+#define MAX_SLEEP_NANOS 1000000L
+
+/** the size of a cache line, which the positions of a queue are kept apart by **/
+#define CACHE_LINE_SIZE 64
+
+/*
+ * A cell of a queue. Its sequence tells whether the cell is free for the push
+ * at a position, or holds the item for the pop at a position.
+ */
+typedef struct sp_pipeline_cell_t {
+	size_t sequence;
+	void* item;
+} Cell;
+
+/*
+ * A bounded multi-producer multi-consumer queue, after Dmitry Vyukov's. The
+ * positions only grow, a position maps to the cell at it modulo the capacity.
+ */
+typedef struct sp_pipeline_queue_t {
+	Cell* cells;
+	size_t mask; // the capacity, a power of 2, minus 1
+	char padding1[CACHE_LINE_SIZE];
+	size_t pushPosition;
+	char padding2[CACHE_LINE_SIZE];
+	size_t popPosition;
+	char padding3[CACHE_LINE_SIZE];
+	long pushesCount; // the statistics below count pushed items, not the end markers
+	long depthsSum;
+	int maxDepth;
+} Queue;
+
+/*
+ * A worker thread of a stage
+ */
+typedef struct sp_pipeline_worker_t {
+	SPPipeline* pipeline;
+	int stage;
+	pthread_t thread;
+	bool started;
+	long itemsCount;
+	double busySeconds;
+	double waitSeconds;
+} Worker;
+
+struct SPPipeline {
+	SPPipelineStage* stages;
+	int stagesCount;
+	Queue* queues; // the input queue of every stage
+	Worker** workers; // the workers of every stage
+	int* activeWorkers; // the workers of every stage which didn't finish yet
+	void (*release)(void* item);
+	bool failed; // accessed atomically
+	bool aborting; // the workers were stopped before any item was run, accessed atomically
+	double elapsedSeconds;
+};
+
+/*
+ * Helper function to get the time in seconds from an arbitrary point
+ */
+double getSeconds() {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/*
+ * Helper function to wait after the given number of failed attempts on a queue
+ */
+void backOff(int attempts) {
+	struct timespec sleep;
+	long nanos = MIN_SLEEP_NANOS;
+
+	if (attempts < YIELD_ATTEMPTS) {
+		sched_yield();
+		return;
+	}
+	for (attempts -= YIELD_ATTEMPTS; attempts > 0 && nanos < MAX_SLEEP_NANOS; attempts--) {
+		nanos *= 2;
+	}
+	sleep.tv_sec = 0;
+	sleep.tv_nsec = nanos < MAX_SLEEP_NANOS ? nanos : MAX_SLEEP_NANOS;
+	nanosleep(&sleep, NULL);
+}
+
+/*
+ * Helper function to initialize a queue of at least the given capacity,
+ * returns false on allocation failure
+ */
+bool initQueue(Queue* queue, int capacity) {
+	size_t size = 1;
+	size_t i;
+
+	while (size < (size_t) capacity) {
+		size *= 2;
+	}
+	queue->cells = (Cell*) malloc(sizeof(Cell) * size);
+	if (queue->cells == NULL) {
+		return false;
+	}
+	for (i = 0; i < size; i++) {
+		queue->cells[i].sequence = i;
+	}
+	queue->mask = size - 1;
+	return true;
+}
+
+/*
+ * Helper function to record the depth of a queue after a push
+ */
+void recordDepth(Queue* queue) {
+	// the pop position is read first, so it can't be past the push position, but
+	// both may move in between, so the depth is a sample bounded by the capacity
+	size_t popPosition = __atomic_load_n(&queue->popPosition, __ATOMIC_RELAXED);
+	size_t pushPosition = __atomic_load_n(&queue->pushPosition, __ATOMIC_RELAXED);
+	int depth = (int) (pushPosition - popPosition > queue->mask ?
+			queue->mask + 1 : pushPosition - popPosition);
+	int maxDepth = __atomic_load_n(&queue->maxDepth, __ATOMIC_RELAXED);
+
+	__atomic_add_fetch(&queue->pushesCount, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&queue->depthsSum, depth, __ATOMIC_RELAXED);
+	while (depth > maxDepth && !__atomic_compare_exchange_n(&queue->maxDepth,
+			&maxDepth, depth, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+	}
+}
+
+/*
+ * Helper function to push an item to a queue, returns false if it is full
+ */
+bool tryPush(Queue* queue, void* item) {
+	size_t position = __atomic_load_n(&queue->pushPosition, __ATOMIC_RELAXED);
+	Cell* cell;
+	intptr_t difference;
+
+	while (true) {
+		cell = &queue->cells[position & queue->mask];
+		difference = (intptr_t) __atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE)
+				- (intptr_t) position;
+		if (difference == 0) {
+			if (__atomic_compare_exchange_n(&queue->pushPosition, &position,
+					position + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+				break;
+			}
+		} else if (difference < 0) {
+			return false;
+		} else {
+			position = __atomic_load_n(&queue->pushPosition, __ATOMIC_RELAXED);
+		}
+	}
+	cell->item = item;
+	__atomic_store_n(&cell->sequence, position + 1, __ATOMIC_RELEASE);
+	return true;
+}
+
+/*
+ * Helper function to pop an item from a queue, returns false if it is empty
+ */
+bool tryPop(Queue* queue, void** item) {
+	size_t position = __atomic_load_n(&queue->popPosition, __ATOMIC_RELAXED);
+	Cell* cell;
+	intptr_t difference;
+
+	while (true) {
+		cell = &queue->cells[position & queue->mask];
+		difference = (intptr_t) __atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE)
+				- (intptr_t) (position + 1);
+		if (difference == 0) {
+			if (__atomic_compare_exchange_n(&queue->popPosition, &position,
+					position + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+				break;
+			}
+		} else if (difference < 0) {
+			return false;
+		} else {
+			position = __atomic_load_n(&queue->popPosition, __ATOMIC_RELAXED);
+		}
+	}
+	*item = cell->item;
+	__atomic_store_n(&cell->sequence, position + queue->mask + 1, __ATOMIC_RELEASE);
+	return true;
+}
+
+/*
+ * Helper function to push an item to a queue, waiting while it is full. A NULL
+ * item marks the end of the input of a worker.
+ */
+void pushItem(Queue* queue, void* item, double* waitSeconds) {
+	double start = 0;
+	int attempts = 0;
+
+	while (!tryPush(queue, item)) {
+		if (attempts == 0) {
+			start = getSeconds();
+		}
+		backOff(attempts++);
+	}
+	if (attempts > 0) {
+		*waitSeconds += getSeconds() - start;
+	}
+	if (item != NULL) {
+		recordDepth(queue);
+	}
+}
+
+/*
+ * Helper function to pop an item from a queue, waiting while it is empty
+ */
+void* popItem(Queue* queue, double* waitSeconds) {
+	void* item;
+	double start = 0;
+	int attempts = 0;
+
+	while (!tryPop(queue, &item)) {
+		if (attempts == 0) {
+			start = getSeconds();
+		}
+		backOff(attempts++);
+	}
+	if (attempts > 0) {
+		*waitSeconds += getSeconds() - start;
+	}
+	return item;
+}
+
+/*
+ * Helper function to tell whether an item of the current run failed
+ */
+bool isFailed(SPPipeline* pipeline) {
+	return __atomic_load_n(&pipeline->failed, __ATOMIC_ACQUIRE);
+}
+
+/*
+ * Helper function to release an item which won't go through all the stages
+ */
+void releaseItem(SPPipeline* pipeline, void* item) {
+	if (pipeline->release != NULL) {
+		pipeline->release(item);
+	}
+}
+
+/*
+ * Helper function to run a stage on an item, returns false if it failed or
+ * wasn't run because another item failed, in which case the item is released
+ */
+bool processItem(Worker* worker, void* item) {
+	SPPipeline* pipeline = worker->pipeline;
+	SPPipelineStage* stage = &pipeline->stages[worker->stage];
+	double start;
+	bool success;
+
+	if (isFailed(pipeline)) {
+		releaseItem(pipeline, item);
+		return false;
+	}
+	start = getSeconds();
+	success = stage->process(item, stage->data);
+	worker->busySeconds += getSeconds() - start;
+	if (!success) {
+		__atomic_store_n(&pipeline->failed, true, __ATOMIC_RELEASE);
+		releaseItem(pipeline, item);
+		return false;
+	}
+	worker->itemsCount++;
+	return true;
+}
+
+/*
+ * The loop of a worker: processes the items of its input queue and passes them
+ * on until it pops the end marker. The last worker of a stage to finish passes
+ * an end marker on to every worker of the next stage.
+ */
+void* runWorker(void* arg) {
+	Worker* worker = (Worker*) arg;
+	SPPipeline* pipeline = worker->pipeline;
+	int next = worker->stage + 1;
+	void* item;
+	int i;
+
+	while ((item = popItem(&pipeline->queues[worker->stage], &worker->waitSeconds)) != NULL) {
+		if (processItem(worker, item) && next < pipeline->stagesCount) {
+			pushItem(&pipeline->queues[next], item, &worker->waitSeconds);
+		}
+	}
+	if (__atomic_sub_fetch(&pipeline->activeWorkers[worker->stage], 1,
+			__ATOMIC_ACQ_REL) == 0 && next < pipeline->stagesCount
+			&& !__atomic_load_n(&pipeline->aborting, __ATOMIC_ACQUIRE)) {
+		for (i = 0; i < pipeline->stages[next].workersCount; i++) {
+			pushItem(&pipeline->queues[next], NULL, &worker->waitSeconds);
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Helper function to start the workers of all the stages. If any can't be
+ * started, the started ones are stopped and false is returned.
+ */
+bool startWorkers(SPPipeline* pipeline) {
+	bool success = true;
+	double waitSeconds = 0;
+	int i, j;
+
+	__atomic_store_n(&pipeline->aborting, false, __ATOMIC_RELEASE);
+	for (i = 0; i < pipeline->stagesCount; i++) {
+		pipeline->activeWorkers[i] = pipeline->stages[i].workersCount;
+	}
+	for (i = 0; i < pipeline->stagesCount && success; i++) {
+		for (j = 0; j < pipeline->stages[i].workersCount && success; j++) {
+			success = pthread_create(&pipeline->workers[i][j].thread, NULL,
+					runWorker, &pipeline->workers[i][j]) == 0;
+			pipeline->workers[i][j].started = success;
+		}
+	}
+	if (success) {
+		return true;
+	}
+
+	__atomic_store_n(&pipeline->aborting, true, __ATOMIC_RELEASE);
+	for (i = 0; i < pipeline->stagesCount; i++) {
+		for (j = 0; j < pipeline->stages[i].workersCount; j++) {
+			if (pipeline->workers[i][j].started) {
+				pushItem(&pipeline->queues[i], NULL, &waitSeconds);
+			}
+		}
+	}
+	for (i = 0; i < pipeline->stagesCount; i++) {
+		for (j = 0; j < pipeline->stages[i].workersCount; j++) {
+			if (pipeline->workers[i][j].started) {
+				pthread_join(pipeline->workers[i][j].thread, NULL);
+				pipeline->workers[i][j].started = false;
+			}
+		}
+	}
+	return false;
+}
+
+/*
+ * Helper function to run the items through the stages on the calling thread,
+ * the statistics of which are kept by the first worker of every stage
+ */
+void runSequentially(SPPipeline* pipeline, void** items, int itemsCount) {
+	int i, j;
+
+	for (i = 0; i < itemsCount; i++) {
+		for (j = 0; j < pipeline->stagesCount; j++) {
+			if (!processItem(&pipeline->workers[j][0], items[i])) {
+				break;
+			}
+		}
+	}
+}
+
+/*
+ * Helper function to clear the statistics of the previous run
+ */
+void resetStats(SPPipeline* pipeline) {
+	Worker* worker;
+	int i, j;
+
+	for (i = 0; i < pipeline->stagesCount; i++) {
+		pipeline->queues[i].pushesCount = 0;
+		pipeline->queues[i].depthsSum = 0;
+		pipeline->queues[i].maxDepth = 0;
+		for (j = 0; j < pipeline->stages[i].workersCount; j++) {
+			worker = &pipeline->workers[i][j];
+			worker->itemsCount = 0;
+			worker->busySeconds = 0;
+			worker->waitSeconds = 0;
+		}
+	}
+}
+
+SPPipeline* spPipelineCreate(const SPPipelineStage* stages, int stagesCount,
+		int queueCapacity, void (*release)(void* item)) {
+	SPPipeline* pipeline;
+	int i, j;
+
+	if (stages == NULL || stagesCount < 1 || queueCapacity < 1) {
+		return NULL;
+	}
+	for (i = 0; i < stagesCount; i++) {
+		if (stages[i].process == NULL || stages[i].workersCount < 1) {
+			return NULL;
+		}
+	}
+	pipeline = (SPPipeline*) calloc(1, sizeof(SPPipeline));
+	if (pipeline == NULL) {
+		return NULL;
+	}
+	pipeline->stagesCount = stagesCount;
+	pipeline->release = release;
+	pipeline->stages = (SPPipelineStage*) malloc(sizeof(SPPipelineStage) * stagesCount);
+	pipeline->queues = (Queue*) calloc(stagesCount, sizeof(Queue));
+	pipeline->workers = (Worker**) calloc(stagesCount, sizeof(Worker*));
+	pipeline->activeWorkers = (int*) calloc(stagesCount, sizeof(int));
+	if (pipeline->stages == NULL || pipeline->queues == NULL
+			|| pipeline->workers == NULL || pipeline->activeWorkers == NULL) {
+		spPipelineDestroy(pipeline);
+		return NULL;
+	}
+	memcpy(pipeline->stages, stages, sizeof(SPPipelineStage) * stagesCount);
+
+	for (i = 0; i < stagesCount; i++) {
+		pipeline->workers[i] = (Worker*) calloc(stages[i].workersCount, sizeof(Worker));
+		// every worker of the stage must fit its end marker in the queue at once
+		if (pipeline->workers[i] == NULL || !initQueue(&pipeline->queues[i],
+				queueCapacity > stages[i].workersCount ?
+						queueCapacity : stages[i].workersCount)) {
+			spPipelineDestroy(pipeline);
+			return NULL;
+		}
+		for (j = 0; j < stages[i].workersCount; j++) {
+			pipeline->workers[i][j].pipeline = pipeline;
+			pipeline->workers[i][j].stage = i;
+		}
+	}
+	return pipeline;
+}
+
+void spPipelineDestroy(SPPipeline* pipeline) {
+	int i;
+
+	if (pipeline == NULL) {
+		return;
+	}
+	for (i = 0; i < pipeline->stagesCount; i++) {
+		if (pipeline->queues != NULL) {
+			free(pipeline->queues[i].cells);
+		}
+		if (pipeline->workers != NULL) {
+			free(pipeline->workers[i]);
+		}
+	}
+	free(pipeline->stages);
+	free(pipeline->queues);
+	free(pipeline->workers);
+	free(pipeline->activeWorkers);
+	free(pipeline);
+}
+
+bool spPipelineRun(SPPipeline* pipeline, void** items, int itemsCount) {
+	double start, waitSeconds = 0;
+	int i, j;
+
+	if (pipeline == NULL || itemsCount < 0 || (items == NULL && itemsCount > 0)) {
+		return false;
+	}
+	for (i = 0; i < itemsCount; i++) {
+		if (items[i] == NULL) {
+			return false;
+		}
+	}
+	pipeline->failed = false;
+	resetStats(pipeline);
+	start = getSeconds();
+
+	if (!startWorkers(pipeline)) {
+		runSequentially(pipeline, items, itemsCount);
+	} else {
+		// the first queue being bounded, the items are fed as the first stage takes them
+		for (i = 0; i < itemsCount; i++) {
+			if (isFailed(pipeline)) {
+				releaseItem(pipeline, items[i]);
+			} else {
+				pushItem(&pipeline->queues[0], items[i], &waitSeconds);
+			}
+		}
+		for (i = 0; i < pipeline->stages[0].workersCount; i++) {
+			pushItem(&pipeline->queues[0], NULL, &waitSeconds);
+		}
+		for (i = 0; i < pipeline->stagesCount; i++) {
+			for (j = 0; j < pipeline->stages[i].workersCount; j++) {
+				pthread_join(pipeline->workers[i][j].thread, NULL);
+				pipeline->workers[i][j].started = false;
+			}
+		}
+	}
+
+	pipeline->elapsedSeconds = getSeconds() - start;
+	return !pipeline->failed;
+}
+
+bool spPipelineGetStageStats(SPPipeline* pipeline, int stage,
+		SPPipelineStageStats* stats) {
+	Queue* queue;
+	Worker* worker;
+	int i;
+
+	if (pipeline == NULL || stats == NULL || stage < 0
+			|| stage >= pipeline->stagesCount) {
+		return false;
+	}
+	queue = &pipeline->queues[stage];
+	stats->name = pipeline->stages[stage].name;
+	stats->workersCount = pipeline->stages[stage].workersCount;
+	stats->itemsCount = 0;
+	stats->busySeconds = 0;
+	stats->waitSeconds = 0;
+	for (i = 0; i < stats->workersCount; i++) {
+		worker = &pipeline->workers[stage][i];
+		stats->itemsCount += worker->itemsCount;
+		stats->busySeconds += worker->busySeconds;
+		stats->waitSeconds += worker->waitSeconds;
+	}
+	stats->maxQueueDepth = queue->maxDepth;
+	stats->averageQueueDepth = queue->pushesCount == 0 ? 0 :
+			(double) queue->depthsSum / queue->pushesCount;
+	return true;
+}
+
+double spPipelineGetElapsedSeconds(SPPipeline* pipeline) {
+	return pipeline == NULL ? 0 : pipeline->elapsedSeconds;
+}
@@ -0,0 +1,107 @@
+/*
+ * SPPipeline.h
+ */
+
+#ifndef SPPIPELINE_H_
+#define SPPIPELINE_H_
+
+#include <stdbool.h>
+
+/*
+ * A pipeline of stages, each run by its own worker threads, which pass items
+ * from one stage to the next through bounded queues. Stages bound by I/O and
+ * stages bound by the CPU work on different items at the same time, and at
+ * most the capacity of the queues is in flight between two stages, so the
+ * memory held by the items stays bounded however many items are run.
+ *
+ * The queues are lock-free, a worker which finds its input empty or its output
+ * full backs off, yielding first and then sleeping for growing intervals.
+ *
+ * Items may be processed by the stages in any order, and the workers of a stage
+ * may process several items at once.
+ */
+struct SPPipeline;
+typedef struct SPPipeline SPPipeline;
+
+/*
+ * The work of a stage on an item, returns false on failure
+ */
+typedef bool (*SPPipelineStageFunction)(void* item, void* data);
+
+/*
+ * A stage of a pipeline
+ */
+typedef struct sp_pipeline_stage_t {
+	const char* name;
+	SPPipelineStageFunction process;
+	void* data; // passed to every call of process
+	int workersCount; // at least 1
+} SPPipelineStage;
+
+/*
+ * Statistics on a stage during the last run of a pipeline
+ */
+typedef struct sp_pipeline_stage_stats_t {
+	const char* name;
+	long itemsCount; // the items the stage processed successfully
+	int workersCount;
+	double busySeconds; // the time spent processing items, summed over the workers
+	double waitSeconds; // the time spent waiting on the queues, summed over the workers
+	int maxQueueDepth; // the most items waiting in the input queue of the stage
+	double averageQueueDepth; // the items waiting in the input queue, on average
+} SPPipelineStageStats;
+
+/*
+ * @param stages - the stages, in order, which are copied
+ * @param stagesCount - the number of stages, at least 1
+ * @param queueCapacity - the most items waiting before every stage, rounded up
+ * 		  to a power of 2 of at least the workers of the stage
+ * @param release - called on every item which fails or isn't run by all the
+ * 		  stages because another one failed, may be NULL
+ *
+ * @return NULL on invalid argument or allocation failure
+ * @return a new pipeline otherwise
+ */
+SPPipeline* spPipelineCreate(const SPPipelineStage* stages, int stagesCount,
+		int queueCapacity, void (*release)(void* item));
+
+/*
+ * @param pipeline - a pipeline
+ *
+ * The function releases the pipeline, which mustn't be running
+ *
+ */
+void spPipelineDestroy(SPPipeline* pipeline);
+
+/*
+ * @param pipeline - a pipeline
+ * @param items - the items to run through the stages, none of them NULL
+ * @param itemsCount - the number of items
+ *
+ * Runs every item through all the stages and returns once all of them are done.
+ * Once an item fails, the items in flight and the items not run yet are
+ * released instead of processed. If the worker threads can't be started, the
+ * items are run through the stages one at a time by the calling thread.
+ *
+ * @return false on invalid argument or if an item failed, true otherwise
+ */
+bool spPipelineRun(SPPipeline* pipeline, void** items, int itemsCount);
+
+/*
+ * @param pipeline - a pipeline
+ * @param stage - the index of a stage
+ * @param stats - an output parameter for the statistics of the stage
+ *
+ * @return false on invalid argument, true otherwise
+ */
+bool spPipelineGetStageStats(SPPipeline* pipeline, int stage,
+		SPPipelineStageStats* stats);
+
+/*
+ * @param pipeline - a pipeline
+ *
+ * @return the duration of the last run in seconds, 0 if it wasn't run
+ */
+double spPipelineGetElapsedSeconds(SPPipeline* pipeline);
+
+#endif /* SPPIPELINE_H_ */
@@ -5,6 +5,7 @@
 #include <math.h>
 
 #include "SPPoint.h"
+#include "SPMemory.h"
 
 struct sp_point_t {
 	double* coordinates;
@@ -12,6 +13,18 @@ struct sp_point_t {
 	int index;
 };
 
+/*
+ * The header in front of an array of points created over a block, which tells
+ * the number of points to release
+ */
+typedef struct sp_point_array_header_t {
+	size_t count;
+} PointArrayHeader;
+
+/** the bytes of an array of count points created over a block, with its header **/
+#define POINT_ARRAY_BYTES(count) (sizeof(PointArrayHeader) \
+		+ (sizeof(SPPoint) + sizeof(struct sp_point_t)) * (size_t) (count))
+
 SPPoint spPointCreate(double* data, int dim, int index) {
 	struct sp_point_t *point;
 	int i;
@@ -26,12 +39,14 @@ SPPoint spPointCreate(double* data, int dim, int index) {
 	point->coordinates = (double*)malloc(sizeof(double)*dim);
 	if (point->coordinates == NULL) {
 		free(point);
+		return NULL;
 	}
 	for(i = 0; i < dim; i++) {
 		point->coordinates[i] = data[i];
 	}
 	point->dimension = dim;
 	point->index = index;
+	spMemoryCharge(SP_MEMORY_POINT, sizeof(struct sp_point_t) + sizeof(double) * dim);
 
 	return point;
 }
@@ -52,11 +67,51 @@ SPPoint spPointCopy(SPPoint source) {
 
 void spPointDestroy(SPPoint point) {
 	if (point != NULL) {
+		spMemoryRelease(SP_MEMORY_POINT,
+				sizeof(struct sp_point_t) + sizeof(double) * point->dimension);
 		free(point->coordinates);
 		free(point);
 	}
 }
 
+SPPoint* spPointCreateArray(double* data, int count, int dim, int index) {
+	PointArrayHeader* header;
+	SPPoint* points;
+	struct sp_point_t* point;
+	int i;
+	if (count <= 0 || dim <= 0 || data == NULL || index < 0) {
+		return NULL;
+	}
+
+	// the header is followed by the array of points, and by the points themselves
+	header = (PointArrayHeader*) malloc(POINT_ARRAY_BYTES(count));
+	if (header == NULL) {
+		return NULL;
+	}
+	header->count = (size_t) count;
+	points = (SPPoint*) (header + 1);
+	point = (struct sp_point_t*) (points + count);
+	for (i = 0; i < count; i++) {
+		point[i].coordinates = data + (size_t) i * dim;
+		point[i].dimension = dim;
+		point[i].index = index;
+		points[i] = &point[i];
+	}
+	spMemoryCharge(SP_MEMORY_POINT, POINT_ARRAY_BYTES(count));
+
+	return points;
+}
+
+void spPointDestroyArray(SPPoint* points) {
+	PointArrayHeader* header;
+	if (points == NULL) {
+		return;
+	}
+	header = (PointArrayHeader*) points - 1;
+	spMemoryRelease(SP_MEMORY_POINT, POINT_ARRAY_BYTES(header->count));
+	free(header);
+}
+
 /*
  * c is stupid
  */
@@ -78,6 +133,11 @@ double spPointGetAxisCoor(SPPoint point, int axis) {
 	return point->coordinates[axis];
 }
 
+const double* spPointGetCoordinates(SPPoint point) {
+	assert(point != NULL);
+	return point->coordinates;
+}
+
 double spPointL2SquaredDistance(SPPoint p, SPPoint q) {
 	double distance = 0;
 
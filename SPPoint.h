@@ -12,9 +12,12 @@
  * spPointCreate        	- Creates a new point
  * spPointCopy				- Create a new copy of a given point
  * spPointDestroy 			- Free all resources associated with a point
+ * spPointCreateArray		- Creates points over the rows of a block of coordinates
+ * spPointDestroyArray		- Free the points created by spPointCreateArray
  * spPointGetDimension		- A getter of the dimension of a point
  * spPointGetIndex			- A getter of the index of a point
  * spPointGetAxisCoor		- A getter of a given coordinate of the point
+ * spPointGetCoordinates	- A getter of all the coordinates of the point
  * spPointL2SquaredDistance	- Calculates the L2 squared distance between two points
  *
  */
@@ -62,6 +65,29 @@ SPPoint spPointCopy(SPPoint source);
  */
 void spPointDestroy(SPPoint point);
 
+/**
+ * Allocates count points over the rows of a contiguous block of coordinates,
+ * in a single allocation. The coordinates aren't copied: the ith point
+ * P = (data[i*dim],...,data[i*dim+dim-1]) reads them from the block, which
+ * must outlive the points. All the points have the given index.
+ *
+ * The points may be used like any other, but only released all at once by
+ * spPointDestroyArray, never by spPointDestroy. Copies of them are regular
+ * points.
+ *
+ * @return
+ * NULL in case allocation failure ocurred OR data is NULL OR count <= 0
+ * OR dim <=0 OR index <0
+ * Otherwise, an array of the new points is returned
+ */
+SPPoint* spPointCreateArray(double* data, int count, int dim, int index);
+
+/**
+ * Free the points created by spPointCreateArray, but not their block of
+ * coordinates. If points is NULL nothing happens.
+ */
+void spPointDestroyArray(SPPoint* points);
+
 /**
  * A getter for the dimension of the point
  *
@@ -94,6 +120,17 @@ int spPointGetIndex(SPPoint point);
  */
 double spPointGetAxisCoor(SPPoint point, int axis);
 
+/**
+ * A getter for all the coordinates, which remain the point's, so they are
+ * valid as long as the point, or the block of a point of spPointCreateArray, is
+ *
+ * @param point - The source point
+ * @assert point!=NULL
+ * @return
+ * The coordinates of the point, p_0 to p_{dim-1}
+ */
+const double* spPointGetCoordinates(SPPoint point);
+
 /**
  * Calculates the L2-squared distance between p and q.
  * The L2-squared distance is defined as:
@@ -0,0 +1,289 @@
+/*
+ * SPPool.c
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "SPPool.h"
+
+/** the alignment of the objects **/
+#define POOL_ALIGNMENT 16
+
+/** the number of objects moved at once between a thread freelist and the shared one **/
+#define BATCH_SIZE 64
+
+/*
+ * rounds a size up to the alignment of the objects
+ */
+#define ALIGN_UP(size) (((size) + POOL_ALIGNMENT - 1) & ~((size_t) POOL_ALIGNMENT - 1))
+
+/*
+ * A free object, linked through its own memory
+ */
+typedef struct sp_free_object_t {
+	struct sp_free_object_t* next;
+} FreeObject;
+
+/*
+ * A slab, followed by its objects
+ */
+typedef struct sp_slab_t {
+	struct sp_slab_t* next;
+} Slab;
+
+/** the space taken at the start of every slab by its header **/
+#define SLAB_HEADER_SIZE ALIGN_UP(sizeof(Slab))
+
+/*
+ * The freelist of a thread
+ */
+typedef struct sp_pool_cache_t {
+	SPPool* pool;
+	FreeObject* head;
+	int count;
+} Cache;
+
+struct SPPool {
+	size_t objectSize;
+	int slabObjects;
+	pthread_key_t cacheKey;
+	pthread_mutex_t lock; // guards the fields below
+	FreeObject* shared;
+	int sharedCount;
+	Slab* slabs;
+	int slabsCount;
+	long objectsInUse; // updated atomically, without the lock
+	SP_MEMORY_SUBSYSTEM subsystem; // the subsystem the slabs are charged to
+};
+
+/*
+ * Helper function to get the bytes of a slab, header included
+ */
+size_t getSlabBytes(SPPool* pool) {
+	return SLAB_HEADER_SIZE + pool->objectSize * pool->slabObjects;
+}
+
+/*
+ * Helper function to return the freelist of an exiting thread to the shared one
+ */
+void releaseCache(void* arg) {
+	Cache* cache = (Cache*) arg;
+	SPPool* pool = cache->pool;
+	FreeObject* last = cache->head;
+
+	if (last != NULL) {
+		while (last->next != NULL) {
+			last = last->next;
+		}
+		pthread_mutex_lock(&pool->lock);
+		last->next = pool->shared;
+		pool->shared = cache->head;
+		pool->sharedCount += cache->count;
+		pthread_mutex_unlock(&pool->lock);
+	}
+	free(cache);
+}
+
+/*
+ * Helper function to get the freelist of the calling thread, creating it on
+ * first use. Returns NULL on allocation failure.
+ */
+Cache* getCache(SPPool* pool) {
+	Cache* cache = (Cache*) pthread_getspecific(pool->cacheKey);
+
+	if (cache == NULL) {
+		cache = (Cache*) calloc(1, sizeof(Cache));
+		if (cache == NULL) {
+			return NULL;
+		}
+		cache->pool = pool;
+		if (pthread_setspecific(pool->cacheKey, cache) != 0) {
+			free(cache);
+			return NULL;
+		}
+	}
+	return cache;
+}
+
+/*
+ * Helper function to allocate a slab and add its objects to the shared freelist,
+ * called with the lock held
+ */
+bool addSlab(SPPool* pool) {
+	Slab* slab = (Slab*) malloc(getSlabBytes(pool));
+	FreeObject* object;
+	int i;
+
+	if (slab == NULL) {
+		return false;
+	}
+	slab->next = pool->slabs;
+	pool->slabs = slab;
+	pool->slabsCount++;
+	spMemoryCharge(pool->subsystem, getSlabBytes(pool));
+	for (i = pool->slabObjects - 1; i >= 0; i--) {
+		object = (FreeObject*) ((char*) slab + SLAB_HEADER_SIZE + pool->objectSize * i);
+		object->next = pool->shared;
+		pool->shared = object;
+	}
+	pool->sharedCount += pool->slabObjects;
+	return true;
+}
+
+/*
+ * Helper function to take up to count objects off the shared freelist, adding a
+ * slab if it is empty, called with the lock held
+ */
+FreeObject* takeShared(SPPool* pool, int count, int* taken) {
+	FreeObject* head;
+	FreeObject* last;
+
+	*taken = 0;
+	if (pool->shared == NULL && !addSlab(pool)) {
+		return NULL;
+	}
+	head = pool->shared;
+	last = head;
+	for (*taken = 1; *taken < count && last->next != NULL; (*taken)++) {
+		last = last->next;
+	}
+	pool->shared = last->next;
+	pool->sharedCount -= *taken;
+	last->next = NULL;
+	return head;
+}
+
+SPPool* spPoolCreate(size_t objectSize, int slabObjects) {
+	SPPool* pool;
+
+	if (objectSize == 0 || slabObjects < 1) {
+		return NULL;
+	}
+	pool = (SPPool*) calloc(1, sizeof(SPPool));
+	if (pool == NULL) {
+		return NULL;
+	}
+	pool->objectSize = ALIGN_UP(objectSize < sizeof(FreeObject) ? sizeof(FreeObject) : objectSize);
+	pool->slabObjects = slabObjects;
+	pool->subsystem = SP_MEMORY_UNCHARGED;
+	if (pthread_key_create(&pool->cacheKey, releaseCache) != 0) {
+		free(pool);
+		return NULL;
+	}
+	if (pthread_mutex_init(&pool->lock, NULL) != 0) {
+		pthread_key_delete(pool->cacheKey);
+		free(pool);
+		return NULL;
+	}
+	return pool;
+}
+
+void spPoolDestroy(SPPool* pool) {
+	Slab* slab;
+	Slab* next;
+
+	if (pool == NULL) {
+		return;
+	}
+	free(pthread_getspecific(pool->cacheKey));
+	pthread_key_delete(pool->cacheKey);
+	pthread_mutex_destroy(&pool->lock);
+	for (slab = pool->slabs; slab != NULL; slab = next) {
+		next = slab->next;
+		free(slab);
+	}
+	spMemoryRelease(pool->subsystem, getSlabBytes(pool) * pool->slabsCount);
+	free(pool);
+}
+
+void* spPoolAlloc(SPPool* pool) {
+	Cache* cache = getCache(pool);
+	FreeObject* object;
+	int taken;
+
+	if (cache == NULL) {
+		// without a freelist of its own, the thread allocates from the shared one
+		pthread_mutex_lock(&pool->lock);
+		object = takeShared(pool, 1, &taken);
+		pthread_mutex_unlock(&pool->lock);
+	} else {
+		if (cache->head == NULL) {
+			pthread_mutex_lock(&pool->lock);
+			cache->head = takeShared(pool, BATCH_SIZE, &cache->count);
+			pthread_mutex_unlock(&pool->lock);
+		}
+		object = cache->head;
+		if (object != NULL) {
+			cache->head = object->next;
+			cache->count--;
+		}
+	}
+
+	if (object != NULL) {
+		__atomic_add_fetch(&pool->objectsInUse, 1, __ATOMIC_RELAXED);
+	}
+	return object;
+}
+
+void spPoolFree(SPPool* pool, void* object) {
+	Cache* cache;
+	FreeObject* freed = (FreeObject*) object;
+	FreeObject* last;
+	int i;
+
+	if (object == NULL) {
+		return;
+	}
+	__atomic_sub_fetch(&pool->objectsInUse, 1, __ATOMIC_RELAXED);
+	cache = getCache(pool);
+	if (cache == NULL) {
+		pthread_mutex_lock(&pool->lock);
+		freed->next = pool->shared;
+		pool->shared = freed;
+		pool->sharedCount++;
+		pthread_mutex_unlock(&pool->lock);
+		return;
+	}
+
+	freed->next = cache->head;
+	cache->head = freed;
+	cache->count++;
+
+	// a thread which frees more than it allocates returns objects to the others
+	if (cache->count >= 2 * BATCH_SIZE) {
+		last = cache->head;
+		for (i = 1; i < BATCH_SIZE; i++) {
+			last = last->next;
+		}
+		pthread_mutex_lock(&pool->lock);
+		freed = cache->head;
+		cache->head = last->next;
+		last->next = pool->shared;
+		pool->shared = freed;
+		pool->sharedCount += BATCH_SIZE;
+		pthread_mutex_unlock(&pool->lock);
+		cache->count -= BATCH_SIZE;
+	}
+}
+
+void spPoolChargeTo(SPPool* pool, SP_MEMORY_SUBSYSTEM subsystem) {
+	if (pool == NULL) {
+		return;
+	}
+	pthread_mutex_lock(&pool->lock);
+	spMemoryRelease(pool->subsystem, getSlabBytes(pool) * pool->slabsCount);
+	spMemoryCharge(subsystem, getSlabBytes(pool) * pool->slabsCount);
+	pool->subsystem = subsystem;
+	pthread_mutex_unlock(&pool->lock);
+}
+
+void spPoolGetStats(SPPool* pool, SPPoolStats* stats) {
+	pthread_mutex_lock(&pool->lock);
+	stats->objectsReserved = (long) pool->slabsCount * pool->slabObjects;
+	stats->slabsCount = pool->slabsCount;
+	pthread_mutex_unlock(&pool->lock);
+	stats->objectsInUse = __atomic_load_n(&pool->objectsInUse, __ATOMIC_RELAXED);
+}
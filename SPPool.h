@@ -0,0 +1,86 @@
+/*
+ * SPPool.h
+ */
+
+#ifndef SPPOOL_H_
+#define SPPOOL_H_
+
+#include <stddef.h>
+#include "SPMemory.h"
+
+/*
+ * A pool of fixed size objects, for small objects which are created and
+ * destroyed constantly.
+ *
+ * Objects are carved from slabs holding many objects each, and freed objects are
+ * kept on a freelist of the thread which freed them, so most allocations and
+ * frees touch neither malloc nor a lock. Objects move between the thread
+ * freelists and a shared freelist in batches, and the freelist of a thread is
+ * returned to the shared one when the thread exits, so objects may be freed by
+ * any thread. Slabs are kept until the pool is destroyed.
+ */
+struct SPPool;
+typedef struct SPPool SPPool;
+
+/*
+ * Statistics on the objects of a pool
+ */
+typedef struct sp_pool_stats_t {
+	long objectsInUse; // objects allocated and not freed
+	long objectsReserved; // objects in all the slabs
+	int slabsCount;
+} SPPoolStats;
+
+/*
+ * @param objectSize - the size of the objects
+ * @param slabObjects - the number of objects in a slab, at least 1
+ *
+ * @return NULL on invalid argument or allocation failure
+ * @return a new pool with no slabs, the first is allocated on demand
+ */
+SPPool* spPoolCreate(size_t objectSize, int slabObjects);
+
+/*
+ * @param pool - a pool
+ *
+ * The function releases all the slabs of the pool, and the pool. No object of
+ * the pool may be in use, and no thread may use it anymore.
+ *
+ */
+void spPoolDestroy(SPPool* pool);
+
+/*
+ * @param pool - a pool
+ *
+ * @return NULL on allocation failure, uninitialized memory for an object otherwise
+ */
+void* spPoolAlloc(SPPool* pool);
+
+/*
+ * @param pool - the pool the object was allocated from
+ * @param object - an object, may be NULL
+ *
+ * The function returns an object to the pool
+ *
+ */
+void spPoolFree(SPPool* pool, void* object);
+
+/*
+ * @param pool - a pool
+ * @param subsystem - the subsystem the memory of the pool belongs to
+ *
+ * The function charges the slabs of the pool, the ones allocated already and
+ * the ones to come, to the subsystem, until the pool is destroyed, see
+ * SPMemory.h. The slabs of a new pool are charged to no subsystem.
+ *
+ */
+void spPoolChargeTo(SPPool* pool, SP_MEMORY_SUBSYSTEM subsystem);
+
+/*
+ * @param pool - a pool
+ * @param stats - an output parameter for the statistics of the pool
+ *
+ */
+void spPoolGetStats(SPPool* pool, SPPoolStats* stats);
+
+#endif /* SPPOOL_H_ */
@@ -0,0 +1,118 @@
+/*
+ * SPProjection.c
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "SPProjection.h"
+
+/** the input vectors projected at once, each with its own accumulators **/
+#define BLOCK_ROWS 4
+
+/** the output dimension is padded to a multiple of this many lanes **/
+#define LANES 8
+
+struct SPProjection {
+	int inputDim;
+	int outputDim;
+	int width; // the output dimension, padded
+	float* weights; // the transposed eigenvectors, inputDim rows of width, zero padded
+	float* mean; // inputDim coordinates
+};
+
+/*
+ * Helper function to project a block of up to BLOCK_ROWS input vectors. The
+ * accumulators of every row are updated a lane at a time along the padded
+ * output dimension, which the compiler turns into vector instructions.
+ */
+void projectBlock(const SPProjection* projection, const float* input, int rows,
+		double* output) {
+	float sums[BLOCK_ROWS][SP_PROJECTION_MAX_OUTPUT_DIM];
+	const float* weights;
+	float value;
+	int width = projection->width;
+	int i, j, k, lane;
+
+	for (i = 0; i < rows; i++) {
+		memset(sums[i], 0, sizeof(float) * width);
+	}
+	for (j = 0; j < projection->inputDim; j++) {
+		weights = projection->weights + (size_t) j * width;
+		for (i = 0; i < rows; i++) {
+			// centering before multiplying keeps the sums small, and so precise
+			value = input[(size_t) i * projection->inputDim + j] - projection->mean[j];
+			// a constant number of lanes at a time, which vectorizes without a remainder
+			for (k = 0; k < width; k += LANES) {
+				for (lane = 0; lane < LANES; lane++) {
+					sums[i][k + lane] += value * weights[k + lane];
+				}
+			}
+		}
+	}
+	for (i = 0; i < rows; i++) {
+		for (k = 0; k < projection->outputDim; k++) {
+			output[(size_t) i * projection->outputDim + k] = sums[i][k];
+		}
+	}
+}
+
+SPProjection* spProjectionCreate(const float* eigenvectors, const float* mean,
+		int inputDim, int outputDim) {
+	SPProjection* projection;
+	int j, k;
+
+	if (eigenvectors == NULL || mean == NULL || inputDim < 1 || outputDim < 1
+			|| outputDim > SP_PROJECTION_MAX_OUTPUT_DIM) {
+		return NULL;
+	}
+	projection = (SPProjection*) malloc(sizeof(SPProjection));
+	if (projection == NULL) {
+		return NULL;
+	}
+	projection->inputDim = inputDim;
+	projection->outputDim = outputDim;
+	projection->width = (outputDim + LANES - 1) / LANES * LANES;
+	projection->weights = (float*) calloc((size_t) inputDim * projection->width,
+			sizeof(float));
+	projection->mean = (float*) malloc(sizeof(float) * inputDim);
+	if (projection->weights == NULL || projection->mean == NULL) {
+		spProjectionDestroy(projection);
+		return NULL;
+	}
+
+	memcpy(projection->mean, mean, sizeof(float) * inputDim);
+	for (k = 0; k < outputDim; k++) {
+		for (j = 0; j < inputDim; j++) {
+			projection->weights[(size_t) j * projection->width + k] =
+					eigenvectors[(size_t) k * inputDim + j];
+		}
+	}
+	return projection;
+}
+
+void spProjectionDestroy(SPProjection* projection) {
+	if (projection != NULL) {
+		free(projection->weights);
+		free(projection->mean);
+		free(projection);
+	}
+}
+
+void spProjectionApply(const SPProjection* projection, const float* input,
+		int count, double* output) {
+	int i;
+
+	for (i = 0; i < count; i += BLOCK_ROWS) {
+		projectBlock(projection, input + (size_t) i * projection->inputDim,
+				count - i < BLOCK_ROWS ? count - i : BLOCK_ROWS,
+				output + (size_t) i * projection->outputDim);
+	}
+}
+
+int spProjectionGetInputDim(const SPProjection* projection) {
+	return projection->inputDim;
+}
+
+int spProjectionGetOutputDim(const SPProjection* projection) {
+	return projection->outputDim;
+}
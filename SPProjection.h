@@ -0,0 +1,70 @@
+/*
+ * SPProjection.h
+ */
+
+#ifndef SPPROJECTION_H_
+#define SPPROJECTION_H_
+
+/*
+ * A linear projection of vectors on a lower dimension, such as the projection
+ * of the SIFT descriptors on their principal components: every output vector
+ * is the input vector minus the mean, multiplied by the eigenvectors.
+ *
+ * A batch of centered input vectors is multiplied by the transposed
+ * eigenvectors in blocks of rows, with the output dimension padded so the
+ * innermost loop vectorizes. The results are written as doubles, the precision
+ * of the points of the index. A projection may be applied by several threads
+ * at once.
+ */
+struct SPProjection;
+typedef struct SPProjection SPProjection;
+
+/** the highest output dimension of a projection **/
+#define SP_PROJECTION_MAX_OUTPUT_DIM 32
+
+/*
+ * @param eigenvectors - outputDim rows of inputDim coordinates, row after row
+ * @param mean - the inputDim coordinates of the mean
+ * @param inputDim - the dimension of the input vectors
+ * @param outputDim - the dimension of the output vectors, between 1 and
+ * 		  SP_PROJECTION_MAX_OUTPUT_DIM
+ *
+ * @return NULL on invalid argument or allocation failure
+ * @return a new projection otherwise, which copies the arguments
+ */
+SPProjection* spProjectionCreate(const float* eigenvectors, const float* mean,
+		int inputDim, int outputDim);
+
+/*
+ * @param projection - a projection, may be NULL
+ *
+ * The function releases the projection
+ *
+ */
+void spProjectionDestroy(SPProjection* projection);
+
+/*
+ * @param projection - a projection
+ * @param input - count vectors of the input dimension, row after row
+ * @param count - the number of vectors
+ * @param output - the output, count vectors of the output dimension, row after row
+ *
+ */
+void spProjectionApply(const SPProjection* projection, const float* input,
+		int count, double* output);
+
+/*
+ * @param projection - a projection
+ *
+ * @return the dimension of the input vectors
+ */
+int spProjectionGetInputDim(const SPProjection* projection);
+
+/*
+ * @param projection - a projection
+ *
+ * @return the dimension of the output vectors
+ */
+int spProjectionGetOutputDim(const SPProjection* projection);
+
+#endif /* SPPROJECTION_H_ */
@@ -0,0 +1,989 @@
+/*
+ * SPShardedIndex.c
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <pthread.h>
+#include "SPShardedIndex.h"
+#include "SPMemory.h"
+#include "SPLogger.h"
+#include "SPKDArray.h"
+#include "SPKDTree.h"
+#include "SPArena.h"
+#include "SPNuma.h"
+
+/*
+ * A shard: the features added to it until it is built, and its tree afterwards
+ */
+typedef struct sp_shard_t {
+	SPPoint* points;
+	int count;
+	int capacity;
+	SPKDTreeNode* tree;
+	SPKDTreeNode** replicas; // when replicated, a copy of the tree per NUMA node instead
+} Shard;
+
+/*
+ * A thread of the pool of an index, running the tasks of the shards, with the
+ * search contexts it keeps from a search to the next
+ */
+typedef struct sp_shard_worker_t {
+	SPShardedIndex* index;
+	pthread_t thread;
+	SPKDTreeSearchContext* contexts[SP_SHARDED_INDEX_MAX_GROUP_SIZE];
+} ShardWorker;
+
+struct SPShardedIndex {
+	int shardsCount;
+	int imagesCount;
+	int dim;
+	int* shardOfImage;
+	int* featuresOfImage;
+	Shard* shards;
+	bool built;
+	int searchGroupSize;
+	bool replicate;
+	int replicasCount; // the NUMA nodes the trees are replicated on, 0 if they aren't
+	double* block; // the coordinates of the features when adopted, NULL otherwise
+	SPPoint** views; // the points over the block of every image, until built
+	size_t blockBytes; // the bytes of the block, charged to the points
+	ShardWorker** workers; // the pool, kept from the creation to the destruction
+	int workersCount;
+	ShardWorker caller; // the contexts of the thread building or searching
+	bool poolReady; // the locks and the conditions below were initialized
+	pthread_mutex_t batchLock; // held while building or searching
+	pthread_mutex_t poolLock; // guards the batch and stopping
+	pthread_cond_t poolWork; // signalled when tasks are posted or the pool stops
+	pthread_cond_t poolDone; // signalled when the last task of the batch is done
+	void* (*work)(void*, ShardWorker*);
+	char* tasks;
+	size_t taskSize;
+	int tasksCount;
+	int nextTask; // the next task a thread takes
+	int pendingTasks; // the tasks not done yet
+	bool stopping;
+};
+
+/*
+ * The work of a single shard while building
+ */
+typedef struct sp_build_task_t {
+	Shard* shard;
+	int dim;
+	SplitMethod splitMethod;
+	BuildMethod buildMethod;
+	TreeLayout layout;
+	bool borrowed; // the points are views of an adopted block, the tree borrows it
+	bool failed;
+} BuildTask;
+
+/*
+ * The copy of the tree of a shard to a NUMA node
+ */
+typedef struct sp_replicate_task_t {
+	SPKDTreeNode* tree;
+	int dim;
+	TreeLayout layout;
+	int node;
+	SPKDTreeNode** replica;
+	bool failed;
+} ReplicateTask;
+
+/*
+ * The work of a single shard while searching
+ */
+typedef struct sp_search_task_t {
+	SPKDTreeNode* tree;
+	int node; // the NUMA node to run on, SP_NUMA_ANY_NODE for any
+	SPPoint* queries;
+	int queriesCount;
+	int neighborsCount;
+	int groupSize;
+	int* resultsCounts; // the number of results of every query
+	int* indices; // neighborsCount results per query, nearest first
+	double* distances;
+	bool failed;
+} SearchTask;
+
+/*
+ * Helper function to get search contexts for count queries from a worker,
+ * creating the ones it lacks and growing the ones it has only if needed.
+ * Returns false on allocation failure.
+ */
+bool reserveWorkerContexts(ShardWorker* worker, int count, int neighborsCount) {
+	int g;
+
+	for (g = 0; g < count; g++) {
+		if (worker->contexts[g] == NULL) {
+			worker->contexts[g] = spKDTreeSearchContextCreate(neighborsCount);
+			if (worker->contexts[g] == NULL) {
+				return false;
+			}
+		} else if (!spKDTreeSearchContextReserve(worker->contexts[g],
+				neighborsCount)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/*
+ * Helper function to destroy the search contexts of a worker
+ */
+void destroyWorkerContexts(ShardWorker* worker) {
+	int g;
+
+	for (g = 0; g < SP_SHARDED_INDEX_MAX_GROUP_SIZE; g++) {
+		spKDTreeSearchContextDestroy(worker->contexts[g]);
+		worker->contexts[g] = NULL;
+	}
+}
+
+/*
+ * Helper function to run the tasks of the batch on a worker until none is left
+ * to take, called with the pool lock held, which is held again on return
+ */
+void runPoolTasks(SPShardedIndex* index, ShardWorker* worker) {
+	int task;
+
+	while (index->nextTask < index->tasksCount) {
+		task = index->nextTask++;
+		pthread_mutex_unlock(&index->poolLock);
+		index->work(index->tasks + task * index->taskSize, worker);
+		pthread_mutex_lock(&index->poolLock);
+		if (--index->pendingTasks == 0) {
+			pthread_cond_signal(&index->poolDone);
+		}
+	}
+}
+
+/*
+ * The loop of a thread of the pool, which waits for tasks until the pool stops
+ */
+void* runShardWorker(void* arg) {
+	ShardWorker* worker = (ShardWorker*) arg;
+	SPShardedIndex* index = worker->index;
+
+	pthread_mutex_lock(&index->poolLock);
+	while (!index->stopping) {
+		if (index->nextTask < index->tasksCount) {
+			runPoolTasks(index, worker);
+		} else {
+			pthread_cond_wait(&index->poolWork, &index->poolLock);
+		}
+	}
+	pthread_mutex_unlock(&index->poolLock);
+	return NULL;
+}
+
+/*
+ * Helper function to grow the pool to the given number of threads. A pool
+ * which can't grow is kept as it is, its threads running more of the tasks.
+ */
+void growShardWorkers(SPShardedIndex* index, int workersCount) {
+	ShardWorker** workers;
+	ShardWorker* worker;
+
+	if (workersCount <= index->workersCount) {
+		return;
+	}
+	workers = (ShardWorker**) realloc(index->workers,
+			sizeof(ShardWorker*) * workersCount);
+	if (workers == NULL) {
+		return;
+	}
+	index->workers = workers;
+	while (index->workersCount < workersCount) {
+		worker = (ShardWorker*) calloc(1, sizeof(ShardWorker));
+		if (worker == NULL) {
+			return;
+		}
+		worker->index = index;
+		if (pthread_create(&worker->thread, NULL, runShardWorker, worker) != 0) {
+			free(worker);
+			return;
+		}
+		index->workers[index->workersCount++] = worker;
+	}
+}
+
+/*
+ * Helper function to stop the threads of the pool and release it
+ */
+void destroyShardWorkers(SPShardedIndex* index) {
+	int i;
+
+	if (!index->poolReady) {
+		return;
+	}
+	pthread_mutex_lock(&index->poolLock);
+	index->stopping = true;
+	pthread_cond_broadcast(&index->poolWork);
+	pthread_mutex_unlock(&index->poolLock);
+	for (i = 0; i < index->workersCount; i++) {
+		pthread_join(index->workers[i]->thread, NULL);
+		destroyWorkerContexts(index->workers[i]);
+		free(index->workers[i]);
+	}
+	free(index->workers);
+	destroyWorkerContexts(&index->caller);
+	pthread_cond_destroy(&index->poolDone);
+	pthread_cond_destroy(&index->poolWork);
+	pthread_mutex_destroy(&index->poolLock);
+	pthread_mutex_destroy(&index->batchLock);
+}
+
+/*
+ * Helper function to run tasks in parallel on the pool of the index, which
+ * grows to a thread per task but one. The calling thread runs tasks as well,
+ * as the caller worker, and returns once all of them are done. Called with the
+ * batch lock held, so batches of concurrent callers run one after the other.
+ */
+void runTasks(SPShardedIndex* index, void* (*work)(void*, ShardWorker*),
+		void* tasks, size_t taskSize, int count) {
+	growShardWorkers(index, count - 1);
+	pthread_mutex_lock(&index->poolLock);
+	index->work = work;
+	index->tasks = (char*) tasks;
+	index->taskSize = taskSize;
+	index->tasksCount = count;
+	index->nextTask = 0;
+	index->pendingTasks = count;
+	pthread_cond_broadcast(&index->poolWork);
+	runPoolTasks(index, &index->caller);
+	while (index->pendingTasks > 0) {
+		pthread_cond_wait(&index->poolDone, &index->poolLock);
+	}
+	index->tasksCount = 0;
+	index->nextTask = 0;
+	pthread_mutex_unlock(&index->poolLock);
+}
+
+/*
+ * Helper function to initialize the pool of the index, with a thread per
+ * shard but one, the calling thread running a shard as well
+ */
+bool initShardWorkers(SPShardedIndex* index) {
+	if (pthread_mutex_init(&index->batchLock, NULL) != 0) {
+		return false;
+	}
+	if (pthread_mutex_init(&index->poolLock, NULL) != 0) {
+		pthread_mutex_destroy(&index->batchLock);
+		return false;
+	}
+	if (pthread_cond_init(&index->poolWork, NULL) != 0) {
+		pthread_mutex_destroy(&index->poolLock);
+		pthread_mutex_destroy(&index->batchLock);
+		return false;
+	}
+	if (pthread_cond_init(&index->poolDone, NULL) != 0) {
+		pthread_cond_destroy(&index->poolWork);
+		pthread_mutex_destroy(&index->poolLock);
+		pthread_mutex_destroy(&index->batchLock);
+		return false;
+	}
+	index->poolReady = true;
+	index->caller.index = index;
+	growShardWorkers(index, index->shardsCount - 1);
+	return true;
+}
+
+/*
+ * Builds the tree of a shard, its points are released once every shard is built
+ */
+void* buildShard(void* arg, ShardWorker* worker) {
+	BuildTask* task = (BuildTask*) arg;
+	Shard* shard = task->shard;
+	SPKDArray* kdArr;
+
+	(void) worker;
+	if (shard->count == 0) {
+		return NULL;
+	}
+	if (task->borrowed) {
+		kdArr = (task->buildMethod == SELECTION) ?
+				spKDArrayInitSelectionBorrowed(shard->points, shard->count, task->dim) :
+				spKDArrayInitBorrowed(shard->points, shard->count, task->dim);
+	} else if (task->buildMethod == SELECTION) {
+		kdArr = spKDArrayInitSelection(shard->points, shard->count, task->dim);
+	} else {
+		kdArr = spKDArrayInit(shard->points, shard->count, task->dim);
+	}
+	if (kdArr == NULL) {
+		task->failed = true;
+		return NULL;
+	}
+	if (task->borrowed) {
+		shard->tree = spKDTreeInitBorrowed(kdArr, task->splitMethod, task->layout);
+	} else {
+		shard->tree = spKDTreeInitWithLayout(kdArr, task->splitMethod, task->layout);
+	}
+	spKDArrayDestroy(kdArr);
+	task->failed = (shard->tree == NULL);
+	return NULL;
+}
+
+/*
+ * Copies the tree of a shard on a thread pinned to a NUMA node, so the copy is
+ * placed on the node
+ */
+void* replicateShard(void* arg, ShardWorker* worker) {
+	ReplicateTask* task = (ReplicateTask*) arg;
+
+	(void) worker;
+	// an empty shard has no tree, and no replicas either
+	if (task->tree == NULL) {
+		return NULL;
+	}
+	spNumaRunOnNode(task->node);
+	*task->replica = spKDTreeCopy(task->tree, task->dim, task->layout);
+	task->failed = (*task->replica == NULL);
+	spNumaRunOnNode(SP_NUMA_ANY_NODE);
+	return NULL;
+}
+
+/*
+ * Helper function to replace the tree of every shard by a copy on every NUMA
+ * node. Returns false on allocation failure, in which case the trees are kept
+ * as they are.
+ */
+bool replicateTrees(SPShardedIndex* index, TreeLayout layout) {
+	int nodesCount = spNumaGetNodesCount();
+	int tasksCount = nodesCount * index->shardsCount;
+	ReplicateTask* tasks = (ReplicateTask*) malloc(sizeof(ReplicateTask) * tasksCount);
+	bool failed = (tasks == NULL);
+	Shard* shard;
+	int i, n;
+
+	for (i = 0; i < index->shardsCount && !failed; i++) {
+		index->shards[i].replicas = (SPKDTreeNode**) calloc(nodesCount,
+				sizeof(SPKDTreeNode*));
+		failed = (index->shards[i].replicas == NULL);
+	}
+	for (i = 0; i < tasksCount && !failed; i++) {
+		shard = &index->shards[i % index->shardsCount];
+		n = i / index->shardsCount;
+		tasks[i].tree = shard->tree;
+		tasks[i].dim = index->dim;
+		tasks[i].layout = layout;
+		tasks[i].node = n;
+		tasks[i].replica = &shard->replicas[n];
+		tasks[i].failed = false;
+	}
+	if (!failed) {
+		runTasks(index, replicateShard, tasks, sizeof(ReplicateTask), tasksCount);
+		for (i = 0; i < tasksCount; i++) {
+			failed = failed || tasks[i].failed;
+		}
+	}
+	free(tasks);
+
+	for (i = 0; i < index->shardsCount; i++) {
+		shard = &index->shards[i];
+		if (failed) {
+			for (n = 0; shard->replicas != NULL && n < nodesCount; n++) {
+				spKDTreeDestroy(shard->replicas[n]);
+			}
+			free(shard->replicas);
+			shard->replicas = NULL;
+		} else {
+			spKDTreeDestroy(shard->tree);
+			shard->tree = NULL;
+		}
+	}
+	if (failed) {
+		SP_LOG_WARNING("the trees couldn't be replicated on %d NUMA nodes, "
+				"they are searched from where they were built", nodesCount);
+	}
+	index->replicasCount = failed ? 0 : nodesCount;
+	return !failed;
+}
+
+/*
+ * Searches the tree of a shard for all the queries, in the contexts of the
+ * worker running the task
+ */
+void* searchShard(void* arg, ShardWorker* worker) {
+	SearchTask* task = (SearchTask*) arg;
+	SPKDTreeSearchContext** contexts = worker->contexts;
+	int i, j, g, count, offset;
+
+	if (task->node != SP_NUMA_ANY_NODE) {
+		spNumaRunOnNode(task->node);
+	}
+
+	// a context per query of a group serves all the groups of the shard
+	task->failed = !reserveWorkerContexts(worker, task->groupSize,
+			task->neighborsCount);
+	for (i = 0; i < task->queriesCount && !task->failed; i += count) {
+		count = task->queriesCount - i;
+		count = (count < task->groupSize) ? count : task->groupSize;
+		for (g = 0; g < count; g++) {
+			spKDTreeSearchContextReset(contexts[g]);
+		}
+		if (count == 1) {
+			task->failed = !spKDTreeSearch(task->tree, task->queries[i], contexts[0],
+					NULL, NULL, NULL);
+		} else {
+			task->failed = !spKDTreeSearchGroup(task->tree, task->queries + i, count,
+					contexts, NULL, NULL, NULL);
+		}
+		for (g = 0; g < count; g++) {
+			task->resultsCounts[i + g] = spKDTreeSearchContextGetResultsCount(
+					contexts[g]);
+			offset = (i + g) * task->neighborsCount;
+			for (j = 0; j < task->resultsCounts[i + g]; j++) {
+				task->indices[offset + j] = spKDTreeSearchContextGetIndex(contexts[g], j);
+				task->distances[offset + j] = spKDTreeSearchContextGetDistance(
+						contexts[g], j);
+			}
+		}
+	}
+	if (task->node != SP_NUMA_ANY_NODE) {
+		spNumaRunOnNode(SP_NUMA_ANY_NODE);
+	}
+	return NULL;
+}
+
+SPShardedIndex* spShardedIndexCreate(int shardsCount, int imagesCount, int dim) {
+	SPShardedIndex* index;
+	int i;
+
+	if (shardsCount < 1 || imagesCount < 0 || dim <= 0) {
+		return NULL;
+	}
+	index = (SPShardedIndex*) calloc(1, sizeof(SPShardedIndex));
+	if (index == NULL) {
+		return NULL;
+	}
+	index->shardsCount = shardsCount;
+	index->imagesCount = imagesCount;
+	index->searchGroupSize = SP_SHARDED_INDEX_DEFAULT_GROUP_SIZE;
+	index->dim = dim;
+	index->shardOfImage = (int*) malloc(sizeof(int) * (imagesCount + 1));
+	index->featuresOfImage = (int*) calloc(imagesCount + 1, sizeof(int));
+	index->shards = (Shard*) calloc(shardsCount, sizeof(Shard));
+	if (index->shardOfImage == NULL || index->featuresOfImage == NULL
+			|| index->shards == NULL || !initShardWorkers(index)) {
+		spShardedIndexDestroy(index);
+		return NULL;
+	}
+	for (i = 0; i < imagesCount; i++) {
+		index->shardOfImage[i] = -1;
+	}
+	return index;
+}
+
+/*
+ * Helper function to release the points over the adopted block
+ */
+void destroyBlockViews(SPShardedIndex* index) {
+	int i;
+
+	for (i = 0; index->views != NULL && i < index->imagesCount; i++) {
+		spPointDestroyArray(index->views[i]);
+	}
+	free(index->views);
+	index->views = NULL;
+}
+
+/*
+ * Helper function to release the adopted block
+ */
+void destroyBlock(SPShardedIndex* index) {
+	spMemoryRelease(SP_MEMORY_POINT, index->blockBytes);
+	spArenaFreeHuge(index->block);
+	index->block = NULL;
+	index->blockBytes = 0;
+}
+
+void spShardedIndexDestroy(SPShardedIndex* index) {
+	int i, j;
+
+	if (index == NULL) {
+		return;
+	}
+	destroyShardWorkers(index);
+	for (i = 0; index->shards != NULL && i < index->shardsCount; i++) {
+		for (j = 0; index->block == NULL && index->shards[i].points != NULL
+				&& j < index->shards[i].count; j++) {
+			spPointDestroy(index->shards[i].points[j]);
+		}
+		free(index->shards[i].points);
+		spKDTreeDestroy(index->shards[i].tree);
+		for (j = 0; index->shards[i].replicas != NULL && j < index->replicasCount;
+				j++) {
+			spKDTreeDestroy(index->shards[i].replicas[j]);
+		}
+		free(index->shards[i].replicas);
+	}
+	free(index->shards);
+	free(index->shardOfImage);
+	free(index->featuresOfImage);
+	destroyBlockViews(index);
+	destroyBlock(index);
+	free(index);
+}
+
+SP_SHARDED_INDEX_MSG spShardedIndexAssign(SPShardedIndex* index, int imageIndex,
+		int shard) {
+	if (index == NULL || imageIndex < 0 || imageIndex >= index->imagesCount
+			|| shard < 0 || shard >= index->shardsCount
+			|| index->featuresOfImage[imageIndex] > 0) {
+		return SP_SHARDED_INDEX_INVALID_ARGUMENT;
+	}
+	if (index->built) {
+		return SP_SHARDED_INDEX_ALREADY_BUILT;
+	}
+	index->shardOfImage[imageIndex] = shard;
+	return SP_SHARDED_INDEX_SUCCESS;
+}
+
+/*
+ * Helper function to get the shard holding the fewest features, counted by
+ * counts if given and by the shards otherwise
+ */
+int getFewestFeaturesShard(Shard* shards, int shardsCount, const long* counts) {
+	int shardIndex = 0, i;
+
+	for (i = 1; i < shardsCount; i++) {
+		if (counts != NULL ? counts[i] < counts[shardIndex] :
+				shards[i].count < shards[shardIndex].count) {
+			shardIndex = i;
+		}
+	}
+	return shardIndex;
+}
+
+SP_SHARDED_INDEX_MSG spShardedIndexAddImage(SPShardedIndex* index, int imageIndex,
+		SPPoint* features, int count) {
+	Shard* shard;
+	SPPoint* points;
+	int shardIndex, capacity, i;
+
+	if (index == NULL || imageIndex < 0 || imageIndex >= index->imagesCount
+			|| count < 0 || (features == NULL && count > 0)) {
+		return SP_SHARDED_INDEX_INVALID_ARGUMENT;
+	}
+	if (index->built) {
+		return SP_SHARDED_INDEX_ALREADY_BUILT;
+	}
+	for (i = 0; i < count; i++) {
+		if (features[i] == NULL || spPointGetDimension(features[i]) != index->dim) {
+			return SP_SHARDED_INDEX_INVALID_ARGUMENT;
+		}
+	}
+	if (index->block != NULL) {
+		return SP_SHARDED_INDEX_INVALID_ARGUMENT;
+	}
+
+	shardIndex = index->shardOfImage[imageIndex];
+	if (shardIndex == -1) {
+		shardIndex = getFewestFeaturesShard(index->shards, index->shardsCount, NULL);
+	}
+	shard = &index->shards[shardIndex];
+
+	if (shard->count + count > shard->capacity) {
+		capacity = shard->capacity * 2;
+		if (capacity < shard->count + count) {
+			capacity = shard->count + count;
+		}
+		points = (SPPoint*) realloc(shard->points, sizeof(SPPoint) * capacity);
+		if (points == NULL) {
+			return SP_SHARDED_INDEX_OUT_OF_MEMORY;
+		}
+		shard->points = points;
+		shard->capacity = capacity;
+	}
+	for (i = 0; i < count; i++) {
+		shard->points[shard->count++] = features[i];
+	}
+	index->shardOfImage[imageIndex] = shardIndex;
+	index->featuresOfImage[imageIndex] += count;
+	return SP_SHARDED_INDEX_SUCCESS;
+}
+
+/*
+ * Helper function to release what the adoption of a block allocated before it
+ * failed, the block remaining the caller's
+ */
+SP_SHARDED_INDEX_MSG failAdoption(SPShardedIndex* index, int* placement,
+		long* shardCounts, SPPoint** shardPoints) {
+	int i;
+
+	for (i = 0; shardPoints != NULL && i < index->shardsCount; i++) {
+		free(shardPoints[i]);
+	}
+	free(shardPoints);
+	free(placement);
+	free(shardCounts);
+	destroyBlockViews(index);
+	return SP_SHARDED_INDEX_OUT_OF_MEMORY;
+}
+
+SP_SHARDED_INDEX_MSG spShardedIndexAdoptFeatures(SPShardedIndex* index,
+		double* coordinates, const int* counts) {
+	int* placement;
+	long* shardCounts;
+	SPPoint** shardPoints;
+	Shard* shard;
+	long offset = 0;
+	int i, j;
+
+	if (index == NULL || coordinates == NULL || counts == NULL
+			|| index->block != NULL) {
+		return SP_SHARDED_INDEX_INVALID_ARGUMENT;
+	}
+	for (i = 0; i < index->imagesCount; i++) {
+		if (counts[i] < 0 || index->featuresOfImage[i] > 0) {
+			return SP_SHARDED_INDEX_INVALID_ARGUMENT;
+		}
+	}
+	if (index->built) {
+		return SP_SHARDED_INDEX_ALREADY_BUILT;
+	}
+
+	// the images are placed as spShardedIndexAddImage places them one by one,
+	// and everything is allocated before the index changes
+	placement = (int*) malloc(sizeof(int) * (index->imagesCount + 1));
+	shardCounts = (long*) calloc(index->shardsCount, sizeof(long));
+	shardPoints = (SPPoint**) calloc(index->shardsCount, sizeof(SPPoint*));
+	index->views = (SPPoint**) calloc(index->imagesCount + 1, sizeof(SPPoint*));
+	if (placement == NULL || shardCounts == NULL || shardPoints == NULL
+			|| index->views == NULL) {
+		return failAdoption(index, placement, shardCounts, shardPoints);
+	}
+	for (i = 0; i < index->imagesCount; i++) {
+		placement[i] = index->shardOfImage[i];
+		if (placement[i] == -1) {
+			placement[i] = getFewestFeaturesShard(index->shards, index->shardsCount,
+					shardCounts);
+		}
+		shardCounts[placement[i]] += counts[i];
+		if (counts[i] > 0) {
+			index->views[i] = spPointCreateArray(coordinates + offset * index->dim,
+					counts[i], index->dim, i);
+			if (index->views[i] == NULL) {
+				return failAdoption(index, placement, shardCounts, shardPoints);
+			}
+		}
+		offset += counts[i];
+	}
+	for (i = 0; i < index->shardsCount; i++) {
+		if (shardCounts[i] > INT_MAX) {
+			failAdoption(index, placement, shardCounts, shardPoints);
+			return SP_SHARDED_INDEX_INVALID_ARGUMENT;
+		}
+		shardPoints[i] = (SPPoint*) malloc(sizeof(SPPoint) * (shardCounts[i] + 1));
+		if (shardPoints[i] == NULL) {
+			return failAdoption(index, placement, shardCounts, shardPoints);
+		}
+	}
+
+	for (i = 0; i < index->shardsCount; i++) {
+		index->shards[i].points = shardPoints[i];
+		index->shards[i].capacity = (int) shardCounts[i];
+		index->shards[i].count = 0;
+	}
+	for (i = 0; i < index->imagesCount; i++) {
+		shard = &index->shards[placement[i]];
+		for (j = 0; j < counts[i]; j++) {
+			shard->points[shard->count++] = index->views[i][j];
+		}
+		index->shardOfImage[i] = placement[i];
+		index->featuresOfImage[i] = counts[i];
+	}
+	index->block = coordinates;
+	index->blockBytes = sizeof(double) * index->dim * (size_t) offset;
+	spMemoryCharge(SP_MEMORY_POINT, index->blockBytes);
+	free(placement);
+	free(shardCounts);
+	free(shardPoints);
+	return SP_SHARDED_INDEX_SUCCESS;
+}
+
+/*
+ * Helper function to release the trees of the shards after a failed build, the
+ * shards keep their points so the build can be retried
+ */
+void destroyShardTrees(SPShardedIndex* index) {
+	int i;
+
+	for (i = 0; i < index->shardsCount; i++) {
+		spKDTreeDestroy(index->shards[i].tree);
+		index->shards[i].tree = NULL;
+	}
+}
+
+/*
+ * Helper function to release the points of the shards once all the trees are
+ * built, the trees hold copies of them, or point into the block
+ */
+void destroyShardPoints(SPShardedIndex* index) {
+	Shard* shard;
+	int i, j;
+
+	for (i = 0; i < index->shardsCount; i++) {
+		shard = &index->shards[i];
+		for (j = 0; index->block == NULL && j < shard->count; j++) {
+			spPointDestroy(shard->points[j]);
+		}
+		free(shard->points);
+		shard->points = NULL;
+		shard->capacity = 0;
+	}
+}
+
+/*
+ * Helper function to build the trees of the shards, called with the batch lock held
+ */
+SP_SHARDED_INDEX_MSG buildShards(SPShardedIndex* index, SplitMethod splitMethod,
+		BuildMethod buildMethod, TreeLayout layout) {
+	BuildTask* tasks;
+	bool failed = false;
+	int i;
+
+	if (index->built) {
+		return SP_SHARDED_INDEX_ALREADY_BUILT;
+	}
+	tasks = (BuildTask*) malloc(sizeof(BuildTask) * index->shardsCount);
+	if (tasks == NULL) {
+		return SP_SHARDED_INDEX_OUT_OF_MEMORY;
+	}
+	for (i = 0; i < index->shardsCount; i++) {
+		tasks[i].shard = &index->shards[i];
+		tasks[i].dim = index->dim;
+		tasks[i].splitMethod = splitMethod;
+		tasks[i].buildMethod = buildMethod;
+		tasks[i].layout = layout;
+		tasks[i].borrowed = (index->block != NULL);
+		tasks[i].failed = false;
+	}
+
+	runTasks(index, buildShard, tasks, sizeof(BuildTask), index->shardsCount);
+
+	for (i = 0; i < index->shardsCount; i++) {
+		failed = failed || tasks[i].failed;
+	}
+	free(tasks);
+	if (failed) {
+		destroyShardTrees(index);
+		return SP_SHARDED_INDEX_OUT_OF_MEMORY;
+	}
+
+	// the trees point at the block, the views over it aren't needed anymore
+	destroyShardPoints(index);
+	destroyBlockViews(index);
+
+	// trees which can't be replicated are searched from wherever they are,
+	// replicas hold copies of the coordinates so the block isn't needed by them
+	if (index->replicate && replicateTrees(index, layout)) {
+		destroyBlock(index);
+	}
+	index->built = true;
+	return SP_SHARDED_INDEX_SUCCESS;
+}
+
+SP_SHARDED_INDEX_MSG spShardedIndexBuild(SPShardedIndex* index,
+		SplitMethod splitMethod, BuildMethod buildMethod, TreeLayout layout) {
+	SP_SHARDED_INDEX_MSG msg;
+
+	if (index == NULL) {
+		return SP_SHARDED_INDEX_INVALID_ARGUMENT;
+	}
+	pthread_mutex_lock(&index->batchLock);
+	msg = buildShards(index, splitMethod, buildMethod, layout);
+	pthread_mutex_unlock(&index->batchLock);
+	return msg;
+}
+
+/*
+ * Helper function to search the shards for the queries and merge their results,
+ * called with the batch lock held, so the contexts of the caller are its own
+ */
+SP_SHARDED_INDEX_MSG searchShards(SPShardedIndex* index, SPPoint* queries,
+		int queriesCount, int neighborsCount, SPBPQueue* results) {
+	SearchTask* tasks;
+	SPKDTreeSearchContext* context;
+	size_t resultsCount, offset;
+	int* resultsCounts;
+	int* indices;
+	double* distances;
+	bool failed = false;
+	int i, j, r, n, start, tasksCount, nodesCount;
+
+	if (!index->built) {
+		return SP_SHARDED_INDEX_NOT_BUILT;
+	}
+
+	// with replicas, the queries are split between the nodes, each searching its own
+	nodesCount = (index->replicasCount > 0) ? index->replicasCount : 1;
+	tasksCount = nodesCount * index->shardsCount;
+	resultsCount = (size_t) index->shardsCount * queriesCount;
+	tasks = (SearchTask*) malloc(sizeof(SearchTask) * tasksCount);
+	resultsCounts = (int*) calloc(resultsCount + 1, sizeof(int));
+	indices = (int*) malloc(sizeof(int) * (resultsCount * neighborsCount + 1));
+	distances = (double*) malloc(sizeof(double) * (resultsCount * neighborsCount + 1));
+	if (tasks == NULL || resultsCounts == NULL || indices == NULL
+			|| distances == NULL) {
+		free(tasks);
+		free(resultsCounts);
+		free(indices);
+		free(distances);
+		return SP_SHARDED_INDEX_OUT_OF_MEMORY;
+	}
+	for (i = 0; i < tasksCount; i++) {
+		j = i % index->shardsCount;
+		n = i / index->shardsCount;
+		start = (int) ((long) queriesCount * n / nodesCount);
+		offset = (size_t) j * queriesCount + start;
+		if (index->replicasCount > 0) {
+			tasks[i].tree = index->shards[j].replicas[n];
+			tasks[i].node = n;
+		} else {
+			tasks[i].tree = index->shards[j].tree;
+			tasks[i].node = SP_NUMA_ANY_NODE;
+		}
+		tasks[i].queries = queries + start;
+		tasks[i].queriesCount = (int) ((long) queriesCount * (n + 1) / nodesCount)
+				- start;
+		tasks[i].neighborsCount = neighborsCount;
+		tasks[i].groupSize = index->searchGroupSize;
+		tasks[i].resultsCounts = resultsCounts + offset;
+		tasks[i].indices = indices + offset * neighborsCount;
+		tasks[i].distances = distances + offset * neighborsCount;
+		tasks[i].failed = false;
+	}
+
+	runTasks(index, searchShard, tasks, sizeof(SearchTask), tasksCount);
+
+	for (i = 0; i < tasksCount; i++) {
+		failed = failed || tasks[i].failed;
+	}
+
+	// merging the bounded results of the shards keeps the global nearest neighbors,
+	// in a context of the caller, which is done with its tasks
+	failed = failed || !reserveWorkerContexts(&index->caller, 1, neighborsCount);
+	context = index->caller.contexts[0];
+	for (i = 0; i < queriesCount; i++) {
+		results[i] = NULL;
+		if (failed) {
+			continue;
+		}
+		spKDTreeSearchContextReset(context);
+		for (j = 0; j < index->shardsCount; j++) {
+			offset = (size_t) j * queriesCount + i;
+			for (r = 0; r < resultsCounts[offset]; r++) {
+				spKDTreeSearchContextOffer(context,
+						indices[offset * neighborsCount + r],
+						distances[offset * neighborsCount + r]);
+			}
+		}
+		results[i] = spBPQueueCreate(neighborsCount);
+		failed = (results[i] == NULL
+				|| !spKDTreeSearchContextCopyResults(context, results[i]));
+	}
+	free(tasks);
+	free(resultsCounts);
+	free(indices);
+	free(distances);
+
+	if (failed) {
+		for (i = 0; i < queriesCount; i++) {
+			if (results[i] != NULL) {
+				spBPQueueDestroy(results[i]);
+				results[i] = NULL;
+			}
+		}
+		return SP_SHARDED_INDEX_OUT_OF_MEMORY;
+	}
+	return SP_SHARDED_INDEX_SUCCESS;
+}
+
+SP_SHARDED_INDEX_MSG spShardedIndexSearch(SPShardedIndex* index, SPPoint* queries,
+		int queriesCount, int neighborsCount, SPBPQueue* results) {
+	SP_SHARDED_INDEX_MSG msg;
+
+	if (index == NULL || queries == NULL || queriesCount < 0
+			|| neighborsCount <= 0 || results == NULL) {
+		return SP_SHARDED_INDEX_INVALID_ARGUMENT;
+	}
+	pthread_mutex_lock(&index->batchLock);
+	msg = searchShards(index, queries, queriesCount, neighborsCount, results);
+	pthread_mutex_unlock(&index->batchLock);
+	return msg;
+}
+
+SP_SHARDED_INDEX_MSG spShardedIndexSetSearchGroupSize(SPShardedIndex* index,
+		int groupSize) {
+	if (index == NULL || groupSize < 1 || groupSize > SP_SHARDED_INDEX_MAX_GROUP_SIZE) {
+		return SP_SHARDED_INDEX_INVALID_ARGUMENT;
+	}
+	index->searchGroupSize = groupSize;
+	return SP_SHARDED_INDEX_SUCCESS;
+}
+
+SP_SHARDED_INDEX_MSG spShardedIndexSetNumaReplication(SPShardedIndex* index,
+		bool replicate) {
+	if (index == NULL) {
+		return SP_SHARDED_INDEX_INVALID_ARGUMENT;
+	}
+	if (index->built) {
+		return SP_SHARDED_INDEX_ALREADY_BUILT;
+	}
+	index->replicate = replicate;
+	return SP_SHARDED_INDEX_SUCCESS;
+}
+
+int spShardedIndexGetReplicasCount(SPShardedIndex* index) {
+	if (index == NULL) {
+		return -1;
+	}
+	return index->replicasCount;
+}
+
+int spShardedIndexGetShardsCount(SPShardedIndex* index) {
+	if (index == NULL) {
+		return -1;
+	}
+	return index->shardsCount;
+}
+
+int spShardedIndexGetImagesCount(SPShardedIndex* index) {
+	if (index == NULL) {
+		return -1;
+	}
+	return index->imagesCount;
+}
+
+int spShardedIndexGetShard(SPShardedIndex* index, int imageIndex) {
+	if (index == NULL || imageIndex < 0 || imageIndex >= index->imagesCount) {
+		return -1;
+	}
+	return index->shardOfImage[imageIndex];
+}
+
+int spShardedIndexGetImageFeaturesCount(SPShardedIndex* index, int imageIndex) {
+	if (index == NULL || imageIndex < 0 || imageIndex >= index->imagesCount) {
+		return -1;
+	}
+	return index->featuresOfImage[imageIndex];
+}
+
+int spShardedIndexGetShardFeaturesCount(SPShardedIndex* index, int shard) {
+	int count = 0, i;
+
+	if (index == NULL || shard < 0 || shard >= index->shardsCount) {
+		return -1;
+	}
+	for (i = 0; i < index->imagesCount; i++) {
+		if (index->shardOfImage[i] == shard) {
+			count += index->featuresOfImage[i];
+		}
+	}
+	return count;
+}
@@ -0,0 +1,241 @@
+/*
+ * SPShardedIndex.h
+ */
+
+#ifndef SPSHARDEDINDEX_H_
+#define SPSHARDEDINDEX_H_
+
+#include <stdbool.h>
+#include "SPPoint.h"
+#include "SPBPriorityQueue.h"
+#include "SPConfigUtils.h"
+
+/*
+ * An index which partitions the images into shards, each with its own kd-tree.
+ *
+ * Every image belongs to exactly one shard. Images may be placed in a shard
+ * explicitly, e.g. when restoring a persisted assignment, otherwise they are
+ * placed in the shard holding the fewest features. The shard trees are built
+ * and searched in parallel, one thread per shard, and the per-shard results of
+ * every query are merged into a single bounded queue, which holds the global
+ * nearest neighbors.
+ *
+ * The threads are a pool the index starts when created and stops when
+ * destroyed, so a search doesn't start any. The calling thread searches a
+ * shard as well, and the searches of threads sharing an index run one after
+ * the other. Every thread keeps its search contexts from a search to the
+ * next, growing them only for more neighbors than they were used for.
+ */
+struct SPShardedIndex;
+typedef struct SPShardedIndex SPShardedIndex;
+
+/** type used for error reporting **/
+typedef enum sp_sharded_index_msg_t {
+	SP_SHARDED_INDEX_SUCCESS,
+	SP_SHARDED_INDEX_INVALID_ARGUMENT,
+	SP_SHARDED_INDEX_OUT_OF_MEMORY,
+	SP_SHARDED_INDEX_ALREADY_BUILT,
+	SP_SHARDED_INDEX_NOT_BUILT
+} SP_SHARDED_INDEX_MSG;
+
+/** the number of queries a shard searches at once unless set otherwise **/
+#define SP_SHARDED_INDEX_DEFAULT_GROUP_SIZE 8
+
+/** the most queries a shard may search at once **/
+#define SP_SHARDED_INDEX_MAX_GROUP_SIZE 16
+
+/*
+ * @param shardsCount - the number of shards, at least 1
+ * @param imagesCount - the number of images, images are indexed 0..imagesCount-1
+ * @param dim - the dimension of the features
+ *
+ * @return NULL on invalid argument or allocation failure
+ * @return a new index, with no image assigned to any shard
+ */
+SPShardedIndex* spShardedIndexCreate(int shardsCount, int imagesCount, int dim);
+
+/*
+ * @param index - a sharded index
+ *
+ * The function destroys the index with all its trees and features
+ *
+ */
+void spShardedIndexDestroy(SPShardedIndex* index);
+
+/*
+ * @param index - a sharded index
+ * @param imageIndex - the index of an image which has no features in the index yet
+ * @param shard - the shard to place the image in
+ *
+ * The function places an image in a shard, before its features are added
+ *
+ * @return SP_SHARDED_INDEX_INVALID_ARGUMENT if any argument is out of range, or
+ * 		   if features of the image were already added
+ * @return SP_SHARDED_INDEX_ALREADY_BUILT if the trees were already built
+ * @return SP_SHARDED_INDEX_SUCCESS otherwise
+ */
+SP_SHARDED_INDEX_MSG spShardedIndexAssign(SPShardedIndex* index, int imageIndex,
+		int shard);
+
+/*
+ * @param index - a sharded index
+ * @param imageIndex - the index of the image the features belong to
+ * @param features - the features of the image
+ * @param count - the number of features
+ *
+ * The function adds the features of an image to its shard, placing the image
+ * in the shard holding the fewest features if it wasn't placed yet. The index
+ * takes ownership of the points, the array itself remains the caller's.
+ *
+ * @return SP_SHARDED_INDEX_INVALID_ARGUMENT if any argument is invalid, if
+ * 		   the dimension of any of the features doesn't match, or if features
+ * 		   were adopted
+ * @return SP_SHARDED_INDEX_ALREADY_BUILT if the trees were already built
+ * @return SP_SHARDED_INDEX_OUT_OF_MEMORY on allocation failure, the points
+ * 		   remain the caller's
+ * @return SP_SHARDED_INDEX_SUCCESS otherwise
+ */
+SP_SHARDED_INDEX_MSG spShardedIndexAddImage(SPShardedIndex* index, int imageIndex,
+		SPPoint* features, int count);
+
+/*
+ * @param index - a sharded index to which no features were added yet
+ * @param coordinates - the features of all the images, image after image and
+ * 		  feature after feature, e.g. the block of SPFeaturesLoader.h
+ * @param counts - the number of features of every image
+ *
+ * The function adds the features of all the images at once, placing them as
+ * spShardedIndexAddImage would one image after the other. The block is
+ * allocated by spArenaAllocHuge, as the loaded features hand it over. The index takes
+ * ownership of the block instead of copying it: the features are views of the
+ * block, see spPointCreateArray, and the leaves of the trees point into it,
+ * see spKDTreeInitBorrowed, so the index holds a single copy of the features.
+ * The block is released with the index, or once the trees are replicated.
+ * spShardedIndexAddImage can't be used afterwards.
+ *
+ * @return SP_SHARDED_INDEX_INVALID_ARGUMENT if any argument is NULL, a count is
+ * 		   negative, or features were already added
+ * @return SP_SHARDED_INDEX_ALREADY_BUILT if the trees were already built
+ * @return SP_SHARDED_INDEX_OUT_OF_MEMORY on allocation failure, the block
+ * 		   remains the caller's
+ * @return SP_SHARDED_INDEX_SUCCESS otherwise
+ */
+SP_SHARDED_INDEX_MSG spShardedIndexAdoptFeatures(SPShardedIndex* index,
+		double* coordinates, const int* counts);
+
+/*
+ * @param index - a sharded index
+ * @param splitMethod - the method by which the shard trees are split
+ * @param buildMethod - the way the kd-arrays of the shards are ordered
+ * @param layout - the order in which the nodes of the shard trees are stored
+ *
+ * The function builds the trees of all the shards in parallel, and releases the
+ * added features once all of them are copied into the trees. The trees of
+ * adopted features point into their block instead.
+ *
+ * @return SP_SHARDED_INDEX_INVALID_ARGUMENT if index is NULL
+ * @return SP_SHARDED_INDEX_ALREADY_BUILT if the trees were already built
+ * @return SP_SHARDED_INDEX_OUT_OF_MEMORY on allocation failure, the added
+ * 		   features are kept, and the build may be retried
+ * @return SP_SHARDED_INDEX_SUCCESS otherwise
+ */
+SP_SHARDED_INDEX_MSG spShardedIndexBuild(SPShardedIndex* index,
+		SplitMethod splitMethod, BuildMethod buildMethod, TreeLayout layout);
+
+/*
+ * @param index - a sharded index which was built
+ * @param queries - the points for which to search neighbors
+ * @param queriesCount - the number of queries
+ * @param neighborsCount - the number of neighbors to search for
+ * @param results - an output array of queriesCount queues, the i-th queue holds
+ * 		  the nearest points to the i-th query across all shards, represented by
+ * 		  index and distance. The caller destroys the queues.
+ *
+ * The function searches all the shards in parallel, each for all the queries
+ *
+ * @return SP_SHARDED_INDEX_INVALID_ARGUMENT if any argument is invalid
+ * @return SP_SHARDED_INDEX_NOT_BUILT if the trees weren't built yet
+ * @return SP_SHARDED_INDEX_OUT_OF_MEMORY on allocation failure, no queue is returned
+ * @return SP_SHARDED_INDEX_SUCCESS otherwise
+ */
+SP_SHARDED_INDEX_MSG spShardedIndexSearch(SPShardedIndex* index, SPPoint* queries,
+		int queriesCount, int neighborsCount, SPBPQueue* results);
+
+/*
+ * @param index - a sharded index
+ * @param groupSize - the number of queries every shard searches at once, between
+ * 		  1 and SP_SHARDED_INDEX_MAX_GROUP_SIZE
+ *
+ * The searches of a group are interleaved, see spKDTreeSearchGroup, a group of 1
+ * searches the queries one at a time. The results are the same for every size.
+ *
+ * @return SP_SHARDED_INDEX_INVALID_ARGUMENT if index is NULL or groupSize is out
+ * 		   of range
+ * @return SP_SHARDED_INDEX_SUCCESS otherwise
+ */
+SP_SHARDED_INDEX_MSG spShardedIndexSetSearchGroupSize(SPShardedIndex* index,
+		int groupSize);
+
+/*
+ * @param index - a sharded index which wasn't built yet
+ * @param replicate - whether to replicate the trees on every NUMA node
+ *
+ * When replicated, the build copies the tree of every shard to the memory of
+ * every NUMA node, and the queries of a search are split between the nodes, each
+ * searching its local copies, at the cost of a copy of the trees per node.
+ * Without libnuma, see SPNuma.h, there is a single node.
+ *
+ * @return SP_SHARDED_INDEX_INVALID_ARGUMENT if index is NULL
+ * @return SP_SHARDED_INDEX_ALREADY_BUILT if the trees were already built
+ * @return SP_SHARDED_INDEX_SUCCESS otherwise
+ */
+SP_SHARDED_INDEX_MSG spShardedIndexSetNumaReplication(SPShardedIndex* index,
+		bool replicate);
+
+/*
+ * @param index - a sharded index
+ *
+ * @return -1 if index is NULL, otherwise the number of NUMA nodes the trees
+ * are replicated on, 0 if they aren't
+ */
+int spShardedIndexGetReplicasCount(SPShardedIndex* index);
+
+/*
+ * @param index - a sharded index
+ *
+ * @return -1 if index is NULL, the number of shards otherwise
+ */
+int spShardedIndexGetShardsCount(SPShardedIndex* index);
+
+/*
+ * @param index - a sharded index
+ *
+ * @return -1 if index is NULL, the number of images otherwise
+ */
+int spShardedIndexGetImagesCount(SPShardedIndex* index);
+
+/*
+ * @param index - a sharded index
+ * @param imageIndex - the index of an image
+ *
+ * @return the shard of the image, or -1 if it wasn't placed yet or on invalid argument
+ */
+int spShardedIndexGetShard(SPShardedIndex* index, int imageIndex);
+
+/*
+ * @param index - a sharded index
+ * @param imageIndex - the index of an image
+ *
+ * @return the number of features added for the image, or -1 on invalid argument
+ */
+int spShardedIndexGetImageFeaturesCount(SPShardedIndex* index, int imageIndex);
+
+/*
+ * @param index - a sharded index
+ * @param shard - the index of a shard
+ *
+ * @return the number of features in the shard, or -1 on invalid argument
+ */
+int spShardedIndexGetShardFeaturesCount(SPShardedIndex* index, int shard);
+
+#endif /* SPSHARDEDINDEX_H_ */
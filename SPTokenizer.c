@@ -0,0 +1,292 @@
+/*
+ * SPTokenizer.c
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "SPTokenizer.h"
+
+/** the largest mantissa which is exact in a double **/
+#define EXACT_MANTISSA_LIMIT ((uint64_t) 1 << 53)
+
+/** the largest mantissa a digit can be appended to without overflowing **/
+#define MANTISSA_LIMIT ((UINT64_MAX - 9) / 10)
+
+/** the largest power of ten which is exact in a double **/
+#define EXACT_POWER_LIMIT 22
+
+/** beyond this decimal exponent any double is 0 or infinite **/
+#define EXPONENT_LIMIT 10000
+
+/** the powers of ten which are exact in a double **/
+static const double exactPowersOfTen[EXACT_POWER_LIMIT + 1] = { 1e0, 1e1, 1e2,
+		1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+		1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+SP_TOKENIZER_MSG spTokenizerReadFile(const char* path, char** buffer,
+		size_t* capacity, size_t* length) {
+	int file = open(path, O_RDONLY);
+	SP_TOKENIZER_MSG msg;
+
+	if (file == -1) {
+		return SP_TOKENIZER_CANNOT_OPEN_FILE;
+	}
+	msg = spTokenizerReadOpenFile(file, buffer, capacity, length);
+	close(file);
+	return msg;
+}
+
+SP_TOKENIZER_MSG spTokenizerReadOpenFile(int file, char** buffer,
+		size_t* capacity, size_t* length) {
+	struct stat status;
+	size_t bytesTotal = 0, size;
+	ssize_t bytesRead = 0;
+	char* grown;
+
+	if (fstat(file, &status) != 0) {
+		return SP_TOKENIZER_CANNOT_OPEN_FILE;
+	}
+	// a file still growing is read up to the size it had when sized
+	size = (size_t) status.st_size + 1;
+	if (size > *capacity) {
+		grown = (char*) realloc(*buffer, size);
+		if (grown == NULL) {
+			return SP_TOKENIZER_ALLOC_FAIL;
+		}
+		*buffer = grown;
+		*capacity = size;
+	}
+	while (bytesTotal < size - 1 && (bytesRead = pread(file, *buffer + bytesTotal,
+			size - 1 - bytesTotal, (off_t) bytesTotal)) > 0) {
+		bytesTotal += bytesRead;
+	}
+	if (bytesRead < 0) {
+		return SP_TOKENIZER_CANNOT_OPEN_FILE;
+	}
+	(*buffer)[bytesTotal] = '\0';
+	if (length != NULL) {
+		*length = bytesTotal;
+	}
+	return SP_TOKENIZER_SUCCESS;
+}
+
+void spTokenizerInit(SPTokenizer* tokenizer, const char* text) {
+	tokenizer->cursor = text;
+	tokenizer->lineStart = text;
+	tokenizer->line = 1;
+}
+
+bool spTokenizerAtEnd(const SPTokenizer* tokenizer) {
+	return *tokenizer->cursor == '\0';
+}
+
+/*
+ * Helper function to skip the whitespace on the line of the cursor
+ */
+void skipTokenizerBlanks(SPTokenizer* tokenizer) {
+	const char* cursor = tokenizer->cursor;
+	while (*cursor == ' ' || *cursor == '\t' || *cursor == '\r') {
+		cursor++;
+	}
+	tokenizer->cursor = cursor;
+}
+
+/*
+ * Helper function to skip any whitespace, counting the lines which end
+ */
+void skipTokenizerSpaces(SPTokenizer* tokenizer) {
+	const char* cursor = tokenizer->cursor;
+	for (;; cursor++) {
+		if (*cursor == '\n') {
+			tokenizer->line++;
+			tokenizer->lineStart = cursor + 1;
+		} else if (*cursor != ' ' && *cursor != '\t' && *cursor != '\r') {
+			break;
+		}
+	}
+	tokenizer->cursor = cursor;
+}
+
+bool spTokenizerAtLineEnd(SPTokenizer* tokenizer) {
+	skipTokenizerBlanks(tokenizer);
+	return *tokenizer->cursor == '\n' || *tokenizer->cursor == '\0';
+}
+
+bool spTokenizerExpect(SPTokenizer* tokenizer, char expected) {
+	skipTokenizerBlanks(tokenizer);
+	if (*tokenizer->cursor != expected || expected == '\0') {
+		return false;
+	}
+	tokenizer->cursor++;
+	return true;
+}
+
+bool spTokenizerReadInt(SPTokenizer* tokenizer, int* value) {
+	const char* position;
+	bool negative;
+	int result = 0;
+
+	skipTokenizerSpaces(tokenizer);
+	position = tokenizer->cursor;
+	negative = (*position == '-');
+	if (*position == '-' || *position == '+') {
+		position++;
+	}
+	if (*position < '0' || *position > '9') {
+		return false;
+	}
+	for (; *position >= '0' && *position <= '9'; position++) {
+		if (result > (INT_MAX - (*position - '0')) / 10) {
+			return false;
+		}
+		result = result * 10 + (*position - '0');
+	}
+	*value = negative ? -result : result;
+	tokenizer->cursor = position;
+	return true;
+}
+
+/*
+ * Helper function to scale a mantissa by a power of ten which isn't exact, by
+ * squaring in long double precision
+ */
+double scaleTokenizerMantissa(uint64_t mantissa, int exponent) {
+	long double result = (long double) mantissa;
+	long double power = 10;
+	int remaining = exponent < 0 ? -exponent : exponent;
+	long double scale = 1;
+
+	for (; remaining > 0; remaining >>= 1, power *= power) {
+		if (remaining & 1) {
+			scale *= power;
+		}
+	}
+	return (double) (exponent < 0 ? result / scale : result * scale);
+}
+
+bool spTokenizerReadDouble(SPTokenizer* tokenizer, double* value) {
+	const char* position;
+	uint64_t mantissa = 0;
+	int exponent = 0, explicitExponent = 0, exponentSign = 1;
+	bool negative, digits = false;
+
+	skipTokenizerSpaces(tokenizer);
+	position = tokenizer->cursor;
+	negative = (*position == '-');
+	if (*position == '-' || *position == '+') {
+		position++;
+	}
+	// the digits beyond those a mantissa holds only scale it
+	for (; *position >= '0' && *position <= '9'; position++) {
+		if (mantissa <= MANTISSA_LIMIT) {
+			mantissa = mantissa * 10 + (*position - '0');
+		} else {
+			exponent++;
+		}
+		digits = true;
+	}
+	if (*position == '.') {
+		for (position++; *position >= '0' && *position <= '9'; position++) {
+			if (mantissa <= MANTISSA_LIMIT) {
+				mantissa = mantissa * 10 + (*position - '0');
+				exponent--;
+			}
+			digits = true;
+		}
+	}
+	if (!digits) {
+		return false;
+	}
+	if (*position == 'e' || *position == 'E') {
+		position++;
+		if (*position == '-' || *position == '+') {
+			exponentSign = (*position == '-') ? -1 : 1;
+			position++;
+		}
+		if (*position < '0' || *position > '9') {
+			return false;
+		}
+		for (; *position >= '0' && *position <= '9'; position++) {
+			if (explicitExponent < EXPONENT_LIMIT) {
+				explicitExponent = explicitExponent * 10 + (*position - '0');
+			}
+		}
+		exponent += exponentSign * explicitExponent;
+	}
+
+	if (mantissa == 0) {
+		*value = 0;
+	} else if (mantissa > EXACT_MANTISSA_LIMIT
+			|| exponent < -EXACT_POWER_LIMIT || exponent > EXACT_POWER_LIMIT) {
+		*value = scaleTokenizerMantissa(mantissa, exponent);
+	} else {
+		*value = exponent < 0 ?
+				(double) mantissa / exactPowersOfTen[-exponent] :
+				(double) mantissa * exactPowersOfTen[exponent];
+	}
+	if (negative) {
+		*value = -*value;
+	}
+	tokenizer->cursor = position;
+	return true;
+}
+
+int spTokenizerReadWord(SPTokenizer* tokenizer, const char* delimiters,
+		char* word, int capacity) {
+	const char* start;
+	const char* position;
+	int length;
+
+	skipTokenizerBlanks(tokenizer);
+	start = tokenizer->cursor;
+	for (position = start;
+			*position != '\0' && *position != ' ' && *position != '\t'
+					&& *position != '\r' && *position != '\n'
+					&& strchr(delimiters, *position) == NULL; position++) {
+	}
+	length = (int) (position - start);
+	if (length >= capacity) {
+		return -1;
+	}
+	memcpy(word, start, length);
+	word[length] = '\0';
+	tokenizer->cursor = position;
+	return length;
+}
+
+int spTokenizerReadLine(SPTokenizer* tokenizer, char* line, int capacity) {
+	const char* start = tokenizer->cursor;
+	const char* end = strchr(start, '\n');
+	int length;
+
+	if (end == NULL) {
+		end = start + strlen(start);
+		tokenizer->cursor = end;
+	} else {
+		tokenizer->cursor = end + 1;
+		tokenizer->lineStart = end + 1;
+		tokenizer->line++;
+	}
+	length = (int) (end - start);
+	if (length >= capacity) {
+		return -1;
+	}
+	memcpy(line, start, length);
+	line[length] = '\0';
+	return length;
+}
+
+int spTokenizerGetLine(const SPTokenizer* tokenizer) {
+	return tokenizer->line;
+}
+
+int spTokenizerGetColumn(const SPTokenizer* tokenizer) {
+	return (int) (tokenizer->cursor - tokenizer->lineStart) + 1;
+}
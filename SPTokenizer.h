@@ -0,0 +1,169 @@
+/*
+ * SPTokenizer.h
+ */
+
+#ifndef SPTOKENIZER_H_
+#define SPTOKENIZER_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * A tokenizer of the text files of the system, the features files, the shard
+ * manifests and the configuration file, which are read whole into a buffer and
+ * scanned in place.
+ *
+ * Numbers are parsed without the locale and without allocating: a decimal
+ * number of at most 15 significant digits and a decimal exponent of at most 22,
+ * such as every number "%f" prints, is an exact mantissa and an exact power of
+ * ten, so a single division or multiplication rounds it correctly. Any other
+ * number is computed in long double precision.
+ *
+ * A failed read leaves the tokenizer at the token it failed on, whose line and
+ * column are then reported by spTokenizerGetLine and spTokenizerGetColumn.
+ * The tokenizer is a plain structure so it may live on the stack, its fields
+ * are read and written only by the functions below.
+ */
+typedef struct sp_tokenizer_t {
+	const char* cursor; // the next character, the text ends with a null character
+	const char* lineStart; // the first character of the line of the cursor
+	int line; // the line of the cursor, from 1
+} SPTokenizer;
+
+/** Type used for reading files **/
+typedef enum sp_tokenizer_msg_t {
+	SP_TOKENIZER_CANNOT_OPEN_FILE,
+	SP_TOKENIZER_ALLOC_FAIL,
+	SP_TOKENIZER_SUCCESS
+} SP_TOKENIZER_MSG;
+
+/*
+ * @param path - the path of the file
+ * @param buffer - a buffer allocated by malloc, or a pointer to NULL
+ * @param capacity - the size of the buffer, 0 if it is NULL
+ * @param length - pointer in which the length of the file is stored, may be NULL
+ *
+ * Reads a file whole into the buffer, ending it with a null character. The
+ * buffer is grown with realloc when the file doesn't fit, so a buffer may be
+ * reused for many files, and the caller frees it once done.
+ *
+ * @return SP_TOKENIZER_CANNOT_OPEN_FILE if the file can't be opened or read
+ * @return SP_TOKENIZER_ALLOC_FAIL if the buffer can't be grown, it is kept
+ * @return SP_TOKENIZER_SUCCESS otherwise
+ */
+SP_TOKENIZER_MSG spTokenizerReadFile(const char* path, char** buffer,
+		size_t* capacity, size_t* length);
+
+/*
+ * @param file - a file descriptor open for reading
+ * @param buffer - a buffer allocated by malloc, or a pointer to NULL
+ * @param capacity - the size of the buffer, 0 if it is NULL
+ * @param length - pointer in which the length of the file is stored, may be NULL
+ *
+ * Reads an open file whole into the buffer as spTokenizerReadFile does, from
+ * its start whatever its offset is. The file is left open.
+ *
+ * @return SP_TOKENIZER_CANNOT_OPEN_FILE if the file can't be sized or read
+ * @return SP_TOKENIZER_ALLOC_FAIL if the buffer can't be grown, it is kept
+ * @return SP_TOKENIZER_SUCCESS otherwise
+ */
+SP_TOKENIZER_MSG spTokenizerReadOpenFile(int file, char** buffer,
+		size_t* capacity, size_t* length);
+
+/*
+ * @param tokenizer - a tokenizer
+ * @param text - the text to tokenize, ending with a null character, which must
+ * 		  outlive the tokenization
+ */
+void spTokenizerInit(SPTokenizer* tokenizer, const char* text);
+
+/*
+ * @param tokenizer - a tokenizer
+ *
+ * @return true if the text ended, false otherwise
+ */
+bool spTokenizerAtEnd(const SPTokenizer* tokenizer);
+
+/*
+ * @param tokenizer - a tokenizer
+ *
+ * Skips the spaces, tabs and carriage returns before the next token on the line
+ *
+ * @return true if the line or the text ended, false otherwise
+ */
+bool spTokenizerAtLineEnd(SPTokenizer* tokenizer);
+
+/*
+ * @param tokenizer - a tokenizer
+ * @param expected - a character
+ *
+ * Skips the spaces, tabs and carriage returns before the next token on the
+ * line, and the expected character if it is next
+ *
+ * @return true if the expected character was skipped, false otherwise
+ */
+bool spTokenizerExpect(SPTokenizer* tokenizer, char expected);
+
+/*
+ * @param tokenizer - a tokenizer
+ * @param value - pointer in which the integer is stored
+ *
+ * Skips any whitespace, including line ends, and reads a decimal integer with
+ * an optional sign
+ *
+ * @return false if there's no integer next or it overflows an int, true otherwise
+ */
+bool spTokenizerReadInt(SPTokenizer* tokenizer, int* value);
+
+/*
+ * @param tokenizer - a tokenizer
+ * @param value - pointer in which the number is stored
+ *
+ * Skips any whitespace, including line ends, and reads a decimal number with
+ * an optional sign, fraction and exponent
+ *
+ * @return false if there's no number next, true otherwise
+ */
+bool spTokenizerReadDouble(SPTokenizer* tokenizer, double* value);
+
+/*
+ * @param tokenizer - a tokenizer
+ * @param delimiters - the characters which end a word besides whitespace
+ * @param word - the buffer in which the word is stored, ending with a null character
+ * @param capacity - the size of the buffer
+ *
+ * Skips the spaces, tabs and carriage returns before the next token on the
+ * line, and reads the characters up to the next whitespace or delimiter
+ *
+ * @return the length of the word, 0 if there's none, -1 if it doesn't fit
+ */
+int spTokenizerReadWord(SPTokenizer* tokenizer, const char* delimiters,
+		char* word, int capacity);
+
+/*
+ * @param tokenizer - a tokenizer
+ * @param line - the buffer in which the line is stored, ending with a null character
+ * @param capacity - the size of the buffer
+ *
+ * Reads the rest of the line without its end, and moves to the next line
+ *
+ * @return the length of the line, -1 if it doesn't fit, in which case the line
+ * 		   is skipped
+ */
+int spTokenizerReadLine(SPTokenizer* tokenizer, char* line, int capacity);
+
+/*
+ * @param tokenizer - a tokenizer
+ *
+ * @return the line of the next token, from 1
+ */
+int spTokenizerGetLine(const SPTokenizer* tokenizer);
+
+/*
+ * @param tokenizer - a tokenizer
+ *
+ * @return the column of the next token, from 1
+ */
+int spTokenizerGetColumn(const SPTokenizer* tokenizer);
+
+#endif /* SPTOKENIZER_H_ */
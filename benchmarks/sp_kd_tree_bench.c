@@ -0,0 +1,253 @@
+/*
+ * sp_kd_tree_bench.c
+ *
+ * Compares the split methods and the layouts of the kd-tree on synthetic
+ * clustered features, reporting the build time and the work done per query by
+ * every method, then the query time of interleaved searches on a tree larger
+ * than the cache.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "../SPKDArray.h"
+#include "../SPKDTree.h"
+#include "../SPConfigUtils.h"
+
+#define BENCH_DIM 8
+#define BENCH_POINTS 20000
+#define BENCH_CLUSTERS 24
+#define BENCH_QUERIES 500
+#define BENCH_NEIGHBORS 5
+#define BENCH_SEED 2016u
+#define BENCH_GROUP_POINTS 400000
+#define BENCH_GROUP_QUERIES 20000
+#define BENCH_GROUP_SIZES 4
+
+/*
+ * Helper function to get a pseudo random value in [0, 1), deterministic between
+ * runs. A xorshift generator, as successive values of a linear congruential one
+ * are correlated enough to line the points of a cluster up.
+ */
+double nextUniform(unsigned int* seed) {
+	*seed ^= *seed << 13;
+	*seed ^= *seed >> 17;
+	*seed ^= *seed << 5;
+	return (double) (*seed >> 8) / 0x1000000;
+}
+
+/*
+ * Helper function to create points spread around random cluster centers, with
+ * clusters of uneven sizes and extents, as features of similar images are. The
+ * centers are the same for every call, so queries fall in the clusters of the
+ * points.
+ */
+SPPoint* createClusteredPoints(int count, unsigned int* seed) {
+	double centers[BENCH_CLUSTERS][BENCH_DIM];
+	double values[BENCH_DIM];
+	double extent;
+	SPPoint* points = (SPPoint*) malloc(sizeof(SPPoint) * count);
+	unsigned int centersSeed = BENCH_SEED;
+	int i, j, cluster;
+
+	if (points == NULL) {
+		return NULL;
+	}
+	for (i = 0; i < BENCH_CLUSTERS; i++) {
+		for (j = 0; j < BENCH_DIM; j++) {
+			centers[i][j] = 1000 * nextUniform(&centersSeed);
+		}
+	}
+	for (i = 0; i < count; i++) {
+		// squaring skews the clusters towards the first ones
+		cluster = (int) (BENCH_CLUSTERS * nextUniform(seed) * nextUniform(seed));
+		extent = 5 + 5 * cluster;
+		for (j = 0; j < BENCH_DIM; j++) {
+			values[j] = centers[cluster][j] + extent * (nextUniform(seed) - 0.5);
+		}
+		points[i] = spPointCreate(values, BENCH_DIM, i);
+	}
+	return points;
+}
+
+/*
+ * Helper function to destroy the points
+ */
+void destroyPoints(SPPoint* points, int count) {
+	int i;
+	for (i = 0; i < count; i++) {
+		spPointDestroy(points[i]);
+	}
+	free(points);
+}
+
+/*
+ * Helper function to time searches of all the queries in groups of the given
+ * size, a size of 1 searching one query at a time. Returns the time per query
+ * in microseconds, or -1 on allocation failure.
+ */
+double timeGroupSearch(SPKDTreeNode* root, SPPoint* queries, int queriesCount,
+		int groupSize) {
+	SPKDTreeSearchContext* contexts[16];
+	clock_t start;
+	bool success = true;
+	int i, j;
+
+	for (i = 0; i < groupSize; i++) {
+		contexts[i] = spKDTreeSearchContextCreate(BENCH_NEIGHBORS);
+		success = success && contexts[i] != NULL;
+	}
+	start = clock();
+	for (i = 0; i < queriesCount && success; i += groupSize) {
+		for (j = 0; j < groupSize; j++) {
+			spKDTreeSearchContextReset(contexts[j]);
+		}
+		if (groupSize == 1) {
+			success = spKDTreeSearch(root, queries[i], contexts[0], NULL, NULL, NULL);
+		} else {
+			success = spKDTreeSearchGroup(root, queries + i,
+					queriesCount - i < groupSize ? queriesCount - i : groupSize,
+					contexts, NULL, NULL, NULL);
+		}
+	}
+	for (i = 0; i < groupSize; i++) {
+		spKDTreeSearchContextDestroy(contexts[i]);
+	}
+	return success ? 1000000.0 * (clock() - start) / CLOCKS_PER_SEC / queriesCount : -1;
+}
+
+/*
+ * Helper function to compare one query at a time to interleaved groups of
+ * queries, on a tree too large for the cache, whose leaves hold copies of the
+ * coordinates or point at the coordinates of the points
+ */
+int benchGroups(unsigned int* seed) {
+	int groupSizes[BENCH_GROUP_SIZES] = { 1, 4, 8, 16 };
+	SPPoint* points = createClusteredPoints(BENCH_GROUP_POINTS, seed);
+	SPPoint* queries = createClusteredPoints(BENCH_GROUP_QUERIES, seed);
+	SPKDArray* kdArr;
+	SPKDArray* borrowedArr;
+	SPKDTreeNode* root;
+	TreeLayout layout;
+	bool borrowed;
+	int i, b;
+
+	if (points == NULL || queries == NULL) {
+		return 1;
+	}
+	kdArr = spKDArrayInitSelection(points, BENCH_GROUP_POINTS, BENCH_DIM);
+	borrowedArr = spKDArrayInitSelectionBorrowed(points, BENCH_GROUP_POINTS,
+			BENCH_DIM);
+	if (kdArr == NULL || borrowedArr == NULL) {
+		return 1;
+	}
+
+	printf("\n%d points, %d queries, MAX_SPREAD, query us by group size\n",
+			BENCH_GROUP_POINTS, BENCH_GROUP_QUERIES);
+	printf("%-14s %-9s", "layout", "leaves");
+	for (i = 0; i < BENCH_GROUP_SIZES; i++) {
+		printf(" %10d", groupSizes[i]);
+	}
+	printf("\n");
+	for (b = 0; b < 2; b++) {
+		borrowed = (b == 1);
+		for (layout = DEPTH_FIRST; layout <= VAN_EMDE_BOAS; layout++) {
+			root = borrowed ? spKDTreeInitBorrowed(borrowedArr, MAX_SPREAD, layout)
+					: spKDTreeInitWithLayout(kdArr, MAX_SPREAD, layout);
+			if (root == NULL) {
+				return 1;
+			}
+			printf("%-14s %-9s", convertLayoutToString(layout),
+					borrowed ? "borrowed" : "copied");
+			for (i = 0; i < BENCH_GROUP_SIZES; i++) {
+				printf(" %10.2f", timeGroupSearch(root, queries, BENCH_GROUP_QUERIES,
+						groupSizes[i]));
+			}
+			printf("\n");
+			spKDTreeDestroy(root);
+		}
+	}
+
+	spKDArrayDestroy(kdArr);
+	spKDArrayDestroy(borrowedArr);
+	destroyPoints(points, BENCH_GROUP_POINTS);
+	destroyPoints(queries, BENCH_GROUP_QUERIES);
+	return 0;
+}
+
+int main() {
+	unsigned int seed = BENCH_SEED;
+	SPPoint* points = createClusteredPoints(BENCH_POINTS, &seed);
+	SPPoint* queries = createClusteredPoints(BENCH_QUERIES, &seed);
+	SPKDArray* kdArr;
+	SPKDTreeNode* root;
+	SPKDTreeSearchStats stats;
+	SPKDTreeSearchContext* context = spKDTreeSearchContextCreate(BENCH_NEIGHBORS);
+	SPArenaStats memoryStats;
+	SPBPQueue bpq;
+	SplitMethod method;
+	TreeLayout layout;
+	clock_t start;
+	double buildTime, queryTime, destroyTime;
+	int i;
+
+	if (points == NULL || queries == NULL || context == NULL) {
+		printf("memory allocation failure\n");
+		return 1;
+	}
+	kdArr = spKDArrayInit(points, BENCH_POINTS, BENCH_DIM);
+	if (kdArr == NULL) {
+		printf("memory allocation failure\n");
+		return 1;
+	}
+
+	printf("%d points, %d dimensions, %d queries for %d neighbors\n",
+			BENCH_POINTS, BENCH_DIM, BENCH_QUERIES, BENCH_NEIGHBORS);
+	printf("%-20s %-14s %10s %12s %10s %14s %14s %12s\n", "method", "layout",
+			"build ms", "destroy ms", "tree KB", "nodes/query", "leaves/query",
+			"query us");
+	for (method = RANDOM; method <= COST_MODEL; method++) {
+		for (layout = DEPTH_FIRST; layout <= VAN_EMDE_BOAS; layout++) {
+			srand(BENCH_SEED);
+			start = clock();
+			root = spKDTreeInitWithLayout(kdArr, method, layout);
+			buildTime = 1000.0 * (clock() - start) / CLOCKS_PER_SEC;
+			if (root == NULL) {
+				printf("memory allocation failure\n");
+				return 1;
+			}
+
+			stats.nodesVisited = 0;
+			stats.leavesVisited = 0;
+			start = clock();
+			for (i = 0; i < BENCH_QUERIES; i++) {
+				bpq = spKDTreeNearestNeighborInContext(root, queries[i], context, &stats);
+				spBPQueueDestroy(bpq);
+			}
+			queryTime = 1000000.0 * (clock() - start) / CLOCKS_PER_SEC / BENCH_QUERIES;
+
+			spKDTreeGetMemoryStats(root, &memoryStats);
+			start = clock();
+			spKDTreeDestroy(root);
+			destroyTime = 1000.0 * (clock() - start) / CLOCKS_PER_SEC;
+
+			printf("%-20s %-14s %10.1f %12.2f %10lu %14.1f %14.1f %12.1f\n",
+					convertMethodToString(method), convertLayoutToString(layout),
+					buildTime, destroyTime,
+					(unsigned long) (memoryStats.bytesUsed / 1024),
+					(double) stats.nodesVisited / BENCH_QUERIES,
+					(double) stats.leavesVisited / BENCH_QUERIES, queryTime);
+		}
+	}
+
+	spKDTreeSearchContextDestroy(context);
+	spKDArrayDestroy(kdArr);
+	destroyPoints(points, BENCH_POINTS);
+	destroyPoints(queries, BENCH_QUERIES);
+
+	if (benchGroups(&seed) != 0) {
+		printf("memory allocation failure\n");
+		return 1;
+	}
+	return 0;
+}
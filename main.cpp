@@ -6,6 +6,7 @@
 #include <stdio.h>
 #include <string.h>
 #include "SPImageProc.h"
+#include "SPExtraction.h"
 
 using sp::ImageProc;
 
@@ -14,13 +15,21 @@ extern "C" {
 #include "SPLogger.h"
 #include "SPConfig.h"
 #include "SPFeaturesSerializer.h"
-#include "SPKDTree.h"
+#include "SPFeaturesLoader.h"
+#include "SPShardedIndex.h"
+#include "SPArena.h"
+#include "SPMemory.h"
 }
 
 #ifndef MAX_PATH
 #define MAX_PATH 1024
 #endif
 
+/** the flag printing the memory report of every phase to the standard output **/
+#define MEMORY_REPORT_FLAG "--memory-report"
+
+#define BYTES_PER_MB (1024.0 * 1024.0)
+
 /*
  * Creates logger according to information from config
  *
@@ -67,6 +76,28 @@ int terminate(SPConfig config, SP_CONFIG_MSG msg) {
 	exit(msg);
 }
 
+/*
+ * Logs the current memory of every subsystem after a phase and its peak during
+ * the phase, see SPMemory.h, and prints them as well when the memory report was
+ * asked for. The peaks are reset for the next phase.
+ */
+void reportMemory(const char* phase, bool print) {
+	SPMemoryStats stats;
+
+	for (int i = 0; i <= SP_MEMORY_TOTAL; i++) {
+		spMemoryGetStats((SP_MEMORY_SUBSYSTEM) i, &stats);
+		SP_LOG_INFO("memory after %s, %s: %.2fMB, peak %.2fMB", phase,
+				spMemoryGetName((SP_MEMORY_SUBSYSTEM) i),
+				stats.currentBytes / BYTES_PER_MB, stats.peakBytes / BYTES_PER_MB);
+		if (print) {
+			printf("memory after %s, %s: %.2fMB, peak %.2fMB\n", phase,
+					spMemoryGetName((SP_MEMORY_SUBSYSTEM) i),
+					stats.currentBytes / BYTES_PER_MB, stats.peakBytes / BYTES_PER_MB);
+		}
+	}
+	spMemoryResetPeaks();
+}
+
 /*
  * main entry point, returns status code
  */
@@ -76,33 +107,28 @@ int main(int argc, char* argv[]) {
 	SP_LOGGER_MSG logMsg;
 	SPConfig config = NULL;
 	char imagePath[MAX_PATH];
-	SPPoint* imFeatures = NULL;
-	int numOfFeats;
 	int numOfImages;
 	int i, j;
 	ImageProc* imageProc = NULL;
-	SPPoint** featuresPerImage;
-	int* featureCountPerImage;
-	int totalFeatures = 0;
-	SPPoint* allFeatures;
-	int featureIndex;
-	SPKDArray* kdArray;
-	SPKDTreeNode* kdTree;
+	int numOfShards;
+	SPShardedIndex* index;
+	SPLoadedFeatures* loadedFeatures;
+	double* loadedCoordinates;
 	char queryPath[MAX_PATH];
+	bool memoryReport = false;
 	
 	setvbuf (stdout, NULL, _IONBF, BUFSIZ);
 
-	// should be at most 2 arguments: program name and config name
-	if (argc > 3 || argc == 2) {
-		return terminate(NULL, SP_CONFIG_INVALID_COMMANDLINE);
-	}
-
-	// the user entered config name, so default name shouldn't be used
-	if (argc == 3) {
-		if (strcmp("-c", argv[1]) != 0) {
+	// the arguments are an optional config name after -c, so the default name
+	// isn't used, and the optional memory report flag
+	for (i = 1; i < argc; i++) {
+		if (strcmp("-c", argv[i]) == 0 && i + 1 < argc) {
+			filename = argv[++i];
+		} else if (strcmp(MEMORY_REPORT_FLAG, argv[i]) == 0) {
+			memoryReport = true;
+		} else {
 			return terminate(NULL, SP_CONFIG_INVALID_COMMANDLINE);
 		}
-		filename = argv[2];
 	}
 
 	// creating SPConfig
@@ -133,82 +159,76 @@ int main(int argc, char* argv[]) {
 	imageProc = new ImageProc(config);
 
 	if (spConfigIsExtractionMode(config, &msg)) {
-		for (i = 0; i < numOfImages; i++) {
-			msg = spConfigGetImagePath(imagePath, config, i);
-			if (msg != SP_CONFIG_SUCCESS) {
-				spLoggerPrintError(imPathErr, __FILE__, __func__, __LINE__);
-				return terminate(config, msg);
-			}
-			imFeatures = imageProc->getImageFeatures(imagePath, i, &numOfFeats);
-			if (imFeatures == NULL) {
-				spLoggerPrintError(unknownErr, __FILE__, __func__, __LINE__);
-				return terminate(config, msg);
-			}
-
-			msg = writeImageFeaturesToFile(imFeatures, numOfFeats, config, i);
-			if (msg != SP_CONFIG_SUCCESS) {
-				terminate(config, msg);
-			}
-			for (j = 0; j<numOfFeats; j++) {
-				spPointDestroy(imFeatures[j]);
-			}
-			free(imFeatures);
+		msg = extractImagesFeatures(imageProc, config);
+		if (msg != SP_CONFIG_SUCCESS) {
+			return terminate(config, msg);
 		}
+		reportMemory("extraction", memoryReport);
 	}
 
-	// importing features from files
+	// importing features from files into their shards
 
-	featuresPerImage = (SPPoint**) malloc(sizeof(SPPoint*) * numOfImages);
-	VERIFY_ALLOC(featuresPerImage);
-	featureCountPerImage = (int*) malloc(sizeof(int) * numOfImages);
-	VERIFY_ALLOC(featureCountPerImage);
+	numOfShards = spConfigGetNumOfShards(config, &msg);
+	index = spShardedIndexCreate(numOfShards, numOfImages,
+			spConfigGetPCADim(config, &msg));
+	VERIFY_ALLOC(index);
+
+	// the features files are loaded in parallel, a thread per online processor,
+	// into a single block which the index adopts, and its trees point into
+	loadedFeatures = spFeaturesLoad(config, 0, &msg);
+	if (loadedFeatures == NULL) {
+		terminate(config, msg);
+	}
 
-	for (i = 0; i < numOfImages; i++) {
-		readImageFeaturesFromFile(&(featuresPerImage[i]),
-				&(featureCountPerImage[i]), config, i);
+	// a single shard is a plain kd-tree, no manifest is kept for it. The
+	// manifests are checked against the features loaded.
+	if (numOfShards > 1) {
+		msg = readShardManifests(index, config,
+				spLoadedFeaturesGetCounts(loadedFeatures));
 		if (msg != SP_CONFIG_SUCCESS) {
 			terminate(config, msg);
 		}
-		totalFeatures += featureCountPerImage[i];
 	}
+	loadedCoordinates = spLoadedFeaturesReleaseCoordinates(loadedFeatures);
+	if (spShardedIndexAdoptFeatures(index, loadedCoordinates,
+			spLoadedFeaturesGetCounts(loadedFeatures)) != SP_SHARDED_INDEX_SUCCESS) {
+		spArenaFreeHuge(loadedCoordinates);
+		spLoggerPrintError(allocFail, __FILE__, __func__, __LINE__);
+		terminate(config, SP_CONFIG_ALLOC_FAIL);
+	}
+	spLoadedFeaturesDestroy(loadedFeatures);
+	reportMemory("loading", memoryReport);
 
-	allFeatures = (SPPoint*) malloc(sizeof(SPPoint) * totalFeatures);
-	VERIFY_ALLOC(allFeatures);
-	featureIndex = 0;
-	for (i = 0; i < numOfImages; i++) {
-		for (j = 0; j < featureCountPerImage[i]; j++, featureIndex++) {
-			allFeatures[featureIndex] = featuresPerImage[i][j];
+	if (numOfShards > 1) {
+		msg = writeShardManifests(index, config);
+		if (msg != SP_CONFIG_SUCCESS) {
+			terminate(config, msg);
 		}
 	}
 
-	// building kd-array
-	
-	kdArray = spKDArrayInit(allFeatures, totalFeatures,
-			spConfigGetPCADim(config, &msg));
-	VERIFY_ALLOC(kdArray);
+	// building the kd-trees of the shards
 
-	free(allFeatures);
-	for (i = 0; i < numOfImages; i++) {
-		for (j = 0; j < featureCountPerImage[i]; j++, featureIndex++) {
-			spPointDestroy(featuresPerImage[i][j]);
-		}
-		free(featuresPerImage[i]);
+	spShardedIndexSetNumaReplication(index, spConfigIsNumaReplication(config, &msg));
+	if (spShardedIndexBuild(index, spConfigGetSplitMethod(config, &msg),
+			spConfigGetBuildMethod(config, &msg), spConfigGetTreeLayout(config, &msg))
+			!= SP_SHARDED_INDEX_SUCCESS) {
+		spLoggerPrintError(allocFail, __FILE__, __func__, __LINE__);
+		terminate(config, SP_CONFIG_ALLOC_FAIL);
 	}
-	free(featuresPerImage);
-	free(featureCountPerImage);
-
-	// building kd-tree
+	reportMemory("building", memoryReport);
 
-	kdTree = spKDTreeInit(kdArray,
-			spConfigGetSplitMethod(config, &msg));
-	VERIFY_ALLOC(kdTree);
-	spKDArrayDestroy(kdArray);
+	// getting user query until hitting "<>", reusing the detector and the
+	// buffers of the extraction between queries
 
-	// getting user query until hitting "<>"
+	sp::ExtractionContext queryContext(QUERY_IMAGES);
+	double* queryCoordinates = (double*) malloc(sizeof(double)
+			* imageProc->getMaxFeatures() * spConfigGetPCADim(config, &msg));
+	VERIFY_ALLOC(queryCoordinates);
 
 	while (true) {
 		int queryNumOfFeats;
 		SPPoint* queryFeats;
+		SPBPQueue* queues;
 		int* histogram;
 		printf("Please enter an image path:\n");
 
@@ -222,20 +242,36 @@ int main(int argc, char* argv[]) {
 		// calculate feats of given query
 
 		
-		queryFeats = imageProc->getImageFeatures(queryPath, 0,	&queryNumOfFeats);
-		if (queryFeats == NULL) {
+		queryNumOfFeats = imageProc->extractFeatures(queryPath, queryContext,
+				queryCoordinates, imageProc->getMaxFeatures());
+		if (queryNumOfFeats < 0) {
 			spLoggerPrintError(unknownErr, __FILE__, __func__, __LINE__);
 			terminate(config, SP_CONFIG_UNKNOWN_ERROR);
 		}
+		queryFeats = spPointCreateArray(queryCoordinates, queryNumOfFeats,
+				spConfigGetPCADim(config, &msg), 0);
+		if (queryNumOfFeats > 0 && queryFeats == NULL) {
+			spLoggerPrintError(allocFail, __FILE__, __func__, __LINE__);
+			terminate(config, SP_CONFIG_ALLOC_FAIL);
+		}
 
-		// compare query feats to all feats in kd-tree and apply to histogram
+		// compare query feats to all feats in the shards and apply to histogram
 
 		histogram = (int*) calloc(sizeof(int), numOfImages);
 		VERIFY_ALLOC(histogram);
+		queues = (SPBPQueue*) malloc(sizeof(SPBPQueue) * (queryNumOfFeats + 1));
+		VERIFY_ALLOC(queues);
+
+		if (queryNumOfFeats > 0
+				&& spShardedIndexSearch(index, queryFeats, queryNumOfFeats,
+						spConfigGetSpKNN(config, &msg), queues)
+						!= SP_SHARDED_INDEX_SUCCESS) {
+			spLoggerPrintError(allocFail, __FILE__, __func__, __LINE__);
+			terminate(config, SP_CONFIG_ALLOC_FAIL);
+		}
 
 		for (i = 0; i < queryNumOfFeats; i++) {
-			SPBPQueue queue = spKDTreeNearestNeighbor(kdTree, queryFeats[i],
-					spConfigGetSpKNN(config, &msg));
+			SPBPQueue queue = queues[i];
 			while (!spBPQueueIsEmpty(queue)) {
 				SPListElement element = spBPQueuePeekLast(queue);
 				int imageIndex = spListElementGetIndex(element);
@@ -245,6 +281,8 @@ int main(int argc, char* argv[]) {
 			}
 			spBPQueueDestroy(queue);
 		}
+		free(queues);
+		spPointDestroyArray(queryFeats);
 
 		// extract and display similar images from histogram
 
@@ -278,7 +316,9 @@ int main(int argc, char* argv[]) {
 		free(histogram);
 	}
 
-	spKDTreeDestroy(kdTree);
+	reportMemory("querying", memoryReport);
+	free(queryCoordinates);
+	spShardedIndexDestroy(index);
 	delete imageProc;
 
 	return terminate(config, SP_CONFIG_SUCCESS);
@@ -0,0 +1,158 @@
+/*
+ * sp_feats_convert.c
+ *
+ * Converts the features files of a catalog to another format, in place:
+ *
+ *   sp_feats_convert -c <config> [TEXT_FEATURES | BINARY_FEATURES]
+ *
+ * The format defaults to the spFeaturesFormat of the configuration. Every
+ * features file is read in whichever format it is and written again in the
+ * format given, images without a features file are skipped. A file is written
+ * next to the one it replaces and renamed over it, so a conversion which fails
+ * keeps the file as it was. The total size of the files before and after is
+ * reported.
+ *
+ * The binary format quantizes the coordinates, to at most 16 bits per
+ * dimension of an image, so text files converted to it lose precision, which
+ * is warned about.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "../SPConfig.h"
+#include "../SPConfigUtils.h"
+#include "../SPFeaturesSerializer.h"
+#include "../SPFeaturesCodec.h"
+#include "../SPLogger.h"
+
+#define CONVERT_PATH_LENGTH (3 * MAX_SIZE)
+
+/*
+ * Helper function to get the size of the features file of an image
+ *
+ * @return the size in bytes, 0 if the file doesn't exist
+ */
+long convertedFileSize(SPConfig config, int imageIndex) {
+	char featsPath[CONVERT_PATH_LENGTH];
+	struct stat status;
+
+	if (spConfigGetImageFeatsPath(featsPath, config, imageIndex)
+			!= SP_CONFIG_SUCCESS || stat(featsPath, &status) != 0) {
+		return 0;
+	}
+	return (long) status.st_size;
+}
+
+/*
+ * Helper function to check whether the features file of an image is in the
+ * text format, by its magic
+ */
+bool convertedFileIsText(SPConfig config, int imageIndex) {
+	char featsPath[CONVERT_PATH_LENGTH];
+	char magic[SP_FILE_MAGIC_LENGTH];
+	FILE* file;
+	size_t length;
+
+	if (spConfigGetImageFeatsPath(featsPath, config, imageIndex)
+			!= SP_CONFIG_SUCCESS || (file = fopen(featsPath, "rb")) == NULL) {
+		return false;
+	}
+	length = fread(magic, 1, sizeof(magic), file);
+	fclose(file);
+	return !spFeaturesIsEncoded(magic, length);
+}
+
+/*
+ * Helper function to convert the features file of an image
+ *
+ * @return SP_CONFIG_SUCCESS if it was converted, or an error otherwise
+ */
+SP_CONFIG_MSG convertImageFeatures(SPConfig config, int imageIndex,
+		FeaturesFormat format) {
+	SPPoint* features;
+	int count, i;
+	SP_CONFIG_MSG msg = readImageFeaturesFromFile(&features, &count, config,
+			imageIndex);
+
+	if (msg != SP_CONFIG_SUCCESS) {
+		return msg;
+	}
+	msg = writeImageFeaturesInFormat(features, count, config, imageIndex,
+			format);
+	for (i = 0; i < count; i++) {
+		spPointDestroy(features[i]);
+	}
+	free(features);
+	return msg;
+}
+
+int main(int argc, char* argv[]) {
+	SP_CONFIG_MSG msg;
+	SPConfig config;
+	FeaturesFormat format;
+	long sizeBefore = 0, sizeAfter = 0, size;
+	int imagesCount, converted = 0, skipped = 0, i;
+	bool warned = false;
+
+	if ((argc != 3 && argc != 4) || strcmp(argv[1], "-c") != 0) {
+		printf("Usage: %s -c <config> [TEXT_FEATURES | BINARY_FEATURES]\n",
+				argv[0]);
+		return 1;
+	}
+	config = spConfigCreate(argv[2], &msg);
+	if (config == NULL) {
+		printf("The configuration file %s is invalid\n", argv[2]);
+		return 1;
+	}
+	format = spConfigGetFeaturesFormat(config, &msg);
+	if (argc == 4) {
+		for (format = TEXT_FEATURES;
+				format <= BINARY_FEATURES
+						&& strcmp(argv[3], convertFeaturesFormatToString(format)) != 0;
+				format++) {
+		}
+		if (format > BINARY_FEATURES) {
+			printf("Unknown format %s\n", argv[3]);
+			spConfigDestroy(config);
+			return 1;
+		}
+	}
+	if (spLoggerCreate(NULL, SP_LOGGER_ERROR_LEVEL) != SP_LOGGER_SUCCESS) {
+		spConfigDestroy(config);
+		return 1;
+	}
+
+	imagesCount = spConfigGetNumOfImages(config, &msg);
+	for (i = 0; i < imagesCount; i++) {
+		size = convertedFileSize(config, i);
+		if (size == 0) {
+			skipped++;
+			continue;
+		}
+		if (format == BINARY_FEATURES && !warned && convertedFileIsText(config, i)) {
+			printf("Warning: the binary format quantizes the coordinates to %d bits, "
+					"text features converted to it lose precision\n",
+					SP_CODEC_QUANTIZATION_BITS);
+			warned = true;
+		}
+		msg = convertImageFeatures(config, i, format);
+		if (msg != SP_CONFIG_SUCCESS) {
+			printf("Converting the features of image %d failed\n", i);
+			break;
+		}
+		sizeBefore += size;
+		sizeAfter += convertedFileSize(config, i);
+		converted++;
+	}
+
+	printf("%d files converted to %s, %d skipped, %ld bytes to %ld bytes\n",
+			converted, convertFeaturesFormatToString(format), skipped, sizeBefore,
+			sizeAfter);
+	spLoggerDestroy();
+	spConfigDestroy(config);
+	return msg == SP_CONFIG_SUCCESS ? 0 : 1;
+}
@@ -0,0 +1,83 @@
+/*
+ * sp_feats_validate.c
+ *
+ * Validates the features files of a catalog without loading it:
+ *
+ *   sp_feats_validate -c <config> [threads]
+ *
+ * The files are validated by several threads, one per online processor by
+ * default: a binary file by its header, its checksum and its layout, a text
+ * file by parsing it whole. The images whose files are invalid are listed with
+ * the reason logged, and the rate of the validation is reported. Exits with 1
+ * if any file is invalid, so a catalog can be checked before it is served.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../SPConfig.h"
+#include "../SPFeaturesLoader.h"
+#include "../SPLogger.h"
+
+/*
+ * Helper function to get the seconds of a monotonic clock
+ */
+double validateClock() {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+int main(int argc, char* argv[]) {
+	SP_CONFIG_MSG msg;
+	SPConfig config;
+	bool* valid;
+	double start, seconds;
+	long bytes = 0;
+	int imagesCount, threadsCount = 0, invalid, i;
+
+	if ((argc != 3 && argc != 4) || strcmp(argv[1], "-c") != 0
+			|| (argc == 4 && (threadsCount = atoi(argv[3])) < 1)) {
+		printf("Usage: %s -c <config> [threads]\n", argv[0]);
+		return 1;
+	}
+	config = spConfigCreate(argv[2], &msg);
+	if (config == NULL) {
+		printf("The configuration file %s is invalid\n", argv[2]);
+		return 1;
+	}
+	if (spLoggerCreate(NULL, SP_LOGGER_ERROR_LEVEL) != SP_LOGGER_SUCCESS) {
+		spConfigDestroy(config);
+		return 1;
+	}
+	imagesCount = spConfigGetNumOfImages(config, &msg);
+	valid = (bool*) malloc(sizeof(bool) * (imagesCount + 1));
+	if (valid == NULL) {
+		spLoggerDestroy();
+		spConfigDestroy(config);
+		return 1;
+	}
+
+	start = validateClock();
+	invalid = spFeaturesValidate(config, threadsCount, valid, &bytes, &msg);
+	seconds = validateClock() - start;
+	if (invalid < 0) {
+		printf("Validating the features failed\n");
+	} else {
+		for (i = 0; i < imagesCount; i++) {
+			if (!valid[i]) {
+				printf("The features file of image %d is invalid\n", i);
+			}
+		}
+		printf("%d of %d files valid, %ld bytes in %.3f seconds, %.1f MB/s\n",
+				imagesCount - invalid, imagesCount, bytes, seconds,
+				seconds > 0 ? bytes / seconds / 1e6 : 0);
+	}
+	free(valid);
+	spLoggerDestroy();
+	spConfigDestroy(config);
+	return invalid == 0 ? 0 : 1;
+}
@@ -0,0 +1,177 @@
+#include "../SPArena.h"
+#include "unit_test_util.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "unit_tests.h"
+
+#define ARENA_BLOCK_SIZE 256
+
+/*
+ * Test allocations are aligned, distinct, and spill to new blocks
+ */
+bool ArenaAlloc() {
+	SPArena* arena = spArenaCreate(ARENA_BLOCK_SIZE);
+	SPArenaStats stats;
+	char* first;
+	char* second;
+	char* large;
+	int* zeroed;
+
+	ASSERT_NULL(spArenaCreate(0));
+	ASSERT_NOT_NULL(arena);
+	ASSERT_NULL(spArenaAlloc(arena, 0));
+	ASSERT_NULL(spArenaAlloc(NULL, 8));
+
+	first = (char*) spArenaAlloc(arena, 3);
+	second = (char*) spArenaAlloc(arena, 5);
+	ASSERT_NOT_NULL(first);
+	ASSERT_NOT_NULL(second);
+	ASSERT_TRUE((uintptr_t) first % SP_ARENA_ALIGNMENT == 0);
+	ASSERT_TRUE((uintptr_t) second % SP_ARENA_ALIGNMENT == 0);
+	ASSERT_TRUE(second >= first + 3);
+
+	// an allocation larger than a block gets a block of its own
+	large = (char*) spArenaAlloc(arena, 4 * ARENA_BLOCK_SIZE);
+	ASSERT_NOT_NULL(large);
+	for (int i = 0; i < 4 * ARENA_BLOCK_SIZE; i++) {
+		large[i] = (char) i;
+	}
+	zeroed = (int*) spArenaCalloc(arena, 10, sizeof(int));
+	ASSERT_NOT_NULL(zeroed);
+	for (int i = 0; i < 10; i++) {
+		ASSERT_EQUALS(zeroed[i], 0);
+	}
+
+	spArenaGetStats(arena, &stats);
+	ASSERT_EQUALS(stats.allocationsCount, 4);
+	ASSERT_TRUE(stats.blocksCount >= 2);
+	ASSERT_TRUE(stats.bytesUsed >= 4 * ARENA_BLOCK_SIZE + 3 + 5 + 10 * sizeof(int));
+	ASSERT_TRUE(stats.bytesReserved >= stats.bytesUsed);
+	ASSERT_EQUALS(stats.peakBytesUsed, stats.bytesUsed);
+
+	spArenaDestroy(arena);
+	return true;
+}
+
+/*
+ * Test rewinding to a mark releases later allocations and reuses their blocks
+ */
+bool ArenaRewind() {
+	SPArena* arena = spArenaCreate(ARENA_BLOCK_SIZE);
+	SPArenaStats before, after;
+	SPArenaMark mark;
+	char* kept;
+	char* released;
+	char* reused;
+
+	ASSERT_NOT_NULL(arena);
+	kept = (char*) spArenaAlloc(arena, 32);
+	ASSERT_NOT_NULL(kept);
+	spArenaGetStats(arena, &before);
+
+	mark = spArenaGetMark(arena);
+	released = (char*) spArenaAlloc(arena, 64);
+	ASSERT_NOT_NULL(released);
+	for (int i = 0; i < 10; i++) {
+		ASSERT_NOT_NULL(spArenaAlloc(arena, ARENA_BLOCK_SIZE / 2));
+	}
+	spArenaRewind(arena, mark);
+	spArenaGetStats(arena, &after);
+	ASSERT_EQUALS(after.bytesUsed, before.bytesUsed);
+	ASSERT_TRUE(after.peakBytesUsed > after.bytesUsed);
+
+	// the released memory and blocks are handed out again
+	reused = (char*) spArenaAlloc(arena, 64);
+	ASSERT_TRUE(reused == released);
+	for (int i = 0; i < 10; i++) {
+		ASSERT_NOT_NULL(spArenaAlloc(arena, ARENA_BLOCK_SIZE / 2));
+	}
+	spArenaGetStats(arena, &before);
+	ASSERT_EQUALS(before.blocksCount, after.blocksCount);
+	ASSERT_EQUALS(before.bytesReserved, after.bytesReserved);
+
+	spArenaReset(arena);
+	spArenaGetStats(arena, &after);
+	ASSERT_EQUALS(after.bytesUsed, 0);
+	ASSERT_TRUE(spArenaAlloc(arena, 32) == kept);
+
+	spArenaDestroy(arena);
+	return true;
+}
+
+/*
+ * Test large blocks of an arena for huge pages are mapped to whole huge pages,
+ * and small blocks are not
+ */
+bool ArenaHugePages() {
+	SPArena* arena = spArenaCreateHuge(ARENA_BLOCK_SIZE);
+	SPArenaStats stats;
+	size_t size = SP_ARENA_HUGE_PAGE_SIZE + 1000;
+	char* small;
+	char* large;
+
+	ASSERT_NULL(spArenaCreateHuge(0));
+	ASSERT_NOT_NULL(arena);
+	small = (char*) spArenaAlloc(arena, 64);
+	ASSERT_NOT_NULL(small);
+	spArenaGetStats(arena, &stats);
+	ASSERT_EQUALS(stats.hugeBlocksCount, 0);
+
+	large = (char*) spArenaAlloc(arena, size);
+	ASSERT_NOT_NULL(large);
+	ASSERT_TRUE((uintptr_t) large % SP_ARENA_ALIGNMENT == 0);
+	for (size_t i = 0; i < size; i++) {
+		large[i] = (char) i;
+	}
+	for (size_t i = 0; i < size; i += 4096) {
+		ASSERT_EQUALS(large[i], (char) i);
+	}
+	spArenaGetStats(arena, &stats);
+	ASSERT_EQUALS(stats.hugeBlocksCount, 1);
+	ASSERT_EQUALS(stats.blocksCount, 2);
+	ASSERT_TRUE(stats.bytesReserved >= 2 * SP_ARENA_HUGE_PAGE_SIZE);
+
+	// the rest of the huge pages of the block is used by later allocations
+	ASSERT_NOT_NULL(spArenaAlloc(arena, SP_ARENA_HUGE_PAGE_SIZE / 2));
+	spArenaGetStats(arena, &stats);
+	ASSERT_EQUALS(stats.blocksCount, 2);
+
+	spArenaDestroy(arena);
+	return true;
+}
+
+/*
+ * Test memory allocated outside of an arena is aligned and usable whether it is
+ * mapped to huge pages or falls back to malloc
+ */
+bool ArenaAllocHuge() {
+	size_t sizes[2] = { 64, SP_ARENA_HUGE_PAGE_SIZE + 1000 };
+	char* memory;
+
+	for (int i = 0; i < 2; i++) {
+		memory = (char*) spArenaAllocHuge(sizes[i]);
+		ASSERT_NOT_NULL(memory);
+		ASSERT_TRUE((uintptr_t) memory % SP_ARENA_ALIGNMENT == 0);
+		for (size_t j = 0; j < sizes[i]; j++) {
+			memory[j] = (char) j;
+		}
+		ASSERT_EQUALS(memory[sizes[i] - 1], (char) (sizes[i] - 1));
+		spArenaFreeHuge(memory);
+	}
+	spArenaFreeHuge(NULL);
+	return true;
+}
+
+/*
+ * main caller to tests of this module
+ */
+int sp_arena_unit_tests() {
+	RUN_TEST(ArenaAlloc);
+	RUN_TEST(ArenaRewind);
+	RUN_TEST(ArenaHugePages);
+	RUN_TEST(ArenaAllocHuge);
+
+	return 0;
+}
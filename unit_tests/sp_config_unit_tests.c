@@ -39,6 +39,15 @@ bool spConfigBasicTest1() {
 
 	ASSERT_TRUE(spConfigIsExtractionMode(config, &msg) == expExtrMode);
 	ASSERT_TRUE(spConfigMinimalGui(config, &msg) == expMinimalGui);
+	ASSERT_FALSE(spConfigIsAppendMode(config, &msg));
+	ASSERT_TRUE(spConfigGetNumOfShards(config, &msg) == 1);
+	ASSERT_TRUE(spConfigGetBuildMethod(config, &msg) == PRESORT);
+	ASSERT_TRUE(spConfigGetTreeLayout(config, &msg) == DEPTH_FIRST);
+	ASSERT_FALSE(spConfigIsNumaReplication(config, &msg));
+	ASSERT_TRUE(spConfigGetExtractionThreads(config, &msg) == 0);
+	ASSERT_TRUE(spConfigGetMaxImageSide(config, QUERY_IMAGES, &msg) == 0);
+	ASSERT_TRUE(spConfigGetOctaveLayers(config, DATABASE_IMAGES, &msg) == 3);
+	ASSERT_TRUE(spConfigGetEnoughFeatures(config, QUERY_IMAGES, &msg) == 0);
 
 	ASSERT_TRUE(spConfigGetNumOfImages(config, &msg) == expNumOfIm);
 	ASSERT_TRUE(spConfigGetPCADim(config, &msg) == expPCADim);
@@ -59,6 +68,70 @@ bool spConfigBasicTest1() {
 	return true;
 }
 
+/*
+ * tester for the extraction limits, which are set separately for the database
+ * and the query images
+ */
+bool spConfigImageRolesTest() {
+	SPConfig config;
+	SP_CONFIG_MSG msg;
+	const char* configFilename = "./files_for_unit_tests/configExample2.txt";
+
+	config = spConfigCreate(configFilename, &msg);
+	ASSERT_NOT_NULL(config);
+	ASSERT_TRUE(msg == SP_CONFIG_SUCCESS);
+
+	ASSERT_TRUE(spConfigGetMaxImageSide(config, DATABASE_IMAGES, &msg) == 1600);
+	ASSERT_TRUE(spConfigGetMaxImageSide(config, QUERY_IMAGES, &msg) == 640);
+	ASSERT_TRUE(spConfigGetOctaveLayers(config, DATABASE_IMAGES, &msg) == 3);
+	ASSERT_TRUE(spConfigGetOctaveLayers(config, QUERY_IMAGES, &msg) == 2);
+	ASSERT_TRUE(spConfigGetEnoughFeatures(config, DATABASE_IMAGES, &msg) == 0);
+	ASSERT_TRUE(spConfigGetEnoughFeatures(config, QUERY_IMAGES, &msg) == 60);
+	ASSERT_TRUE(spConfigGetFeaturesFormat(config, &msg) == TEXT_FEATURES);
+	ASSERT_TRUE(msg == SP_CONFIG_SUCCESS);
+
+	spConfigDestroy(config);
+	ASSERT_TRUE(spConfigGetOctaveLayers(NULL, QUERY_IMAGES, &msg) == -1);
+	ASSERT_TRUE(msg == SP_CONFIG_INVALID_ARGUMENT);
+
+	return true;
+}
+
+/*
+ * tester for a configuration asking for more keypoints to be enough than are detected
+ * @return true if spConfigCreate rejects it with SP_CONFIG_INVALID_INTEGER
+ */
+bool spConfigEnoughFeaturesTest() {
+	SP_CONFIG_MSG msg;
+	const char* configFilename = "./files_for_unit_tests/configExample3.txt";
+
+	ASSERT_NULL(spConfigCreate(configFilename, &msg));
+	ASSERT_TRUE(msg == SP_CONFIG_INVALID_INTEGER);
+
+	return true;
+}
+
+/*
+ * tester for the append mode, set to true, and rejected when it isn't a boolean
+ * @return true if it is parsed, and the invalid value fails with SP_CONFIG_INVALID_BOOLEAN
+ */
+bool spConfigAppendModeTest() {
+	SPConfig config;
+	SP_CONFIG_MSG msg;
+
+	config = spConfigCreate("./files_for_unit_tests/configExample4.txt", &msg);
+	ASSERT_NOT_NULL(config);
+	ASSERT_TRUE(msg == SP_CONFIG_SUCCESS);
+	ASSERT_TRUE(spConfigIsAppendMode(config, &msg));
+	ASSERT_TRUE(msg == SP_CONFIG_SUCCESS);
+	spConfigDestroy(config);
+
+	ASSERT_NULL(spConfigCreate("./files_for_unit_tests/configExample5.txt", &msg));
+	ASSERT_TRUE(msg == SP_CONFIG_INVALID_BOOLEAN);
+
+	return true;
+}
+
 /*
  * basic tester for various getters called before config was created
  * @return true if after each call for some getter, *msg == SP_CONFIG_INVALID_ARGUMENT
@@ -239,6 +312,9 @@ bool getPathWithValidArgumentsTest() {
 
 int sp_config_unit_tests() {
 	RUN_TEST(spConfigBasicTest1);
+	RUN_TEST(spConfigImageRolesTest);
+	RUN_TEST(spConfigEnoughFeaturesTest);
+	RUN_TEST(spConfigAppendModeTest);
 	RUN_TEST(spConfigUninitialized);
 	RUN_TEST(getPathNullImagepathTest);
 	RUN_TEST(getPathNullConfigTest);
@@ -83,14 +83,51 @@ bool methodToStringTest() {
 	char* str1 = (char*) "RANDOM";
 	char* str2 = (char*) "MAX_SPREAD";
 	char* str3 = (char*) "INCREMENTAL";
+	char* str4 = (char*) "MAX_VARIANCE";
+	char* str5 = (char*) "SAMPLED_MAX_SPREAD";
+	char* str6 = (char*) "SLIDING_MIDPOINT";
+	char* str7 = (char*) "COST_MODEL";
 
 	const char* res1 = convertMethodToString(RANDOM);
 	const char* res2 = convertMethodToString(MAX_SPREAD);
 	const char* res3 = convertMethodToString(INCREMENTAL);
+	const char* res4 = convertMethodToString(MAX_VARIANCE);
+	const char* res5 = convertMethodToString(SAMPLED_MAX_SPREAD);
+	const char* res6 = convertMethodToString(SLIDING_MIDPOINT);
+	const char* res7 = convertMethodToString(COST_MODEL);
 
 	ASSERT_TRUE(strcmp(str1, res1) == 0);
 	ASSERT_TRUE(strcmp(str2, res2) == 0);
 	ASSERT_TRUE(strcmp(str3, res3) == 0);
+	ASSERT_TRUE(strcmp(str4, res4) == 0);
+	ASSERT_TRUE(strcmp(str5, res5) == 0);
+	ASSERT_TRUE(strcmp(str6, res6) == 0);
+	ASSERT_TRUE(strcmp(str7, res7) == 0);
+
+	return true;
+}
+
+/*
+ * @return true if each call for convertLayoutToString returns the expected value
+ * @return false otherwise
+ */
+bool layoutToStringTest() {
+	ASSERT_TRUE(strcmp(convertLayoutToString(DEPTH_FIRST), "DEPTH_FIRST") == 0);
+	ASSERT_TRUE(strcmp(convertLayoutToString(VAN_EMDE_BOAS), "VAN_EMDE_BOAS") == 0);
+	ASSERT_TRUE(convertFieldToNum((char*) "spKDTreeLayout") == 18);
+	ASSERT_TRUE(convertFieldToNum((char*) "spNumaReplication") == 19);
+	ASSERT_TRUE(convertFieldToNum((char*) "spExtractionThreads") == 20);
+	ASSERT_TRUE(convertFieldToNum((char*) "spExtractionMaxImageSide") == 21);
+	ASSERT_TRUE(convertFieldToNum((char*) "spQueryMaxImageSide") == 22);
+	ASSERT_TRUE(convertFieldToNum((char*) "spExtractionOctaveLayers") == 23);
+	ASSERT_TRUE(convertFieldToNum((char*) "spQueryOctaveLayers") == 24);
+	ASSERT_TRUE(convertFieldToNum((char*) "spExtractionEnoughFeatures") == 25);
+	ASSERT_TRUE(convertFieldToNum((char*) "spQueryEnoughFeatures") == 26);
+	ASSERT_TRUE(convertFieldToNum((char*) "spFeaturesFormat") == 27);
+	ASSERT_TRUE(strcmp(convertFeaturesFormatToString(TEXT_FEATURES),
+			"TEXT_FEATURES") == 0);
+	ASSERT_TRUE(strcmp(convertFeaturesFormatToString(BINARY_FEATURES),
+			"BINARY_FEATURES") == 0);
 
 	return true;
 }
@@ -164,6 +201,7 @@ int sp_config_utils_unit_tests() {
 	RUN_TEST(stringToIntTest);
 	RUN_TEST(fieldToNumTest);
 	RUN_TEST(methodToStringTest);
+	RUN_TEST(layoutToStringTest);
 	RUN_TEST(typeToStringTest);
 	RUN_TEST(extractFieldAndValueTest);
 
@@ -0,0 +1,244 @@
+#include "../SPDynamicKDTree.h"
+#include "unit_test_util.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "unit_tests.h"
+
+#define DYNAMIC_DIM 3
+#define DYNAMIC_IMAGES 40
+#define DYNAMIC_FEATURES 50
+#define DYNAMIC_NEIGHBORS 5
+
+/*
+ * Helper method to get pseudo random coordinates, deterministic between runs
+ */
+double nextCoor(unsigned int* seed) {
+	*seed = *seed * 1103515245u + 12345u;
+	return (double) ((*seed >> 16) % 1000);
+}
+
+/*
+ * Helper method to create the features of an image
+ */
+SPPoint* createImageFeatures(int imageIndex, unsigned int* seed) {
+	SPPoint* features = (SPPoint*) malloc(sizeof(SPPoint) * DYNAMIC_FEATURES);
+	double values[DYNAMIC_DIM];
+
+	for (int i = 0; i < DYNAMIC_FEATURES; i++) {
+		for (int j = 0; j < DYNAMIC_DIM; j++) {
+			values[j] = nextCoor(seed);
+		}
+		features[i] = spPointCreate(values, DYNAMIC_DIM, imageIndex);
+	}
+	return features;
+}
+
+/*
+ * Helper method to destroy the features of an image
+ */
+void destroyImageFeatures(SPPoint* features) {
+	for (int i = 0; i < DYNAMIC_FEATURES; i++) {
+		spPointDestroy(features[i]);
+	}
+	free(features);
+}
+
+/*
+ * Helper method to compare a search of the index, in the context if given, to a
+ * linear scan of the live images
+ */
+bool matchesLinearScan(SPDynamicKDTree* tree, SPPoint** images, bool* live,
+		SPPoint query, SPKDTreeSearchContext* context) {
+	SPBPQueue expected = spBPQueueCreate(DYNAMIC_NEIGHBORS);
+	SPBPQueue actual = (context == NULL) ?
+			spDynamicKDTreeNearestNeighbor(tree, query, DYNAMIC_NEIGHBORS) :
+			spDynamicKDTreeNearestNeighborInContext(tree, query,
+					DYNAMIC_NEIGHBORS, context);
+	SPListElement expectedElement, actualElement;
+	bool equal;
+
+	ASSERT_NOT_NULL(actual);
+	for (int i = 0; i < DYNAMIC_IMAGES; i++) {
+		for (int j = 0; live[i] && j < DYNAMIC_FEATURES; j++) {
+			expectedElement = spListElementCreate(i,
+					spPointL2SquaredDistance(images[i][j], query));
+			spBPQueueEnqueue(expected, expectedElement);
+			spListElementDestroy(expectedElement);
+		}
+	}
+
+	equal = (spBPQueueSize(expected) == spBPQueueSize(actual));
+	while (equal && !spBPQueueIsEmpty(expected)) {
+		expectedElement = spBPQueuePeek(expected);
+		actualElement = spBPQueuePeek(actual);
+		equal = (spListElementGetValue(expectedElement)
+				== spListElementGetValue(actualElement));
+		spListElementDestroy(expectedElement);
+		spListElementDestroy(actualElement);
+		spBPQueueDequeue(expected);
+		spBPQueueDequeue(actual);
+	}
+	spBPQueueDestroy(expected);
+	spBPQueueDestroy(actual);
+	return equal;
+}
+
+/*
+ * Helper method to run a batch of queries against the index, every other query
+ * in a context kept across the batch, which grows for the first of them
+ */
+bool allQueriesMatch(SPDynamicKDTree* tree, SPPoint** images, bool* live,
+		unsigned int* seed) {
+	double values[DYNAMIC_DIM];
+	SPPoint query;
+	SPKDTreeSearchContext* context = spKDTreeSearchContextCreate(1);
+	bool equal = true;
+
+	ASSERT_NOT_NULL(context);
+	for (int i = 0; equal && i < 20; i++) {
+		for (int j = 0; j < DYNAMIC_DIM; j++) {
+			values[j] = nextCoor(seed);
+		}
+		query = spPointCreate(values, DYNAMIC_DIM, 0);
+		equal = matchesLinearScan(tree, images, live, query,
+				i % 2 == 0 ? NULL : context);
+		spPointDestroy(query);
+	}
+	spKDTreeSearchContextDestroy(context);
+	return equal;
+}
+
+/*
+ * Test invalid arguments and inserting features of the wrong image
+ */
+bool DynamicKDTreeInvalidArgs() {
+	unsigned int seed = 7;
+	SPPoint* features = createImageFeatures(1, &seed);
+	SPDynamicKDTree* tree = spDynamicKDTreeCreate(DYNAMIC_DIM, MAX_SPREAD);
+
+	ASSERT_NULL(spDynamicKDTreeCreate(0, MAX_SPREAD));
+	ASSERT_NOT_NULL(tree);
+	ASSERT_EQUALS(SP_DYNAMIC_KDTREE_INVALID_ARGUMENT,
+			spDynamicKDTreeInsert(NULL, 1, features, DYNAMIC_FEATURES));
+	ASSERT_EQUALS(SP_DYNAMIC_KDTREE_INVALID_ARGUMENT,
+			spDynamicKDTreeInsert(tree, 2, features, DYNAMIC_FEATURES));
+	ASSERT_EQUALS(SP_DYNAMIC_KDTREE_INVALID_ARGUMENT, spDynamicKDTreeDelete(tree, -1));
+	ASSERT_EQUALS(0, spDynamicKDTreeGetPointsCount(tree));
+	ASSERT_NULL(spDynamicKDTreeNearestNeighborInContext(tree, features[0],
+			DYNAMIC_NEIGHBORS, NULL));
+
+	// deleting an unknown image does nothing
+	ASSERT_EQUALS(SP_DYNAMIC_KDTREE_SUCCESS, spDynamicKDTreeDelete(tree, 3));
+	ASSERT_EQUALS(SP_DYNAMIC_KDTREE_SUCCESS,
+			spDynamicKDTreeInsert(tree, 1, features, DYNAMIC_FEATURES));
+	ASSERT_EQUALS(DYNAMIC_FEATURES, spDynamicKDTreeGetPointsCount(tree));
+
+	spDynamicKDTreeDestroy(tree);
+	destroyImageFeatures(features);
+	return true;
+}
+
+/*
+ * Test searches while images are inserted, merged and deleted
+ */
+bool DynamicKDTreeInsertDelete() {
+	unsigned int seed = 2016;
+	SPPoint* images[DYNAMIC_IMAGES];
+	bool live[DYNAMIC_IMAGES] = { false };
+	SPDynamicKDTree* tree = spDynamicKDTreeCreate(DYNAMIC_DIM, MAX_SPREAD);
+	int liveImages = 0;
+
+	ASSERT_NOT_NULL(tree);
+	for (int i = 0; i < DYNAMIC_IMAGES; i++) {
+		images[i] = createImageFeatures(i, &seed);
+	}
+
+	// insert all images, searching while merges run in the background
+	for (int i = 0; i < DYNAMIC_IMAGES; i++) {
+		ASSERT_EQUALS(SP_DYNAMIC_KDTREE_SUCCESS,
+				spDynamicKDTreeInsert(tree, i, images[i], DYNAMIC_FEATURES));
+		live[i] = true;
+		liveImages++;
+		if (i % 8 == 0) {
+			ASSERT_TRUE(allQueriesMatch(tree, images, live, &seed));
+		}
+	}
+	spDynamicKDTreeFlush(tree);
+	ASSERT_EQUALS(DYNAMIC_IMAGES * DYNAMIC_FEATURES,
+			spDynamicKDTreeGetPointsCount(tree));
+	ASSERT_TRUE(spDynamicKDTreeGetTreesCount(tree) > 0);
+	ASSERT_TRUE(allQueriesMatch(tree, images, live, &seed));
+
+	// delete every third image, deleted points must never be returned
+	for (int i = 0; i < DYNAMIC_IMAGES; i += 3) {
+		ASSERT_EQUALS(SP_DYNAMIC_KDTREE_SUCCESS, spDynamicKDTreeDelete(tree, i));
+		live[i] = false;
+		liveImages--;
+	}
+	ASSERT_EQUALS(liveImages * DYNAMIC_FEATURES, spDynamicKDTreeGetPointsCount(tree));
+	ASSERT_TRUE(allQueriesMatch(tree, images, live, &seed));
+
+	// delete most of the rest, which purges the deleted points with a full merge
+	for (int i = 1; i < DYNAMIC_IMAGES - 4; i++) {
+		if (live[i]) {
+			ASSERT_EQUALS(SP_DYNAMIC_KDTREE_SUCCESS, spDynamicKDTreeDelete(tree, i));
+			live[i] = false;
+			liveImages--;
+		}
+	}
+	spDynamicKDTreeFlush(tree);
+	ASSERT_EQUALS(liveImages * DYNAMIC_FEATURES, spDynamicKDTreeGetPointsCount(tree));
+	ASSERT_TRUE(allQueriesMatch(tree, images, live, &seed));
+
+	// purged images may be inserted again
+	ASSERT_EQUALS(SP_DYNAMIC_KDTREE_SUCCESS,
+			spDynamicKDTreeInsert(tree, 0, images[0], DYNAMIC_FEATURES));
+	live[0] = true;
+	ASSERT_TRUE(allQueriesMatch(tree, images, live, &seed));
+
+	spDynamicKDTreeDestroy(tree);
+	for (int i = 0; i < DYNAMIC_IMAGES; i++) {
+		destroyImageFeatures(images[i]);
+	}
+	return true;
+}
+
+/*
+ * Test re-inserting an image before its deleted points were purged
+ */
+bool DynamicKDTreePendingDelete() {
+	unsigned int seed = 11;
+	SPPoint* features = createImageFeatures(4, &seed);
+	SPDynamicKDTree* tree = spDynamicKDTreeCreate(DYNAMIC_DIM, RANDOM);
+	SP_DYNAMIC_KDTREE_MSG msg;
+
+	ASSERT_NOT_NULL(tree);
+	ASSERT_EQUALS(SP_DYNAMIC_KDTREE_SUCCESS,
+			spDynamicKDTreeInsert(tree, 4, features, DYNAMIC_FEATURES));
+	ASSERT_EQUALS(SP_DYNAMIC_KDTREE_SUCCESS, spDynamicKDTreeDelete(tree, 4));
+	ASSERT_EQUALS(0, spDynamicKDTreeGetPointsCount(tree));
+
+	msg = spDynamicKDTreeInsert(tree, 4, features, DYNAMIC_FEATURES);
+	if (msg == SP_DYNAMIC_KDTREE_PENDING_DELETE) {
+		spDynamicKDTreeFlush(tree);
+		msg = spDynamicKDTreeInsert(tree, 4, features, DYNAMIC_FEATURES);
+	}
+	ASSERT_EQUALS(SP_DYNAMIC_KDTREE_SUCCESS, msg);
+	ASSERT_EQUALS(DYNAMIC_FEATURES, spDynamicKDTreeGetPointsCount(tree));
+
+	spDynamicKDTreeDestroy(tree);
+	destroyImageFeatures(features);
+	return true;
+}
+
+/*
+ * main caller to tests of this module
+ */
+int sp_dynamic_kd_tree_unit_tests() {
+	RUN_TEST(DynamicKDTreeInvalidArgs);
+	RUN_TEST(DynamicKDTreeInsertDelete);
+	RUN_TEST(DynamicKDTreePendingDelete);
+
+	return 0;
+}
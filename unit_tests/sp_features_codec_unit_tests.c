@@ -0,0 +1,166 @@
+#include "../SPFeaturesCodec.h"
+#include "unit_test_util.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "unit_tests.h"
+
+#define CODEC_COUNT 100
+#define CODEC_DIM 20
+
+/*
+ * Helper method to create features spread over ranges which grow with the
+ * dimension, the first dimension being constant
+ */
+double* createCodecFeatures(unsigned int seed) {
+	double* coordinates = (double*) malloc(
+			sizeof(double) * CODEC_COUNT * CODEC_DIM);
+
+	if (coordinates == NULL) {
+		return NULL;
+	}
+	for (int i = 0; i < CODEC_COUNT; i++) {
+		for (int j = 0; j < CODEC_DIM; j++) {
+			seed = seed * 1103515245u + 12345u;
+			coordinates[i * CODEC_DIM + j] = j == 0 ? 7.25 :
+					((double) (seed >> 8) / 0x1000000 - 0.5) * j * j * 50;
+		}
+	}
+	return coordinates;
+}
+
+/*
+ * Test that every decoded coordinate is within half a step of its dimension
+ */
+bool FeaturesCodecRoundTrip() {
+	double* coordinates = createCodecFeatures(11);
+	double* decoded = (double*) malloc(sizeof(double) * CODEC_COUNT * CODEC_DIM);
+	unsigned char* data = (unsigned char*) malloc(
+			spFeaturesEncodedBound(CODEC_COUNT, CODEC_DIM));
+	double difference, tolerance;
+	size_t length;
+	int count, dim;
+	bool equal = true;
+
+	ASSERT_NOT_NULL(coordinates);
+	ASSERT_NOT_NULL(decoded);
+	ASSERT_NOT_NULL(data);
+	length = spFeaturesEncode(coordinates, CODEC_COUNT, CODEC_DIM, data);
+	ASSERT_TRUE(length <= spFeaturesEncodedBound(CODEC_COUNT, CODEC_DIM));
+	ASSERT_TRUE(spFeaturesIsEncoded(data, length));
+	ASSERT_TRUE(spFeaturesDecodeHeader(data, length, &count, &dim));
+	ASSERT_EQUALS(count, CODEC_COUNT);
+	ASSERT_EQUALS(dim, CODEC_DIM);
+	ASSERT_TRUE(spFeaturesDecode(data, length, decoded) == SP_FILE_FORMAT_SUCCESS);
+
+	for (int i = 0; i < CODEC_COUNT; i++) {
+		for (int j = 0; j < CODEC_DIM; j++) {
+			// the range of a dimension is at most j * j * 50
+			tolerance = j * j * 50.0 / ((1 << SP_CODEC_QUANTIZATION_BITS) - 1) / 2
+					+ SP_CODEC_MIN_STEP;
+			difference = decoded[i * CODEC_DIM + j] - coordinates[i * CODEC_DIM + j];
+			equal = equal && difference <= tolerance && difference >= -tolerance;
+		}
+	}
+	ASSERT_TRUE(equal);
+	// the constant dimension is exact
+	ASSERT_TRUE(decoded[5 * CODEC_DIM] == 7.25);
+
+	free(coordinates);
+	free(decoded);
+	free(data);
+	return true;
+}
+
+/*
+ * Test that dimensions over short ranges take fewer bits, and an empty image
+ */
+bool FeaturesCodecNarrowDimensions() {
+	double coordinates[6] = { 0.5, 1, 0.5, 1.000002, 0.5, 1.000004 };
+	double decoded[6];
+	unsigned char data[128];
+	size_t length;
+	int count, dim;
+
+	// the first dimension takes no bits, the second 3 bits of steps of 1e-6
+	length = spFeaturesEncode(coordinates, 3, 2, data);
+	ASSERT_TRUE(length == SP_FILE_HEADER_LENGTH + 2 * SP_CODEC_DIMENSION_HEADER_LENGTH + (3 * 3 + 7) / 8);
+	ASSERT_TRUE(spFeaturesDecode(data, length, decoded) == SP_FILE_FORMAT_SUCCESS);
+	ASSERT_TRUE(decoded[0] == 0.5 && decoded[2] == 0.5 && decoded[4] == 0.5);
+	ASSERT_TRUE(decoded[1] == 1);
+	ASSERT_TRUE(decoded[5] - 1.000004 < 1e-9 && 1.000004 - decoded[5] < 1e-9);
+
+	length = spFeaturesEncode(coordinates, 0, 2, data);
+	ASSERT_TRUE(spFeaturesDecodeHeader(data, length, &count, &dim));
+	ASSERT_EQUALS(count, 0);
+	ASSERT_EQUALS(dim, 2);
+	ASSERT_TRUE(spFeaturesDecode(data, length, decoded) == SP_FILE_FORMAT_SUCCESS);
+	return true;
+}
+
+/*
+ * Test text files, and truncated, corrupted and newer binary files
+ */
+bool FeaturesCodecInvalid() {
+	double* coordinates = createCodecFeatures(3);
+	double* decoded = (double*) malloc(sizeof(double) * CODEC_COUNT * CODEC_DIM);
+	unsigned char* data = (unsigned char*) malloc(
+			spFeaturesEncodedBound(CODEC_COUNT, CODEC_DIM) + 1);
+	SPFileHeader header;
+	size_t length;
+	int count, dim;
+
+	ASSERT_NOT_NULL(coordinates);
+	ASSERT_NOT_NULL(decoded);
+	ASSERT_NOT_NULL(data);
+	ASSERT_FALSE(spFeaturesIsEncoded("3\n2,10\n", 7));
+	ASSERT_FALSE(spFeaturesIsEncoded("SPF", 3));
+	ASSERT_FALSE(spFeaturesDecodeHeader("3\n2,10\n0.5\n", 11, &count, &dim));
+	ASSERT_TRUE(spFeaturesVerify("3\n2,10\n0.5\n", 11) == SP_FILE_FORMAT_BAD_MAGIC);
+
+	length = spFeaturesEncode(coordinates, CODEC_COUNT, CODEC_DIM, data);
+	ASSERT_TRUE(spFeaturesVerify(data, length) == SP_FILE_FORMAT_SUCCESS);
+	ASSERT_TRUE(spFeaturesDecode(data, length - 1, decoded)
+			== SP_FILE_FORMAT_TRUNCATED);
+	ASSERT_TRUE(spFeaturesVerify(data, SP_FILE_HEADER_LENGTH - 1)
+			== SP_FILE_FORMAT_TRUNCATED);
+	data[length] = 0;
+	ASSERT_TRUE(spFeaturesVerify(data, length + 1) == SP_FILE_FORMAT_INVALID);
+
+	// a flipped bit in the packed steps
+	data[length - 10] ^= 4;
+	ASSERT_TRUE(spFeaturesDecode(data, length, decoded)
+			== SP_FILE_FORMAT_CHECKSUM_MISMATCH);
+	data[length - 10] ^= 4;
+
+	// a dimension claiming more bits than the quantization has, checksummed
+	data[SP_FILE_HEADER_LENGTH + 16] = SP_CODEC_QUANTIZATION_BITS + 1;
+	ASSERT_TRUE(spFileHeaderRead(data, length, SP_CODEC_MAGIC, &header)
+			== SP_FILE_FORMAT_SUCCESS);
+	spFileHeaderWrite(&header, data + SP_FILE_HEADER_LENGTH,
+			length - SP_FILE_HEADER_LENGTH, data);
+	ASSERT_TRUE(spFeaturesVerify(data, length) == SP_FILE_FORMAT_INVALID);
+
+	// a newer version
+	data[4] = SP_FILE_FORMAT_VERSION + 1;
+	ASSERT_FALSE(spFeaturesDecodeHeader(data, length, &count, &dim));
+	ASSERT_TRUE(spFeaturesVerify(data, length)
+			== SP_FILE_FORMAT_UNSUPPORTED_VERSION);
+
+	free(coordinates);
+	free(decoded);
+	free(data);
+	return true;
+}
+
+/*
+ * main caller to tests of this module
+ */
+int sp_features_codec_unit_tests() {
+	RUN_TEST(FeaturesCodecRoundTrip);
+	RUN_TEST(FeaturesCodecNarrowDimensions);
+	RUN_TEST(FeaturesCodecInvalid);
+
+	return 0;
+}
@@ -0,0 +1,255 @@
+#include "../SPFeaturesLoader.h"
+#include "../SPConfig.h"
+#include "unit_test_util.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "unit_tests.h"
+
+#define LOADER_DIM 10
+#define LOADER_TOLERANCE 1e-6
+
+/** half a step of the quantization of the widest dimension of img0.feats **/
+#define BINARY_LOADER_TOLERANCE 0.01
+
+/*
+ * Helper method to load the features of the images of a configuration file
+ */
+SPLoadedFeatures* loadConfigFeatures(const char* configFilename,
+		int threadsCount, SP_CONFIG_MSG* msg) {
+	SPLoadedFeatures* features;
+	SPConfig config = spConfigCreate(configFilename, msg);
+
+	if (config == NULL) {
+		return NULL;
+	}
+	features = spFeaturesLoad(config, threadsCount, msg);
+	spConfigDestroy(config);
+	return features;
+}
+
+/*
+ * Helper method to check a coordinate, as "%f" printed it
+ */
+bool loadedCoordinateMatches(double coordinate, double expected) {
+	double difference = coordinate - expected;
+	return difference <= LOADER_TOLERANCE && difference >= -LOADER_TOLERANCE;
+}
+
+/*
+ * Helper method to check the features of the images of loaderConfig.txt,
+ * three images of which the second has no features
+ */
+bool loadedFeaturesMatch(int threadsCount) {
+	SP_CONFIG_MSG msg;
+	SPLoadedFeatures* features = loadConfigFeatures(
+			"./files_for_unit_tests/loaderConfig.txt", threadsCount, &msg);
+	const double* coordinates;
+	bool equal = true;
+
+	ASSERT_NOT_NULL(features);
+	ASSERT_TRUE(msg == SP_CONFIG_SUCCESS);
+	ASSERT_EQUALS(spLoadedFeaturesGetImagesCount(features), 3);
+	ASSERT_EQUALS(spLoadedFeaturesGetDim(features), LOADER_DIM);
+	ASSERT_EQUALS(spLoadedFeaturesGetCount(features, 0), 3);
+	ASSERT_EQUALS(spLoadedFeaturesGetCount(features, 1), 0);
+	ASSERT_EQUALS(spLoadedFeaturesGetCount(features, 2), 2);
+	ASSERT_EQUALS(spLoadedFeaturesGetCount(features, 3), -1);
+	ASSERT_TRUE(spLoadedFeaturesGetTotalCount(features) == 5);
+	ASSERT_NULL(spLoadedFeaturesGetCoordinates(features, -1));
+
+	// the images follow each other in a single block
+	coordinates = spLoadedFeaturesGetCoordinates(features, 0);
+	ASSERT_TRUE(spLoadedFeaturesGetCoordinates(features, 2)
+			== coordinates + 3 * LOADER_DIM);
+	ASSERT_TRUE(coordinates[0] == 1234.567891);
+	ASSERT_TRUE(coordinates[1] == -0.000001);
+	ASSERT_TRUE(coordinates[2] == 0);
+	for (int i = 0; i < 3; i++) {
+		for (int j = (i == 0 ? 3 : 0); j < LOADER_DIM; j++) {
+			equal = equal && loadedCoordinateMatches(coordinates[i * LOADER_DIM + j],
+					(i * 10 + j) * 1.5 - 40);
+		}
+	}
+	coordinates = spLoadedFeaturesGetCoordinates(features, 2);
+	for (int i = 0; i < 2; i++) {
+		for (int j = 0; j < LOADER_DIM; j++) {
+			equal = equal && loadedCoordinateMatches(coordinates[i * LOADER_DIM + j],
+					-(i + j / 8.0));
+		}
+	}
+	ASSERT_TRUE(equal);
+
+	spLoadedFeaturesDestroy(features);
+	return true;
+}
+
+/*
+ * Test loading on a single thread, on fewer threads than images, and on more
+ */
+bool FeaturesLoad() {
+	ASSERT_TRUE(loadedFeaturesMatch(1));
+	ASSERT_TRUE(loadedFeaturesMatch(2));
+	ASSERT_TRUE(loadedFeaturesMatch(8));
+	ASSERT_TRUE(loadedFeaturesMatch(0));
+	return true;
+}
+
+/*
+ * Test the points created over the loaded features
+ */
+bool FeaturesCreatePoints() {
+	SP_CONFIG_MSG msg;
+	SPLoadedFeatures* features = loadConfigFeatures(
+			"./files_for_unit_tests/loaderConfig.txt", 2, &msg);
+	SPPoint* points;
+
+	ASSERT_NOT_NULL(features);
+	ASSERT_NULL(spLoadedFeaturesCreatePoints(features, 1));
+	ASSERT_NULL(spLoadedFeaturesCreatePoints(features, 3));
+	points = spLoadedFeaturesCreatePoints(features, 2);
+	ASSERT_NOT_NULL(points);
+	for (int i = 0; i < 2; i++) {
+		ASSERT_EQUALS(spPointGetIndex(points[i]), 2);
+		ASSERT_EQUALS(spPointGetDimension(points[i]), LOADER_DIM);
+		ASSERT_TRUE(spPointGetAxisCoor(points[i], 1)
+				== spLoadedFeaturesGetCoordinates(features, 2)[i * LOADER_DIM + 1]);
+	}
+
+	// the points own their coordinates
+	spLoadedFeaturesDestroy(features);
+	ASSERT_TRUE(spPointGetAxisCoor(points[1], 8) == -2);
+	for (int i = 0; i < 2; i++) {
+		spPointDestroy(points[i]);
+	}
+	free(points);
+	return true;
+}
+
+/*
+ * Test a catalog of binary features files and a text one, against the text
+ * catalog the binary files were converted from
+ */
+bool FeaturesLoadBinary() {
+	SP_CONFIG_MSG msg;
+	SPLoadedFeatures* features = loadConfigFeatures(
+			"./files_for_unit_tests/loaderConfig.txt", 1, &msg);
+	SPLoadedFeatures* binaryFeatures = loadConfigFeatures(
+			"./files_for_unit_tests/loaderBinaryConfig.txt", 2, &msg);
+	const double* coordinates;
+	const double* binaryCoordinates;
+	double difference;
+	bool equal = true;
+
+	ASSERT_NOT_NULL(features);
+	ASSERT_NOT_NULL(binaryFeatures);
+	ASSERT_TRUE(spLoadedFeaturesGetTotalCount(binaryFeatures) == 5);
+	ASSERT_EQUALS(spLoadedFeaturesGetCount(binaryFeatures, 1), 0);
+	coordinates = spLoadedFeaturesGetCoordinates(features, 0);
+	binaryCoordinates = spLoadedFeaturesGetCoordinates(binaryFeatures, 0);
+	for (int i = 0; i < 5 * LOADER_DIM; i++) {
+		difference = binaryCoordinates[i] - coordinates[i];
+		equal = equal && difference <= BINARY_LOADER_TOLERANCE
+				&& difference >= -BINARY_LOADER_TOLERANCE;
+	}
+	ASSERT_TRUE(equal);
+
+	spLoadedFeaturesDestroy(features);
+	spLoadedFeaturesDestroy(binaryFeatures);
+	return true;
+}
+
+/*
+ * Test missing, truncated and mismatched features files, and invalid arguments
+ */
+bool FeaturesLoadFailure() {
+	SP_CONFIG_MSG msg;
+
+	ASSERT_NULL(loadConfigFeatures("./files_for_unit_tests/loaderMissingConfig.txt",
+			2, &msg));
+	ASSERT_TRUE(msg == SP_CONFIG_UNKNOWN_ERROR);
+	ASSERT_NULL(loadConfigFeatures("./files_for_unit_tests/loaderTruncatedConfig.txt",
+			1, &msg));
+	ASSERT_TRUE(msg == SP_CONFIG_UNKNOWN_ERROR);
+	ASSERT_NULL(loadConfigFeatures("./files_for_unit_tests/loaderMismatchConfig.txt",
+			1, &msg));
+	ASSERT_TRUE(msg == SP_CONFIG_UNKNOWN_ERROR);
+	ASSERT_NULL(loadConfigFeatures("./files_for_unit_tests/loaderConfig.txt",
+			-1, &msg));
+	ASSERT_TRUE(msg == SP_CONFIG_INVALID_ARGUMENT);
+	ASSERT_NULL(spFeaturesLoad(NULL, 1, &msg));
+	ASSERT_TRUE(msg == SP_CONFIG_INVALID_ARGUMENT);
+	spLoadedFeaturesDestroy(NULL);
+	return true;
+}
+
+/*
+ * Helper method to validate the features of the images of a configuration file
+ */
+int validateConfigFeatures(const char* configFilename, bool* valid,
+		long* bytes, SP_CONFIG_MSG* msg) {
+	int invalid;
+	SPConfig config = spConfigCreate(configFilename, msg);
+
+	if (config == NULL) {
+		return -1;
+	}
+	invalid = spFeaturesValidate(config, 2, valid, bytes, msg);
+	spConfigDestroy(config);
+	return invalid;
+}
+
+/*
+ * Test validating text, binary, missing, truncated, oversized and corrupted files
+ */
+bool FeaturesValidate() {
+	SP_CONFIG_MSG msg;
+	bool valid[4];
+	long bytes = 0;
+
+	ASSERT_EQUALS(validateConfigFeatures(
+			"./files_for_unit_tests/loaderBinaryConfig.txt", valid, &bytes, &msg), 0);
+	ASSERT_TRUE(msg == SP_CONFIG_SUCCESS);
+	ASSERT_TRUE(valid[0] && valid[1] && valid[2]);
+	ASSERT_TRUE(bytes > 0);
+	ASSERT_EQUALS(validateConfigFeatures(
+			"./files_for_unit_tests/loaderMissingConfig.txt", valid, NULL, &msg), 1);
+	ASSERT_TRUE(valid[0] && valid[1] && valid[2] && !valid[3]);
+	ASSERT_EQUALS(validateConfigFeatures(
+			"./files_for_unit_tests/loaderTruncatedConfig.txt", valid, NULL, &msg), 1);
+	ASSERT_FALSE(valid[0]);
+	ASSERT_EQUALS(validateConfigFeatures(
+			"./files_for_unit_tests/loaderMismatchConfig.txt", valid, NULL, &msg), 1);
+	ASSERT_FALSE(valid[0]);
+	ASSERT_EQUALS(validateConfigFeatures(
+			"./files_for_unit_tests/loaderOversizedConfig.txt", valid, NULL, &msg), 1);
+	ASSERT_FALSE(valid[0]);
+
+	// a corrupted file is rejected by the load as well
+	ASSERT_EQUALS(validateConfigFeatures(
+			"./files_for_unit_tests/loaderCorruptConfig.txt", valid, NULL, &msg), 1);
+	ASSERT_FALSE(valid[0]);
+	ASSERT_NULL(loadConfigFeatures("./files_for_unit_tests/loaderCorruptConfig.txt",
+			1, &msg));
+	ASSERT_TRUE(msg == SP_CONFIG_UNKNOWN_ERROR);
+
+	ASSERT_EQUALS(validateConfigFeatures(
+			"./files_for_unit_tests/loaderConfig.txt", NULL, NULL, &msg), -1);
+	ASSERT_TRUE(msg == SP_CONFIG_INVALID_ARGUMENT);
+	ASSERT_EQUALS(spFeaturesValidate(NULL, 1, valid, NULL, &msg), -1);
+	ASSERT_TRUE(msg == SP_CONFIG_INVALID_ARGUMENT);
+	return true;
+}
+
+/*
+ * main caller to tests of this module
+ */
+int sp_features_loader_unit_tests() {
+	RUN_TEST(FeaturesLoad);
+	RUN_TEST(FeaturesCreatePoints);
+	RUN_TEST(FeaturesLoadBinary);
+	RUN_TEST(FeaturesLoadFailure);
+	RUN_TEST(FeaturesValidate);
+
+	return 0;
+}
@@ -0,0 +1,76 @@
+#include "../SPFeaturesSerializer.h"
+#include "../SPConfig.h"
+#include "unit_test_util.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "unit_tests.h"
+
+#define SERIALIZER_DIM 10
+
+/*
+ * Helper method to read the features file of an image of a configuration file,
+ * destroying the features read
+ */
+SP_CONFIG_MSG readConfigImageFeatures(const char* configFilename, int imageIndex,
+		int* numOfFeats) {
+	SPPoint* imFeatures;
+	SP_CONFIG_MSG msg;
+	SPConfig config = spConfigCreate(configFilename, &msg);
+
+	if (config == NULL) {
+		return msg;
+	}
+	msg = readImageFeaturesFromFile(&imFeatures, numOfFeats, config, imageIndex);
+	if (msg == SP_CONFIG_SUCCESS) {
+		for (int i = 0; i < *numOfFeats; i++) {
+			if (spPointGetDimension(imFeatures[i]) != SERIALIZER_DIM
+					|| spPointGetIndex(imFeatures[i]) != imageIndex) {
+				msg = SP_CONFIG_UNKNOWN_ERROR;
+			}
+			spPointDestroy(imFeatures[i]);
+		}
+		free(imFeatures);
+	}
+	spConfigDestroy(config);
+	return msg;
+}
+
+/*
+ * Test reading text and binary files, and that truncated files and files of
+ * a dimension other than the configured one are reported invalid
+ */
+bool FeaturesSerializerRead() {
+	int count = -1;
+
+	ASSERT_TRUE(readConfigImageFeatures("./files_for_unit_tests/loaderConfig.txt",
+			0, &count) == SP_CONFIG_SUCCESS);
+	ASSERT_EQUALS(count, 3);
+	ASSERT_TRUE(readConfigImageFeatures("./files_for_unit_tests/loaderConfig.txt",
+			1, &count) == SP_CONFIG_SUCCESS);
+	ASSERT_EQUALS(count, 0);
+	ASSERT_TRUE(readConfigImageFeatures(
+			"./files_for_unit_tests/loaderBinaryConfig.txt", 0, &count)
+			== SP_CONFIG_SUCCESS);
+	ASSERT_EQUALS(count, 3);
+
+	ASSERT_TRUE(readConfigImageFeatures(
+			"./files_for_unit_tests/loaderTruncatedConfig.txt", 0, &count)
+			== SP_CONFIG_UNKNOWN_ERROR);
+	ASSERT_TRUE(readConfigImageFeatures(
+			"./files_for_unit_tests/loaderOversizedConfig.txt", 0, &count)
+			== SP_CONFIG_UNKNOWN_ERROR);
+	ASSERT_TRUE(readConfigImageFeatures(
+			"./files_for_unit_tests/loaderMissingConfig.txt", 3, &count)
+			== SP_CONFIG_UNKNOWN_ERROR);
+	return true;
+}
+
+/*
+ * main caller to tests of this module
+ */
+int sp_features_serializer_unit_tests() {
+	RUN_TEST(FeaturesSerializerRead);
+
+	return 0;
+}
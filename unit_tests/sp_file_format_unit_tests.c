@@ -0,0 +1,88 @@
+#include "../SPFileFormat.h"
+#include "unit_test_util.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "unit_tests.h"
+
+#define FORMAT_BUFFER_LENGTH 4099
+
+/*
+ * Test the CRC32C against known values, and continued over pieces
+ */
+bool FileChecksum() {
+	unsigned char* buffer = (unsigned char*) malloc(FORMAT_BUFFER_LENGTH);
+	uint32_t whole, pieces;
+
+	ASSERT_NOT_NULL(buffer);
+	ASSERT_TRUE(spFileChecksum(0, "123456789", 9) == 0xE3069283u);
+	ASSERT_TRUE(spFileChecksum(0, "", 0) == 0);
+	memset(buffer, 0, 32);
+	ASSERT_TRUE(spFileChecksum(0, buffer, 32) == 0x8A9136AAu);
+
+	for (int i = 0; i < FORMAT_BUFFER_LENGTH; i++) {
+		buffer[i] = (unsigned char) (i * 131 + 7);
+	}
+	whole = spFileChecksum(0, buffer, FORMAT_BUFFER_LENGTH);
+	// pieces which aren't whole words start and end anywhere
+	pieces = spFileChecksum(0, buffer, 3);
+	pieces = spFileChecksum(pieces, buffer + 3, 1000);
+	pieces = spFileChecksum(pieces, buffer + 1003, FORMAT_BUFFER_LENGTH - 1003);
+	ASSERT_TRUE(whole == pieces);
+	buffer[2000] ^= 1;
+	ASSERT_TRUE(spFileChecksum(0, buffer, FORMAT_BUFFER_LENGTH) != whole);
+
+	free(buffer);
+	return true;
+}
+
+/*
+ * Test a header written and read back, and the files it is verified against
+ */
+bool FileHeaderReadAndVerify() {
+	unsigned char file[SP_FILE_HEADER_LENGTH + 5];
+	SPFileHeader header, read;
+
+	memcpy(header.magic, "TEST", SP_FILE_MAGIC_LENGTH);
+	header.dim = 20;
+	header.count = 3;
+	memcpy(file + SP_FILE_HEADER_LENGTH, "abcde", 5);
+	spFileHeaderWrite(&header, file + SP_FILE_HEADER_LENGTH, 5, file);
+	ASSERT_EQUALS(header.version, SP_FILE_FORMAT_VERSION);
+	ASSERT_TRUE(header.payloadLength == 5);
+
+	ASSERT_TRUE(spFileHeaderRead(file, sizeof(file), "TEST", &read)
+			== SP_FILE_FORMAT_SUCCESS);
+	ASSERT_EQUALS(read.dim, 20);
+	ASSERT_EQUALS(read.count, 3);
+	ASSERT_TRUE(read.checksum == spFileChecksum(0, "abcde", 5));
+	ASSERT_TRUE(spFileHeaderVerify(&read, file, sizeof(file))
+			== SP_FILE_FORMAT_SUCCESS);
+	ASSERT_TRUE(spFileHeaderVerify(&read, file, sizeof(file) - 1)
+			== SP_FILE_FORMAT_TRUNCATED);
+	file[SP_FILE_HEADER_LENGTH + 4] = 'E';
+	ASSERT_TRUE(spFileHeaderVerify(&read, file, sizeof(file))
+			== SP_FILE_FORMAT_CHECKSUM_MISMATCH);
+
+	ASSERT_TRUE(spFileHeaderRead(file, sizeof(file), "FEAT", &read)
+			== SP_FILE_FORMAT_BAD_MAGIC);
+	ASSERT_TRUE(spFileHeaderRead(file, SP_FILE_HEADER_LENGTH - 1, "TEST", &read)
+			== SP_FILE_FORMAT_TRUNCATED);
+	file[4] = 0;
+	ASSERT_TRUE(spFileHeaderRead(file, sizeof(file), "TEST", &read)
+			== SP_FILE_FORMAT_UNSUPPORTED_VERSION);
+	ASSERT_TRUE(strcmp(spFileFormatDescribe(SP_FILE_FORMAT_TRUNCATED),
+			"is truncated") == 0);
+	return true;
+}
+
+/*
+ * main caller to tests of this module
+ */
+int sp_file_format_unit_tests() {
+	RUN_TEST(FileChecksum);
+	RUN_TEST(FileHeaderReadAndVerify);
+
+	return 0;
+}
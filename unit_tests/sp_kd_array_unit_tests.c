@@ -221,6 +221,323 @@ bool SplitArray() {
 	return true;
 }
 
+/*
+ * Check sorting of coordinates which differ by less than 1
+ */
+bool SortCloseValues() {
+	double values0[1] = { 0.3 };
+	double values1[1] = { 0.1 };
+	double values2[1] = { 0.2 };
+	SPPoint points[3];
+	points[0] = spPointCreate(values0, 1, 0);
+	points[1] = spPointCreate(values1, 1, 1);
+	points[2] = spPointCreate(values2, 1, 2);
+
+	SPKDArray* kdArr = spKDArrayInit(points, 3, 1);
+	ASSERT_NOT_NULL(kdArr);
+
+	ASSERT_EQUALS(spKDArrayGetPointVal(kdArr, 0, 0), 0.1);
+	ASSERT_EQUALS(spKDArrayGetPointVal(kdArr, 0, 1), 0.2);
+	ASSERT_EQUALS(spKDArrayGetPointVal(kdArr, 0, 2), 0.3);
+	ASSERT_EQUALS(spKDArrayGetMedian(kdArr, 0), 0.2);
+
+	spKDArrayDestroy(kdArr);
+	for (int i = 0; i < 3; i++) {
+		spPointDestroy(points[i]);
+	}
+	return true;
+}
+
+/*
+ * Helper function to check a split array holds exactly the given points, in any order
+ */
+bool holdsPoints(SPKDArray* kdArr, SPPoint* points, int* expected, int count) {
+	bool found;
+
+	if (spKDArrayGetPointsCount(kdArr) != count) {
+		return false;
+	}
+	for (int i = 0; i < count; i++) {
+		found = false;
+		for (int j = 0; j < count && !found; j++) {
+			found = (spPointGetIndex(spKDArrayGetPointAt(kdArr, j))
+					== spPointGetIndex(points[expected[i]]));
+		}
+		if (!found) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/*
+ * Check median and splitting of a kd-array built for selection
+ */
+bool SelectionSplitArray() {
+	SPPoint* points = fillPoints();
+	SPKDArray* kdArr = spKDArrayInitSelection(points, POINTS_SIZE, POINTS_DIM);
+	int lefts[POINTS_DIM][3] = { { 0, 2, 4 }, { 0, 4, 2 }, { 2, 0, 3 } };
+	int rights[POINTS_DIM][2] = { { 3, 1 }, { 3, 1 }, { 1, 4 } };
+
+	SPKDArray* left = NULL;
+	SPKDArray* right = NULL;
+
+	ASSERT_NOT_NULL(kdArr);
+	ASSERT_EQUALS(spKDArrayGetMedian(kdArr, 0), 3);
+	ASSERT_EQUALS(spKDArrayGetMedian(kdArr, 1), 7);
+	ASSERT_EQUALS(spKDArrayGetMedian(kdArr, 2), 5);
+
+	for (int i = 0; i < POINTS_DIM; i++) {
+		spKDArraySplit(kdArr, i, &left, &right);
+		ASSERT_NOT_NULL(left);
+		ASSERT_NOT_NULL(right);
+		ASSERT_TRUE(holdsPoints(left, points, lefts[i], 3));
+		ASSERT_TRUE(holdsPoints(right, points, rights[i], 2));
+		spKDArrayDestroy(left);
+		spKDArrayDestroy(right);
+	}
+
+	killPoints(points);
+	spKDArrayDestroy(kdArr);
+	return true;
+}
+
+/*
+ * Check kd-arrays over the points themselves, and the arrays split from them,
+ * which leave the points to the caller
+ */
+bool BorrowedArray() {
+	SPPoint* points = fillPoints();
+	SPKDArray* kdArr = spKDArrayInitBorrowed(points, POINTS_SIZE, POINTS_DIM);
+	SPKDArray* selection = spKDArrayInitSelectionBorrowed(points, POINTS_SIZE,
+			POINTS_DIM);
+	int lefts[3] = { 0, 2, 4 };
+	int rights[2] = { 3, 1 };
+	SPKDArray* left = NULL;
+	SPKDArray* right = NULL;
+
+	ASSERT_NOT_NULL(kdArr);
+	ASSERT_NOT_NULL(selection);
+	for (int i = 0; i < POINTS_SIZE; i++) {
+		ASSERT_TRUE(spKDArrayGetPointAt(kdArr, i) == points[i]);
+		ASSERT_TRUE(spKDArrayGetPointAt(selection, i) == points[i]);
+	}
+	ASSERT_EQUALS(spKDArrayGetPointVal(kdArr, 2, 0), -17);
+	ASSERT_EQUALS(spKDArrayGetMedian(selection, 0), 3);
+
+	spKDArraySplit(kdArr, 0, &left, &right);
+	ASSERT_NOT_NULL(left);
+	ASSERT_NOT_NULL(right);
+	ASSERT_TRUE(holdsPoints(left, points, lefts, 3));
+	ASSERT_TRUE(holdsPoints(right, points, rights, 2));
+	ASSERT_TRUE(spKDArrayGetPointAt(right, 1) == points[1]
+			|| spKDArrayGetPointAt(right, 0) == points[1]);
+	spKDArrayDestroy(left);
+	spKDArrayDestroy(right);
+	spKDArrayDestroy(kdArr);
+	spKDArrayDestroy(selection);
+
+	// the points are still the caller's
+	ASSERT_EQUALS(spPointGetAxisCoor(points[4], 2), 911);
+	killPoints(points);
+	return true;
+}
+
+/*
+ * Check spread and variance based dimension selection, including fractional spreads
+ */
+bool FindSampledDimensions() {
+	double values[5][3] = { { 0, 0, 0.1 }, { 0, 9, 0.9 }, { 0, 0, 0.5 },
+			{ 0, 9, 0.2 }, { 10, 0, 0.3 } };
+	SPPoint points[5];
+	unsigned int seed = 1;
+	SPKDArray* kdArr;
+	SPKDArray* fractionalArr;
+
+	for (int i = 0; i < 5; i++) {
+		points[i] = spPointCreate(values[i], 3, i);
+	}
+	kdArr = spKDArrayInit(points, 5, 2);
+
+	// dimension 0 has the widest spread, dimension 1 the highest variance
+	ASSERT_EQUALS(spKDArrayFindMaxSpreadDimension(kdArr), 0);
+	ASSERT_EQUALS(spKDArrayFindSampledMaxSpreadDimension(kdArr, &seed), 0);
+	ASSERT_EQUALS(spKDArrayFindMaxVarianceDimension(kdArr, &seed), 1);
+
+	// a spread below 1 must still beat a zero spread
+	for (int i = 0; i < 5; i++) {
+		values[i][0] = 0.25;
+		spPointDestroy(points[i]);
+		points[i] = spPointCreate(values[i], 3, i);
+	}
+	fractionalArr = spKDArrayInitSelection(points, 5, 3);
+	ASSERT_NOT_NULL(fractionalArr);
+	spKDArrayDestroy(kdArr);
+	kdArr = spKDArrayInit(points, 5, 3);
+	ASSERT_EQUALS(spKDArrayFindMaxSpreadDimension(kdArr), 1);
+	ASSERT_EQUALS(spKDArrayFindMaxSpreadDimension(fractionalArr), 1);
+
+	spKDArrayDestroy(kdArr);
+	spKDArrayDestroy(fractionalArr);
+	for (int i = 0; i < 5; i++) {
+		spPointDestroy(points[i]);
+	}
+	return true;
+}
+
+/*
+ * Check sampled dimension selection on more points than the sample size
+ */
+bool FindSampledDimensionsLarge() {
+	int count = 8 * SP_KDARRAY_SAMPLE_SIZE;
+	SPPoint* points = (SPPoint*) malloc(sizeof(SPPoint) * count);
+	double values[POINTS_DIM];
+	unsigned int seed = 7;
+	SPKDArray* kdArr;
+
+	for (int i = 0; i < count; i++) {
+		values[0] = i % 10;
+		values[1] = (i * 37) % 1000;
+		values[2] = (i % 2) * 0.5;
+		points[i] = spPointCreate(values, POINTS_DIM, i);
+	}
+	kdArr = spKDArrayInitSelection(points, count, POINTS_DIM);
+	ASSERT_NOT_NULL(kdArr);
+
+	ASSERT_EQUALS(spKDArrayFindSampledMaxSpreadDimension(kdArr, &seed), 1);
+	ASSERT_EQUALS(spKDArrayFindMaxVarianceDimension(kdArr, &seed), 1);
+
+	spKDArrayDestroy(kdArr);
+	for (int i = 0; i < count; i++) {
+		spPointDestroy(points[i]);
+	}
+	free(points);
+	return true;
+}
+
+/*
+ * Check splitting at a given rank, and the ranks found by the midpoint rule, for
+ * both kinds of kd-arrays
+ */
+bool SplitArrayAtRank() {
+	SPPoint* points = fillPoints();
+	SPKDArray* arrays[2] = { spKDArrayInit(points, POINTS_SIZE, POINTS_DIM),
+			spKDArrayInitSelection(points, POINTS_SIZE, POINTS_DIM) };
+	int lefts[1] = { 0 };
+	int rights[4] = { 2, 4, 3, 1 };
+	SPKDArray* left = NULL;
+	SPKDArray* right = NULL;
+
+	ASSERT_NOT_NULL(arrays[1]);
+	for (int i = 0; i < 2; i++) {
+		ASSERT_EQUALS(spKDArrayGetRankValue(arrays[i], 0, 0), 1);
+		ASSERT_EQUALS(spKDArrayGetRankValue(arrays[i], 0, 3), 9);
+		ASSERT_EQUALS(spKDArrayGetRankValue(arrays[i], 2, 4), 911);
+
+		// the planes at 62 and 447 leave a single point on the right
+		ASSERT_EQUALS(spKDArrayFindMidpointSplit(arrays[i], 0), 4);
+		ASSERT_EQUALS(spKDArrayFindMidpointSplit(arrays[i], 2), 4);
+
+		spKDArraySplitAt(arrays[i], 0, 0, &left, &right);
+		ASSERT_NULL(left);
+		ASSERT_NULL(right);
+		spKDArraySplitAt(arrays[i], 0, POINTS_SIZE, &left, &right);
+		ASSERT_NULL(left);
+		ASSERT_NULL(right);
+
+		spKDArraySplitAt(arrays[i], 0, 1, &left, &right);
+		ASSERT_NOT_NULL(left);
+		ASSERT_NOT_NULL(right);
+		ASSERT_TRUE(holdsPoints(left, points, lefts, 1));
+		ASSERT_TRUE(holdsPoints(right, points, rights, 4));
+		ASSERT_EQUALS(spKDArrayGetMedian(right, 0), 3);
+		spKDArrayDestroy(left);
+		spKDArrayDestroy(right);
+	}
+
+	killPoints(points);
+	spKDArrayDestroy(arrays[0]);
+	spKDArrayDestroy(arrays[1]);
+	return true;
+}
+
+/*
+ * Check the cost model splits two uneven clusters at the gap between them
+ */
+bool FindCostModelSplit() {
+	int count = SP_KDARRAY_SAMPLE_SIZE;
+	int clusterCount = 3 * count / 8;
+	SPPoint* points = (SPPoint*) malloc(sizeof(SPPoint) * count);
+	double values[POINTS_DIM] = { 0, 0, 0 };
+	unsigned int seed = 5;
+	SPKDArray* kdArr;
+
+	for (int i = 0; i < count; i++) {
+		values[1] = i < clusterCount ? i * 0.4 : 1000 + i * 0.25;
+		points[i] = spPointCreate(values, POINTS_DIM, i);
+	}
+	kdArr = spKDArrayInitSelection(points, count, POINTS_DIM);
+	ASSERT_NOT_NULL(kdArr);
+
+	ASSERT_EQUALS(spKDArrayFindCostModelSplit(kdArr, 1, &seed), clusterCount);
+	ASSERT_EQUALS(spKDArrayFindMidpointSplit(kdArr, 1), clusterCount);
+
+	spKDArrayDestroy(kdArr);
+	for (int i = 0; i < count; i++) {
+		spPointDestroy(points[i]);
+	}
+	free(points);
+	return true;
+}
+
+/*
+ * Check splitting into an arena, which borrows the points and is released by a rewind
+ */
+bool SplitArrayInArena() {
+	SPPoint* points = fillPoints();
+	SPKDArray* arrays[2] = { spKDArrayInit(points, POINTS_SIZE, POINTS_DIM),
+			spKDArrayInitSelection(points, POINTS_SIZE, POINTS_DIM) };
+	SPArena* arena = spArenaCreate(1024);
+	SPArenaMark mark;
+	SPArenaStats stats;
+	int lefts[3] = { 0, 2, 4 };
+	int rights[2] = { 3, 1 };
+	SPKDArray* left = NULL;
+	SPKDArray* right = NULL;
+	SPKDArray* leftLeft = NULL;
+	SPKDArray* leftRight = NULL;
+
+	ASSERT_NOT_NULL(arena);
+	for (int i = 0; i < 2; i++) {
+		mark = spArenaGetMark(arena);
+		spKDArraySplitInArena(arrays[i], 0, 3, arena, &left, &right);
+		ASSERT_NOT_NULL(left);
+		ASSERT_NOT_NULL(right);
+		ASSERT_TRUE(holdsPoints(left, points, lefts, 3));
+		ASSERT_TRUE(holdsPoints(right, points, rights, 2));
+		ASSERT_TRUE(spKDArrayGetPointAt(right, 0) == spKDArrayGetPointAt(arrays[i], 3));
+		ASSERT_EQUALS(spKDArrayGetMedian(left, 2), 3);
+
+		// arrays split from an arena array split again
+		spKDArraySplitInArena(left, 2, 1, arena, &leftLeft, &leftRight);
+		ASSERT_NOT_NULL(leftLeft);
+		ASSERT_EQUALS(spPointGetIndex(spKDArrayGetPointAt(leftLeft, 0)), 2);
+		ASSERT_EQUALS(spKDArrayGetPointsCount(leftRight), 2);
+		spKDArrayDestroy(left);
+		spKDArrayDestroy(right);
+
+		spArenaRewind(arena, mark);
+		spArenaGetStats(arena, &stats);
+		ASSERT_EQUALS(stats.bytesUsed, 0);
+	}
+
+	spArenaDestroy(arena);
+	spKDArrayDestroy(arrays[0]);
+	spKDArrayDestroy(arrays[1]);
+	killPoints(points);
+	return true;
+}
+
 /*
  * main tests runner
  */
@@ -233,6 +550,14 @@ int sp_kd_array_unit_tests() {
 	RUN_TEST(GetAxisMedian);
 	RUN_TEST(FindMaxSpreadDimension);
 	RUN_TEST(SplitArray);
+	RUN_TEST(SortCloseValues);
+	RUN_TEST(SelectionSplitArray);
+	RUN_TEST(BorrowedArray);
+	RUN_TEST(FindSampledDimensions);
+	RUN_TEST(FindSampledDimensionsLarge);
+	RUN_TEST(SplitArrayAtRank);
+	RUN_TEST(FindCostModelSplit);
+	RUN_TEST(SplitArrayInArena);
 	return 0;
 }
 
@@ -17,6 +17,25 @@
 		ASSERT_EQUALS(spPointGetAxisCoor(a, ii), spPointGetAxisCoor(b, ii));   \
 	}
 
+/*
+ * Helper function to step the linear congruential generator of the random
+ * tests, returning the high bits of the new seed
+ */
+unsigned int nextTreeRandom(unsigned int* seed) {
+	*seed = *seed * 1103515245u + 12345u;
+	return *seed >> 16;
+}
+
+/*
+ * Helper function to fill values with random integers in [0, modulus)
+ */
+void fillTreeRandomValues(double* values, int count, unsigned int modulus,
+		unsigned int* seed) {
+	for (int i = 0; i < count; i++) {
+		values[i] = (double) (nextTreeRandom(seed) % modulus);
+	}
+}
+
 /*
  * Helper methods to get a points array
  */
@@ -258,6 +277,537 @@ bool KDTreeSplitRandom() {
 	return true;
 }
 
+/*
+ * Helper method to check two trees find the same neighbors for every neighbors count
+ */
+bool sameNeighbors(SPKDTreeNode* expectedRoot, SPKDTreeNode* actualRoot, SPPoint H) {
+	for (int k = 1; k <= POINTS_SIZE; k++) {
+		SPBPQueue expected = spKDTreeNearestNeighbor(expectedRoot, H, k);
+		SPBPQueue actual = spKDTreeNearestNeighbor(actualRoot, H, k);
+		ASSERT_EQUALS(spBPQueueSize(expected), spBPQueueSize(actual));
+		while (!spBPQueueIsEmpty(expected)) {
+			SPListElement expectedElement = spBPQueuePeek(expected);
+			SPListElement actualElement = spBPQueuePeek(actual);
+			ASSERT_EQUALS(spListElementGetIndex(expectedElement),
+					spListElementGetIndex(actualElement));
+			spListElementDestroy(expectedElement);
+			spListElementDestroy(actualElement);
+			spBPQueueDequeue(expected);
+			spBPQueueDequeue(actual);
+		}
+		spBPQueueDestroy(expected);
+		spBPQueueDestroy(actual);
+	}
+	return true;
+}
+
+/*
+ * Test a tree built by median selection finds the same neighbors as a presorted one
+ */
+bool KDTreeSelectionBuild() {
+	SPPoint* points = fillTreePoints();
+	SPKDArray* sortedArr = spKDArrayInit(points, POINTS_SIZE, POINTS_DIM);
+	SPKDArray* selectionArr = spKDArrayInitSelection(points, POINTS_SIZE, POINTS_DIM);
+	ASSERT_NOT_NULL(selectionArr);
+
+	SPKDTreeNode* sortedRoot = spKDTreeInit(sortedArr, MAX_SPREAD);
+	SPKDTreeNode* selectionRoot = spKDTreeInit(selectionArr, MAX_SPREAD);
+	ASSERT_NOT_NULL(selectionRoot);
+
+	double values[] = { 2, 3, 1, -1 };
+	SPPoint H = spPointCreate(values, POINTS_DIM, 7);
+
+	ASSERT_TRUE(sameNeighbors(sortedRoot, selectionRoot, H));
+
+	spKDTreeDestroy(sortedRoot);
+	spKDTreeDestroy(selectionRoot);
+	spPointDestroy(H);
+	spKDArrayDestroy(sortedArr);
+	spKDArrayDestroy(selectionArr);
+	killTreePoints(points);
+
+	return true;
+}
+
+/*
+ * Test trees split by the sampled methods find the same neighbors as max spread
+ */
+bool KDTreeSplitSampled() {
+	SPPoint* points = fillTreePoints();
+	SPKDArray* kdArr = spKDArrayInit(points, POINTS_SIZE, POINTS_DIM);
+	SPKDTreeNode* expectedRoot = spKDTreeInit(kdArr, MAX_SPREAD);
+	SPKDTreeNode* varianceRoot = spKDTreeInit(kdArr, MAX_VARIANCE);
+	SPKDTreeNode* sampledRoot = spKDTreeInit(kdArr, SAMPLED_MAX_SPREAD);
+	ASSERT_NOT_NULL(varianceRoot);
+	ASSERT_NOT_NULL(sampledRoot);
+
+	double values[] = { 2, 3, 1, -1 };
+	SPPoint H = spPointCreate(values, POINTS_DIM, 7);
+
+	ASSERT_TRUE(sameNeighbors(expectedRoot, varianceRoot, H));
+	ASSERT_TRUE(sameNeighbors(expectedRoot, sampledRoot, H));
+
+	spKDTreeDestroy(expectedRoot);
+	spKDTreeDestroy(varianceRoot);
+	spKDTreeDestroy(sampledRoot);
+	spPointDestroy(H);
+	spKDArrayDestroy(kdArr);
+	killTreePoints(points);
+
+	return true;
+}
+
+/*
+ * Test trees split away from the median find the same neighbors as max spread,
+ * and count the nodes they visit
+ */
+bool KDTreeSplitPositions() {
+	SPPoint* points = fillTreePoints();
+	SPKDArray* kdArr = spKDArrayInit(points, POINTS_SIZE, POINTS_DIM);
+	SPKDTreeNode* expectedRoot = spKDTreeInit(kdArr, MAX_SPREAD);
+	SPKDTreeNode* midpointRoot = spKDTreeInit(kdArr, SLIDING_MIDPOINT);
+	SPKDTreeNode* costRoot = spKDTreeInit(kdArr, COST_MODEL);
+	SPKDTreeSearchStats stats = { 0, 0 };
+	SPBPQueue bpq;
+	ASSERT_NOT_NULL(midpointRoot);
+	ASSERT_NOT_NULL(costRoot);
+
+	double values[] = { 2, 3, 1, -1 };
+	SPPoint H = spPointCreate(values, POINTS_DIM, 7);
+
+	ASSERT_TRUE(sameNeighbors(expectedRoot, midpointRoot, H));
+	ASSERT_TRUE(sameNeighbors(expectedRoot, costRoot, H));
+
+	// a search for all the points visits every node of the tree
+	bpq = spKDTreeNearestNeighborWithStats(midpointRoot, H, POINTS_SIZE, &stats);
+	ASSERT_NOT_NULL(bpq);
+	ASSERT_EQUALS(stats.leavesVisited, POINTS_SIZE);
+	ASSERT_EQUALS(stats.nodesVisited, 2 * POINTS_SIZE - 1);
+	spBPQueueDestroy(bpq);
+
+	spKDTreeDestroy(expectedRoot);
+	spKDTreeDestroy(midpointRoot);
+	spKDTreeDestroy(costRoot);
+	spPointDestroy(H);
+	spKDArrayDestroy(kdArr);
+	killTreePoints(points);
+
+	return true;
+}
+
+/*
+ * Helper function to compare a tree search to a linear scan of the points, by distance
+ */
+bool matchesScan(SPKDTreeNode* root, SPPoint* points, int count, SPPoint query,
+		int neighborsCount) {
+	SPBPQueue expected = spBPQueueCreate(neighborsCount);
+	SPBPQueue actual = spKDTreeNearestNeighbor(root, query, neighborsCount);
+	SPListElement element;
+	bool equal;
+
+	for (int i = 0; i < count; i++) {
+		element = spListElementCreate(i, spPointL2SquaredDistance(points[i], query));
+		spBPQueueEnqueue(expected, element);
+		spListElementDestroy(element);
+	}
+	equal = (spBPQueueSize(expected) == spBPQueueSize(actual));
+	while (equal && !spBPQueueIsEmpty(expected)) {
+		equal = (spBPQueueMinValue(expected) == spBPQueueMinValue(actual));
+		spBPQueueDequeue(expected);
+		spBPQueueDequeue(actual);
+	}
+	spBPQueueDestroy(expected);
+	spBPQueueDestroy(actual);
+	return equal;
+}
+
+/*
+ * Test searches in a higher dimension, where the bound on the distance to a cell
+ * accumulates over many splitting dimensions, against a linear scan
+ */
+bool KDTreeSearchHighDimension() {
+	int count = 400, dim = 12;
+	SPPoint* points = (SPPoint*) malloc(sizeof(SPPoint) * count);
+	double values[12];
+	unsigned int seed = 99;
+	SPKDArray* kdArr;
+	SPKDTreeNode* roots[2];
+	SPPoint query;
+
+	for (int i = 0; i < count; i++) {
+		fillTreeRandomValues(values, dim, 100, &seed);
+		points[i] = spPointCreate(values, dim, i);
+	}
+	kdArr = spKDArrayInit(points, count, dim);
+	roots[0] = spKDTreeInit(kdArr, MAX_SPREAD);
+	roots[1] = spKDTreeInit(kdArr, INCREMENTAL);
+	ASSERT_NOT_NULL(roots[0]);
+	ASSERT_NOT_NULL(roots[1]);
+
+	for (int q = 0; q < 40; q++) {
+		for (int j = 0; j < dim; j++) {
+			values[j] = (double) (nextTreeRandom(&seed) % 120) - 10;
+		}
+		query = spPointCreate(values, dim, 0);
+		ASSERT_TRUE(matchesScan(roots[0], points, count, query, 7));
+		ASSERT_TRUE(matchesScan(roots[1], points, count, query, 7));
+		spPointDestroy(query);
+	}
+
+	spKDTreeDestroy(roots[0]);
+	spKDTreeDestroy(roots[1]);
+	spKDArrayDestroy(kdArr);
+	for (int i = 0; i < count; i++) {
+		spPointDestroy(points[i]);
+	}
+	free(points);
+	return true;
+}
+
+/*
+ * Test a tree stored in van Emde Boas order does the same searches as one stored
+ * in depth first order, for balanced and unbalanced trees
+ */
+bool KDTreeLayouts() {
+	int count = 300, dim = 3;
+	SPPoint* points = (SPPoint*) malloc(sizeof(SPPoint) * count);
+	double values[3];
+	unsigned int seed = 7;
+	SPKDArray* kdArr;
+	SPKDTreeNode* roots[2];
+	SPArenaStats stats[2];
+	SPKDTreeSearchStats searchStats[2];
+	SplitMethod methods[2] = { MAX_SPREAD, SLIDING_MIDPOINT };
+	SPBPQueue bpq;
+	SPPoint query;
+
+	// squared coordinates make the sliding midpoint tree unbalanced
+	for (int i = 0; i < count; i++) {
+		fillTreeRandomValues(values, dim, 50, &seed);
+		for (int j = 0; j < dim; j++) {
+			values[j] *= values[j];
+		}
+		points[i] = spPointCreate(values, dim, i);
+	}
+	kdArr = spKDArrayInit(points, count, dim);
+
+	for (int m = 0; m < 2; m++) {
+		roots[0] = spKDTreeInitWithLayout(kdArr, methods[m], DEPTH_FIRST);
+		roots[1] = spKDTreeInitWithLayout(kdArr, methods[m], VAN_EMDE_BOAS);
+		ASSERT_NOT_NULL(roots[0]);
+		ASSERT_NOT_NULL(roots[1]);
+
+		// the copy takes the memory of the tree, in a single block
+		spKDTreeGetMemoryStats(roots[0], &stats[0]);
+		spKDTreeGetMemoryStats(roots[1], &stats[1]);
+		ASSERT_EQUALS(stats[1].blocksCount, 1);
+		ASSERT_EQUALS(stats[1].allocationsCount, stats[0].allocationsCount);
+		ASSERT_EQUALS(stats[1].bytesUsed, stats[0].bytesUsed);
+
+		for (int q = 0; q < 30; q++) {
+			fillTreeRandomValues(values, dim, 2600, &seed);
+			query = spPointCreate(values, dim, 0);
+			ASSERT_TRUE(matchesScan(roots[1], points, count, query, 5));
+			for (int l = 0; l < 2; l++) {
+				searchStats[l].nodesVisited = 0;
+				searchStats[l].leavesVisited = 0;
+				bpq = spKDTreeNearestNeighborWithStats(roots[l], query, 5,
+						&searchStats[l]);
+				ASSERT_NOT_NULL(bpq);
+				spBPQueueDestroy(bpq);
+			}
+			ASSERT_EQUALS(searchStats[1].nodesVisited, searchStats[0].nodesVisited);
+			ASSERT_EQUALS(searchStats[1].leavesVisited, searchStats[0].leavesVisited);
+			spPointDestroy(query);
+		}
+		spKDTreeDestroy(roots[0]);
+		spKDTreeDestroy(roots[1]);
+	}
+
+	spKDArrayDestroy(kdArr);
+	for (int i = 0; i < count; i++) {
+		spPointDestroy(points[i]);
+	}
+	free(points);
+	return true;
+}
+
+/*
+ * Test trees whose leaves point into a block of coordinates, in both layouts,
+ * searched once their kd-array and points are gone, and a copy of them which
+ * outlives the block
+ */
+bool KDTreeBorrowed() {
+	int count = 200, dim = 4;
+	double* block = (double*) malloc(sizeof(double) * count * dim);
+	SPPoint* points = (SPPoint*) malloc(sizeof(SPPoint) * count);
+	SPPoint* views;
+	double values[4];
+	unsigned int seed = 11;
+	SPKDArray* kdArr;
+	SPKDTreeNode* roots[2];
+	SPKDTreeNode* copy;
+	SPKDTreeNode* owned;
+	SPArenaStats stats[2];
+	SPPoint query;
+
+	ASSERT_NOT_NULL(block);
+	ASSERT_NOT_NULL(points);
+	fillTreeRandomValues(block, count * dim, 1000, &seed);
+	for (int i = 0; i < count; i++) {
+		points[i] = spPointCreate(block + i * dim, dim, i);
+	}
+	views = spPointCreateArray(block, count, dim, 0);
+	ASSERT_NOT_NULL(views);
+	ASSERT_TRUE(spPointGetCoordinates(views[3]) == block + 3 * dim);
+
+	kdArr = spKDArrayInitBorrowed(views, count, dim);
+	ASSERT_NOT_NULL(kdArr);
+	roots[0] = spKDTreeInitBorrowed(kdArr, MAX_SPREAD, DEPTH_FIRST);
+	roots[1] = spKDTreeInitBorrowed(kdArr, MAX_SPREAD, VAN_EMDE_BOAS);
+	ASSERT_NOT_NULL(roots[0]);
+	ASSERT_NOT_NULL(roots[1]);
+	owned = spKDTreeInitWithLayout(kdArr, MAX_SPREAD, DEPTH_FIRST);
+	ASSERT_NOT_NULL(owned);
+	spKDArrayDestroy(kdArr);
+	spPointDestroyArray(views);
+
+	// the borrowing trees hold their nodes only
+	spKDTreeGetMemoryStats(roots[0], &stats[0]);
+	spKDTreeGetMemoryStats(owned, &stats[1]);
+	ASSERT_TRUE(stats[0].bytesUsed + count * dim * sizeof(double)
+			<= stats[1].bytesUsed);
+	copy = spKDTreeCopy(roots[1], dim, VAN_EMDE_BOAS);
+	ASSERT_NOT_NULL(copy);
+	spKDTreeGetMemoryStats(copy, &stats[0]);
+	ASSERT_EQUALS(stats[0].blocksCount, 1);
+	ASSERT_EQUALS(stats[0].bytesUsed, stats[1].bytesUsed);
+
+	for (int q = 0; q < 20; q++) {
+		fillTreeRandomValues(values, dim, 1000, &seed);
+		query = spPointCreate(values, dim, 0);
+		ASSERT_TRUE(matchesScan(roots[0], points, count, query, 5));
+		ASSERT_TRUE(matchesScan(roots[1], points, count, query, 5));
+		spPointDestroy(query);
+	}
+	spKDTreeDestroy(roots[0]);
+	spKDTreeDestroy(roots[1]);
+	spKDTreeDestroy(owned);
+
+	// the copy holds coordinates of its own
+	free(block);
+	for (int q = 0; q < 20; q++) {
+		fillTreeRandomValues(values, dim, 1000, &seed);
+		query = spPointCreate(values, dim, 0);
+		ASSERT_TRUE(matchesScan(copy, points, count, query, 5));
+		spPointDestroy(query);
+	}
+	spKDTreeDestroy(copy);
+	for (int i = 0; i < count; i++) {
+		spPointDestroy(points[i]);
+	}
+	free(points);
+	return true;
+}
+
+/*
+ * Helper predicate excluding the points of odd images
+ */
+bool isOddImage(int index, void* data) {
+	(void) data;
+	return index % 2 == 1;
+}
+
+/*
+ * Test interleaved searches find what searching one point at a time finds, and
+ * do the same work
+ */
+bool KDTreeSearchGroup() {
+	int count = 500, dim = 5, groupSize = 6;
+	SPPoint* points = (SPPoint*) malloc(sizeof(SPPoint) * count);
+	SPPoint queries[6];
+	SPKDTreeSearchContext* contexts[6];
+	SPKDTreeSearchContext* expected = spKDTreeSearchContextCreate(4);
+	SPKDTreeSearchStats groupStats = { 0, 0 }, stats = { 0, 0 };
+	double values[5];
+	unsigned int seed = 11;
+	SPKDArray* kdArr;
+	SPKDTreeNode* root;
+
+	for (int i = 0; i < count + groupSize; i++) {
+		fillTreeRandomValues(values, dim, 1000, &seed);
+		if (i < count) {
+			points[i] = spPointCreate(values, dim, i);
+		} else {
+			queries[i - count] = spPointCreate(values, dim, 0);
+		}
+	}
+	kdArr = spKDArrayInit(points, count, dim);
+	root = spKDTreeInitWithLayout(kdArr, MAX_SPREAD, VAN_EMDE_BOAS);
+	ASSERT_NOT_NULL(root);
+	for (int g = 0; g < groupSize; g++) {
+		contexts[g] = spKDTreeSearchContextCreate(4);
+		ASSERT_NOT_NULL(contexts[g]);
+	}
+
+	ASSERT_TRUE(spKDTreeSearchGroup(root, queries, groupSize, contexts, isOddImage,
+			NULL, &groupStats));
+	ASSERT_TRUE(spKDTreeSearchGroup(NULL, queries, groupSize, contexts, NULL, NULL,
+			NULL));
+	ASSERT_TRUE(spKDTreeSearchGroup(root, queries, 0, contexts, NULL, NULL, NULL));
+	ASSERT_FALSE(spKDTreeSearchGroup(root, NULL, groupSize, contexts, NULL, NULL,
+			NULL));
+	for (int g = 0; g < groupSize; g++) {
+		spKDTreeSearchContextReset(expected);
+		ASSERT_TRUE(spKDTreeSearch(root, queries[g], expected, isOddImage, NULL,
+				&stats));
+		ASSERT_EQUALS(spKDTreeSearchContextGetResultsCount(contexts[g]), 4);
+		for (int r = 0; r < 4; r++) {
+			ASSERT_EQUALS(spKDTreeSearchContextGetIndex(contexts[g], r),
+					spKDTreeSearchContextGetIndex(expected, r));
+			ASSERT_EQUALS(spKDTreeSearchContextGetIndex(contexts[g], r) % 2, 0);
+		}
+	}
+	ASSERT_EQUALS(groupStats.nodesVisited, stats.nodesVisited);
+	ASSERT_EQUALS(groupStats.leavesVisited, stats.leavesVisited);
+
+	for (int g = 0; g < groupSize; g++) {
+		spKDTreeSearchContextDestroy(contexts[g]);
+		spPointDestroy(queries[g]);
+	}
+	spKDTreeSearchContextDestroy(expected);
+	spKDTreeDestroy(root);
+	spKDArrayDestroy(kdArr);
+	for (int i = 0; i < count; i++) {
+		spPointDestroy(points[i]);
+	}
+	free(points);
+	return true;
+}
+
+/*
+ * Test a context reused for several searches, and searching two trees into one
+ * context, against a tree of all the points
+ */
+bool KDTreeSearchContext() {
+	SPPoint* points = fillTreePoints();
+	SPKDArray* kdArr = spKDArrayInit(points, POINTS_SIZE, POINTS_DIM);
+	SPKDArray* lowArr = spKDArrayInit(points, 3, POINTS_DIM);
+	SPKDArray* highArr = spKDArrayInit(points + 3, POINTS_SIZE - 3, POINTS_DIM);
+	SPKDTreeNode* root = spKDTreeInit(kdArr, MAX_SPREAD);
+	SPKDTreeNode* lowRoot = spKDTreeInit(lowArr, MAX_SPREAD);
+	SPKDTreeNode* highRoot = spKDTreeInit(highArr, INCREMENTAL);
+	SPKDTreeSearchContext* context = spKDTreeSearchContextCreate(3);
+	SPBPQueue expected;
+	SPListElement element;
+	SPArenaStats stats;
+
+	ASSERT_NULL(spKDTreeSearchContextCreate(0));
+	ASSERT_NOT_NULL(context);
+
+	// the whole tree fits a single block
+	spKDTreeGetMemoryStats(root, &stats);
+	ASSERT_EQUALS(stats.blocksCount, 1);
+	ASSERT_EQUALS(stats.allocationsCount, 2 * POINTS_SIZE - 1 + POINTS_SIZE);
+	ASSERT_TRUE(stats.bytesUsed <= stats.bytesReserved);
+	ASSERT_EQUALS(spKDTreeSearchContextGetResultsCount(context), 0);
+
+	for (int i = 0; i < POINTS_SIZE; i++) {
+		spKDTreeSearchContextReset(context);
+		ASSERT_TRUE(spKDTreeSearch(lowRoot, points[i], context, NULL, NULL, NULL));
+		ASSERT_TRUE(spKDTreeSearch(highRoot, points[i], context, NULL, NULL, NULL));
+		ASSERT_TRUE(spKDTreeSearch(NULL, points[i], context, NULL, NULL, NULL));
+		ASSERT_EQUALS(spKDTreeSearchContextGetResultsCount(context), 3);
+
+		// the point itself is the nearest
+		ASSERT_EQUALS(spKDTreeSearchContextGetIndex(context, 0), i);
+		ASSERT_EQUALS(spKDTreeSearchContextGetDistance(context, 0), 0);
+
+		// the queue dequeues its farthest element
+		expected = spKDTreeNearestNeighbor(root, points[i], 3);
+		for (int r = 2; r >= 0; r--) {
+			element = spBPQueuePeekLast(expected);
+			ASSERT_EQUALS(spKDTreeSearchContextGetIndex(context, r),
+					spListElementGetIndex(element));
+			ASSERT_EQUALS(spKDTreeSearchContextGetDistance(context, r),
+					spListElementGetValue(element));
+			spListElementDestroy(element);
+			spBPQueueDequeue(expected);
+		}
+		spBPQueueDestroy(expected);
+	}
+
+	// offered points are ordered by distance then index, and bounded
+	spKDTreeSearchContextReset(context);
+	spKDTreeSearchContextOffer(context, 9, 4);
+	spKDTreeSearchContextOffer(context, 8, 1);
+	spKDTreeSearchContextOffer(context, 7, 4);
+	spKDTreeSearchContextOffer(context, 6, 5);
+	spKDTreeSearchContextOffer(context, 5, 1);
+	ASSERT_EQUALS(spKDTreeSearchContextGetResultsCount(context), 3);
+	ASSERT_EQUALS(spKDTreeSearchContextGetIndex(context, 0), 5);
+	ASSERT_EQUALS(spKDTreeSearchContextGetIndex(context, 1), 8);
+	ASSERT_EQUALS(spKDTreeSearchContextGetIndex(context, 2), 7);
+
+	spKDTreeSearchContextDestroy(context);
+	spKDTreeDestroy(root);
+	spKDTreeDestroy(lowRoot);
+	spKDTreeDestroy(highRoot);
+	spKDArrayDestroy(kdArr);
+	spKDArrayDestroy(lowArr);
+	spKDArrayDestroy(highArr);
+	killTreePoints(points);
+	return true;
+}
+
+/*
+ * Test a single context reserved for more neighbors, then for fewer, finds what
+ * a search in a context of its own finds
+ */
+bool KDTreeSearchContextReserve() {
+	SPPoint* points = fillTreePoints();
+	SPKDArray* kdArr = spKDArrayInit(points, POINTS_SIZE, POINTS_DIM);
+	SPKDTreeNode* root = spKDTreeInit(kdArr, MAX_SPREAD);
+	SPKDTreeSearchContext* context = spKDTreeSearchContextCreate(2);
+	int counts[4] = { 2, POINTS_SIZE, 3, POINTS_SIZE + 2 };
+	SPBPQueue expected, actual;
+	SPListElement expectedElement, actualElement;
+
+	ASSERT_NOT_NULL(context);
+	ASSERT_FALSE(spKDTreeSearchContextReserve(NULL, 3));
+	ASSERT_FALSE(spKDTreeSearchContextReserve(context, 0));
+	ASSERT_NULL(spKDTreeNearestNeighborInContext(root, points[0], NULL, NULL));
+
+	for (int c = 0; c < 4; c++) {
+		ASSERT_TRUE(spKDTreeSearchContextReserve(context, counts[c]));
+		for (int i = 0; i < POINTS_SIZE; i++) {
+			expected = spKDTreeNearestNeighbor(root, points[i], counts[c]);
+			actual = spKDTreeNearestNeighborInContext(root, points[i], context, NULL);
+			ASSERT_NOT_NULL(actual);
+			ASSERT_EQUALS(spBPQueueGetMaxSize(actual), counts[c]);
+			ASSERT_EQUALS(spBPQueueSize(expected), spBPQueueSize(actual));
+			while (!spBPQueueIsEmpty(expected)) {
+				expectedElement = spBPQueuePeek(expected);
+				actualElement = spBPQueuePeek(actual);
+				ASSERT_EQUALS(spListElementGetIndex(expectedElement),
+						spListElementGetIndex(actualElement));
+				spListElementDestroy(expectedElement);
+				spListElementDestroy(actualElement);
+				spBPQueueDequeue(expected);
+				spBPQueueDequeue(actual);
+			}
+			spBPQueueDestroy(expected);
+			spBPQueueDestroy(actual);
+		}
+	}
+
+	spKDTreeSearchContextDestroy(context);
+	spKDTreeDestroy(root);
+	spKDArrayDestroy(kdArr);
+	killTreePoints(points);
+	return true;
+}
+
 /*
  * main caller to tests of this module
  */
@@ -266,7 +816,15 @@ int sp_kd_tree_unit_tests() {
 	RUN_TEST(KDTreeSplitIncremental);
 	RUN_TEST(KDTreeSplitMaxSpread);
 	RUN_TEST(KDTreeSplitRandom);
+	RUN_TEST(KDTreeSelectionBuild);
+	RUN_TEST(KDTreeSplitSampled);
+	RUN_TEST(KDTreeSplitPositions);
+	RUN_TEST(KDTreeSearchHighDimension);
+	RUN_TEST(KDTreeLayouts);
+	RUN_TEST(KDTreeBorrowed);
+	RUN_TEST(KDTreeSearchContext);
+	RUN_TEST(KDTreeSearchContextReserve);
+	RUN_TEST(KDTreeSearchGroup);
 
 	return 0;
 }
-
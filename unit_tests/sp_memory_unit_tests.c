@@ -0,0 +1,182 @@
+#include "../SPMemory.h"
+#include "../SPArena.h"
+#include "../SPKDTree.h"
+#include "../SPBPriorityQueue.h"
+#include "unit_test_util.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "unit_tests.h"
+
+#define MEMORY_POINTS 64
+#define MEMORY_DIM 3
+
+/*
+ * Helper function to get the current bytes of a subsystem
+ */
+long getMemoryCurrentBytes(SP_MEMORY_SUBSYSTEM subsystem) {
+	SPMemoryStats stats;
+	spMemoryGetStats(subsystem, &stats);
+	return stats.currentBytes;
+}
+
+/*
+ * Helper function to get the peak bytes of a subsystem
+ */
+long getMemoryPeakBytes(SP_MEMORY_SUBSYSTEM subsystem) {
+	SPMemoryStats stats;
+	spMemoryGetStats(subsystem, &stats);
+	return stats.peakBytes;
+}
+
+/*
+ * Test charges and releases, the peaks, the total and their reset
+ */
+bool MemoryChargeAndPeak() {
+	long points = getMemoryCurrentBytes(SP_MEMORY_POINT);
+	long trees = getMemoryCurrentBytes(SP_MEMORY_KD_TREE);
+	long total = getMemoryCurrentBytes(SP_MEMORY_TOTAL);
+
+	spMemoryResetPeaks();
+	ASSERT_EQUALS(getMemoryPeakBytes(SP_MEMORY_POINT), points);
+	ASSERT_EQUALS(getMemoryPeakBytes(SP_MEMORY_TOTAL), total);
+
+	spMemoryCharge(SP_MEMORY_POINT, 1000);
+	spMemoryCharge(SP_MEMORY_KD_TREE, 500);
+	spMemoryRelease(SP_MEMORY_POINT, 1000);
+	spMemoryCharge(SP_MEMORY_POINT, 200);
+	ASSERT_EQUALS(getMemoryCurrentBytes(SP_MEMORY_POINT), points + 200);
+	ASSERT_EQUALS(getMemoryPeakBytes(SP_MEMORY_POINT), points + 1000);
+	ASSERT_EQUALS(getMemoryCurrentBytes(SP_MEMORY_KD_TREE), trees + 500);
+	ASSERT_EQUALS(getMemoryCurrentBytes(SP_MEMORY_TOTAL), total + 700);
+	ASSERT_EQUALS(getMemoryPeakBytes(SP_MEMORY_TOTAL), total + 1500);
+
+	// the total and no subsystem can't be charged
+	spMemoryCharge(SP_MEMORY_TOTAL, 300);
+	spMemoryCharge(SP_MEMORY_UNCHARGED, 300);
+	ASSERT_EQUALS(getMemoryCurrentBytes(SP_MEMORY_TOTAL), total + 700);
+
+	spMemoryResetPeaks();
+	ASSERT_EQUALS(getMemoryPeakBytes(SP_MEMORY_POINT), points + 200);
+	spMemoryRelease(SP_MEMORY_POINT, 200);
+	spMemoryRelease(SP_MEMORY_KD_TREE, 500);
+	ASSERT_EQUALS(getMemoryCurrentBytes(SP_MEMORY_TOTAL), total);
+	ASSERT_EQUALS(getMemoryPeakBytes(SP_MEMORY_TOTAL), total + 700);
+
+	ASSERT_TRUE(strcmp(spMemoryGetName(SP_MEMORY_KD_ARRAY), "kd-arrays") == 0);
+	ASSERT_TRUE(strcmp(spMemoryGetName(SP_MEMORY_TOTAL), "total") == 0);
+	return true;
+}
+
+/*
+ * Test an arena is charged for its blocks, to the subsystem it is moved to
+ */
+bool MemoryArena() {
+	long trees = getMemoryCurrentBytes(SP_MEMORY_KD_TREE);
+	long arrays = getMemoryCurrentBytes(SP_MEMORY_KD_ARRAY);
+	SPArena* arena = spArenaCreate(256);
+	SPArenaStats stats;
+
+	ASSERT_NOT_NULL(arena);
+	ASSERT_NOT_NULL(spArenaAlloc(arena, 100));
+	ASSERT_EQUALS(getMemoryCurrentBytes(SP_MEMORY_KD_TREE), trees);
+
+	spArenaChargeTo(arena, SP_MEMORY_KD_TREE);
+	ASSERT_NOT_NULL(spArenaAlloc(arena, 1000));
+	spArenaGetStats(arena, &stats);
+	ASSERT_EQUALS(getMemoryCurrentBytes(SP_MEMORY_KD_TREE), trees + (long) stats.bytesReserved);
+
+	spArenaChargeTo(arena, SP_MEMORY_KD_ARRAY);
+	ASSERT_EQUALS(getMemoryCurrentBytes(SP_MEMORY_KD_TREE), trees);
+	ASSERT_EQUALS(getMemoryCurrentBytes(SP_MEMORY_KD_ARRAY), arrays + (long) stats.bytesReserved);
+	spArenaDestroy(arena);
+	ASSERT_EQUALS(getMemoryCurrentBytes(SP_MEMORY_KD_ARRAY), arrays);
+	return true;
+}
+
+/*
+ * Test the points, the kd-arrays, the trees and the queues charge what they
+ * hold, and release all of it once destroyed
+ */
+bool MemorySubsystems() {
+	double values[MEMORY_DIM];
+	SPPoint points[MEMORY_POINTS];
+	SPPoint* views;
+	double* block = (double*) malloc(sizeof(double) * MEMORY_POINTS * MEMORY_DIM);
+	long total = getMemoryCurrentBytes(SP_MEMORY_TOTAL);
+	long pointsBytes = getMemoryCurrentBytes(SP_MEMORY_POINT);
+	long arrays = getMemoryCurrentBytes(SP_MEMORY_KD_ARRAY);
+	long trees = getMemoryCurrentBytes(SP_MEMORY_KD_TREE);
+	long firstLists = getMemoryCurrentBytes(SP_MEMORY_LIST);
+	long lists, current;
+	SPKDArray* kdArr;
+	SPKDTreeNode* root;
+	SPArenaStats stats;
+	SPBPQueue queue;
+
+	ASSERT_NOT_NULL(block);
+	for (int i = 0; i < MEMORY_POINTS; i++) {
+		for (int j = 0; j < MEMORY_DIM; j++) {
+			values[j] = (i * 7 + j * 13) % 29;
+			block[i * MEMORY_DIM + j] = values[j];
+		}
+		points[i] = spPointCreate(values, MEMORY_DIM, i);
+	}
+	ASSERT_TRUE(getMemoryCurrentBytes(SP_MEMORY_POINT)
+			>= pointsBytes + (long) (MEMORY_POINTS * MEMORY_DIM * sizeof(double)));
+	current = getMemoryCurrentBytes(SP_MEMORY_POINT);
+	views = spPointCreateArray(block, MEMORY_POINTS, MEMORY_DIM, 0);
+	ASSERT_NOT_NULL(views);
+	ASSERT_TRUE(getMemoryCurrentBytes(SP_MEMORY_POINT) > current);
+
+	// the points of the array may be reordered, as the kd-arrays sort them
+	views[0] = views[MEMORY_POINTS - 1];
+	spPointDestroyArray(views);
+	ASSERT_EQUALS(getMemoryCurrentBytes(SP_MEMORY_POINT), current);
+
+	spMemoryResetPeaks();
+	kdArr = spKDArrayInitBorrowed(points, MEMORY_POINTS, MEMORY_DIM);
+	ASSERT_NOT_NULL(kdArr);
+	ASSERT_TRUE(getMemoryCurrentBytes(SP_MEMORY_KD_ARRAY)
+			>= arrays + (long) (MEMORY_POINTS * MEMORY_DIM * sizeof(int)));
+	root = spKDTreeInit(kdArr, MAX_SPREAD);
+	ASSERT_NOT_NULL(root);
+	spKDTreeGetMemoryStats(root, &stats);
+	ASSERT_EQUALS(getMemoryCurrentBytes(SP_MEMORY_KD_TREE), trees + (long) stats.bytesReserved);
+	// the scratch of the build is released, but counts in the peak
+	ASSERT_TRUE(getMemoryPeakBytes(SP_MEMORY_KD_ARRAY) > getMemoryCurrentBytes(SP_MEMORY_KD_ARRAY));
+	spKDArrayDestroy(kdArr);
+	ASSERT_EQUALS(getMemoryCurrentBytes(SP_MEMORY_KD_ARRAY), arrays);
+	spKDTreeDestroy(root);
+	ASSERT_EQUALS(getMemoryCurrentBytes(SP_MEMORY_KD_TREE), trees);
+
+	// the slabs of the pools are kept once allocated
+	queue = spBPQueueCreate(4);
+	spBPQueueDestroy(queue);
+	lists = getMemoryCurrentBytes(SP_MEMORY_LIST);
+	queue = spBPQueueCreate(4);
+	ASSERT_NOT_NULL(queue);
+	ASSERT_TRUE(getMemoryCurrentBytes(SP_MEMORY_LIST) > lists);
+	spBPQueueDestroy(queue);
+	ASSERT_EQUALS(getMemoryCurrentBytes(SP_MEMORY_LIST), lists);
+
+	for (int i = 0; i < MEMORY_POINTS; i++) {
+		spPointDestroy(points[i]);
+	}
+	ASSERT_EQUALS(getMemoryCurrentBytes(SP_MEMORY_POINT), pointsBytes);
+	ASSERT_EQUALS(getMemoryCurrentBytes(SP_MEMORY_TOTAL), total + lists - firstLists);
+	free(block);
+	return true;
+}
+
+/*
+ * main caller to tests of this module
+ */
+int sp_memory_unit_tests() {
+	RUN_TEST(MemoryChargeAndPeak);
+	RUN_TEST(MemoryArena);
+	RUN_TEST(MemorySubsystems);
+
+	return 0;
+}
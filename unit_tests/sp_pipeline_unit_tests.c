@@ -0,0 +1,165 @@
+#include "../SPPipeline.h"
+#include "unit_test_util.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "unit_tests.h"
+
+#define PIPELINE_ITEMS 500
+#define PIPELINE_CAPACITY 4
+#define PIPELINE_FAILING_ITEM 100
+
+/*
+ * An item of the test pipelines
+ */
+typedef struct pipeline_test_item_t {
+	int value;
+	int stagesRun;
+	int releasesCount;
+	bool done;
+} PipelineTestItem;
+
+/*
+ * Adds the value of the stage data to the item
+ */
+bool addStage(void* item, void* data) {
+	PipelineTestItem* testItem = (PipelineTestItem*) item;
+	testItem->value += *(int*) data;
+	testItem->stagesRun++;
+	return true;
+}
+
+/*
+ * Doubles the item, failing on the item whose value is the stage data if any
+ */
+bool doubleStage(void* item, void* data) {
+	PipelineTestItem* testItem = (PipelineTestItem*) item;
+	if (data != NULL && testItem->value == *(int*) data) {
+		return false;
+	}
+	testItem->value *= 2;
+	testItem->stagesRun++;
+	return true;
+}
+
+/*
+ * Marks the item done
+ */
+bool doneStage(void* item, void* data) {
+	PipelineTestItem* testItem = (PipelineTestItem*) item;
+	(void) data;
+	testItem->stagesRun++;
+	testItem->done = true;
+	return true;
+}
+
+/*
+ * Counts the releases of an item
+ */
+void releaseTestItem(void* item) {
+	((PipelineTestItem*) item)->releasesCount++;
+}
+
+/*
+ * Helper method to create the items of a run
+ */
+void initTestItems(PipelineTestItem* items, void** pointers) {
+	for (int i = 0; i < PIPELINE_ITEMS; i++) {
+		items[i].value = i;
+		items[i].stagesRun = 0;
+		items[i].releasesCount = 0;
+		items[i].done = false;
+		pointers[i] = &items[i];
+	}
+}
+
+/*
+ * Test invalid arguments, and that every item goes through all the stages
+ * once, with several workers per stage and short queues
+ */
+bool PipelineRun() {
+	int increment = 3;
+	SPPipelineStage stages[3] = {
+		{ "add", addStage, &increment, 2 },
+		{ "double", doubleStage, NULL, 3 },
+		{ "done", doneStage, NULL, 1 }
+	};
+	SPPipelineStage invalid = { "invalid", NULL, NULL, 1 };
+	PipelineTestItem items[PIPELINE_ITEMS];
+	void* pointers[PIPELINE_ITEMS];
+	SPPipelineStageStats stats;
+	SPPipeline* pipeline = spPipelineCreate(stages, 3, PIPELINE_CAPACITY,
+			releaseTestItem);
+
+	ASSERT_NULL(spPipelineCreate(stages, 0, PIPELINE_CAPACITY, NULL));
+	ASSERT_NULL(spPipelineCreate(stages, 3, 0, NULL));
+	ASSERT_NULL(spPipelineCreate(&invalid, 1, PIPELINE_CAPACITY, NULL));
+	ASSERT_NOT_NULL(pipeline);
+
+	// the pipeline may run several times
+	for (int run = 0; run < 2; run++) {
+		initTestItems(items, pointers);
+		ASSERT_TRUE(spPipelineRun(pipeline, pointers, PIPELINE_ITEMS));
+		for (int i = 0; i < PIPELINE_ITEMS; i++) {
+			ASSERT_EQUALS((i + increment) * 2, items[i].value);
+			ASSERT_EQUALS(3, items[i].stagesRun);
+			ASSERT_EQUALS(0, items[i].releasesCount);
+			ASSERT_TRUE(items[i].done);
+		}
+		for (int i = 0; i < 3; i++) {
+			ASSERT_TRUE(spPipelineGetStageStats(pipeline, i, &stats));
+			ASSERT_EQUALS(PIPELINE_ITEMS, stats.itemsCount);
+			ASSERT_EQUALS(stages[i].workersCount, stats.workersCount);
+			ASSERT_TRUE(stats.maxQueueDepth >= 1 && stats.maxQueueDepth <= PIPELINE_CAPACITY);
+			ASSERT_TRUE(stats.averageQueueDepth <= stats.maxQueueDepth);
+		}
+	}
+	ASSERT_FALSE(spPipelineGetStageStats(pipeline, 3, &stats));
+	ASSERT_TRUE(spPipelineGetElapsedSeconds(pipeline) >= 0);
+	ASSERT_TRUE(spPipelineRun(pipeline, pointers, 0));
+	pointers[0] = NULL;
+	ASSERT_FALSE(spPipelineRun(pipeline, pointers, PIPELINE_ITEMS));
+
+	spPipelineDestroy(pipeline);
+	return true;
+}
+
+/*
+ * Test that once an item fails, every item is either done or released exactly
+ * once
+ */
+bool PipelineFailure() {
+	int increment = 0;
+	int failing = PIPELINE_FAILING_ITEM * 2;
+	SPPipelineStage stages[3] = {
+		{ "add", addStage, &increment, 1 },
+		{ "double", doubleStage, NULL, 2 },
+		{ "fail", doubleStage, &failing, 2 }
+	};
+	PipelineTestItem items[PIPELINE_ITEMS];
+	void* pointers[PIPELINE_ITEMS];
+	SPPipeline* pipeline = spPipelineCreate(stages, 3, PIPELINE_CAPACITY,
+			releaseTestItem);
+
+	ASSERT_NOT_NULL(pipeline);
+	initTestItems(items, pointers);
+	ASSERT_FALSE(spPipelineRun(pipeline, pointers, PIPELINE_ITEMS));
+	ASSERT_EQUALS(1, items[PIPELINE_FAILING_ITEM].releasesCount);
+	ASSERT_EQUALS(2, items[PIPELINE_FAILING_ITEM].stagesRun);
+	for (int i = 0; i < PIPELINE_ITEMS; i++) {
+		ASSERT_TRUE(items[i].releasesCount == (items[i].stagesRun == 3 ? 0 : 1));
+	}
+
+	spPipelineDestroy(pipeline);
+	return true;
+}
+
+/*
+ * main caller to tests of this module
+ */
+int sp_pipeline_unit_tests() {
+	RUN_TEST(PipelineRun);
+	RUN_TEST(PipelineFailure);
+
+	return 0;
+}
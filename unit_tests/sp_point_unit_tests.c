@@ -0,0 +1,67 @@
+#include "../SPPoint.h"
+#include "unit_test_util.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "unit_tests.h"
+
+#define ARRAY_POINTS 5
+#define ARRAY_DIM 3
+
+/*
+ * Test points created over a block of coordinates, which are read in place
+ */
+bool PointArray() {
+	double block[ARRAY_POINTS * ARRAY_DIM];
+	SPPoint* points;
+	SPPoint copy;
+
+	for (int i = 0; i < ARRAY_POINTS * ARRAY_DIM; i++) {
+		block[i] = i;
+	}
+	ASSERT_NULL(spPointCreateArray(NULL, ARRAY_POINTS, ARRAY_DIM, 0));
+	ASSERT_NULL(spPointCreateArray(block, ARRAY_POINTS, 0, 0));
+	ASSERT_NULL(spPointCreateArray(block, ARRAY_POINTS, ARRAY_DIM, -1));
+	points = spPointCreateArray(block, ARRAY_POINTS, ARRAY_DIM, 7);
+	ASSERT_NOT_NULL(points);
+	for (int i = 0; i < ARRAY_POINTS; i++) {
+		ASSERT_EQUALS(spPointGetIndex(points[i]), 7);
+		ASSERT_EQUALS(spPointGetDimension(points[i]), ARRAY_DIM);
+		ASSERT_EQUALS(spPointGetAxisCoor(points[i], 1), i * ARRAY_DIM + 1);
+		ASSERT_TRUE(spPointGetCoordinates(points[i]) == block + i * ARRAY_DIM);
+	}
+
+	// a copy owns its coordinates, the points read the block
+	copy = spPointCopy(points[2]);
+	block[2 * ARRAY_DIM] = -1;
+	ASSERT_EQUALS(spPointGetAxisCoor(points[2], 0), -1);
+	ASSERT_EQUALS(spPointGetAxisCoor(copy, 0), 2 * ARRAY_DIM);
+
+	spPointDestroy(copy);
+	spPointDestroyArray(points);
+	return true;
+}
+
+/*
+ * Test no points are created over an empty block, which a query without
+ * features relies on, and that destroying them is then safe
+ */
+bool PointArrayEmpty() {
+	double block[ARRAY_DIM] = { 0 };
+	SPPoint* points = spPointCreateArray(block, 0, ARRAY_DIM, 0);
+
+	ASSERT_NULL(points);
+	ASSERT_NULL(spPointCreateArray(block, -1, ARRAY_DIM, 0));
+	spPointDestroyArray(points);
+	return true;
+}
+
+/*
+ * main tests runner
+ */
+int sp_point_unit_tests() {
+	RUN_TEST(PointArray);
+	RUN_TEST(PointArrayEmpty);
+
+	return 0;
+}
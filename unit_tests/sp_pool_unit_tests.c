@@ -0,0 +1,183 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "../SPPool.h"
+#include "../SPList.h"
+#include "../SPListElement.h"
+#include "unit_test_util.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "unit_tests.h"
+
+#define POOL_OBJECTS 1000
+#define POOL_SLAB_SIZE 100
+#define POOL_THREADS 4
+
+/*
+ * Test objects are distinct, aligned and reused once freed
+ */
+bool PoolAllocFree() {
+	SPPool* pool = spPoolCreate(20, POOL_SLAB_SIZE);
+	void* objects[POOL_OBJECTS];
+	SPPoolStats stats;
+	void* reused;
+
+	ASSERT_NULL(spPoolCreate(0, POOL_SLAB_SIZE));
+	ASSERT_NULL(spPoolCreate(20, 0));
+	ASSERT_NOT_NULL(pool);
+
+	for (int i = 0; i < POOL_OBJECTS; i++) {
+		objects[i] = spPoolAlloc(pool);
+		ASSERT_NOT_NULL(objects[i]);
+		ASSERT_TRUE((uintptr_t) objects[i] % sizeof(double) == 0);
+		*(int*) objects[i] = i;
+	}
+	for (int i = 0; i < POOL_OBJECTS; i++) {
+		ASSERT_EQUALS(*(int*) objects[i], i);
+	}
+	spPoolGetStats(pool, &stats);
+	ASSERT_EQUALS(stats.objectsInUse, POOL_OBJECTS);
+	ASSERT_EQUALS(stats.slabsCount, POOL_OBJECTS / POOL_SLAB_SIZE);
+	ASSERT_EQUALS(stats.objectsReserved, POOL_OBJECTS);
+
+	// a freed object is the next one allocated, without new slabs
+	spPoolFree(pool, objects[7]);
+	spPoolFree(pool, NULL);
+	reused = spPoolAlloc(pool);
+	ASSERT_TRUE(reused == objects[7]);
+	for (int i = 0; i < POOL_OBJECTS; i++) {
+		spPoolFree(pool, objects[i]);
+	}
+	for (int i = 0; i < POOL_OBJECTS; i++) {
+		objects[i] = spPoolAlloc(pool);
+	}
+	spPoolGetStats(pool, &stats);
+	ASSERT_EQUALS(stats.slabsCount, POOL_OBJECTS / POOL_SLAB_SIZE);
+	for (int i = 0; i < POOL_OBJECTS; i++) {
+		spPoolFree(pool, objects[i]);
+	}
+	spPoolGetStats(pool, &stats);
+	ASSERT_EQUALS(stats.objectsInUse, 0);
+
+	spPoolDestroy(pool);
+	return true;
+}
+
+/*
+ * The work of a thread freeing the objects allocated by another one, and
+ * allocating its own
+ */
+typedef struct sp_pool_test_task_t {
+	SPPool* pool;
+	void** objects;
+	bool failed;
+} PoolTask;
+
+void* freeAndAlloc(void* arg) {
+	PoolTask* task = (PoolTask*) arg;
+
+	for (int i = 0; i < POOL_OBJECTS; i++) {
+		spPoolFree(task->pool, task->objects[i]);
+	}
+	for (int i = 0; i < POOL_OBJECTS; i++) {
+		task->objects[i] = spPoolAlloc(task->pool);
+		task->failed = task->failed || task->objects[i] == NULL;
+	}
+	return NULL;
+}
+
+/*
+ * Test objects freed by other threads, and the freelists of exited threads,
+ * are reused
+ */
+bool PoolThreads() {
+	SPPool* pool = spPoolCreate(sizeof(double), POOL_SLAB_SIZE);
+	void* objects[POOL_THREADS][POOL_OBJECTS];
+	PoolTask tasks[POOL_THREADS];
+	pthread_t threads[POOL_THREADS];
+	SPPoolStats before, after;
+
+	ASSERT_NOT_NULL(pool);
+	for (int t = 0; t < POOL_THREADS; t++) {
+		for (int i = 0; i < POOL_OBJECTS; i++) {
+			objects[t][i] = spPoolAlloc(pool);
+			ASSERT_NOT_NULL(objects[t][i]);
+		}
+		tasks[t].pool = pool;
+		tasks[t].objects = objects[t];
+		tasks[t].failed = false;
+	}
+	spPoolGetStats(pool, &before);
+
+	for (int t = 0; t < POOL_THREADS; t++) {
+		ASSERT_EQUALS(pthread_create(&threads[t], NULL, freeAndAlloc, &tasks[t]), 0);
+	}
+	for (int t = 0; t < POOL_THREADS; t++) {
+		pthread_join(threads[t], NULL);
+		ASSERT_FALSE(tasks[t].failed);
+	}
+
+	// the objects allocated by the threads are all distinct
+	for (int t = 0; t < POOL_THREADS; t++) {
+		for (int i = 0; i < POOL_OBJECTS; i++) {
+			*(int*) objects[t][i] = t * POOL_OBJECTS + i;
+		}
+	}
+	for (int t = 0; t < POOL_THREADS; t++) {
+		for (int i = 0; i < POOL_OBJECTS; i++) {
+			ASSERT_EQUALS(*(int*) objects[t][i], t * POOL_OBJECTS + i);
+			spPoolFree(pool, objects[t][i]);
+		}
+	}
+	spPoolGetStats(pool, &after);
+	ASSERT_EQUALS(after.objectsInUse, 0);
+	ASSERT_TRUE(after.slabsCount <= before.slabsCount + POOL_THREADS);
+
+	spPoolDestroy(pool);
+	return true;
+}
+
+/*
+ * Test lists of pooled nodes and elements keep their elements
+ */
+bool PoolListElements() {
+	SPList list = spListCreate();
+	SPList copy;
+	SPListElement element;
+
+	ASSERT_NOT_NULL(list);
+	for (int i = 0; i < POOL_OBJECTS; i++) {
+		element = spListElementCreate(i, i / 2.0);
+		ASSERT_NOT_NULL(element);
+		ASSERT_EQUALS(spListInsertLast(list, element), SP_LIST_SUCCESS);
+		spListElementDestroy(element);
+	}
+	copy = spListCopy(list);
+	ASSERT_NOT_NULL(copy);
+	spListDestroy(list);
+
+	ASSERT_EQUALS(spListGetSize(copy), POOL_OBJECTS);
+	element = spListGetFirst(copy);
+	for (int i = 0; i < POOL_OBJECTS; i++) {
+		ASSERT_EQUALS(spListElementGetIndex(element), i);
+		ASSERT_EQUALS(spListElementGetValue(element), i / 2.0);
+		element = spListGetNext(copy);
+	}
+	ASSERT_NULL(element);
+
+	spListDestroy(copy);
+	return true;
+}
+
+/*
+ * main caller to tests of this module
+ */
+int sp_pool_unit_tests() {
+	RUN_TEST(PoolAllocFree);
+	RUN_TEST(PoolThreads);
+	RUN_TEST(PoolListElements);
+
+	return 0;
+}
@@ -0,0 +1,116 @@
+#include "../SPProjection.h"
+#include "unit_test_util.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "unit_tests.h"
+
+#define PROJECTION_MAX_INPUT_DIM 128
+#define PROJECTION_MAX_COUNT 9
+#define PROJECTION_TOLERANCE 1e-4
+
+/*
+ * Helper method to get a pseudo random value in [0, 1), deterministic between runs
+ */
+float nextProjectionValue(unsigned int* seed) {
+	*seed = *seed * 1103515245u + 12345u;
+	return (float) ((*seed >> 8) % 10000) / 10000;
+}
+
+/*
+ * Helper method to get the absolute value of a difference
+ */
+double projectionDistance(double a, double b) {
+	return a > b ? a - b : b - a;
+}
+
+/*
+ * Helper method to compare a projection to its definition, the input minus the
+ * mean multiplied by the eigenvectors, for every number of input vectors up to
+ * PROJECTION_MAX_COUNT, which covers partial blocks
+ */
+bool projectionMatches(int inputDim, int outputDim) {
+	float eigenvectors[SP_PROJECTION_MAX_OUTPUT_DIM * PROJECTION_MAX_INPUT_DIM];
+	float mean[PROJECTION_MAX_INPUT_DIM];
+	float input[PROJECTION_MAX_COUNT * PROJECTION_MAX_INPUT_DIM];
+	double output[PROJECTION_MAX_COUNT * SP_PROJECTION_MAX_OUTPUT_DIM + 1];
+	double expected;
+	unsigned int seed = inputDim * 31 + outputDim;
+	SPProjection* projection;
+	bool equal = true;
+
+	for (int i = 0; i < outputDim * inputDim; i++) {
+		eigenvectors[i] = nextProjectionValue(&seed) - 0.5f;
+	}
+	for (int i = 0; i < inputDim; i++) {
+		mean[i] = 100 * nextProjectionValue(&seed);
+	}
+	for (int i = 0; i < PROJECTION_MAX_COUNT * inputDim; i++) {
+		input[i] = 255 * nextProjectionValue(&seed);
+	}
+	projection = spProjectionCreate(eigenvectors, mean, inputDim, outputDim);
+	ASSERT_NOT_NULL(projection);
+	ASSERT_EQUALS(inputDim, spProjectionGetInputDim(projection));
+	ASSERT_EQUALS(outputDim, spProjectionGetOutputDim(projection));
+
+	for (int count = 0; count <= PROJECTION_MAX_COUNT; count++) {
+		// the output past the projected vectors is left alone
+		output[count * outputDim] = -1;
+		spProjectionApply(projection, input, count, output);
+		for (int i = 0; i < count; i++) {
+			for (int k = 0; k < outputDim; k++) {
+				expected = 0;
+				for (int j = 0; j < inputDim; j++) {
+					expected += ((double) input[i * inputDim + j] - mean[j])
+							* eigenvectors[k * inputDim + j];
+				}
+				equal = equal && projectionDistance(output[i * outputDim + k], expected)
+						<= PROJECTION_TOLERANCE * (1 + projectionDistance(expected, 0));
+			}
+		}
+		equal = equal && output[count * outputDim] == -1;
+	}
+
+	spProjectionDestroy(projection);
+	ASSERT_TRUE(equal);
+	return true;
+}
+
+/*
+ * Test invalid arguments
+ */
+bool ProjectionCreate() {
+	float eigenvectors[4] = { 1, 0, 0, 1 };
+	float mean[2] = { 0, 0 };
+
+	ASSERT_NULL(spProjectionCreate(NULL, mean, 2, 2));
+	ASSERT_NULL(spProjectionCreate(eigenvectors, NULL, 2, 2));
+	ASSERT_NULL(spProjectionCreate(eigenvectors, mean, 0, 2));
+	ASSERT_NULL(spProjectionCreate(eigenvectors, mean, 2, 0));
+	ASSERT_NULL(spProjectionCreate(eigenvectors, mean, 2,
+			SP_PROJECTION_MAX_OUTPUT_DIM + 1));
+	spProjectionDestroy(NULL);
+	return true;
+}
+
+/*
+ * Test projections of SIFT descriptors on the PCA dimensions, and of dimensions
+ * which don't fill the lanes of the output
+ */
+bool ProjectionApply() {
+	ASSERT_TRUE(projectionMatches(128, 20));
+	ASSERT_TRUE(projectionMatches(128, 28));
+	ASSERT_TRUE(projectionMatches(5, 3));
+	ASSERT_TRUE(projectionMatches(7, SP_PROJECTION_MAX_OUTPUT_DIM));
+	return true;
+}
+
+/*
+ * main caller to tests of this module
+ */
+int sp_projection_unit_tests() {
+	RUN_TEST(ProjectionCreate);
+	RUN_TEST(ProjectionApply);
+
+	return 0;
+}
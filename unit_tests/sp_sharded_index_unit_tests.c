@@ -0,0 +1,408 @@
+#include "../SPShardedIndex.h"
+#include "../SPKDArray.h"
+#include "../SPKDTree.h"
+#include "../SPArena.h"
+#include "../SPNuma.h"
+#include "unit_test_util.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "unit_tests.h"
+
+#define SHARDED_DIM 4
+#define SHARDED_IMAGES 12
+#define SHARDED_FEATURES 30
+#define SHARDED_SHARDS 3
+#define SHARDED_QUERIES 25
+#define SHARDED_NEIGHBORS 6
+
+/*
+ * Helper method to get pseudo random coordinates, deterministic between runs
+ */
+double nextShardedCoor(unsigned int* seed) {
+	*seed = *seed * 1103515245u + 12345u;
+	return (double) ((*seed >> 16) % 500);
+}
+
+/*
+ * Helper method to create a point with pseudo random coordinates
+ */
+SPPoint createShardedPoint(int imageIndex, unsigned int* seed) {
+	double values[SHARDED_DIM];
+
+	for (int i = 0; i < SHARDED_DIM; i++) {
+		values[i] = nextShardedCoor(seed);
+	}
+	return spPointCreate(values, SHARDED_DIM, imageIndex);
+}
+
+/*
+ * Helper method to compare queues by their values, emptying both
+ */
+bool queuesMatch(SPBPQueue expected, SPBPQueue actual) {
+	SPListElement expectedElement, actualElement;
+	bool equal = (spBPQueueSize(expected) == spBPQueueSize(actual));
+
+	while (equal && !spBPQueueIsEmpty(expected)) {
+		expectedElement = spBPQueuePeek(expected);
+		actualElement = spBPQueuePeek(actual);
+		equal = (spListElementGetValue(expectedElement)
+				== spListElementGetValue(actualElement));
+		spListElementDestroy(expectedElement);
+		spListElementDestroy(actualElement);
+		spBPQueueDequeue(expected);
+		spBPQueueDequeue(actual);
+	}
+	return equal;
+}
+
+/*
+ * Test invalid arguments and the placement of images in shards
+ */
+bool ShardedIndexAssignment() {
+	unsigned int seed = 3;
+	SPPoint features[SHARDED_FEATURES];
+	SPBPQueue results[1];
+	SPShardedIndex* index = spShardedIndexCreate(SHARDED_SHARDS, SHARDED_IMAGES,
+			SHARDED_DIM);
+
+	ASSERT_NULL(spShardedIndexCreate(0, SHARDED_IMAGES, SHARDED_DIM));
+	ASSERT_NOT_NULL(index);
+	ASSERT_EQUALS(SP_SHARDED_INDEX_INVALID_ARGUMENT,
+			spShardedIndexAssign(index, 0, SHARDED_SHARDS));
+	ASSERT_EQUALS(SP_SHARDED_INDEX_INVALID_ARGUMENT,
+			spShardedIndexSetSearchGroupSize(index, 0));
+	ASSERT_EQUALS(SP_SHARDED_INDEX_INVALID_ARGUMENT,
+			spShardedIndexSetSearchGroupSize(index, SP_SHARDED_INDEX_MAX_GROUP_SIZE + 1));
+	ASSERT_EQUALS(SP_SHARDED_INDEX_INVALID_ARGUMENT,
+			spShardedIndexAssign(index, SHARDED_IMAGES, 0));
+	ASSERT_EQUALS(SP_SHARDED_INDEX_NOT_BUILT,
+			spShardedIndexSearch(index, features, 0, 1, results));
+
+	// an explicit placement is kept
+	ASSERT_EQUALS(SP_SHARDED_INDEX_SUCCESS, spShardedIndexAssign(index, 5, 2));
+	ASSERT_EQUALS(2, spShardedIndexGetShard(index, 5));
+	ASSERT_EQUALS(-1, spShardedIndexGetShard(index, 0));
+
+	// the other images go to the shard with the fewest features
+	for (int i = 0; i < SHARDED_FEATURES; i++) {
+		features[i] = createShardedPoint(5, &seed);
+	}
+	ASSERT_EQUALS(SP_SHARDED_INDEX_SUCCESS,
+			spShardedIndexAddImage(index, 5, features, SHARDED_FEATURES));
+	for (int i = 0; i < SHARDED_FEATURES; i++) {
+		features[i] = createShardedPoint(0, &seed);
+	}
+	ASSERT_EQUALS(SP_SHARDED_INDEX_SUCCESS,
+			spShardedIndexAddImage(index, 0, features, SHARDED_FEATURES));
+	ASSERT_EQUALS(0, spShardedIndexGetShard(index, 0));
+	for (int i = 0; i < SHARDED_FEATURES; i++) {
+		features[i] = createShardedPoint(1, &seed);
+	}
+	ASSERT_EQUALS(SP_SHARDED_INDEX_SUCCESS,
+			spShardedIndexAddImage(index, 1, features, SHARDED_FEATURES));
+	ASSERT_EQUALS(1, spShardedIndexGetShard(index, 1));
+	ASSERT_EQUALS(SHARDED_FEATURES, spShardedIndexGetShardFeaturesCount(index, 2));
+
+	// an image with features can't be moved
+	ASSERT_EQUALS(SP_SHARDED_INDEX_INVALID_ARGUMENT,
+			spShardedIndexAssign(index, 1, 2));
+
+	ASSERT_EQUALS(SP_SHARDED_INDEX_SUCCESS,
+			spShardedIndexBuild(index, MAX_SPREAD, PRESORT, DEPTH_FIRST));
+	ASSERT_EQUALS(SP_SHARDED_INDEX_ALREADY_BUILT,
+			spShardedIndexAddImage(index, 3, features, 0));
+	ASSERT_EQUALS(SP_SHARDED_INDEX_INVALID_ARGUMENT,
+			spShardedIndexSetNumaReplication(NULL, true));
+	ASSERT_EQUALS(SP_SHARDED_INDEX_ALREADY_BUILT,
+			spShardedIndexSetNumaReplication(index, true));
+
+	spShardedIndexDestroy(index);
+	return true;
+}
+
+/*
+ * Helper method to test the merged results of the shards against a single
+ * kd-tree, with the trees replicated on the NUMA nodes or not, and the features
+ * added image by image or adopted in a block
+ */
+bool searchMatchesTree(bool replicate, bool adopt) {
+	unsigned int seed = 2016;
+	double* block = (double*) spArenaAllocHuge(sizeof(double)
+			* SHARDED_IMAGES * SHARDED_FEATURES * SHARDED_DIM);
+	int counts[SHARDED_IMAGES];
+	SPPoint allPoints[SHARDED_IMAGES * SHARDED_FEATURES];
+	SPPoint features[SHARDED_FEATURES];
+	SPPoint queries[SHARDED_QUERIES];
+	SPBPQueue results[SHARDED_QUERIES];
+	SPShardedIndex* index = spShardedIndexCreate(SHARDED_SHARDS, SHARDED_IMAGES,
+			SHARDED_DIM);
+	SPKDArray* kdArr;
+	SPKDTreeNode* tree;
+	SPBPQueue expected;
+	int groupSizes[3] = { 1, 4, SP_SHARDED_INDEX_MAX_GROUP_SIZE };
+	int neighborsCounts[3] = { SHARDED_NEIGHBORS, 2 * SHARDED_NEIGHBORS, 2 };
+	bool equal = true;
+
+	ASSERT_NOT_NULL(index);
+	ASSERT_NOT_NULL(block);
+	for (int i = 0; i < SHARDED_IMAGES; i++) {
+		for (int j = 0; j < SHARDED_FEATURES; j++) {
+			features[j] = createShardedPoint(i, &seed);
+			allPoints[i * SHARDED_FEATURES + j] = spPointCopy(features[j]);
+			for (int k = 0; adopt && k < SHARDED_DIM; k++) {
+				block[(i * SHARDED_FEATURES + j) * SHARDED_DIM + k] =
+						spPointGetAxisCoor(features[j], k);
+			}
+		}
+		counts[i] = SHARDED_FEATURES;
+		if (adopt) {
+			for (int j = 0; j < SHARDED_FEATURES; j++) {
+				spPointDestroy(features[j]);
+			}
+		} else {
+			ASSERT_EQUALS(SP_SHARDED_INDEX_SUCCESS,
+					spShardedIndexAddImage(index, i, features, SHARDED_FEATURES));
+		}
+	}
+	if (adopt) {
+		ASSERT_EQUALS(SP_SHARDED_INDEX_INVALID_ARGUMENT,
+				spShardedIndexAdoptFeatures(index, NULL, counts));
+		ASSERT_EQUALS(SP_SHARDED_INDEX_SUCCESS,
+				spShardedIndexAdoptFeatures(index, block, counts));
+		ASSERT_EQUALS(SP_SHARDED_INDEX_INVALID_ARGUMENT,
+				spShardedIndexAdoptFeatures(index, block, counts));
+		ASSERT_EQUALS(SP_SHARDED_INDEX_INVALID_ARGUMENT,
+				spShardedIndexAddImage(index, 0, features, 0));
+	} else {
+		ASSERT_EQUALS(SP_SHARDED_INDEX_INVALID_ARGUMENT,
+				spShardedIndexAdoptFeatures(index, block, counts));
+		spArenaFreeHuge(block);
+	}
+	for (int i = 0; i < SHARDED_SHARDS; i++) {
+		ASSERT_EQUALS(SHARDED_IMAGES * SHARDED_FEATURES / SHARDED_SHARDS,
+				spShardedIndexGetShardFeaturesCount(index, i));
+	}
+	ASSERT_EQUALS(SP_SHARDED_INDEX_SUCCESS,
+			spShardedIndexSetNumaReplication(index, replicate));
+	ASSERT_EQUALS(SP_SHARDED_INDEX_SUCCESS,
+			spShardedIndexBuild(index, INCREMENTAL, adopt ? PRESORT : SELECTION,
+					VAN_EMDE_BOAS));
+
+	kdArr = spKDArrayInit(allPoints, SHARDED_IMAGES * SHARDED_FEATURES, SHARDED_DIM);
+	tree = spKDTreeInit(kdArr, INCREMENTAL);
+	spKDArrayDestroy(kdArr);
+	for (int i = 0; i < SHARDED_QUERIES; i++) {
+		queries[i] = createShardedPoint(0, &seed);
+	}
+
+	// the queries don't divide into groups evenly, the last group is smaller, and
+	// the contexts the threads keep grow for more neighbors and serve fewer
+	for (int g = 0; g < 3; g++) {
+		ASSERT_EQUALS(SP_SHARDED_INDEX_SUCCESS,
+				spShardedIndexSetSearchGroupSize(index, groupSizes[g]));
+		ASSERT_EQUALS(SP_SHARDED_INDEX_SUCCESS,
+				spShardedIndexSearch(index, queries, SHARDED_QUERIES,
+						neighborsCounts[g], results));
+		for (int i = 0; i < SHARDED_QUERIES; i++) {
+			expected = spKDTreeNearestNeighbor(tree, queries[i], neighborsCounts[g]);
+			equal = equal && queuesMatch(expected, results[i]);
+			spBPQueueDestroy(expected);
+			spBPQueueDestroy(results[i]);
+		}
+	}
+	for (int i = 0; i < SHARDED_QUERIES; i++) {
+		spPointDestroy(queries[i]);
+	}
+
+	for (int i = 0; i < SHARDED_IMAGES * SHARDED_FEATURES; i++) {
+		spPointDestroy(allPoints[i]);
+	}
+	spKDTreeDestroy(tree);
+	spShardedIndexDestroy(index);
+	ASSERT_TRUE(equal);
+	return true;
+}
+
+/*
+ * Test the merged results of the shards against a single kd-tree
+ */
+bool ShardedIndexSearch() {
+	return searchMatchesTree(false, false);
+}
+
+/*
+ * Test the merged results of trees replicated on every NUMA node, whose queries
+ * are split between the nodes, against a single kd-tree
+ */
+bool ShardedIndexReplicatedSearch() {
+	return searchMatchesTree(true, false);
+}
+
+/*
+ * Test the merged results of shards which adopted a block of features, and
+ * whose trees point into it, against a single kd-tree
+ */
+bool ShardedIndexAdoptedSearch() {
+	return searchMatchesTree(false, true);
+}
+
+/*
+ * Test the merged results of replicas of trees which pointed into an adopted
+ * block, and hold copies of it, against a single kd-tree
+ */
+bool ShardedIndexAdoptedReplicatedSearch() {
+	return searchMatchesTree(true, true);
+}
+
+/*
+ * Test the trees are replicated even if a shard holds no features, and that
+ * the shard is searched as empty
+ */
+bool ShardedIndexReplicatedEmptyShard() {
+	unsigned int seed = 17;
+	SPPoint allPoints[SHARDED_IMAGES * SHARDED_FEATURES];
+	SPPoint features[SHARDED_FEATURES];
+	SPPoint query;
+	SPBPQueue results[1];
+	SPShardedIndex* index = spShardedIndexCreate(SHARDED_SHARDS, SHARDED_IMAGES,
+			SHARDED_DIM);
+	SPKDArray* kdArr;
+	SPKDTreeNode* tree;
+	SPBPQueue expected;
+	bool equal = true;
+
+	ASSERT_NOT_NULL(index);
+	for (int i = 0; i < SHARDED_IMAGES; i++) {
+		ASSERT_EQUALS(SP_SHARDED_INDEX_SUCCESS,
+				spShardedIndexAssign(index, i, i % (SHARDED_SHARDS - 1)));
+		for (int j = 0; j < SHARDED_FEATURES; j++) {
+			features[j] = createShardedPoint(i, &seed);
+			allPoints[i * SHARDED_FEATURES + j] = spPointCopy(features[j]);
+		}
+		ASSERT_EQUALS(SP_SHARDED_INDEX_SUCCESS,
+				spShardedIndexAddImage(index, i, features, SHARDED_FEATURES));
+	}
+	ASSERT_EQUALS(0, spShardedIndexGetShardFeaturesCount(index, SHARDED_SHARDS - 1));
+	ASSERT_EQUALS(SP_SHARDED_INDEX_SUCCESS,
+			spShardedIndexSetNumaReplication(index, true));
+	ASSERT_EQUALS(SP_SHARDED_INDEX_SUCCESS,
+			spShardedIndexBuild(index, MAX_SPREAD, PRESORT, DEPTH_FIRST));
+	ASSERT_EQUALS(spNumaGetNodesCount(), spShardedIndexGetReplicasCount(index));
+
+	kdArr = spKDArrayInit(allPoints, SHARDED_IMAGES * SHARDED_FEATURES, SHARDED_DIM);
+	tree = spKDTreeInit(kdArr, MAX_SPREAD);
+	spKDArrayDestroy(kdArr);
+	for (int i = 0; i < SHARDED_QUERIES; i++) {
+		query = createShardedPoint(0, &seed);
+		ASSERT_EQUALS(SP_SHARDED_INDEX_SUCCESS,
+				spShardedIndexSearch(index, &query, 1, SHARDED_NEIGHBORS, results));
+		expected = spKDTreeNearestNeighbor(tree, query, SHARDED_NEIGHBORS);
+		equal = equal && queuesMatch(expected, results[0]);
+		spBPQueueDestroy(expected);
+		spBPQueueDestroy(results[0]);
+		spPointDestroy(query);
+	}
+
+	for (int i = 0; i < SHARDED_IMAGES * SHARDED_FEATURES; i++) {
+		spPointDestroy(allPoints[i]);
+	}
+	spKDTreeDestroy(tree);
+	spShardedIndexDestroy(index);
+	ASSERT_TRUE(equal);
+	return true;
+}
+
+/*
+ * A search of the concurrent search test
+ */
+typedef struct sp_sharded_search_t {
+	SPShardedIndex* index;
+	SPPoint* queries;
+	SPBPQueue results[SHARDED_QUERIES];
+	SP_SHARDED_INDEX_MSG msg;
+} ShardedSearch;
+
+/*
+ * Helper method to run a search of the concurrent search test
+ */
+void* runShardedSearch(void* arg) {
+	ShardedSearch* search = (ShardedSearch*) arg;
+
+	search->msg = spShardedIndexSearch(search->index, search->queries,
+			SHARDED_QUERIES, SHARDED_NEIGHBORS, search->results);
+	return NULL;
+}
+
+/*
+ * Test threads searching an index at once, whose pool runs their searches one
+ * after the other, get the results of searching alone
+ */
+bool ShardedIndexConcurrentSearch() {
+	unsigned int seed = 5;
+	SPPoint features[SHARDED_FEATURES];
+	SPPoint queries[SHARDED_QUERIES];
+	SPBPQueue expected[SHARDED_QUERIES];
+	SPBPQueue copy;
+	ShardedSearch searches[2];
+	pthread_t thread;
+	SPShardedIndex* index = spShardedIndexCreate(SHARDED_SHARDS, SHARDED_IMAGES,
+			SHARDED_DIM);
+	bool equal = true;
+
+	ASSERT_NOT_NULL(index);
+	for (int i = 0; i < SHARDED_IMAGES; i++) {
+		for (int j = 0; j < SHARDED_FEATURES; j++) {
+			features[j] = createShardedPoint(i, &seed);
+		}
+		ASSERT_EQUALS(SP_SHARDED_INDEX_SUCCESS,
+				spShardedIndexAddImage(index, i, features, SHARDED_FEATURES));
+	}
+	ASSERT_EQUALS(SP_SHARDED_INDEX_SUCCESS,
+			spShardedIndexBuild(index, MAX_SPREAD, PRESORT, DEPTH_FIRST));
+	for (int i = 0; i < SHARDED_QUERIES; i++) {
+		queries[i] = createShardedPoint(0, &seed);
+	}
+	ASSERT_EQUALS(SP_SHARDED_INDEX_SUCCESS, spShardedIndexSearch(index, queries,
+			SHARDED_QUERIES, SHARDED_NEIGHBORS, expected));
+
+	for (int s = 0; s < 2; s++) {
+		searches[s].index = index;
+		searches[s].queries = queries;
+	}
+	ASSERT_EQUALS(0, pthread_create(&thread, NULL, runShardedSearch, &searches[0]));
+	runShardedSearch(&searches[1]);
+	pthread_join(thread, NULL);
+	for (int s = 0; s < 2; s++) {
+		ASSERT_EQUALS(SP_SHARDED_INDEX_SUCCESS, searches[s].msg);
+	}
+	for (int i = 0; i < SHARDED_QUERIES; i++) {
+		copy = spBPQueueCopy(expected[i]);
+		equal = equal && queuesMatch(copy, searches[0].results[i]);
+		equal = equal && queuesMatch(expected[i], searches[1].results[i]);
+		spBPQueueDestroy(copy);
+		spBPQueueDestroy(searches[0].results[i]);
+		spBPQueueDestroy(searches[1].results[i]);
+		spBPQueueDestroy(expected[i]);
+		spPointDestroy(queries[i]);
+	}
+	spShardedIndexDestroy(index);
+	ASSERT_TRUE(equal);
+	return true;
+}
+
+/*
+ * main caller to tests of this module
+ */
+int sp_sharded_index_unit_tests() {
+	RUN_TEST(ShardedIndexAssignment);
+	RUN_TEST(ShardedIndexSearch);
+	RUN_TEST(ShardedIndexReplicatedSearch);
+	RUN_TEST(ShardedIndexAdoptedSearch);
+	RUN_TEST(ShardedIndexAdoptedReplicatedSearch);
+	RUN_TEST(ShardedIndexReplicatedEmptyShard);
+	RUN_TEST(ShardedIndexConcurrentSearch);
+
+	return 0;
+}
@@ -0,0 +1,162 @@
+#include "../SPTokenizer.h"
+#include "unit_test_util.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "unit_tests.h"
+
+#define TOKENIZER_WORD_SIZE 16
+
+/*
+ * Helper method to parse a single number with the tokenizer and with strtod
+ */
+bool tokenizerNumberMatches(const char* text) {
+	SPTokenizer tokenizer;
+	double value;
+
+	spTokenizerInit(&tokenizer, text);
+	ASSERT_TRUE(spTokenizerReadDouble(&tokenizer, &value));
+	ASSERT_TRUE(value == strtod(text, NULL));
+	ASSERT_TRUE(spTokenizerAtEnd(&tokenizer));
+	return true;
+}
+
+/*
+ * Test numbers as "%f" prints them, which are rounded exactly, and others
+ */
+bool TokenizerReadDouble() {
+	char text[64];
+	unsigned int seed = 7;
+
+	ASSERT_TRUE(tokenizerNumberMatches("0.000000"));
+	ASSERT_TRUE(tokenizerNumberMatches("-0.000001"));
+	ASSERT_TRUE(tokenizerNumberMatches("1234.567891"));
+	ASSERT_TRUE(tokenizerNumberMatches("+17"));
+	ASSERT_TRUE(tokenizerNumberMatches(".5"));
+	ASSERT_TRUE(tokenizerNumberMatches("5."));
+	ASSERT_TRUE(tokenizerNumberMatches("2.5e3"));
+	ASSERT_TRUE(tokenizerNumberMatches("2.5E-3"));
+	ASSERT_TRUE(tokenizerNumberMatches("9007199254740993"));
+	for (int i = 0; i < 1000; i++) {
+		seed = seed * 1103515245u + 12345u;
+		sprintf(text, "%f", ((int) (seed >> 4) - (1 << 27)) / 1024.0 / 7);
+		ASSERT_TRUE(tokenizerNumberMatches(text));
+	}
+	return true;
+}
+
+/*
+ * Test numbers whose mantissa or exponent isn't exact, which are within an ulp
+ */
+bool TokenizerReadInexactDouble() {
+	const char* texts[] = { "3.14159265358979323846", "1e300", "-2.5e-300",
+			"123456789012345678901234567890", "1e-400" };
+	SPTokenizer tokenizer;
+	double value, expected;
+
+	for (int i = 0; i < 5; i++) {
+		spTokenizerInit(&tokenizer, texts[i]);
+		ASSERT_TRUE(spTokenizerReadDouble(&tokenizer, &value));
+		expected = strtod(texts[i], NULL);
+		ASSERT_TRUE(value == expected
+				|| ((value - expected) / expected < 1e-15
+						&& (expected - value) / expected < 1e-15));
+	}
+	return true;
+}
+
+/*
+ * Test integers, and the positions of the tokens which fail
+ */
+bool TokenizerReadInt() {
+	SPTokenizer tokenizer;
+	double number;
+	int value;
+
+	spTokenizerInit(&tokenizer, "12\n  -3,+4\n\n 2147483648 x");
+	ASSERT_TRUE(spTokenizerReadInt(&tokenizer, &value));
+	ASSERT_EQUALS(value, 12);
+	ASSERT_TRUE(spTokenizerReadInt(&tokenizer, &value));
+	ASSERT_EQUALS(value, -3);
+	ASSERT_FALSE(spTokenizerReadInt(&tokenizer, &value));
+	ASSERT_EQUALS(spTokenizerGetLine(&tokenizer), 2);
+	ASSERT_EQUALS(spTokenizerGetColumn(&tokenizer), 5);
+	ASSERT_TRUE(spTokenizerExpect(&tokenizer, ','));
+	ASSERT_TRUE(spTokenizerReadInt(&tokenizer, &value));
+	ASSERT_EQUALS(value, 4);
+	ASSERT_FALSE(spTokenizerReadInt(&tokenizer, &value));
+	ASSERT_EQUALS(spTokenizerGetLine(&tokenizer), 4);
+	ASSERT_EQUALS(spTokenizerGetColumn(&tokenizer), 2);
+	ASSERT_TRUE(spTokenizerReadDouble(&tokenizer, &number));
+	ASSERT_FALSE(spTokenizerReadDouble(&tokenizer, &number));
+	ASSERT_EQUALS(spTokenizerGetColumn(&tokenizer), 13);
+	ASSERT_FALSE(spTokenizerAtEnd(&tokenizer));
+	return true;
+}
+
+/*
+ * Test words and lines, as the configuration file is read
+ */
+bool TokenizerReadWordsAndLines() {
+	SPTokenizer tokenizer;
+	char word[TOKENIZER_WORD_SIZE];
+
+	spTokenizerInit(&tokenizer, " spKNN =\t4 \r\n#comment\nspImagesDirectoryIsLong=x");
+	ASSERT_EQUALS(spTokenizerReadWord(&tokenizer, "=", word, TOKENIZER_WORD_SIZE), 5);
+	ASSERT_TRUE(strcmp(word, "spKNN") == 0);
+	ASSERT_FALSE(spTokenizerExpect(&tokenizer, ':'));
+	ASSERT_TRUE(spTokenizerExpect(&tokenizer, '='));
+	ASSERT_EQUALS(spTokenizerReadWord(&tokenizer, "", word, TOKENIZER_WORD_SIZE), 1);
+	ASSERT_TRUE(strcmp(word, "4") == 0);
+	ASSERT_TRUE(spTokenizerAtLineEnd(&tokenizer));
+	ASSERT_EQUALS(spTokenizerReadLine(&tokenizer, word, TOKENIZER_WORD_SIZE), 0);
+	ASSERT_EQUALS(spTokenizerReadLine(&tokenizer, word, TOKENIZER_WORD_SIZE), 8);
+	ASSERT_TRUE(strcmp(word, "#comment") == 0);
+	ASSERT_EQUALS(spTokenizerReadWord(&tokenizer, "=", word, TOKENIZER_WORD_SIZE), -1);
+	ASSERT_EQUALS(spTokenizerGetLine(&tokenizer), 3);
+	ASSERT_EQUALS(spTokenizerReadLine(&tokenizer, word, TOKENIZER_WORD_SIZE), -1);
+	ASSERT_TRUE(spTokenizerAtEnd(&tokenizer));
+	ASSERT_TRUE(spTokenizerAtLineEnd(&tokenizer));
+	return true;
+}
+
+/*
+ * Test reading files into a reused buffer
+ */
+bool TokenizerReadFile() {
+	char* buffer = NULL;
+	size_t capacity = 0, length;
+	SPTokenizer tokenizer;
+	int value;
+
+	ASSERT_TRUE(spTokenizerReadFile("./files_for_unit_tests/features/img2.feats",
+			&buffer, &capacity, &length) == SP_TOKENIZER_SUCCESS);
+	ASSERT_TRUE(capacity == length + 1 && length == strlen(buffer));
+	spTokenizerInit(&tokenizer, buffer);
+	ASSERT_TRUE(spTokenizerReadInt(&tokenizer, &value));
+	ASSERT_EQUALS(value, 2);
+
+	// a smaller file fits the buffer
+	ASSERT_TRUE(spTokenizerReadFile("./files_for_unit_tests/features/img1.feats",
+			&buffer, &capacity, &length) == SP_TOKENIZER_SUCCESS);
+	ASSERT_TRUE(strcmp(buffer, "0\n") == 0 && length == 2);
+	ASSERT_TRUE(capacity > strlen(buffer) + 1);
+	ASSERT_TRUE(spTokenizerReadFile("./files_for_unit_tests/features/none.feats",
+			&buffer, &capacity, NULL) == SP_TOKENIZER_CANNOT_OPEN_FILE);
+	free(buffer);
+	return true;
+}
+
+/*
+ * main caller to tests of this module
+ */
+int sp_tokenizer_unit_tests() {
+	RUN_TEST(TokenizerReadDouble);
+	RUN_TEST(TokenizerReadInexactDouble);
+	RUN_TEST(TokenizerReadInt);
+	RUN_TEST(TokenizerReadWordsAndLines);
+	RUN_TEST(TokenizerReadFile);
+
+	return 0;
+}
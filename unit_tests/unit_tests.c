@@ -13,12 +13,51 @@ int main() {
 	printf("Running config utils tests\n");
 	sp_config_utils_unit_tests();
 
+	printf("Running point tests\n");
+	sp_point_unit_tests();
+
 	printf("Running kdarray tests\n");
 	sp_kd_array_unit_tests();
 
 	printf("Running kdtree tests\n");
 	sp_kd_tree_unit_tests();
 
+	printf("Running dynamic kdtree tests\n");
+	sp_dynamic_kd_tree_unit_tests();
+
+	printf("Running sharded index tests\n");
+	sp_sharded_index_unit_tests();
+
+	printf("Running arena tests\n");
+	sp_arena_unit_tests();
+
+	printf("Running pool tests\n");
+	sp_pool_unit_tests();
+
+	printf("Running pipeline tests\n");
+	sp_pipeline_unit_tests();
+
+	printf("Running projection tests\n");
+	sp_projection_unit_tests();
+
+	printf("Running features loader tests\n");
+	sp_features_loader_unit_tests();
+
+	printf("Running features serializer tests\n");
+	sp_features_serializer_unit_tests();
+
+	printf("Running tokenizer tests\n");
+	sp_tokenizer_unit_tests();
+
+	printf("Running features codec tests\n");
+	sp_features_codec_unit_tests();
+
+	printf("Running file format tests\n");
+	sp_file_format_unit_tests();
+
+	printf("Running memory tests\n");
+	sp_memory_unit_tests();
+
 	printf("Done!\n");
 
 	return 0;
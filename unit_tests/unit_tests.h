@@ -18,6 +18,11 @@ int sp_config_unit_tests();
  */
 int sp_config_utils_unit_tests();
 
+/*
+ * unit tests for SPPoint
+ */
+int sp_point_unit_tests();
+
 /*
  * unit tests for SPKDArray
  */
@@ -28,4 +33,64 @@ int sp_kd_array_unit_tests();
  */
 int sp_kd_tree_unit_tests();
 
+/*
+ * unit tests for SPDynamicKDTree
+ */
+int sp_dynamic_kd_tree_unit_tests();
+
+/*
+ * unit tests for SPShardedIndex
+ */
+int sp_sharded_index_unit_tests();
+
+/*
+ * unit tests for SPArena
+ */
+int sp_arena_unit_tests();
+
+/*
+ * unit tests for SPPool
+ */
+int sp_pool_unit_tests();
+
+/*
+ * unit tests for SPPipeline
+ */
+int sp_pipeline_unit_tests();
+
+/*
+ * unit tests for SPProjection
+ */
+int sp_projection_unit_tests();
+
+/*
+ * unit tests for SPFeaturesLoader
+ */
+int sp_features_loader_unit_tests();
+
+/*
+ * unit tests for SPFeaturesSerializer
+ */
+int sp_features_serializer_unit_tests();
+
+/*
+ * unit tests for SPTokenizer
+ */
+int sp_tokenizer_unit_tests();
+
+/*
+ * unit tests for SPFeaturesCodec
+ */
+int sp_features_codec_unit_tests();
+
+/*
+ * unit tests for SPFileFormat
+ */
+int sp_file_format_unit_tests();
+
+/*
+ * unit tests for SPMemory
+ */
+int sp_memory_unit_tests();
+
 #endif /* UNIT_TESTS_UNIT_TESTS_H_ */